@@ -32,11 +32,31 @@ Rename this file to lodepng.cpp to use it for C++, or to lodepng.c to use it for
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+/*SSE2 code for unfiltering scanlines, with an SSSE3 Paeth filter, SSSE3 Adler-32 and PCLMULQDQ
+CRC32 picked at runtime. Define LODEPNG_NO_COMPILE_SIMD to use only the plain C code.*/
+#if !defined(LODEPNG_NO_COMPILE_SIMD) && (defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__))
+#define LODEPNG_COMPILE_SIMD
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <wmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif /*LODEPNG_COMPILE_SIMD*/
 
 #ifdef LODEPNG_COMPILE_CPP
 #include <fstream>
 #endif /*LODEPNG_COMPILE_CPP*/
 
+#ifdef LODEPNG_COMPILE_THREADS
+#include <atomic>
+#include <thread>
+#endif /*LODEPNG_COMPILE_THREADS*/
+
 #define VERSION_STRING "20131222"
 
 /*
@@ -57,19 +77,141 @@ define them in your own project's source files without needing to change
 lodepng source code. Don't forget to remove "static" if you copypaste them
 from here.*/
 
+#if defined(LODEPNG_COMPILE_DECODER) || defined(LODEPNG_COMPILE_ENCODER)
+#define LODEPNG_COMPILE_ARENA
+#endif
+
+#ifdef LODEPNG_COMPILE_ARENA
+#ifdef _MSC_VER
+#define LODEPNG_THREAD_LOCAL __declspec(thread)
+#else
+#define LODEPNG_THREAD_LOCAL __thread
+#endif
+
+/*the arena that gets the allocations of this thread, if any, see arena_enter*/
+static LODEPNG_THREAD_LOCAL LodePNGArena* current_arena = 0;
+
+/*every allocation in the arena has its size in a header before it, which keeps them 16-byte aligned*/
+#define ARENA_HEADER_SIZE 16
+#define ARENA_ROUND(size) (((size) + 15) & ~(size_t)15)
+
+static void arena_init(LodePNGArena* arena)
+{
+    arena->data = 0;
+    arena->size = arena->allocsize = arena->overflow = arena->peak = 0;
+    arena->allocations = arena->fallbacks = 0;
+}
+
+static void arena_cleanup(LodePNGArena* arena)
+{
+    free(arena->data);
+    arena_init(arena);
+}
+
+static int arena_owns(const LodePNGArena* arena, const void* ptr)
+{
+    const unsigned char* p = (const unsigned char*)ptr;
+    return arena->data && p >= arena->data && p < arena->data + arena->allocsize;
+}
+
+static void arena_use(LodePNGArena* arena, size_t heapbytes)
+{
+    arena->overflow += heapbytes;
+    if (arena->size + arena->overflow > arena->peak) arena->peak = arena->size + arena->overflow;
+}
+
+static void* arena_alloc(LodePNGArena* arena, size_t size)
+{
+    size_t needed = ARENA_HEADER_SIZE + ARENA_ROUND(size);
+    arena->allocations++;
+    if (needed <= arena->allocsize - arena->size)
+    {
+        unsigned char* block = &arena->data[arena->size];
+        *(size_t*)block = size;
+        arena->size += needed;
+        arena_use(arena, 0);
+        return block + ARENA_HEADER_SIZE;
+    }
+    /*doesn't fit anymore: the heap gives it, and the arena grows by it at the reset*/
+    arena->fallbacks++;
+    arena_use(arena, needed);
+    return malloc(size);
+}
+
+static void* arena_realloc(LodePNGArena* arena, void* ptr, size_t new_size)
+{
+    unsigned char* p = (unsigned char*)ptr;
+    size_t size = *(size_t*)(p - ARENA_HEADER_SIZE);
+    size_t offset = (size_t)(p - arena->data);
+    void* result;
+    if (offset + ARENA_ROUND(size) == arena->size && offset + ARENA_ROUND(new_size) <= arena->allocsize)
+    {
+        /*the last allocation grows in place, so growing vectors are not copied*/
+        *(size_t*)(p - ARENA_HEADER_SIZE) = new_size;
+        arena->size = offset + ARENA_ROUND(new_size);
+        arena_use(arena, 0);
+        return ptr;
+    }
+    result = arena_alloc(arena, new_size);
+    if (result) memcpy(result, ptr, size < new_size ? size : new_size);
+    return result;
+}
+
+static void arena_free(LodePNGArena* arena, void* ptr)
+{
+    unsigned char* p = (unsigned char*)ptr;
+    size_t size = *(size_t*)(p - ARENA_HEADER_SIZE);
+    size_t offset = (size_t)(p - arena->data);
+    /*only the last allocation can be given back, the rest waits for the reset*/
+    if (offset + ARENA_ROUND(size) == arena->size) arena->size = offset - ARENA_HEADER_SIZE;
+}
+
+/*called when nothing is allocated in the arena anymore: grows it to what the last image needed*/
+static void arena_reset(LodePNGArena* arena)
+{
+    if (arena->peak > arena->allocsize)
+    {
+        free(arena->data);
+        arena->data = (unsigned char*)malloc(arena->peak);
+        arena->allocsize = arena->data ? arena->peak : 0;
+    }
+    arena->size = arena->overflow = arena->peak = 0;
+}
+#endif /*LODEPNG_COMPILE_ARENA*/
+
 #ifdef LODEPNG_COMPILE_ALLOCATORS
 static void* lodepng_malloc(size_t size)
 {
+#ifdef LODEPNG_COMPILE_ARENA
+    if (current_arena) return arena_alloc(current_arena, size);
+#endif /*LODEPNG_COMPILE_ARENA*/
     return malloc(size);
 }
 
 static void* lodepng_realloc(void* ptr, size_t new_size)
 {
+#ifdef LODEPNG_COMPILE_ARENA
+    if (current_arena)
+    {
+        if (!ptr) return arena_alloc(current_arena, new_size);
+        if (arena_owns(current_arena, ptr)) return arena_realloc(current_arena, ptr, new_size);
+        /*memory from before the arena was entered stays on the heap*/
+        current_arena->fallbacks++;
+        arena_use(current_arena, new_size);
+    }
+#endif /*LODEPNG_COMPILE_ARENA*/
     return realloc(ptr, new_size);
 }
 
 static void lodepng_free(void* ptr)
 {
+#ifdef LODEPNG_COMPILE_ARENA
+    if (current_arena && arena_owns(current_arena, ptr))
+    {
+        arena_free(current_arena, ptr);
+        return;
+    }
+#endif /*LODEPNG_COMPILE_ARENA*/
     free(ptr);
 }
 #else /*LODEPNG_COMPILE_ALLOCATORS*/
@@ -78,6 +220,42 @@ void* lodepng_realloc(void* ptr, size_t new_size);
 void lodepng_free(void* ptr);
 #endif /*LODEPNG_COMPILE_ALLOCATORS*/
 
+#ifdef LODEPNG_COMPILE_ARENA
+/*
+From here until arena_leave, the allocations of this thread come from the arena of the
+state if it uses one. Everything allocated in between must be freed before arena_leave,
+anything that outlives it must be allocated before arena_enter or moved out with
+arena_release. Returns the arena that got the allocations before, for arena_leave.
+*/
+static LodePNGArena* arena_enter(LodePNGState* state)
+{
+    LodePNGArena* previous = current_arena;
+    current_arena = state->use_arena ? &state->arena : 0;
+    return previous;
+}
+
+/*resets the arena, unless this was a nested use of it*/
+static void arena_leave(LodePNGState* state, LodePNGArena* previous)
+{
+    if (state->use_arena && previous != &state->arena) arena_reset(&state->arena);
+    current_arena = previous;
+}
+
+/*gives memory in the arena a heap copy that outlives it. Returns the memory that was given if it's on the heap*/
+static void* arena_release(void* ptr, size_t size)
+{
+    LodePNGArena* arena = current_arena;
+    void* result;
+    if (!arena || !ptr || !arena_owns(arena, ptr)) return ptr;
+    current_arena = 0;
+    result = lodepng_malloc(size);
+    current_arena = arena;
+    if (result) memcpy(result, ptr, size);
+    lodepng_free(ptr);
+    return result;
+}
+#endif /*LODEPNG_COMPILE_ARENA*/
+
 /* ////////////////////////////////////////////////////////////////////////// */
 /* ////////////////////////////////////////////////////////////////////////// */
 /* // Tools for C, and common code for PNG and Zlib.                       // */
@@ -114,6 +292,41 @@ Example: if(!uivector_resizev(&frequencies_ll, 286, 0)) ERROR_BREAK(83);
 if (error) return error; \
 }
 
+#ifdef LODEPNG_COMPILE_SIMD
+
+#ifdef __GNUC__
+#define LODEPNG_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define LODEPNG_TARGET_PCLMUL __attribute__((target("pclmul")))
+#else
+#define LODEPNG_TARGET_SSSE3
+#define LODEPNG_TARGET_PCLMUL
+#endif
+
+/*feature bits of CPUID leaf 1 in ECX*/
+#define CPU_PCLMUL (1u << 1)
+#define CPU_SSSE3 (1u << 9)
+
+/*returns the CPU features, only asks them once*/
+static unsigned cpuFeatures(void)
+{
+    static int asked = 0;
+    static unsigned result = 0;
+    if (!asked)
+    {
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 1);
+        result = (unsigned)info[2];
+#else
+        unsigned eax, ebx, ecx, edx;
+        result = __get_cpuid(1, &eax, &ebx, &ecx, &edx) ? ecx : 0;
+#endif
+        asked = 1;
+    }
+    return result;
+}
+#endif /*LODEPNG_COMPILE_SIMD*/
+
 /*
 About uivector, ucvector and string:
 -All of them wrap dynamic arrays or text strings in a similar way.
@@ -490,6 +703,7 @@ typedef struct HuffmanTree
     unsigned* lengths; /*the lengths of the codes of the 1d-tree*/
     unsigned maxbitlen; /*maximum number of bits a single code can get*/
     unsigned numcodes; /*number of symbols in the alphabet = number of codes*/
+    unsigned* table; /*first level lookup table of the decoder, only made when needed, see HuffmanTree_makeTable*/
 } HuffmanTree;
 
 /*function used for debug purposes to draw the tree in ascii art with C++*/
@@ -510,6 +724,7 @@ static void HuffmanTree_init(HuffmanTree* tree)
     tree->tree2d = 0;
     tree->tree1d = 0;
     tree->lengths = 0;
+    tree->table = 0;
 }
 
 static void HuffmanTree_cleanup(HuffmanTree* tree)
@@ -517,6 +732,7 @@ static void HuffmanTree_cleanup(HuffmanTree* tree)
     lodepng_free(tree->tree2d);
     lodepng_free(tree->tree1d);
     lodepng_free(tree->lengths);
+    lodepng_free(tree->table);
 }
 
 /*the tree representation used by the decoder. return value is error*/
@@ -919,6 +1135,69 @@ static unsigned huffmanDecodeSymbol(const unsigned char* in, size_t* bp,
         if (treepos >= codetree->numcodes) return (unsigned)(-1); /*error: it appeared outside the codetree*/
     }
 }
+
+/*number of bits the lookup table decodes at once. Longer codes continue in tree2d from where the table ends*/
+#define FIRSTBITS 10
+
+/*
+Fills the table entries below the tree2d node treepos, which is depth bits deep. reversed
+are the bits that lead to the node, in stream order (the first bit read is the lsb).
+An entry is (symbol << 4) | codelength, or (treepos << 4) with a length of 0 if the code
+is longer than FIRSTBITS and decoding must continue in tree2d at treepos.
+*/
+static void HuffmanTree_fillTable(HuffmanTree* tree, unsigned treepos, unsigned depth, unsigned reversed)
+{
+    unsigned bit;
+    for (bit = 0; bit < 2; bit++)
+    {
+        unsigned ct = tree->tree2d[(treepos << 1) + bit];
+        unsigned index = reversed | (bit << depth);
+        if (ct < tree->numcodes)
+        {
+            /*all entries that start with the bits of this code decode to it*/
+            for (; index < (1u << FIRSTBITS); index += 1u << (depth + 1)) tree->table[index] = (ct << 4) | (depth + 1);
+        }
+        else if (depth + 1 == FIRSTBITS) tree->table[index] = (ct - tree->numcodes) << 4;
+        else HuffmanTree_fillTable(tree, ct - tree->numcodes, depth + 1, index);
+    }
+}
+
+/*makes the lookup table from tree2d, so it decodes exactly the same symbols. return value is error*/
+static unsigned HuffmanTree_makeTable(HuffmanTree* tree)
+{
+    if (!tree->tree2d) return 83; /*the tree itself failed to allocate*/
+    tree->table = (unsigned*)lodepng_malloc((1u << FIRSTBITS) * sizeof(unsigned));
+    if (!tree->table) return 83; /*alloc fail*/
+    HuffmanTree_fillTable(tree, 0, 0, 0);
+    return 0;
+}
+
+/*
+returns the code, or (unsigned)(-1) if it points outside the codetree. bits are the next
+bits of the stream (at least 15 valid ones, the lsb first), *used gets the length of the code
+*/
+static unsigned huffmanDecodeSymbolFast(const HuffmanTree* codetree, unsigned long long bits, unsigned* used)
+{
+    unsigned entry = codetree->table[bits & ((1u << FIRSTBITS) - 1)];
+    unsigned treepos, ct, numbits = FIRSTBITS;
+    if (entry & 15)
+    {
+        *used = entry & 15;
+        return entry >> 4;
+    }
+    /*the code is longer than the table, walk the rest of it in the tree*/
+    for (treepos = entry >> 4; treepos < codetree->numcodes; treepos = ct - codetree->numcodes)
+    {
+        ct = codetree->tree2d[(treepos << 1) + (unsigned)((bits >> numbits) & 1)];
+        numbits++;
+        if (ct < codetree->numcodes)
+        {
+            *used = numbits;
+            return ct;
+        }
+    }
+    return (unsigned)(-1);
+}
 #endif /*LODEPNG_COMPILE_DECODER*/
 
 #ifdef LODEPNG_COMPILE_DECODER
@@ -1083,9 +1362,133 @@ static unsigned getTreeInflateDynamic(HuffmanTree* tree_ll, HuffmanTree* tree_d,
     return error;
 }
 
+/*
+Lets the inflator hand over its output while decoding, instead of keeping all of it. When the
+out buffer is full, the bytes before the last 32KB (as far back as a distance can go) are given
+to flush and dropped from the buffer.
+*/
+typedef struct InflateStream
+{
+    unsigned (*flush)(void* context, const unsigned char* data, size_t size); /*return value is error*/
+    void* context;
+    unsigned adler; /*adler32 of the flushed bytes*/
+    size_t kept; /*the bytes at the start of the buffer were already flushed, they're kept for distances*/
+} InflateStream;
+
+#define INFLATE_WINDOW_SIZE 32768
+
+static unsigned update_adler32(unsigned adler, const unsigned char* data, unsigned len);
+
+static unsigned InflateStream_flush(InflateStream* stream, const unsigned char* data, size_t size)
+{
+    stream->adler = update_adler32(stream->adler, data, (unsigned)size);
+    return stream->flush(stream->context, data, size);
+}
+
+/*makes room in out for the bytes before end, which moves *pos back if it flushes. return value is error*/
+static unsigned inflateReserve(ucvector* out, size_t* pos, size_t end, InflateStream* stream)
+{
+    if (end <= out->size) return 0;
+    if (stream && (*pos) >= stream->kept + INFLATE_WINDOW_SIZE)
+    {
+        size_t start = (*pos) - INFLATE_WINDOW_SIZE;
+        size_t needed = end - (*pos);
+        CERROR_TRY_RETURN(InflateStream_flush(stream, &out->data[stream->kept], (*pos) - stream->kept));
+        memmove(out->data, &out->data[start], INFLATE_WINDOW_SIZE);
+        stream->kept = INFLATE_WINDOW_SIZE;
+        (*pos) = INFLATE_WINDOW_SIZE;
+        end = (*pos) + needed;
+        if (end <= out->size) return 0;
+    }
+    /*reserve more room at once*/
+    if (!ucvector_resize(out, end * 2)) return 83; /*alloc fail*/
+    return 0;
+}
+
+/*reads 8 bytes as a little endian 64-bit value*/
+static unsigned long long readUint64LE(const unsigned char* buffer)
+{
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+    unsigned long long result;
+    memcpy(&result, buffer, 8); /*little endian and unaligned loads are fine on x86*/
+    return result;
+#else
+    unsigned long long result = 0;
+    unsigned i;
+    for (i = 0; i < 8; i++) result |= (unsigned long long)buffer[i] << (8 * i);
+    return result;
+#endif
+}
+
+/*
+Decodes symbols with the lookup tables of the trees while 8 bytes of input are left, which
+is always enough for a literal or a whole length/distance pair. Stops without consuming the
+end code or anything that isn't valid, the regular decoder continues from there and handles
+those (and the last bytes of input) exactly as it does without this. return value is error
+*/
+static unsigned inflateHuffmanBlockFast(ucvector* out, const unsigned char* in, size_t* bp, size_t* pos,
+                                        size_t inlength, const HuffmanTree* tree_ll, const HuffmanTree* tree_d,
+                                        InflateStream* stream)
+{
+    while (((*bp) >> 3) + 8 <= inlength)
+    {
+        /*at least 57 valid bits, a length/distance pair takes at most 15 + 5 + 15 + 13 of them*/
+        unsigned long long bits = readUint64LE(&in[(*bp) >> 3]) >> ((*bp) & 0x7);
+        unsigned used, numbits;
+        unsigned code_ll = huffmanDecodeSymbolFast(tree_ll, bits, &used);
+        if (code_ll <= 255) /*literal symbol*/
+        {
+            CERROR_TRY_RETURN(inflateReserve(out, pos, (*pos) + 1, stream));
+            out->data[(*pos)++] = (unsigned char)code_ll;
+            (*bp) += used;
+        }
+        else if (code_ll >= FIRST_LENGTH_CODE_INDEX && code_ll <= LAST_LENGTH_CODE_INDEX) /*length code*/
+        {
+            unsigned code_d, distance, length, numextrabits;
+            unsigned char* dest;
+            const unsigned char* source;
+
+            numextrabits = LENGTHEXTRA[code_ll - FIRST_LENGTH_CODE_INDEX];
+            length = LENGTHBASE[code_ll - FIRST_LENGTH_CODE_INDEX] + (unsigned)((bits >> used) & ((1u << numextrabits) - 1));
+            used += numextrabits;
+
+            code_d = huffmanDecodeSymbolFast(tree_d, bits >> used, &numbits);
+            if (code_d > 29) return 0; /*invalid distance code, let the regular decoder report it*/
+            used += numbits;
+            numextrabits = DISTANCEEXTRA[code_d];
+            distance = DISTANCEBASE[code_d] + (unsigned)((bits >> used) & ((1u << numextrabits) - 1));
+            used += numextrabits;
+            if (distance > (*pos)) return 0; /*too long backward distance, same*/
+
+            /*the 8 byte copies below can write up to 7 bytes past the end*/
+            CERROR_TRY_RETURN(inflateReserve(out, pos, (*pos) + length + 8, stream));
+
+            dest = &out->data[*pos];
+            source = dest - distance;
+            if (distance >= 8)
+            {
+                /*8 byte chunks never overlap themselves at this distance*/
+                unsigned char* end = dest + length;
+                for (; dest < end; dest += 8, source += 8) memcpy(dest, source, 8);
+            }
+            else if (distance == 1) memset(dest, *source, length);
+            else
+            {
+                unsigned i;
+                for (i = 0; i < length; i++) dest[i] = source[i];
+            }
+            (*pos) += length;
+            (*bp) += used;
+        }
+        else return 0; /*end code or an invalid symbol*/
+    }
+    return 0;
+}
+
 /*inflate a block with dynamic of fixed Huffman tree*/
 static unsigned inflateHuffmanBlock(ucvector* out, const unsigned char* in, size_t* bp,
-                                    size_t* pos, size_t inlength, unsigned btype)
+                                    size_t* pos, size_t inlength, unsigned btype,
+                                    const LodePNGDecompressSettings* settings, InflateStream* stream)
 {
     unsigned error = 0;
     HuffmanTree tree_ll; /*the huffman tree for literal and length codes*/
@@ -1098,17 +1501,21 @@ static unsigned inflateHuffmanBlock(ucvector* out, const unsigned char* in, size
     if (btype == 1) getTreeInflateFixed(&tree_ll, &tree_d);
     else if (btype == 2) error = getTreeInflateDynamic(&tree_ll, &tree_d, in, bp, inlength);
 
+    if (!error && settings->fast_inflate)
+    {
+        error = HuffmanTree_makeTable(&tree_ll);
+        if (!error) error = HuffmanTree_makeTable(&tree_d);
+        if (!error) error = inflateHuffmanBlockFast(out, in, bp, pos, inlength, &tree_ll, &tree_d, stream);
+    }
+
     while (!error) /*decode all symbols until end reached, breaks at end code*/
     {
         /*code_ll is literal, length or end code*/
         unsigned code_ll = huffmanDecodeSymbol(in, bp, &tree_ll, inbitlength);
         if (code_ll <= 255) /*literal symbol*/
         {
-            if ((*pos) >= out->size)
-            {
-                /*reserve more room at once*/
-                if (!ucvector_resize(out, ((*pos) + 1) * 2)) ERROR_BREAK(83 /*alloc fail*/);
-            }
+            error = inflateReserve(out, pos, (*pos) + 1, stream);
+            if (error) break;
             out->data[(*pos)] = (unsigned char)(code_ll);
             (*pos)++;
         }
@@ -1148,14 +1555,11 @@ static unsigned inflateHuffmanBlock(ucvector* out, const unsigned char* in, size
             distance += readBitsFromStream(bp, in, numextrabits_d);
 
             /*part 5: fill in all the out[n] values based on the length and dist*/
+            if (distance > (*pos)) ERROR_BREAK(52); /*too long backward distance*/
+            error = inflateReserve(out, pos, (*pos) + length, stream);
+            if (error) break;
             start = (*pos);
-            if (distance > start) ERROR_BREAK(52); /*too long backward distance*/
             backward = start - distance;
-            if ((*pos) + length >= out->size)
-            {
-                /*reserve more room at once*/
-                if (!ucvector_resize(out, ((*pos) + length) * 2)) ERROR_BREAK(83 /*alloc fail*/);
-            }
 
             for (forward = 0; forward < length; forward++)
             {
@@ -1184,7 +1588,8 @@ static unsigned inflateHuffmanBlock(ucvector* out, const unsigned char* in, size
     return error;
 }
 
-static unsigned inflateNoCompression(ucvector* out, const unsigned char* in, size_t* bp, size_t* pos, size_t inlength)
+static unsigned inflateNoCompression(ucvector* out, const unsigned char* in, size_t* bp, size_t* pos, size_t inlength,
+                                     InflateStream* stream)
 {
     /*go to first boundary of byte*/
     size_t p;
@@ -1200,10 +1605,7 @@ static unsigned inflateNoCompression(ucvector* out, const unsigned char* in, siz
     /*check if 16-bit NLEN is really the one's complement of LEN*/
     if (LEN + NLEN != 65535) return 21; /*error: NLEN is not one's complement of LEN*/
 
-    if ((*pos) + LEN >= out->size)
-    {
-        if (!ucvector_resize(out, (*pos) + LEN)) return 83; /*alloc fail*/
-    }
+    CERROR_TRY_RETURN(inflateReserve(out, pos, (*pos) + LEN, stream));
 
     /*read the literal data: LEN bytes are now stored in the out buffer*/
     if (p + LEN > inlength) return 23; /*error: reading outside of in buffer*/
@@ -1214,9 +1616,10 @@ static unsigned inflateNoCompression(ucvector* out, const unsigned char* in, siz
     return error;
 }
 
+/*with stream, out ends up with the last bytes that weren't flushed yet, and flushes those too*/
 static unsigned lodepng_inflatev(ucvector* out,
                                  const unsigned char* in, size_t insize,
-                                 const LodePNGDecompressSettings* settings)
+                                 const LodePNGDecompressSettings* settings, InflateStream* stream)
 {
     /*bit pointer in the "in" data, current byte is bp >> 3, current bit is bp & 0x7 (from lsb to msb of the byte)*/
     size_t bp = 0;
@@ -1225,8 +1628,6 @@ static unsigned lodepng_inflatev(ucvector* out,
 
     unsigned error = 0;
 
-    (void)settings;
-
     while (!BFINAL)
     {
         unsigned BTYPE;
@@ -1236,12 +1637,14 @@ static unsigned lodepng_inflatev(ucvector* out,
         BTYPE += 2 * readBitFromStream(&bp, in);
 
         if (BTYPE == 3) return 20; /*error: invalid BTYPE*/
-        else if (BTYPE == 0) error = inflateNoCompression(out, in, &bp, &pos, insize); /*no compression*/
-        else error = inflateHuffmanBlock(out, in, &bp, &pos, insize, BTYPE); /*compression, BTYPE 01 or 10*/
+        else if (BTYPE == 0) error = inflateNoCompression(out, in, &bp, &pos, insize, stream); /*no compression*/
+        else error = inflateHuffmanBlock(out, in, &bp, &pos, insize, BTYPE, settings, stream); /*compression, BTYPE 01 or 10*/
 
         if (error) return error;
     }
 
+    if (stream) CERROR_TRY_RETURN(InflateStream_flush(stream, &out->data[stream->kept], pos - stream->kept));
+
     /*Only now we know the true size of out, resize it to that*/
     if (!ucvector_resize(out, pos)) error = 83; /*alloc fail*/
 
@@ -1255,7 +1658,7 @@ unsigned lodepng_inflate(unsigned char** out, size_t* outsize,
     unsigned error;
     ucvector v;
     ucvector_init_buffer(&v, *out, *outsize);
-    error = lodepng_inflatev(&v, in, insize, settings);
+    error = lodepng_inflatev(&v, in, insize, settings, 0);
     *out = v.data;
     *outsize = v.size;
     return error;
@@ -1356,22 +1759,39 @@ typedef struct Hash
     /*circular pos to prev circular pos*/
     unsigned short* chain;
     unsigned short* zeros;
+    /*for LCL_FAST: the FAST_BUCKET_WAYS latest positions per fast hash value, newest first. Else null*/
+    int* bucket;
 } Hash;
 
-static unsigned hash_init(Hash* hash, unsigned windowsize)
+static const unsigned FAST_HASH_BITS = 15;
+static const unsigned FAST_BUCKET_WAYS = 4;
+
+static void hash_clear(Hash* hash, unsigned windowsize)
 {
     unsigned i;
+    for (i = 0; i < HASH_NUM_VALUES; i++) hash->head[i] = -1;
+    for (i = 0; i < windowsize; i++) hash->val[i] = -1;
+    for (i = 0; i < windowsize; i++) hash->chain[i] = i; /*same value as index indicates uninitialized*/
+    if (hash->bucket)
+    {
+        for (i = 0; i < (FAST_BUCKET_WAYS << FAST_HASH_BITS); i++) hash->bucket[i] = -1;
+    }
+}
+
+static unsigned hash_init(Hash* hash, unsigned windowsize, LodePNGCompressLevel level)
+{
     hash->head = (int*)lodepng_malloc(sizeof(int) * HASH_NUM_VALUES);
     hash->val = (int*)lodepng_malloc(sizeof(int) * windowsize);
     hash->chain = (unsigned short*)lodepng_malloc(sizeof(unsigned short) * windowsize);
     hash->zeros = (unsigned short*)lodepng_malloc(sizeof(unsigned short) * windowsize);
+    hash->bucket = 0;
+    if (level == LCL_FAST) hash->bucket = (int*)lodepng_malloc(sizeof(int) * (FAST_BUCKET_WAYS << FAST_HASH_BITS));
 
     if (!hash->head || !hash->val || !hash->chain || !hash->zeros) return 83; /*alloc fail*/
+    if (level == LCL_FAST && !hash->bucket) return 83; /*alloc fail*/
 
     /*initialize hash table*/
-    for (i = 0; i < HASH_NUM_VALUES; i++) hash->head[i] = -1;
-    for (i = 0; i < windowsize; i++) hash->val[i] = -1;
-    for (i = 0; i < windowsize; i++) hash->chain[i] = i; /*same value as index indicates uninitialized*/
+    hash_clear(hash, windowsize);
 
     return 0;
 }
@@ -1382,6 +1802,7 @@ static void hash_cleanup(Hash* hash)
     lodepng_free(hash->val);
     lodepng_free(hash->chain);
     lodepng_free(hash->zeros);
+    lodepng_free(hash->bucket);
 }
 
 static unsigned getHash(const unsigned char* data, size_t size, size_t pos)
@@ -1423,6 +1844,131 @@ static void updateHashChain(Hash* hash, size_t wpos, int hashval)
     hash->head[hashval] = wpos;
 }
 
+/*
+Puts pos in the hash chains. numzeros tracks the run of zeros at pos from one position
+to the next. Returns the hash value of pos.
+*/
+static unsigned hash_insert(Hash* hash, const unsigned char* in, size_t insize, size_t pos,
+                            unsigned windowsize, unsigned usezeros, unsigned* numzeros)
+{
+    size_t wpos = pos & (windowsize - 1);
+    unsigned hashval = getHash(in, insize, pos);
+    updateHashChain(hash, wpos, hashval);
+    if (usezeros && hashval == 0)
+    {
+        if (*numzeros == 0) *numzeros = countZeros(in, insize, pos);
+        else if (pos + *numzeros >= insize || in[pos + *numzeros - 1] != 0) (*numzeros)--;
+        hash->zeros[wpos] = *numzeros;
+    }
+    else
+    {
+        *numzeros = 0;
+    }
+    return hashval;
+}
+
+/*hash of the 3 bytes at pos for the LCL_FAST buckets, pos + 3 must be <= the size*/
+static unsigned getFastHash(const unsigned char* data, size_t pos)
+{
+    unsigned bytes = data[pos] | (data[pos + 1] << 8) | (data[pos + 2] << 16);
+    return (bytes * 2654435761u) >> (32 - FAST_HASH_BITS);
+}
+
+/*puts pos in front of its bucket, the oldest position in it falls out*/
+static void fastHashInsert(Hash* hash, const unsigned char* in, size_t insize, size_t pos)
+{
+    int* bucket;
+    unsigned i;
+    if (pos + 3 > insize) return;
+    bucket = &hash->bucket[getFastHash(in, pos) * FAST_BUCKET_WAYS];
+    for (i = FAST_BUCKET_WAYS - 1; i > 0; i--) bucket[i] = bucket[i - 1];
+    bucket[0] = (int)pos;
+}
+
+#ifdef LODEPNG_COMPILE_THREADS
+/*
+Puts the positions from start to end in the hash the way the LZ77 encoders do, without
+encoding them. An independently encoded block can then refer back to the data before it.
+*/
+static void hash_prime(Hash* hash, const unsigned char* in, size_t start, size_t end, unsigned windowsize)
+{
+    size_t pos;
+    unsigned numzeros = 0;
+    for (pos = start; pos < end; pos++)
+    {
+        if (hash->bucket) fastHashInsert(hash, in, end, pos);
+        else hash_insert(hash, in, end, pos, windowsize, 1, &numzeros);
+    }
+}
+#endif /*LODEPNG_COMPILE_THREADS*/
+
+/*
+Walks the hash chain of pos, which must already be in the hash, for the longest earlier
+string that matches the one at pos. length is 0 if there is none.
+*/
+static void findLongestMatch(const Hash* hash, const unsigned char* in, size_t pos, size_t insize,
+                             unsigned windowsize, unsigned hashval, unsigned numzeros, unsigned usezeros,
+                             unsigned maxchainlength, unsigned nicematch, unsigned* length, unsigned* offset)
+{
+    size_t wpos = pos & (windowsize - 1);
+    unsigned chainlength = 0;
+    unsigned current_offset, current_length;
+    const unsigned char *lastptr, *foreptr, *backptr;
+    unsigned prevpos = hash->head[hashval];
+    unsigned hashpos = hash->chain[prevpos];
+
+    *length = 0;
+    *offset = 0;
+
+    lastptr = &in[insize < pos + MAX_SUPPORTED_DEFLATE_LENGTH ? insize : pos + MAX_SUPPORTED_DEFLATE_LENGTH];
+
+    for (;;)
+    {
+        /*stop when went completely around the circular buffer*/
+        if (prevpos < wpos && hashpos > prevpos && hashpos <= wpos) break;
+        if (prevpos > wpos && (hashpos <= wpos || hashpos > prevpos)) break;
+        if (chainlength++ >= maxchainlength) break;
+
+        current_offset = hashpos <= wpos ? wpos - hashpos : wpos - hashpos + windowsize;
+        if (current_offset > 0)
+        {
+            /*test the next characters*/
+            foreptr = &in[pos];
+            backptr = &in[pos - current_offset];
+
+            /*common case in PNGs is lots of zeros. Quickly skip over them as a speedup*/
+            if (usezeros && hashval == 0 && hash->val[hashpos] == 0 /*hashval[hashpos] may be out of date*/)
+            {
+                unsigned skip = hash->zeros[hashpos];
+                if (skip > numzeros) skip = numzeros;
+                backptr += skip;
+                foreptr += skip;
+            }
+
+            while (foreptr != lastptr && *backptr == *foreptr) /*maximum supported length by deflate is max length*/
+            {
+                ++backptr;
+                ++foreptr;
+            }
+            current_length = (unsigned)(foreptr - &in[pos]);
+
+            if (current_length > *length)
+            {
+                *length = current_length; /*the longest length*/
+                *offset = current_offset; /*the offset that is related to this longest length*/
+                /*jump out once a length of max length is found (speed gain). This also jumps
+                out if length is MAX_SUPPORTED_DEFLATE_LENGTH*/
+                if (current_length >= nicematch) break;
+            }
+        }
+
+        if (hashpos == hash->chain[hashpos]) break;
+
+        prevpos = hashpos;
+        hashpos = hash->chain[hashpos];
+    }
+}
+
 /*
 LZ77-encode the data. Return value is error code. The input are raw bytes, the output
 is in the form of unsigned integers with codes representing for example literal bytes, or
@@ -1449,9 +1995,6 @@ static unsigned encodeLZ77(uivector* out, Hash* hash,
     unsigned lazy = 0;
     unsigned lazylength = 0, lazyoffset = 0;
     unsigned hashval;
-    unsigned current_offset, current_length;
-    const unsigned char *lastptr, *foreptr, *backptr;
-    unsigned hashpos, prevpos;
 
     if (windowsize <= 0 || windowsize > 32768) return 60; /*error: windowsize smaller/larger than allowed*/
     if ((windowsize & (windowsize - 1)) != 0) return 90; /*error: must be power of two*/
@@ -1460,145 +2003,290 @@ static unsigned encodeLZ77(uivector* out, Hash* hash,
 
     for (pos = inpos; pos < insize; pos++)
     {
-        size_t wpos = pos & (windowsize - 1); /*position for in 'circular' hash buffers*/
-        unsigned chainlength = 0;
+        hashval = hash_insert(hash, in, insize, pos, windowsize, usezeros, &numzeros);
 
-        hashval = getHash(in, insize, pos);
-        updateHashChain(hash, wpos, hashval);
+        /*search for the longest string*/
+        findLongestMatch(hash, in, pos, insize, windowsize, hashval, numzeros, usezeros,
+                         maxchainlength, nicematch, &length, &offset);
 
-        if (usezeros && hashval == 0)
+        if (lazymatching)
         {
-            if (numzeros == 0) numzeros = countZeros(in, insize, pos);
-            else if (pos + numzeros >= insize || in[pos + numzeros - 1] != 0) numzeros--;
-            hash->zeros[wpos] = numzeros;
+            if (!lazy && length >= 3 && length <= maxlazymatch && length < MAX_SUPPORTED_DEFLATE_LENGTH)
+            {
+                lazy = 1;
+                lazylength = length;
+                lazyoffset = offset;
+                continue; /*try the next byte*/
+            }
+            if (lazy)
+            {
+                lazy = 0;
+                if (pos == 0) ERROR_BREAK(81);
+                if (length > lazylength + 1)
+                {
+                    /*push the previous character as literal*/
+                    if (!uivector_push_back(out, in[pos - 1])) ERROR_BREAK(83 /*alloc fail*/);
+                }
+                else
+                {
+                    length = lazylength;
+                    offset = lazyoffset;
+                    hash->head[hashval] = -1; /*the same hashchain update will be done, this ensures no wrong alteration*/
+                    pos--;
+                }
+            }
+        }
+        if (length >= 3 && offset > windowsize) ERROR_BREAK(86 /*too big (or overflown negative) offset*/);
+
+        /*encode it as length/distance pair or literal value*/
+        if (length < 3) /*only lengths of 3 or higher are supported as length/distance pair*/
+        {
+            if (!uivector_push_back(out, in[pos])) ERROR_BREAK(83 /*alloc fail*/);
+        }
+        else if (length < minmatch || (length == 3 && offset > 4096))
+        {
+            /*compensate for the fact that longer offsets have more extra bits, a
+            length of only 3 may be not worth it then*/
+            if (!uivector_push_back(out, in[pos])) ERROR_BREAK(83 /*alloc fail*/);
         }
         else
         {
-            numzeros = 0;
+            addLengthDistance(out, length, offset);
+            for (i = 1; i < length; i++)
+            {
+                pos++;
+                hash_insert(hash, in, insize, pos, windowsize, usezeros, &numzeros);
+            }
         }
+    } /*end of the loop through each character of input*/
 
-        /*the length and offset found for the current position*/
-        length = 0;
-        offset = 0;
-
-        prevpos = hash->head[hashval];
-        hashpos = hash->chain[prevpos];
-
-        lastptr = &in[insize < pos + MAX_SUPPORTED_DEFLATE_LENGTH ? insize : pos + MAX_SUPPORTED_DEFLATE_LENGTH];
+    return error;
+}
 
-        /*search for the longest string*/
-        for (;;)
+/*
+LZ77-encode the data for LCL_FAST: greedy, with only the FAST_BUCKET_WAYS latest positions
+that had the same hash as candidates. Matches up to 32768 bytes back are used.
+*/
+static unsigned encodeLZ77Fast(uivector* out, Hash* hash, const unsigned char* in, size_t inpos, size_t insize)
+{
+    size_t pos = inpos;
+    while (pos < insize)
+    {
+        unsigned length = 0, offset = 0, i;
+        if (pos + 3 <= insize)
         {
-            /*stop when went completely around the circular buffer*/
-            if (prevpos < wpos && hashpos > prevpos && hashpos <= wpos) break;
-            if (prevpos > wpos && (hashpos <= wpos || hashpos > prevpos)) break;
-            if (chainlength++ >= maxchainlength) break;
-
-            current_offset = hashpos <= wpos ? wpos - hashpos : wpos - hashpos + windowsize;
-            if (current_offset > 0)
+            const unsigned char* lastptr = &in[insize < pos + MAX_SUPPORTED_DEFLATE_LENGTH ?
+                                               insize : pos + MAX_SUPPORTED_DEFLATE_LENGTH];
+            const int* bucket = &hash->bucket[getFastHash(in, pos) * FAST_BUCKET_WAYS];
+            for (i = 0; i < FAST_BUCKET_WAYS; i++)
             {
-                /*test the next characters*/
-                foreptr = &in[pos];
-                backptr = &in[pos - current_offset];
-
-                /*common case in PNGs is lots of zeros. Quickly skip over them as a speedup*/
-                if (usezeros && hashval == 0 && hash->val[hashpos] == 0 /*hashval[hashpos] may be out of date*/)
-                {
-                    unsigned skip = hash->zeros[hashpos];
-                    if (skip > numzeros) skip = numzeros;
-                    backptr += skip;
-                    foreptr += skip;
-                }
-
-                while (foreptr != lastptr && *backptr == *foreptr) /*maximum supported length by deflate is max length*/
+                const unsigned char* foreptr = &in[pos];
+                const unsigned char* backptr;
+                if (bucket[i] < 0 || pos - bucket[i] > 32768) break; /*the older ones are out of the window too*/
+                if (length >= (unsigned)(lastptr - foreptr)) break; /*can't get longer*/
+                backptr = &in[bucket[i]];
+                if (backptr[length] != foreptr[length]) continue; /*can't be longer than the one found*/
+                while (foreptr != lastptr && *backptr == *foreptr)
                 {
                     ++backptr;
                     ++foreptr;
                 }
-                current_length = (unsigned)(foreptr - &in[pos]);
+                if ((unsigned)(foreptr - &in[pos]) > length)
+                {
+                    length = (unsigned)(foreptr - &in[pos]);
+                    offset = (unsigned)(pos - bucket[i]);
+                }
+            }
+        }
+        fastHashInsert(hash, in, insize, pos);
+
+        if (length < 3 || (length == 3 && offset > 4096))
+        {
+            if (!uivector_push_back(out, in[pos])) return 83; /*alloc fail*/
+            pos++;
+        }
+        else
+        {
+            addLengthDistance(out, length, offset);
+            for (i = 1; i < length; i++) fastHashInsert(hash, in, insize, pos + i);
+            pos += length;
+        }
+    }
+    return 0;
+}
+
+/*max hash chain walk per position for LCL_BEST*/
+static const unsigned BEST_MAX_CHAIN_LENGTH = 256;
+/*times LCL_BEST parses again with the Huffman code lengths of the previous parse*/
+static const unsigned BEST_NUM_PASSES = 2;
+
+/*
+Finds the cheapest parse of the n bytes at in given the longest match at each position, where
+litlenbits and distbits are the code lengths of the lit/len and dist symbols. A match may be
+cut short to any length of 3 or more. Writes in steps[i] the length of the literal (1) or
+match that starts at i for the positions i where one starts in the parse.
+*/
+static void lz77CheapestParse(unsigned short* steps, size_t* cost, const unsigned char* in, size_t n,
+                              const unsigned short* matchlength, const unsigned short* matchoffset,
+                              const unsigned* litlenbits, const unsigned* distbits)
+{
+    unsigned lengthbits[MAX_SUPPORTED_DEFLATE_LENGTH + 1];
+    size_t i, j;
+    unsigned length;
 
-                if (current_length > length)
+    for (length = 3; length <= MAX_SUPPORTED_DEFLATE_LENGTH; length++)
+    {
+        unsigned length_code = (unsigned)searchCodeIndex(LENGTHBASE, 29, length);
+        lengthbits[length] = litlenbits[FIRST_LENGTH_CODE_INDEX + length_code] + LENGTHEXTRA[length_code];
+    }
+
+    /*cost[i] is the fewest bits for the first i bytes, steps[i] the last literal or match of that*/
+    cost[0] = 0;
+    for (i = 1; i <= n; i++) cost[i] = (size_t)(-1);
+    for (i = 0; i < n; i++)
+    {
+        size_t current = cost[i] + litlenbits[in[i]];
+        if (current < cost[i + 1])
+        {
+            cost[i + 1] = current;
+            steps[i + 1] = 1;
+        }
+        if (matchlength[i])
+        {
+            unsigned dist_code = (unsigned)searchCodeIndex(DISTANCEBASE, 30, matchoffset[i]);
+            size_t matchcost = cost[i] + distbits[dist_code] + DISTANCEEXTRA[dist_code];
+            for (length = 3; length <= matchlength[i]; length++)
+            {
+                current = matchcost + lengthbits[length];
+                if (current < cost[i + length])
                 {
-                    length = current_length; /*the longest length*/
-                    offset = current_offset; /*the offset that is related to this longest length*/
-                    /*jump out once a length of max length is found (speed gain). This also jumps
-                    out if length is MAX_SUPPORTED_DEFLATE_LENGTH*/
-                    if (current_length >= nicematch) break;
+                    cost[i + length] = current;
+                    steps[i + length] = (unsigned short)length;
                 }
             }
+        }
+    }
+
+    /*walk back from the end and move each step to where it starts*/
+    length = n ? steps[n] : 0;
+    for (i = n; i > 0; i = j)
+    {
+        unsigned previous;
+        j = i - length;
+        previous = j > 0 ? steps[j] : 0;
+        steps[j] = (unsigned short)length;
+        length = previous;
+    }
+}
 
-            if (hashpos == hash->chain[hashpos]) break;
+/*
+LZ77-encode the data for LCL_BEST. The longest match at each position is searched once
+over the full window, then the data is parsed for the fewest bits: first with the code
+lengths of the fixed trees, then numpasses times with Huffman code lengths from the
+symbols of the previous parse.
+*/
+static unsigned encodeLZ77Best(uivector* out, Hash* hash, const unsigned char* in, size_t inpos, size_t insize,
+                               unsigned numpasses)
+{
+    const unsigned windowsize = 32768;
+    unsigned error = 0;
+    unsigned numzeros = 0, skip = 0, pass;
+    unsigned litlenbits[288], distbits[30];
+    size_t n = insize - inpos, i;
+    unsigned short* matchlength = (unsigned short*)lodepng_malloc(sizeof(unsigned short) * (n + 1));
+    unsigned short* matchoffset = (unsigned short*)lodepng_malloc(sizeof(unsigned short) * (n + 1));
+    unsigned short* steps = (unsigned short*)lodepng_malloc(sizeof(unsigned short) * (n + 1));
+    size_t* cost = (size_t*)lodepng_malloc(sizeof(size_t) * (n + 1));
 
-            prevpos = hashpos;
-            hashpos = hash->chain[hashpos];
-        }
+    while (!error)
+    {
+        if (!matchlength || !matchoffset || !steps || !cost) ERROR_BREAK(83 /*alloc fail*/);
 
-        if (lazymatching)
+        for (i = 0; i < n; i++)
         {
-            if (!lazy && length >= 3 && length <= maxlazymatch && length < MAX_SUPPORTED_DEFLATE_LENGTH)
+            unsigned hashval = hash_insert(hash, in, insize, inpos + i, windowsize, 1, &numzeros);
+            unsigned length = 0, offset = 0;
+            if (skip) skip--;
+            else
             {
-                lazy = 1;
-                lazylength = length;
-                lazyoffset = offset;
-                continue; /*try the next byte*/
+                findLongestMatch(hash, in, inpos + i, insize, windowsize, hashval, numzeros, 1,
+                                 BEST_MAX_CHAIN_LENGTH, MAX_SUPPORTED_DEFLATE_LENGTH, &length, &offset);
+                /*the parse will nearly always take a match of the max length, so don't search inside it*/
+                if (length == MAX_SUPPORTED_DEFLATE_LENGTH) skip = length - 1;
             }
-            if (lazy)
+            matchlength[i] = (unsigned short)(length < 3 ? 0 : length);
+            matchoffset[i] = (unsigned short)offset;
+        }
+
+        /*the fixed trees*/
+        for (i = 0; i < 288; i++) litlenbits[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+        for (i = 0; i < 30; i++) distbits[i] = 5;
+
+        for (pass = 0;; pass++)
+        {
+            unsigned frequencies_ll[288], frequencies_d[30];
+
+            lz77CheapestParse(steps, cost, &in[inpos], n, matchlength, matchoffset, litlenbits, distbits);
+            if (pass == numpasses) break;
+
+            /*code lengths for the symbols of this parse. Each symbol is counted once more so that
+            unused ones don't get length 0 and are still priced*/
+            for (i = 0; i < 288; i++) frequencies_ll[i] = 1;
+            for (i = 0; i < 30; i++) frequencies_d[i] = 1;
+            for (i = 0; i < n; i += steps[i])
             {
-                lazy = 0;
-                if (pos == 0) ERROR_BREAK(81);
-                if (length > lazylength + 1)
-                {
-                    /*push the previous character as literal*/
-                    if (!uivector_push_back(out, in[pos - 1])) ERROR_BREAK(83 /*alloc fail*/);
-                }
+                if (steps[i] == 1) frequencies_ll[in[inpos + i]]++;
                 else
                 {
-                    length = lazylength;
-                    offset = lazyoffset;
-                    hash->head[hashval] = -1; /*the same hashchain update will be done, this ensures no wrong alteration*/
-                    pos--;
+                    frequencies_ll[FIRST_LENGTH_CODE_INDEX + searchCodeIndex(LENGTHBASE, 29, steps[i])]++;
+                    frequencies_d[searchCodeIndex(DISTANCEBASE, 30, matchoffset[i])]++;
                 }
             }
+            error = lodepng_huffman_code_lengths(litlenbits, frequencies_ll, 286, 15);
+            if (!error) error = lodepng_huffman_code_lengths(distbits, frequencies_d, 30, 15);
+            if (error) break;
         }
-        if (length >= 3 && offset > windowsize) ERROR_BREAK(86 /*too big (or overflown negative) offset*/);
+        if (error) break;
 
-        /*encode it as length/distance pair or literal value*/
-        if (length < 3) /*only lengths of 3 or higher are supported as length/distance pair*/
-        {
-            if (!uivector_push_back(out, in[pos])) ERROR_BREAK(83 /*alloc fail*/);
-        }
-        else if (length < minmatch || (length == 3 && offset > 4096))
-        {
-            /*compensate for the fact that longer offsets have more extra bits, a
-            length of only 3 may be not worth it then*/
-            if (!uivector_push_back(out, in[pos])) ERROR_BREAK(83 /*alloc fail*/);
-        }
-        else
+        for (i = 0; i < n; i += steps[i])
         {
-            addLengthDistance(out, length, offset);
-            for (i = 1; i < length; i++)
+            if (steps[i] == 1)
             {
-                pos++;
-                wpos = pos & (windowsize - 1);
-                hashval = getHash(in, insize, pos);
-                updateHashChain(hash, wpos, hashval);
-                if (usezeros && hashval == 0)
-                {
-                    if (numzeros == 0) numzeros = countZeros(in, insize, pos);
-                    else if (pos + numzeros >= insize || in[pos + numzeros - 1] != 0) numzeros--;
-                    hash->zeros[wpos] = numzeros;
-                }
-                else
-                {
-                    numzeros = 0;
-                }
+                if (!uivector_push_back(out, in[inpos + i])) ERROR_BREAK(83 /*alloc fail*/);
             }
+            else addLengthDistance(out, steps[i], matchoffset[i]);
         }
-    } /*end of the loop through each character of input*/
 
+        break; /*end of error-while*/
+    }
+
+    lodepng_free(matchlength);
+    lodepng_free(matchoffset);
+    lodepng_free(steps);
+    lodepng_free(cost);
     return error;
 }
 
+/*the window the LZ77 encoder of settings->level works with*/
+static unsigned lz77WindowSize(const LodePNGCompressSettings* settings)
+{
+    return settings->level == LCL_DEFAULT ? settings->windowsize : 32768;
+}
+
+/*LZ77-encodes with the encoder of settings->level*/
+static unsigned encodeLZ77Level(uivector* out, Hash* hash, const unsigned char* in, size_t inpos, size_t insize,
+                                const LodePNGCompressSettings* settings)
+{
+    if (settings->level == LCL_FAST) return encodeLZ77Fast(out, hash, in, inpos, insize);
+    if (settings->level == LCL_BEST)
+    {
+        /*the fixed trees don't depend on the parse*/
+        return encodeLZ77Best(out, hash, in, inpos, insize, settings->btype == 1 ? 0 : BEST_NUM_PASSES);
+    }
+    return encodeLZ77(out, hash, in, inpos, insize, settings->windowsize,
+                      settings->minmatch, settings->nicematch, settings->lazymatching);
+}
+
 /* /////////////////////////////////////////////////////////////////////////// */
 
 static unsigned deflateNoCompression(ucvector* out, const unsigned char* data, size_t datasize)
@@ -1733,14 +2421,13 @@ static unsigned deflateDynamic(ucvector* out, size_t* bp, Hash* hash,
     {
         if (settings->use_lz77)
         {
-            error = encodeLZ77(&lz77_encoded, hash, data, datapos, dataend, settings->windowsize,
-                               settings->minmatch, settings->nicematch, settings->lazymatching);
+            error = encodeLZ77Level(&lz77_encoded, hash, data, datapos, dataend, settings);
             if (error) break;
         }
         else
         {
             if (!uivector_resize(&lz77_encoded, datasize)) ERROR_BREAK(83 /*alloc fail*/);
-            for (i = datapos; i < dataend; i++) lz77_encoded.data[i] = data[i]; /*no LZ77, but still will be Huffman compressed*/
+            for (i = datapos; i < dataend; i++) lz77_encoded.data[i - datapos] = data[i]; /*no LZ77, but still will be Huffman compressed*/
         }
 
         if (!uivector_resizev(&frequencies_ll, 286, 0)) ERROR_BREAK(83 /*alloc fail*/);
@@ -1943,8 +2630,7 @@ static unsigned deflateFixed(ucvector* out, size_t* bp, Hash* hash,
     {
         uivector lz77_encoded;
         uivector_init(&lz77_encoded);
-        error = encodeLZ77(&lz77_encoded, hash, data, datapos, dataend, settings->windowsize,
-                           settings->minmatch, settings->nicematch, settings->lazymatching);
+        error = encodeLZ77Level(&lz77_encoded, hash, data, datapos, dataend, settings);
         if (!error) writeLZ77data(bp, out, &lz77_encoded, &tree_ll, &tree_d);
         uivector_cleanup(&lz77_encoded);
     }
@@ -1965,6 +2651,110 @@ static unsigned deflateFixed(ucvector* out, size_t* bp, Hash* hash,
     return error;
 }
 
+#ifdef LODEPNG_COMPILE_THREADS
+typedef struct DeflateBlock
+{
+    ucvector out; /*starts at a byte, so the blocks can be appended to each other*/
+    unsigned error;
+} DeflateBlock;
+
+static void deflateBlocksWorker(DeflateBlock* blocks, size_t numblocks, size_t blocksize,
+                                const unsigned char* in, size_t insize,
+                                const LodePNGCompressSettings* settings, std::atomic<size_t>* next)
+{
+    Hash hash;
+    unsigned windowsize = lz77WindowSize(settings);
+    unsigned error = hash_init(&hash, windowsize, settings->level);
+    for (;;)
+    {
+        size_t i = (*next)++;
+        size_t start = i * blocksize;
+        size_t end = start + blocksize;
+        size_t bp = 0;
+        int final = i == numblocks - 1;
+        DeflateBlock* block;
+
+        if (i >= numblocks) break;
+        block = &blocks[i];
+        if (end > insize) end = insize;
+        if (error)
+        {
+            block->error = error;
+            continue;
+        }
+
+        /*the window before the block, like the hash would have it after the previous block*/
+        hash_clear(&hash, windowsize);
+        if (settings->use_lz77)
+        {
+            hash_prime(&hash, in, start < windowsize ? 0 : start - windowsize, start, windowsize);
+        }
+
+        if (settings->btype == 1) block->error = deflateFixed(&block->out, &bp, &hash, in, start, end, settings, final);
+        else block->error = deflateDynamic(&block->out, &bp, &hash, in, start, end, settings, final);
+
+        if (!block->error && !final)
+        {
+            /*an empty stored block ends the block at a byte*/
+            ucvector* blockout = &block->out;
+            addBitToStream(&bp, blockout, 0); /*BFINAL*/
+            addBitToStream(&bp, blockout, 0); /*first bit of BTYPE*/
+            addBitToStream(&bp, blockout, 0); /*second bit of BTYPE*/
+            if (!ucvector_push_back(blockout, 0) || !ucvector_push_back(blockout, 0)
+                || !ucvector_push_back(blockout, 255) || !ucvector_push_back(blockout, 255))
+            {
+                block->error = 83; /*alloc fail*/
+            }
+        }
+    }
+    hash_cleanup(&hash);
+}
+
+/*deflates the blocks independently on settings->threads threads, then appends them in order*/
+static unsigned deflateParallel(ucvector* out, const unsigned char* in, size_t insize,
+                                size_t blocksize, size_t numblocks, const LodePNGCompressSettings* settings)
+{
+    unsigned error = 0;
+    size_t i, threads = settings->threads;
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+    DeflateBlock* blocks;
+    unsigned windowsize = lz77WindowSize(settings);
+
+    if (windowsize == 0 || windowsize > 32768) return 60; /*error: windowsize smaller/larger than allowed*/
+    if ((windowsize & (windowsize - 1)) != 0) return 90; /*error: must be power of two*/
+
+    blocks = (DeflateBlock*)lodepng_malloc(sizeof(DeflateBlock) * numblocks);
+    if (!blocks) return 83; /*alloc fail*/
+    for (i = 0; i < numblocks; i++)
+    {
+        ucvector_init(&blocks[i].out);
+        blocks[i].error = 0;
+    }
+
+    /*the calling thread is one of them*/
+    if (threads > numblocks) threads = numblocks;
+    for (i = 1; i < threads; i++)
+    {
+        workers.push_back(std::thread(deflateBlocksWorker, blocks, numblocks, blocksize, in, insize, settings, &next));
+    }
+    deflateBlocksWorker(blocks, numblocks, blocksize, in, insize, settings, &next);
+    for (i = 0; i < workers.size(); i++) workers[i].join();
+
+    for (i = 0; i < numblocks; i++)
+    {
+        size_t size = out->size;
+        if (!error) error = blocks[i].error;
+        if (!error && !ucvector_resize(out, size + blocks[i].out.size)) error = 83; /*alloc fail*/
+        if (!error) memcpy(&out->data[size], blocks[i].out.data, blocks[i].out.size);
+        ucvector_cleanup(&blocks[i].out);
+    }
+    lodepng_free(blocks);
+
+    return error;
+}
+#endif /*LODEPNG_COMPILE_THREADS*/
+
 static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t insize,
                                  const LodePNGCompressSettings* settings)
 {
@@ -1982,10 +2772,27 @@ static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t
         if (blocksize < 65535) blocksize = 65535;
     }
 
+#ifdef LODEPNG_COMPILE_THREADS
+    if (settings->threads > 1)
+    {
+        /*at least a block per thread, if they don't get too small*/
+        size_t threadblocksize = insize / settings->threads + 1;
+        if (threadblocksize < 65535) threadblocksize = 65535;
+        if (threadblocksize < blocksize) blocksize = threadblocksize;
+    }
+#endif /*LODEPNG_COMPILE_THREADS*/
+
     numdeflateblocks = (insize + blocksize - 1) / blocksize;
     if (numdeflateblocks == 0) numdeflateblocks = 1;
 
-    error = hash_init(&hash, settings->windowsize);
+#ifdef LODEPNG_COMPILE_THREADS
+    if (settings->threads > 1 && numdeflateblocks > 1)
+    {
+        return deflateParallel(out, in, insize, blocksize, numdeflateblocks, settings);
+    }
+#endif /*LODEPNG_COMPILE_THREADS*/
+
+    error = hash_init(&hash, lz77WindowSize(settings), settings->level);
     if (error) return error;
 
     for (i = 0; i < numdeflateblocks && !error; i++)
@@ -2037,11 +2844,76 @@ static unsigned deflate(unsigned char** out, size_t* outsize,
 /* / Adler32                                                                  */
 /* ////////////////////////////////////////////////////////////////////////// */
 
+#ifdef LODEPNG_COMPILE_SIMD
+/*
+Adler-32 of 32 bytes per step: s1 gets the byte sums, s2 gets the bytes times their distance
+from the end of the step, plus 32 times s1 from before the step.
+*/
+LODEPNG_TARGET_SSSE3
+static unsigned update_adler32SSSE3(unsigned adler, const unsigned char* data, unsigned len)
+{
+    const __m128i tap1 = _mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17);
+    const __m128i tap2 = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi16(1);
+    unsigned s1 = adler & 0xffff;
+    unsigned s2 = (adler >> 16) & 0xffff;
+    unsigned steps = len / 32;
+    len -= steps * 32;
+
+    while (steps > 0)
+    {
+        /*173 steps of 32 is the most that fits before the sums overflow, like the 5550 below*/
+        unsigned amount = steps > 173 ? 173 : steps;
+        __m128i v_ps = _mm_cvtsi32_si128((int)(s1 * amount)); /*s1 of before every step, times 32 at the end*/
+        __m128i v_s1 = zero;
+        __m128i v_s2 = _mm_cvtsi32_si128((int)s2);
+        steps -= amount;
+
+        while (amount > 0)
+        {
+            __m128i bytes1 = _mm_loadu_si128((const __m128i*)data);
+            __m128i bytes2 = _mm_loadu_si128((const __m128i*)(data + 16));
+            v_ps = _mm_add_epi32(v_ps, v_s1);
+            v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(bytes1, zero));
+            v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(_mm_maddubs_epi16(bytes1, tap1), ones));
+            v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(bytes2, zero));
+            v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(_mm_maddubs_epi16(bytes2, tap2), ones));
+            data += 32;
+            amount--;
+        }
+        v_s2 = _mm_add_epi32(v_s2, _mm_slli_epi32(v_ps, 5));
+
+        /*add the lanes together*/
+        v_s1 = _mm_add_epi32(v_s1, _mm_shuffle_epi32(v_s1, _MM_SHUFFLE(1, 0, 3, 2)));
+        v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, _MM_SHUFFLE(2, 3, 0, 1)));
+        v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, _MM_SHUFFLE(1, 0, 3, 2)));
+        s1 = (s1 + (unsigned)_mm_cvtsi128_si32(v_s1)) % 65521;
+        s2 = (unsigned)_mm_cvtsi128_si32(v_s2) % 65521;
+    }
+
+    while (len > 0)
+    {
+        s1 += (*data++);
+        s2 += s1;
+        len--;
+    }
+    s1 %= 65521;
+    s2 %= 65521;
+
+    return (s2 << 16) | s1;
+}
+#endif /*LODEPNG_COMPILE_SIMD*/
+
 static unsigned update_adler32(unsigned adler, const unsigned char* data, unsigned len)
 {
     unsigned s1 = adler & 0xffff;
     unsigned s2 = (adler >> 16) & 0xffff;
 
+#ifdef LODEPNG_COMPILE_SIMD
+    if (len >= 64 && (cpuFeatures() & CPU_SSSE3)) return update_adler32SSSE3(adler, data, len);
+#endif /*LODEPNG_COMPILE_SIMD*/
+
     while (len > 0)
     {
         /*at least 5550 sums can be done before the sums overflow, saving a lot of module divisions*/
@@ -2072,10 +2944,9 @@ static unsigned adler32(const unsigned char* data, unsigned len)
 
 #ifdef LODEPNG_COMPILE_DECODER
 
-unsigned lodepng_zlib_decompress(unsigned char** out, size_t* outsize, const unsigned char* in,
-                                 size_t insize, const LodePNGDecompressSettings* settings)
+/*checks the 2 byte zlib header. return value is error*/
+static unsigned zlib_check_header(const unsigned char* in, size_t insize)
 {
-    unsigned error = 0;
     unsigned CM, CINFO, FDICT;
 
     if (insize < 2) return 53; /*error, size of zlib data too small*/
@@ -2104,6 +2975,15 @@ unsigned lodepng_zlib_decompress(unsigned char** out, size_t* outsize, const uns
         return 26;
     }
 
+    return 0;
+}
+
+unsigned lodepng_zlib_decompress(unsigned char** out, size_t* outsize, const unsigned char* in,
+                                 size_t insize, const LodePNGDecompressSettings* settings)
+{
+    unsigned error = zlib_check_header(in, insize);
+    if (error) return error;
+
     error = inflate(out, outsize, in + 2, insize - 2, settings);
     if (error) return error;
 
@@ -2130,6 +3010,38 @@ static unsigned zlib_decompress(unsigned char** out, size_t* outsize, const unsi
     }
 }
 
+/*
+like lodepng_zlib_decompress, but gives the data to flush a part at a time, with only the 32KB window and
+what's inflated since the last flush in memory. The custom zlib and inflate settings can't be used with it
+*/
+static unsigned zlib_decompress_stream(const unsigned char* in, size_t insize, const LodePNGDecompressSettings* settings,
+                                       unsigned (*flush)(void*, const unsigned char*, size_t), void* context)
+{
+    ucvector buffer;
+    InflateStream stream;
+    unsigned error = zlib_check_header(in, insize);
+    if (error) return error;
+
+    stream.flush = flush;
+    stream.context = context;
+    stream.adler = 1;
+    stream.kept = 0;
+    ucvector_init(&buffer);
+    /*flushes in parts of a few times the window*/
+    if (!ucvector_resize(&buffer, INFLATE_WINDOW_SIZE * 8)) return 83; /*alloc fail*/
+    error = lodepng_inflatev(&buffer, in + 2, insize - 2, settings, &stream);
+    ucvector_cleanup(&buffer);
+    if (error) return error;
+
+    if (!settings->ignore_adler32)
+    {
+        unsigned ADLER32 = lodepng_read32bitInt(&in[insize - 4]);
+        if (stream.adler != ADLER32) return 58; /*error, adler checksum not correct, data must be corrupted*/
+    }
+
+    return 0; /*no error*/
+}
+
 #endif /*LODEPNG_COMPILE_DECODER*/
 
 #ifdef LODEPNG_COMPILE_ENCODER
@@ -2233,9 +3145,13 @@ void lodepng_compress_settings_init(LodePNGCompressSettings* settings)
     settings->custom_zlib = 0;
     settings->custom_deflate = 0;
     settings->custom_context = 0;
+
+    settings->threads = 1;
+    settings->level = LCL_DEFAULT;
 }
 
-const LodePNGCompressSettings lodepng_default_compress_settings = {2, 1, DEFAULT_WINDOWSIZE, 3, 128, 1, 0, 0, 0};
+const LodePNGCompressSettings lodepng_default_compress_settings = {2, 1, DEFAULT_WINDOWSIZE, 3, 128, 1, 0, 0, 0, 1,
+                                                                   LCL_DEFAULT};
 
 
 #endif /*LODEPNG_COMPILE_ENCODER*/
@@ -2249,9 +3165,10 @@ void lodepng_decompress_settings_init(LodePNGDecompressSettings* settings)
     settings->custom_zlib = 0;
     settings->custom_inflate = 0;
     settings->custom_context = 0;
+    settings->fast_inflate = 1;
 }
 
-const LodePNGDecompressSettings lodepng_default_decompress_settings = {0, 0, 0, 0};
+const LodePNGDecompressSettings lodepng_default_decompress_settings = {0, 0, 0, 0, 1};
 
 #endif /*LODEPNG_COMPILE_DECODER*/
 
@@ -2267,51 +3184,387 @@ const LodePNGDecompressSettings lodepng_default_decompress_settings = {0, 0, 0,
 /* / CRC32                                                                  / */
 /* ////////////////////////////////////////////////////////////////////////// */
 
-/* CRC polynomial: 0xedb88320 */
-static unsigned lodepng_crc32_table[256] = {
-    0u, 1996959894u, 3993919788u, 2567524794u, 124634137u, 1886057615u, 3915621685u, 2657392035u,
-    249268274u, 2044508324u, 3772115230u, 2547177864u, 162941995u, 2125561021u, 3887607047u, 2428444049u,
-    498536548u, 1789927666u, 4089016648u, 2227061214u, 450548861u, 1843258603u, 4107580753u, 2211677639u,
-    325883990u, 1684777152u, 4251122042u, 2321926636u, 335633487u, 1661365465u, 4195302755u, 2366115317u,
-    997073096u, 1281953886u, 3579855332u, 2724688242u, 1006888145u, 1258607687u, 3524101629u, 2768942443u,
-    901097722u, 1119000684u, 3686517206u, 2898065728u, 853044451u, 1172266101u, 3705015759u, 2882616665u,
-    651767980u, 1373503546u, 3369554304u, 3218104598u, 565507253u, 1454621731u, 3485111705u, 3099436303u,
-    671266974u, 1594198024u, 3322730930u, 2970347812u, 795835527u, 1483230225u, 3244367275u, 3060149565u,
-    1994146192u, 31158534u, 2563907772u, 4023717930u, 1907459465u, 112637215u, 2680153253u, 3904427059u,
-    2013776290u, 251722036u, 2517215374u, 3775830040u, 2137656763u, 141376813u, 2439277719u, 3865271297u,
-    1802195444u, 476864866u, 2238001368u, 4066508878u, 1812370925u, 453092731u, 2181625025u, 4111451223u,
-    1706088902u, 314042704u, 2344532202u, 4240017532u, 1658658271u, 366619977u, 2362670323u, 4224994405u,
-    1303535960u, 984961486u, 2747007092u, 3569037538u, 1256170817u, 1037604311u, 2765210733u, 3554079995u,
-    1131014506u, 879679996u, 2909243462u, 3663771856u, 1141124467u, 855842277u, 2852801631u, 3708648649u,
-    1342533948u, 654459306u, 3188396048u, 3373015174u, 1466479909u, 544179635u, 3110523913u, 3462522015u,
-    1591671054u, 702138776u, 2966460450u, 3352799412u, 1504918807u, 783551873u, 3082640443u, 3233442989u,
-    3988292384u, 2596254646u, 62317068u, 1957810842u, 3939845945u, 2647816111u, 81470997u, 1943803523u,
-    3814918930u, 2489596804u, 225274430u, 2053790376u, 3826175755u, 2466906013u, 167816743u, 2097651377u,
-    4027552580u, 2265490386u, 503444072u, 1762050814u, 4150417245u, 2154129355u, 426522225u, 1852507879u,
-    4275313526u, 2312317920u, 282753626u, 1742555852u, 4189708143u, 2394877945u, 397917763u, 1622183637u,
-    3604390888u, 2714866558u, 953729732u, 1340076626u, 3518719985u, 2797360999u, 1068828381u, 1219638859u,
-    3624741850u, 2936675148u, 906185462u, 1090812512u, 3747672003u, 2825379669u, 829329135u, 1181335161u,
-    3412177804u, 3160834842u, 628085408u, 1382605366u, 3423369109u, 3138078467u, 570562233u, 1426400815u,
-    3317316542u, 2998733608u, 733239954u, 1555261956u, 3268935591u, 3050360625u, 752459403u, 1541320221u,
-    2607071920u, 3965973030u, 1969922972u, 40735498u, 2617837225u, 3943577151u, 1913087877u, 83908371u,
-    2512341634u, 3803740692u, 2075208622u, 213261112u, 2463272603u, 3855990285u, 2094854071u, 198958881u,
-    2262029012u, 4057260610u, 1759359992u, 534414190u, 2176718541u, 4139329115u, 1873836001u, 414664567u,
-    2282248934u, 4279200368u, 1711684554u, 285281116u, 2405801727u, 4167216745u, 1634467795u, 376229701u,
-    2685067896u, 3608007406u, 1308918612u, 956543938u, 2808555105u, 3495958263u, 1231636301u, 1047427035u,
-    2932959818u, 3654703836u, 1088359270u, 936918000u, 2847714899u, 3736837829u, 1202900863u, 817233897u,
-    3183342108u, 3401237130u, 1404277552u, 615818150u, 3134207493u, 3453421203u, 1423857449u, 601450431u,
-    3009837614u, 3294710456u, 1567103746u, 711928724u, 3020668471u, 3272380065u, 1510334235u, 755167117u
+/* CRC polynomial: 0xedb88320. Table k is the CRC of the byte followed by k zero bytes, for slicing by 8*/
+static const unsigned lodepng_crc32_table[8][256] = {
+    {
+        0u, 1996959894u, 3993919788u, 2567524794u, 124634137u, 1886057615u, 3915621685u, 2657392035u,
+        249268274u, 2044508324u, 3772115230u, 2547177864u, 162941995u, 2125561021u, 3887607047u, 2428444049u,
+        498536548u, 1789927666u, 4089016648u, 2227061214u, 450548861u, 1843258603u, 4107580753u, 2211677639u,
+        325883990u, 1684777152u, 4251122042u, 2321926636u, 335633487u, 1661365465u, 4195302755u, 2366115317u,
+        997073096u, 1281953886u, 3579855332u, 2724688242u, 1006888145u, 1258607687u, 3524101629u, 2768942443u,
+        901097722u, 1119000684u, 3686517206u, 2898065728u, 853044451u, 1172266101u, 3705015759u, 2882616665u,
+        651767980u, 1373503546u, 3369554304u, 3218104598u, 565507253u, 1454621731u, 3485111705u, 3099436303u,
+        671266974u, 1594198024u, 3322730930u, 2970347812u, 795835527u, 1483230225u, 3244367275u, 3060149565u,
+        1994146192u, 31158534u, 2563907772u, 4023717930u, 1907459465u, 112637215u, 2680153253u, 3904427059u,
+        2013776290u, 251722036u, 2517215374u, 3775830040u, 2137656763u, 141376813u, 2439277719u, 3865271297u,
+        1802195444u, 476864866u, 2238001368u, 4066508878u, 1812370925u, 453092731u, 2181625025u, 4111451223u,
+        1706088902u, 314042704u, 2344532202u, 4240017532u, 1658658271u, 366619977u, 2362670323u, 4224994405u,
+        1303535960u, 984961486u, 2747007092u, 3569037538u, 1256170817u, 1037604311u, 2765210733u, 3554079995u,
+        1131014506u, 879679996u, 2909243462u, 3663771856u, 1141124467u, 855842277u, 2852801631u, 3708648649u,
+        1342533948u, 654459306u, 3188396048u, 3373015174u, 1466479909u, 544179635u, 3110523913u, 3462522015u,
+        1591671054u, 702138776u, 2966460450u, 3352799412u, 1504918807u, 783551873u, 3082640443u, 3233442989u,
+        3988292384u, 2596254646u, 62317068u, 1957810842u, 3939845945u, 2647816111u, 81470997u, 1943803523u,
+        3814918930u, 2489596804u, 225274430u, 2053790376u, 3826175755u, 2466906013u, 167816743u, 2097651377u,
+        4027552580u, 2265490386u, 503444072u, 1762050814u, 4150417245u, 2154129355u, 426522225u, 1852507879u,
+        4275313526u, 2312317920u, 282753626u, 1742555852u, 4189708143u, 2394877945u, 397917763u, 1622183637u,
+        3604390888u, 2714866558u, 953729732u, 1340076626u, 3518719985u, 2797360999u, 1068828381u, 1219638859u,
+        3624741850u, 2936675148u, 906185462u, 1090812512u, 3747672003u, 2825379669u, 829329135u, 1181335161u,
+        3412177804u, 3160834842u, 628085408u, 1382605366u, 3423369109u, 3138078467u, 570562233u, 1426400815u,
+        3317316542u, 2998733608u, 733239954u, 1555261956u, 3268935591u, 3050360625u, 752459403u, 1541320221u,
+        2607071920u, 3965973030u, 1969922972u, 40735498u, 2617837225u, 3943577151u, 1913087877u, 83908371u,
+        2512341634u, 3803740692u, 2075208622u, 213261112u, 2463272603u, 3855990285u, 2094854071u, 198958881u,
+        2262029012u, 4057260610u, 1759359992u, 534414190u, 2176718541u, 4139329115u, 1873836001u, 414664567u,
+        2282248934u, 4279200368u, 1711684554u, 285281116u, 2405801727u, 4167216745u, 1634467795u, 376229701u,
+        2685067896u, 3608007406u, 1308918612u, 956543938u, 2808555105u, 3495958263u, 1231636301u, 1047427035u,
+        2932959818u, 3654703836u, 1088359270u, 936918000u, 2847714899u, 3736837829u, 1202900863u, 817233897u,
+        3183342108u, 3401237130u, 1404277552u, 615818150u, 3134207493u, 3453421203u, 1423857449u, 601450431u,
+        3009837614u, 3294710456u, 1567103746u, 711928724u, 3020668471u, 3272380065u, 1510334235u, 755167117u
+    },
+    {
+        0u, 421212481u, 842424962u, 724390851u, 1684849924u, 2105013317u, 1448781702u, 1329698503u,
+        3369699848u, 3519200073u, 4210026634u, 3824474571u, 2897563404u, 3048111693u, 2659397006u, 2274893007u,
+        1254232657u, 1406739216u, 2029285587u, 1643069842u, 783210325u, 934667796u, 479770071u, 92505238u,
+        2182846553u, 2600511768u, 2955803355u, 2838940570u, 3866582365u, 4285295644u, 3561045983u, 3445231262u,
+        2508465314u, 2359236067u, 2813478432u, 3198777185u, 4058571174u, 3908292839u, 3286139684u, 3670389349u,
+        1566420650u, 1145479147u, 1869335592u, 1987116393u, 959540142u, 539646703u, 185010476u, 303839341u,
+        3745920755u, 3327985586u, 3983561841u, 4100678960u, 3140154359u, 2721170102u, 2300350837u, 2416418868u,
+        396344571u, 243568058u, 631889529u, 1018359608u, 1945336319u, 1793607870u, 1103436669u, 1490954812u,
+        4034481925u, 3915546180u, 3259968903u, 3679722694u, 2484439553u, 2366552896u, 2787371139u, 3208174018u,
+        950060301u, 565965900u, 177645455u, 328046286u, 1556873225u, 1171730760u, 1861902987u, 2011255754u,
+        3132841300u, 2745199637u, 2290958294u, 2442530455u, 3738671184u, 3352078609u, 3974232786u, 4126854035u,
+        1919080284u, 1803150877u, 1079293406u, 1498383519u, 370020952u, 253043481u, 607678682u, 1025720731u,
+        1711106983u, 2095471334u, 1472923941u, 1322268772u, 26324643u, 411738082u, 866634785u, 717028704u,
+        2904875439u, 3024081134u, 2668790573u, 2248782444u, 3376948395u, 3495106026u, 4219356713u, 3798300520u,
+        792689142u, 908347575u, 487136116u, 68299317u, 1263779058u, 1380486579u, 2036719216u, 1618931505u,
+        3890672638u, 4278043327u, 3587215740u, 3435896893u, 2206873338u, 2593195963u, 2981909624u, 2829542713u,
+        998479947u, 580430090u, 162921161u, 279890824u, 1609522511u, 1190423566u, 1842954189u, 1958874764u,
+        4082766403u, 3930137346u, 3245109441u, 3631694208u, 2536953671u, 2385372678u, 2768287173u, 3155920004u,
+        1900120602u, 1750776667u, 1131931800u, 1517083097u, 355290910u, 204897887u, 656092572u, 1040194781u,
+        3113746450u, 2692952403u, 2343461520u, 2461357009u, 3723805974u, 3304059991u, 4022511508u, 4141455061u,
+        2919742697u, 3072101800u, 2620513899u, 2234183466u, 3396041197u, 3547351212u, 4166851439u, 3779471918u,
+        1725839073u, 2143618976u, 1424512099u, 1307796770u, 45282277u, 464110244u, 813994343u, 698327078u,
+        3838160568u, 4259225593u, 3606301754u, 3488152955u, 2158586812u, 2578602749u, 2996767038u, 2877569151u,
+        740041904u, 889656817u, 506086962u, 120682355u, 1215357364u, 1366020341u, 2051441462u, 1667084919u,
+        3422213966u, 3538019855u, 4190942668u, 3772220557u, 2945847882u, 3062702859u, 2644537544u, 2226864521u,
+        52649286u, 439905287u, 823476164u, 672009861u, 1733269570u, 2119477507u, 1434057408u, 1281543041u,
+        2167981343u, 2552493150u, 3004082077u, 2853541596u, 3847487515u, 4233048410u, 3613549209u, 3464057816u,
+        1239502615u, 1358593622u, 2077699477u, 1657543892u, 764250643u, 882293586u, 532408465u, 111204816u,
+        1585378284u, 1197851309u, 1816695150u, 1968414767u, 974272232u, 587794345u, 136598634u, 289367339u,
+        2527558116u, 2411481253u, 2760973158u, 3179948583u, 4073438432u, 3956313505u, 3237863010u, 3655790371u,
+        347922877u, 229101820u, 646611775u, 1066513022u, 1892689081u, 1774917112u, 1122387515u, 1543337850u,
+        3697634229u, 3313392372u, 3998419255u, 4148705398u, 3087642289u, 2702352368u, 2319436851u, 2468674930u
+    },
+    {
+        0u, 29518391u, 59036782u, 38190681u, 118073564u, 114017003u, 76381362u, 89069189u,
+        236147128u, 265370511u, 228034006u, 206958561u, 152762724u, 148411219u, 178138378u, 190596925u,
+        472294256u, 501532999u, 530741022u, 509615401u, 456068012u, 451764635u, 413917122u, 426358261u,
+        305525448u, 334993663u, 296822438u, 275991697u, 356276756u, 352202787u, 381193850u, 393929805u,
+        944588512u, 965684439u, 1003065998u, 973863097u, 1061482044u, 1049003019u, 1019230802u, 1023561829u,
+        912136024u, 933002607u, 903529270u, 874031361u, 827834244u, 815125939u, 852716522u, 856752605u,
+        611050896u, 631869351u, 669987326u, 640506825u, 593644876u, 580921211u, 551983394u, 556069653u,
+        712553512u, 733666847u, 704405574u, 675154545u, 762387700u, 749958851u, 787859610u, 792175277u,
+        1889177024u, 1901651959u, 1931368878u, 1927033753u, 2006131996u, 1985040171u, 1947726194u, 1976933189u,
+        2122964088u, 2135668303u, 2098006038u, 2093965857u, 2038461604u, 2017599123u, 2047123658u, 2076625661u,
+        1824272048u, 1836991623u, 1866005214u, 1861914857u, 1807058540u, 1786244187u, 1748062722u, 1777547317u,
+        1655668488u, 1668093247u, 1630251878u, 1625932113u, 1705433044u, 1684323811u, 1713505210u, 1742760333u,
+        1222101792u, 1226154263u, 1263738702u, 1251046777u, 1339974652u, 1310460363u, 1281013650u, 1301863845u,
+        1187289752u, 1191637167u, 1161842422u, 1149379777u, 1103966788u, 1074747507u, 1112139306u, 1133218845u,
+        1425107024u, 1429406311u, 1467333694u, 1454888457u, 1408811148u, 1379576507u, 1350309090u, 1371438805u,
+        1524775400u, 1528845279u, 1499917702u, 1487177649u, 1575719220u, 1546255107u, 1584350554u, 1605185389u,
+        3778354048u, 3774312887u, 3803303918u, 3816007129u, 3862737756u, 3892238699u, 3854067506u, 3833203973u,
+        4012263992u, 4007927823u, 3970080342u, 3982554209u, 3895452388u, 3924658387u, 3953866378u, 3932773565u,
+        4245928176u, 4241609415u, 4271336606u, 4283762345u, 4196012076u, 4225268251u, 4187931714u, 4166823541u,
+        4076923208u, 4072833919u, 4035198246u, 4047918865u, 4094247316u, 4123732899u, 4153251322u, 4132437965u,
+        3648544096u, 3636082519u, 3673983246u, 3678331705u, 3732010428u, 3753090955u, 3723829714u, 3694611429u,
+        3614117080u, 3601426159u, 3572488374u, 3576541825u, 3496125444u, 3516976691u, 3555094634u, 3525581405u,
+        3311336976u, 3298595879u, 3336186494u, 3340255305u, 3260503756u, 3281337595u, 3251864226u, 3222399125u,
+        3410866088u, 3398419871u, 3368647622u, 3372945905u, 3427010420u, 3448139075u, 3485520666u, 3456284973u,
+        2444203584u, 2423127159u, 2452308526u, 2481530905u, 2527477404u, 2539934891u, 2502093554u, 2497740997u,
+        2679949304u, 2659102159u, 2620920726u, 2650438049u, 2562027300u, 2574714131u, 2603727690u, 2599670141u,
+        2374579504u, 2353749767u, 2383274334u, 2412743529u, 2323684844u, 2336421851u, 2298759554u, 2294686645u,
+        2207933576u, 2186809023u, 2149495014u, 2178734801u, 2224278612u, 2236720739u, 2266437690u, 2262135309u,
+        2850214048u, 2820717207u, 2858812622u, 2879680249u, 2934667388u, 2938704459u, 2909776914u, 2897069605u,
+        2817622296u, 2788420399u, 2759153014u, 2780249921u, 2700618180u, 2704950259u, 2742877610u, 2730399645u,
+        3049550800u, 3020298727u, 3057690558u, 3078802825u, 2999835404u, 3004150075u, 2974355298u, 2961925461u,
+        3151438440u, 3121956959u, 3092510214u, 3113327665u, 3168701108u, 3172786307u, 3210370778u, 3197646061u
+    },
+    {
+        0u, 3099354981u, 2852767883u, 313896942u, 2405603159u, 937357362u, 627793884u, 2648127673u,
+        3316918511u, 2097696650u, 1874714724u, 3607201537u, 1255587768u, 4067088605u, 3772741427u, 1482887254u,
+        1343838111u, 3903140090u, 4195393300u, 1118632049u, 3749429448u, 1741137837u, 1970407491u, 3452858150u,
+        2511175536u, 756094997u, 1067759611u, 2266550430u, 449832999u, 2725482306u, 2965774508u, 142231497u,
+        2687676222u, 412010587u, 171665333u, 2995192016u, 793786473u, 2548850444u, 2237264098u, 1038456711u,
+        1703315409u, 3711623348u, 3482275674u, 1999841343u, 3940814982u, 1381529571u, 1089329165u, 4166106984u,
+        4029413537u, 1217896388u, 1512189994u, 3802027855u, 2135519222u, 3354724499u, 3577784189u, 1845280792u,
+        899665998u, 2367928107u, 2677414085u, 657096608u, 3137160985u, 37822588u, 284462994u, 2823350519u,
+        2601801789u, 598228824u, 824021174u, 2309093331u, 343330666u, 2898962447u, 3195996129u, 113467524u,
+        1587572946u, 3860600759u, 4104763481u, 1276501820u, 3519211397u, 1769898208u, 2076913422u, 3279374443u,
+        3406630818u, 1941006535u, 1627703081u, 3652755532u, 1148164341u, 4241751952u, 3999682686u, 1457141531u,
+        247015245u, 3053797416u, 2763059142u, 470583459u, 2178658330u, 963106687u, 735213713u, 2473467892u,
+        992409347u, 2207944806u, 2435792776u, 697522413u, 3024379988u, 217581361u, 508405983u, 2800865210u,
+        4271038444u, 1177467017u, 1419450215u, 3962007554u, 1911572667u, 3377213406u, 3690561584u, 1665525589u,
+        1799331996u, 3548628985u, 3241568279u, 2039091058u, 3831314379u, 1558270126u, 1314193216u, 4142438437u,
+        2928380019u, 372764438u, 75645176u, 3158189981u, 568925988u, 2572515393u, 2346768303u, 861712586u,
+        3982079547u, 1441124702u, 1196457648u, 4293663189u, 1648042348u, 3666298377u, 3358779879u, 1888390786u,
+        686661332u, 2421291441u, 2196002399u, 978858298u, 2811169155u, 523464422u, 226935048u, 3040519789u,
+        3175145892u, 100435649u, 390670639u, 2952089162u, 841119475u, 2325614998u, 2553003640u, 546822429u,
+        2029308235u, 3225988654u, 3539796416u, 1782671013u, 4153826844u, 1328167289u, 1570739863u, 3844338162u,
+        1298864389u, 4124540512u, 3882013070u, 1608431339u, 3255406162u, 2058742071u, 1744848601u, 3501990332u,
+        2296328682u, 811816591u, 584513889u, 2590678532u, 129869501u, 3204563416u, 2914283062u, 352848211u,
+        494030490u, 2781751807u, 3078325777u, 264757620u, 2450577869u, 715964072u, 941166918u, 2158327331u,
+        3636881013u, 1618608400u, 1926213374u, 3396585883u, 1470427426u, 4011365959u, 4255988137u, 1158766284u,
+        1984818694u, 3471935843u, 3695453837u, 1693991400u, 4180638033u, 1100160564u, 1395044826u, 3952793279u,
+        3019491049u, 189112716u, 435162722u, 2706139399u, 1016811966u, 2217162459u, 2526189877u, 774831696u,
+        643086745u, 2666061564u, 2354934034u, 887166583u, 2838900430u, 294275499u, 54519365u, 3145957664u,
+        3823145334u, 1532818963u, 1240029693u, 4048895640u, 1820460577u, 3560857924u, 3331051178u, 2117577167u,
+        3598663992u, 1858283101u, 2088143283u, 3301633750u, 1495127663u, 3785470218u, 4078182116u, 1269332353u,
+        332098007u, 2876706482u, 3116540252u, 25085497u, 2628386432u, 605395429u, 916469259u, 2384220526u,
+        2254837415u, 1054503362u, 745528876u, 2496903497u, 151290352u, 2981684885u, 2735556987u, 464596510u,
+        1137851976u, 4218313005u, 3923506883u, 1365741990u, 3434129695u, 1946996346u, 1723425172u, 3724871409u
+    },
+    {
+        0u, 1029712304u, 2059424608u, 1201699536u, 4118849216u, 3370159984u, 2403399072u, 2988497936u,
+        812665793u, 219177585u, 1253054625u, 2010132753u, 3320900865u, 4170237105u, 3207642721u, 2186319825u,
+        1625331586u, 1568718386u, 438355170u, 658566482u, 2506109250u, 2818578674u, 4020265506u, 3535817618u,
+        1351670851u, 1844508147u, 709922595u, 389064339u, 2769320579u, 2557498163u, 3754961379u, 3803185235u,
+        3250663172u, 4238411444u, 3137436772u, 2254525908u, 876710340u, 153198708u, 1317132964u, 1944187668u,
+        4054934725u, 3436268917u, 2339452837u, 3054575125u, 70369797u, 961670069u, 2129760613u, 1133623509u,
+        2703341702u, 2621542710u, 3689016294u, 3867263574u, 1419845190u, 1774270454u, 778128678u, 318858390u,
+        2438067015u, 2888948471u, 3952189479u, 3606153623u, 1691440519u, 1504803895u, 504432359u, 594620247u,
+        1492342857u, 1704161785u, 573770537u, 525542041u, 2910060169u, 2417219385u, 3618876905u, 3939730521u,
+        1753420680u, 1440954936u, 306397416u, 790849880u, 2634265928u, 2690882808u, 3888375336u, 3668168600u,
+        940822475u, 91481723u, 1121164459u, 2142483739u, 3448989963u, 4042473659u, 3075684971u, 2318603227u,
+        140739594u, 889433530u, 1923340138u, 1338244826u, 4259521226u, 3229813626u, 2267247018u, 3124975642u,
+        2570221389u, 2756861693u, 3824297005u, 3734113693u, 1823658381u, 1372780605u, 376603373u, 722643805u,
+        2839690380u, 2485261628u, 3548540908u, 4007806556u, 1556257356u, 1638052860u, 637716780u, 459464860u,
+        4191346895u, 3300051327u, 2199040943u, 3195181599u, 206718479u, 825388991u, 1989285231u, 1274166495u,
+        3382881038u, 4106388158u, 3009607790u, 2382549470u, 1008864718u, 21111934u, 1189240494u, 2072147742u,
+        2984685714u, 2357631266u, 3408323570u, 4131834434u, 1147541074u, 2030452706u, 1051084082u, 63335554u,
+        2174155603u, 3170292451u, 4216760371u, 3325460867u, 1947622803u, 1232499747u, 248909555u, 867575619u,
+        3506841360u, 3966111392u, 2881909872u, 2527485376u, 612794832u, 434546784u, 1581699760u, 1663499008u,
+        3782634705u, 3692447073u, 2612412337u, 2799048193u, 351717905u, 697754529u, 1849071985u, 1398190273u,
+        1881644950u, 1296545318u, 182963446u, 931652934u, 2242328918u, 3100053734u, 4284967478u, 3255255942u,
+        1079497815u, 2100821479u, 983009079u, 133672583u, 3050795671u, 2293717799u, 3474399735u, 4067887175u,
+        281479188u, 765927844u, 1778867060u, 1466397380u, 3846680276u, 3626469220u, 2676489652u, 2733102084u,
+        548881365u, 500656741u, 1517752501u, 1729575173u, 3577210133u, 3898068133u, 2952246901u, 2459410373u,
+        3910527195u, 3564487019u, 2480257979u, 2931134987u, 479546907u, 569730987u, 1716854139u, 1530213579u,
+        3647316762u, 3825568426u, 2745561210u, 2663766474u, 753206746u, 293940330u, 1445287610u, 1799716618u,
+        2314567513u, 3029685993u, 4080348217u, 3461678473u, 2088098201u, 1091956777u, 112560889u, 1003856713u,
+        3112514712u, 2229607720u, 3276105720u, 4263857736u, 1275433560u, 1902492648u, 918929720u, 195422344u,
+        685033439u, 364179055u, 1377080511u, 1869921551u, 3713294623u, 3761522863u, 2811507327u, 2599689167u,
+        413436958u, 633644462u, 1650777982u, 1594160846u, 3978570462u, 3494118254u, 2548332990u, 2860797966u,
+        1211387997u, 1968470509u, 854852413u, 261368461u, 3182753437u, 2161434413u, 3346310653u, 4195650637u,
+        2017729436u, 1160000044u, 42223868u, 1071931724u, 2378480988u, 2963576044u, 4144295484u, 3395602316u
+    },
+    {
+        0u, 3411858341u, 1304994059u, 2257875630u, 2609988118u, 1355649459u, 3596215069u, 486879416u,
+        3964895853u, 655315400u, 2711298918u, 1791488195u, 2009251963u, 3164476382u, 973758832u, 4048990933u,
+        64357019u, 3364540734u, 1310630800u, 2235723829u, 2554806413u, 1394316072u, 3582976390u, 517157411u,
+        4018503926u, 618222419u, 2722963965u, 1762783832u, 1947517664u, 3209171269u, 970744811u, 4068520014u,
+        128714038u, 3438335635u, 1248109629u, 2167961496u, 2621261600u, 1466012805u, 3522553387u, 447296910u,
+        3959392091u, 547575038u, 2788632144u, 1835791861u, 1886307661u, 3140622056u, 1034314822u, 4143626211u,
+        75106221u, 3475428360u, 1236444838u, 2196665603u, 2682996155u, 1421317662u, 3525567664u, 427767573u,
+        3895035328u, 594892389u, 2782995659u, 1857943406u, 1941489622u, 3101955187u, 1047553757u, 4113347960u,
+        257428076u, 3288652233u, 1116777319u, 2311878850u, 2496219258u, 1603640287u, 3640781169u, 308099796u,
+        3809183745u, 676813732u, 2932025610u, 1704983215u, 2023410199u, 3016104370u, 894593820u, 4262377657u,
+        210634999u, 3352484690u, 1095150076u, 2316991065u, 2535410401u, 1547934020u, 3671583722u, 294336591u,
+        3772615322u, 729897279u, 2903845777u, 1716123700u, 2068629644u, 2953845545u, 914647431u, 4258839074u,
+        150212442u, 3282623743u, 1161604689u, 2388688372u, 2472889676u, 1480171241u, 3735940167u, 368132066u,
+        3836185911u, 805002898u, 2842635324u, 1647574937u, 2134298401u, 3026852996u, 855535146u, 4188192143u,
+        186781121u, 3229539940u, 1189784778u, 2377547631u, 2427670487u, 1542429810u, 3715886812u, 371670393u,
+        3882979244u, 741170185u, 2864262823u, 1642462466u, 2095107514u, 3082559007u, 824732849u, 4201955092u,
+        514856152u, 3589064573u, 1400419795u, 2552522358u, 2233554638u, 1316849003u, 3370776517u, 62202976u,
+        4075001525u, 968836368u, 3207280574u, 1954014235u, 1769133219u, 2720925446u, 616199592u, 4024870413u,
+        493229635u, 3594175974u, 1353627464u, 2616354029u, 2264355925u, 1303087088u, 3409966430u, 6498043u,
+        4046820398u, 979978123u, 3170710821u, 2007099008u, 1789187640u, 2717386141u, 661419827u, 3962610838u,
+        421269998u, 3527459403u, 1423225061u, 2676515648u, 2190300152u, 1238466653u, 3477467891u, 68755798u,
+        4115633027u, 1041448998u, 3095868040u, 1943789869u, 1860096405u, 2776760880u, 588673182u, 3897205563u,
+        449450869u, 3516317904u, 1459794558u, 2623431131u, 2170245475u, 1242006214u, 3432247400u, 131015629u,
+        4137259288u, 1036337853u, 3142660115u, 1879958454u, 1829294862u, 2790523051u, 549483013u, 3952910752u,
+        300424884u, 3669282065u, 1545650111u, 2541513754u, 2323209378u, 1092980487u, 3350330793u, 216870412u,
+        4256931033u, 921128828u, 2960342482u, 2066738807u, 1714085583u, 2910195050u, 736264132u, 3770592353u,
+        306060335u, 3647131530u, 1610005796u, 2494197377u, 2309971513u, 1123257756u, 3295149874u, 255536279u,
+        4268596802u, 892423655u, 3013951305u, 2029645036u, 1711070292u, 2929725425u, 674528607u, 3815288570u,
+        373562242u, 3709388839u, 1535949449u, 2429577516u, 2379569556u, 1183418929u, 3223189663u, 188820282u,
+        4195850735u, 827017802u, 3084859620u, 2089020225u, 1636228089u, 2866415708u, 743340786u, 3876759895u,
+        361896217u, 3738094268u, 1482340370u, 2466671543u, 2382584591u, 1163888810u, 3284924932u, 144124321u,
+        4190215028u, 849168593u, 3020503679u, 2136336858u, 1649465698u, 2836138695u, 798521449u, 3838094284u
+    },
+    {
+        0u, 2792819636u, 2543784233u, 837294749u, 4098827283u, 1379413927u, 1674589498u, 3316072078u,
+        871321191u, 2509784531u, 2758827854u, 34034938u, 3349178996u, 1641505216u, 1346337629u, 4131942633u,
+        1742642382u, 3249117050u, 4030828007u, 1446413907u, 2475800797u, 904311657u, 68069876u, 2725880384u,
+        1412551337u, 4064729373u, 3283010432u, 1708771380u, 2692675258u, 101317902u, 937551763u, 2442587175u,
+        3485284764u, 1774858792u, 1478633653u, 4266992385u, 1005723023u, 2642744891u, 2892827814u, 169477906u,
+        4233263099u, 1512406095u, 1808623314u, 3451546982u, 136139752u, 2926205020u, 2676114113u, 972376437u,
+        2825102674u, 236236518u, 1073525883u, 2576072655u, 1546420545u, 4200303349u, 3417542760u, 1841601500u,
+        2609703733u, 1039917185u, 202635804u, 2858742184u, 1875103526u, 3384067218u, 4166835727u, 1579931067u,
+        1141601657u, 3799809741u, 3549717584u, 1977839588u, 2957267306u, 372464350u, 668680259u, 2175552503u,
+        2011446046u, 3516084394u, 3766168119u, 1175200131u, 2209029901u, 635180217u, 338955812u, 2990736784u,
+        601221559u, 2242044419u, 3024812190u, 306049834u, 3617246628u, 1911408144u, 1074125965u, 3866285881u,
+        272279504u, 3058543716u, 2275784441u, 567459149u, 3832906691u, 1107462263u, 1944752874u, 3583875422u,
+        2343980261u, 767641425u, 472473036u, 3126744696u, 2147051766u, 3649987394u, 3899029983u, 1309766251u,
+        3092841090u, 506333494u, 801510315u, 2310084639u, 1276520081u, 3932237093u, 3683203000u, 2113813516u,
+        3966292011u, 1243601823u, 2079834370u, 3716205238u, 405271608u, 3192979340u, 2411259153u, 701492901u,
+        3750207052u, 2045810168u, 1209569125u, 4000285905u, 734575199u, 2378150379u, 3159862134u, 438345922u,
+        2283203314u, 778166598u, 529136603u, 3120492655u, 2086260449u, 3660498261u, 3955679176u, 1303499900u,
+        3153699989u, 495890209u, 744928700u, 2316418568u, 1337360518u, 3921775410u, 3626602927u, 2120129051u,
+        4022892092u, 1237286280u, 2018993941u, 3726666913u, 461853231u, 3186645403u, 2350400262u, 711936178u,
+        3693557851u, 2052076527u, 1270360434u, 3989775046u, 677911624u, 2384402428u, 3220639073u, 427820757u,
+        1202443118u, 3789347034u, 3493118535u, 1984154099u, 3018127229u, 362020041u, 612099668u, 2181885408u,
+        1950653705u, 3526596285u, 3822816288u, 1168934804u, 2148251930u, 645706414u, 395618355u, 2984485767u,
+        544559008u, 2248295444u, 3085590153u, 295523645u, 3560598451u, 1917673479u, 1134918298u, 3855773998u,
+        328860103u, 3052210803u, 2214924526u, 577903450u, 3889505748u, 1101147744u, 1883911421u, 3594338121u,
+        3424493451u, 1785369663u, 1535282850u, 4260726038u, 944946072u, 2653270060u, 2949491377u, 163225861u,
+        4294103532u, 1501944408u, 1752023237u, 3457862513u, 196998655u, 2915761739u, 2619532502u, 978710370u,
+        2881684293u, 229902577u, 1012666988u, 2586515928u, 1603020630u, 4193987810u, 3356702335u, 1852063179u,
+        2553040162u, 1046169238u, 263412747u, 2848217023u, 1818454321u, 3390333573u, 4227627032u, 1569420204u,
+        60859927u, 2782375331u, 2487203646u, 843627658u, 4159668740u, 1368951216u, 1617990445u, 3322386585u,
+        810543216u, 2520310724u, 2815490393u, 27783917u, 3288386659u, 1652017111u, 1402985802u, 4125677310u,
+        1685994201u, 3255382381u, 4091620336u, 1435902020u, 2419138250u, 910562686u, 128847843u, 2715354199u,
+        1469150398u, 4058414858u, 3222168983u, 1719234083u, 2749255853u, 94984985u, 876691844u, 2453031472u
+    },
+    {
+        0u, 3433693342u, 1109723005u, 2391738339u, 2219446010u, 1222643300u, 3329165703u, 180685081u,
+        3555007413u, 525277995u, 2445286600u, 1567235158u, 1471092047u, 2600801745u, 361370162u, 3642757804u,
+        2092642603u, 2953916853u, 1050555990u, 4063508168u, 4176560081u, 878395215u, 3134470316u, 1987983410u,
+        2942184094u, 1676945920u, 3984272867u, 567356797u, 722740324u, 3887998202u, 1764827929u, 2778407815u,
+        4185285206u, 903635656u, 3142804779u, 2012833205u, 2101111980u, 2979425330u, 1058630609u, 4088621903u,
+        714308067u, 3862526333u, 1756790430u, 2753330688u, 2933487385u, 1651734407u, 3975966820u, 542535930u,
+        2244825981u, 1231508451u, 3353891840u, 188896414u, 25648519u, 3442302233u, 1134713594u, 2399689316u,
+        1445480648u, 2592229462u, 336416693u, 3634843435u, 3529655858u, 516441772u, 2420588879u, 1559052753u,
+        698204909u, 3845636723u, 1807271312u, 2803025166u, 2916600855u, 1635634313u, 4025666410u, 593021940u,
+        4202223960u, 919787974u, 3093159461u, 1962401467u, 2117261218u, 2996361020u, 1008193759u, 4038971457u,
+        1428616134u, 2576151384u, 386135227u, 3685348389u, 3513580860u, 499580322u, 2471098945u, 1608776415u,
+        2260985971u, 1248454893u, 3303468814u, 139259792u, 42591881u, 3458459159u, 1085071860u, 2349261162u,
+        3505103035u, 474062885u, 2463016902u, 1583654744u, 1419882049u, 2550902495u, 377792828u, 3660491170u,
+        51297038u, 3483679632u, 1093385331u, 2374089965u, 2269427188u, 1273935210u, 3311514249u, 164344343u,
+        2890961296u, 1627033870u, 4000683757u, 585078387u, 672833386u, 3836780532u, 1782552599u, 2794821769u,
+        2142603813u, 3005188795u, 1032883544u, 4047146438u, 4227826911u, 928351297u, 3118105506u, 1970307900u,
+        1396409818u, 2677114180u, 287212199u, 3719594553u, 3614542624u, 467372990u, 2505346141u, 1509854403u,
+        2162073199u, 1282711281u, 3271268626u, 240228748u, 76845205u, 3359543307u, 1186043880u, 2317064054u,
+        796964081u, 3811226735u, 1839575948u, 2702160658u, 2882189835u, 1734392469u, 3924802934u, 625327592u,
+        4234522436u, 818917338u, 3191908409u, 1927981223u, 2016387518u, 3028656416u, 973776579u, 4137723485u,
+        2857232268u, 1726474002u, 3899187441u, 616751215u, 772270454u, 3803048424u, 1814228491u, 2693328533u,
+        2041117753u, 3036871847u, 999160644u, 4146592730u, 4259508931u, 826864221u, 3217552830u, 1936586016u,
+        3606501031u, 442291769u, 2496909786u, 1484378436u, 1388107869u, 2652297411u, 278519584u, 3694387134u,
+        85183762u, 3384397196u, 1194773103u, 2342308593u, 2170143720u, 1307820918u, 3279733909u, 265733131u,
+        2057717559u, 3054258089u, 948125770u, 4096344276u, 4276898253u, 843467091u, 3167309488u, 1885556270u,
+        2839764098u, 1709792284u, 3949353983u, 667704161u, 755585656u, 3785577190u, 1865176325u, 2743489947u,
+        102594076u, 3401021058u, 1144549729u, 2291298815u, 2186770662u, 1325234296u, 3228729243u, 215514885u,
+        3589828009u, 424832311u, 2547870420u, 1534552650u, 1370645331u, 2635621325u, 328688686u, 3745342640u,
+        2211456353u, 1333405183u, 3254067740u, 224338562u, 127544219u, 3408931589u, 1170156774u, 2299866232u,
+        1345666772u, 2627681866u, 303053225u, 3736746295u, 3565105198u, 416624816u, 2522494803u, 1525692365u,
+        4285207626u, 868291796u, 3176010551u, 1910772649u, 2065767088u, 3079346734u, 956571085u, 4121828691u,
+        747507711u, 3760459617u, 1856702594u, 2717976604u, 2831417605u, 1684930971u, 3940615800u, 642451174u
+    }
 };
 
+#ifdef LODEPNG_COMPILE_SIMD
+/*
+CRC of a multiple of 16 bytes, at least 64, by folding with carry-less multiplications, from
+"Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction" (Intel). c is the
+CRC register, before the final xor.
+*/
+LODEPNG_TARGET_PCLMUL
+static unsigned crc32PCLMUL(const unsigned char* buf, size_t len, unsigned c)
+{
+    /*the bit reflected constants of the paper: x^(4*128+64) and x^(4*128) mod P, x^(128+64) and
+    x^128 mod P, x^64 mod P, then P and the Barrett reduction constant*/
+    const __m128i k1k2 = _mm_set_epi32(0x00000001, 0xc6e41596, 0x00000001, 0x54442bd4);
+    const __m128i k3k4 = _mm_set_epi32(0x00000000, 0xccaa009e, 0x00000001, 0x751997d0);
+    const __m128i k5 = _mm_set_epi32(0, 0, 0x00000001, 0x63cd6124);
+    const __m128i poly = _mm_set_epi32(0x00000001, 0xf7011641, 0x00000001, 0xdb710641);
+    const __m128i mask32 = _mm_setr_epi32(-1, 0, -1, 0);
+    __m128i x1, x2, x3, x4, t1, t2, t3, t4;
+
+    x1 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(buf + 0)), _mm_cvtsi32_si128((int)c));
+    x2 = _mm_loadu_si128((const __m128i*)(buf + 16));
+    x3 = _mm_loadu_si128((const __m128i*)(buf + 32));
+    x4 = _mm_loadu_si128((const __m128i*)(buf + 48));
+    buf += 64;
+    len -= 64;
+
+    /*fold 4 registers forward by 64 bytes at a time*/
+    while (len >= 64)
+    {
+        t1 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+        t2 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+        t3 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+        t4 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, t1), _mm_loadu_si128((const __m128i*)(buf + 0)));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, t2), _mm_loadu_si128((const __m128i*)(buf + 16)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, t3), _mm_loadu_si128((const __m128i*)(buf + 32)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, t4), _mm_loadu_si128((const __m128i*)(buf + 48)));
+        buf += 64;
+        len -= 64;
+    }
+
+    /*fold them into one, then the remaining 16 byte blocks into that*/
+    t1 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x2), t1);
+    t1 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x3), t1);
+    t1 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x4), t1);
+    while (len >= 16)
+    {
+        t1 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, t1), _mm_loadu_si128((const __m128i*)buf));
+        buf += 16;
+        len -= 16;
+    }
+
+    /*fold 128 bits to 64, then Barrett reduce to 32*/
+    t1 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), t1);
+    t1 = _mm_srli_si128(x1, 4);
+    x1 = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, mask32), k5, 0x00), t1);
+
+    t1 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), poly, 0x10);
+    t1 = _mm_clmulepi64_si128(_mm_and_si128(t1, mask32), poly, 0x00);
+    x1 = _mm_xor_si128(x1, t1);
+    return (unsigned)_mm_cvtsi128_si32(_mm_srli_si128(x1, 4));
+}
+#endif /*LODEPNG_COMPILE_SIMD*/
+
 /*Return the CRC of the bytes buf[0..len-1].*/
 unsigned lodepng_crc32(const unsigned char* buf, size_t len)
 {
     unsigned c = 0xffffffffL;
-    size_t n;
 
-    for (n = 0; n < len; n++)
+#ifdef LODEPNG_COMPILE_SIMD
+    if (len >= 64 && (cpuFeatures() & CPU_PCLMUL))
+    {
+        size_t amount = len & ~(size_t)15;
+        c = crc32PCLMUL(buf, amount, c);
+        buf += amount;
+        len -= amount;
+    }
+#endif /*LODEPNG_COMPILE_SIMD*/
+
+    /*slicing by 8: 8 bytes at once, every byte looks up how it changes the CRC from its position*/
+    while (len >= 8)
+    {
+        unsigned one = c ^ (buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((unsigned)buf[3] << 24));
+        unsigned two = buf[4] | (buf[5] << 8) | (buf[6] << 16) | ((unsigned)buf[7] << 24);
+        c = lodepng_crc32_table[7][one & 0xff] ^ lodepng_crc32_table[6][(one >> 8) & 0xff]
+          ^ lodepng_crc32_table[5][(one >> 16) & 0xff] ^ lodepng_crc32_table[4][one >> 24]
+          ^ lodepng_crc32_table[3][two & 0xff] ^ lodepng_crc32_table[2][(two >> 8) & 0xff]
+          ^ lodepng_crc32_table[1][(two >> 16) & 0xff] ^ lodepng_crc32_table[0][two >> 24];
+        buf += 8;
+        len -= 8;
+    }
+    while (len > 0)
     {
-        c = lodepng_crc32_table[(c ^ buf[n]) & 0xff] ^ (c >> 8);
+        c = lodepng_crc32_table[0][(c ^ *buf) & 0xff] ^ (c >> 8);
+        buf++;
+        len--;
     }
     return c ^ 0xffffffffL;
 }
@@ -3177,37 +4430,202 @@ static unsigned getPixelColorRGBA8(unsigned char* r, unsigned char* g,
     }
     else if (mode->colortype == LCT_GREY_ALPHA)
     {
-        if (mode->bitdepth == 8)
+        if (mode->bitdepth == 8)
+        {
+            *r = *g = *b = in[i * 2 + 0];
+            *a = in[i * 2 + 1];
+        }
+        else
+        {
+            *r = *g = *b = in[i * 4 + 0];
+            *a = in[i * 4 + 2];
+        }
+    }
+    else if (mode->colortype == LCT_RGBA)
+    {
+        if (mode->bitdepth == 8)
+        {
+            *r = in[i * 4 + 0];
+            *g = in[i * 4 + 1];
+            *b = in[i * 4 + 2];
+            *a = in[i * 4 + 3];
+        }
+        else
+        {
+            *r = in[i * 8 + 0];
+            *g = in[i * 8 + 2];
+            *b = in[i * 8 + 4];
+            *a = in[i * 8 + 6];
+        }
+    }
+
+    return 0; /*no error*/
+}
+
+/*
+Converts pixels of bit depth 1, 2, 4 or 8 to RGBA or RGB with 8 bit per channel by looking up
+every value in colors, the RGBA of each possible value. Used for palettes and low bit greyscale.
+*/
+static void getPixelColorsFromTable(unsigned char* buffer, size_t numpixels, unsigned has_alpha,
+                                    const unsigned char* in, unsigned bitdepth, const unsigned char* colors)
+{
+    size_t i;
+    if (bitdepth == 8)
+    {
+        if (has_alpha) for (i = 0; i < numpixels; i++) memcpy(&buffer[i * 4], &colors[in[i] * 4], 4);
+        else for (i = 0; i < numpixels; i++) memcpy(&buffer[i * 3], &colors[in[i] * 4], 3);
+    }
+    else
+    {
+        unsigned mask = (1u << bitdepth) - 1u;
+        size_t j = 0; /*bit position in in, the first pixel is in the most significant bits*/
+        for (i = 0; i < numpixels; i++, j += bitdepth)
+        {
+            unsigned value = (in[j >> 3] >> (8 - bitdepth - (j & 7))) & mask;
+            memcpy(&buffer[i * (has_alpha ? 4 : 3)], &colors[value * 4], has_alpha ? 4 : 3);
+        }
+    }
+}
+
+#ifdef LODEPNG_COMPILE_SIMD
+/*greyscale to RGBA, 16 pixels at a time. key is the grey value that becomes transparent, or -1*/
+static void convertGreyToRGBA8SSE2(unsigned char* out, const unsigned char* in, size_t numpixels, int key)
+{
+    const __m128i opaque = _mm_set1_epi8(-1);
+    const __m128i keyvalue = _mm_set1_epi8((char)key);
+    size_t i = 0;
+    for (; i + 16 <= numpixels; i += 16)
+    {
+        __m128i grey = _mm_loadu_si128((const __m128i*)&in[i]);
+        __m128i alpha = key < 0 ? opaque : _mm_andnot_si128(_mm_cmpeq_epi8(grey, keyvalue), opaque);
+        __m128i gg0 = _mm_unpacklo_epi8(grey, grey), gg1 = _mm_unpackhi_epi8(grey, grey);
+        __m128i ga0 = _mm_unpacklo_epi8(grey, alpha), ga1 = _mm_unpackhi_epi8(grey, alpha);
+        _mm_storeu_si128((__m128i*)&out[i * 4 + 0], _mm_unpacklo_epi16(gg0, ga0));
+        _mm_storeu_si128((__m128i*)&out[i * 4 + 16], _mm_unpackhi_epi16(gg0, ga0));
+        _mm_storeu_si128((__m128i*)&out[i * 4 + 32], _mm_unpacklo_epi16(gg1, ga1));
+        _mm_storeu_si128((__m128i*)&out[i * 4 + 48], _mm_unpackhi_epi16(gg1, ga1));
+    }
+    for (; i < numpixels; i++)
+    {
+        out[i * 4 + 0] = out[i * 4 + 1] = out[i * 4 + 2] = in[i];
+        out[i * 4 + 3] = in[i] == key ? 0 : 255;
+    }
+}
+
+/*greyscale with alpha to RGBA, 8 pixels at a time*/
+static void convertGreyAlphaToRGBA8SSE2(unsigned char* out, const unsigned char* in, size_t numpixels)
+{
+    const __m128i lowbytes = _mm_set1_epi16(0x00FF);
+    size_t i = 0;
+    for (; i + 8 <= numpixels; i += 8)
+    {
+        __m128i ga = _mm_loadu_si128((const __m128i*)&in[i * 2]);
+        __m128i grey = _mm_and_si128(ga, lowbytes);
+        __m128i gg = _mm_or_si128(grey, _mm_slli_epi16(grey, 8));
+        _mm_storeu_si128((__m128i*)&out[i * 4 + 0], _mm_unpacklo_epi16(gg, ga));
+        _mm_storeu_si128((__m128i*)&out[i * 4 + 16], _mm_unpackhi_epi16(gg, ga));
+    }
+    for (; i < numpixels; i++)
+    {
+        out[i * 4 + 0] = out[i * 4 + 1] = out[i * 4 + 2] = in[i * 2 + 0];
+        out[i * 4 + 3] = in[i * 2 + 1];
+    }
+}
+
+/*
+RGB to RGBA, 4 pixels per shuffle. key is the RGB color that becomes transparent as 0xBBGGRR, or -1.
+The loads read 16 bytes for 12, so the vector loop stops while there are at least 4 bytes left.
+*/
+LODEPNG_TARGET_SSSE3
+static void convertRGBToRGBA8SSSE3(unsigned char* out, const unsigned char* in, size_t numpixels, long key)
+{
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i opaque = _mm_set1_epi32((int)0xFF000000u);
+    const __m128i keypixel = _mm_set1_epi32((int)(0xFF000000u | (unsigned)key));
+    size_t i = 0;
+    for (; i * 3 + 16 <= numpixels * 3; i += 4)
+    {
+        __m128i rgba = _mm_or_si128(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)&in[i * 3]), shuffle), opaque);
+        if (key >= 0) rgba = _mm_andnot_si128(_mm_and_si128(_mm_cmpeq_epi32(rgba, keypixel), opaque), rgba);
+        _mm_storeu_si128((__m128i*)&out[i * 4], rgba);
+    }
+    for (; i < numpixels; i++)
+    {
+        out[i * 4 + 0] = in[i * 3 + 0];
+        out[i * 4 + 1] = in[i * 3 + 1];
+        out[i * 4 + 2] = in[i * 3 + 2];
+        out[i * 4 + 3] = key >= 0 && (in[i * 3 + 0] | (in[i * 3 + 1] << 8) | (in[i * 3 + 2] << 16)) == key ? 0 : 255;
+    }
+}
+
+/*takes the most significant byte of each of the numvalues big endian 16-bit values, 16 at a time*/
+static void convert16To8SSE2(unsigned char* out, const unsigned char* in, size_t numvalues)
+{
+    const __m128i lowbytes = _mm_set1_epi16(0x00FF);
+    size_t i = 0;
+    for (; i + 16 <= numvalues; i += 16)
+    {
+        __m128i a = _mm_and_si128(_mm_loadu_si128((const __m128i*)&in[i * 2 + 0]), lowbytes);
+        __m128i b = _mm_and_si128(_mm_loadu_si128((const __m128i*)&in[i * 2 + 16]), lowbytes);
+        _mm_storeu_si128((__m128i*)&out[i], _mm_packus_epi16(a, b));
+    }
+    for (; i < numvalues; i++) out[i] = in[i * 2];
+}
+
+/*
+Converts all pixels to RGBA with 8 bit per channel like getPixelColorsRGBA8 if there's SIMD code
+for the color mode of in: greyscale, RGB, greyscale with alpha and RGBA of 8 or 16 bit, except for
+16-bit with a color key. Returns 0 without doing anything otherwise. The conversion is chosen once
+here, the kernels have no per pixel tests of the color mode.
+*/
+static int getPixelColorsRGBA8SIMD(unsigned char* buffer, size_t numpixels,
+                                   const unsigned char* in, const LodePNGColorMode* mode)
+{
+    if (mode->bitdepth == 16)
+    {
+        /*the high bytes are the 8-bit input, converted a chunk at a time to stay in the cache*/
+        LodePNGColorMode mode8 = *mode;
+        unsigned char chunk[1024];
+        size_t channels = getNumColorChannels(mode->colortype);
+        size_t chunkpixels = sizeof(chunk) / channels;
+        size_t i;
+        if (mode->key_defined && (mode->colortype == LCT_GREY || mode->colortype == LCT_RGB)) return 0;
+        if (mode->colortype == LCT_RGB && !(cpuFeatures() & CPU_SSSE3)) return 0;
+        if (mode->colortype == LCT_RGBA)
         {
-            *r = *g = *b = in[i * 2 + 0];
-            *a = in[i * 2 + 1];
+            convert16To8SSE2(buffer, in, numpixels * 4);
+            return 1;
         }
-        else
+        mode8.bitdepth = 8;
+        for (i = 0; i < numpixels; i += chunkpixels)
         {
-            *r = *g = *b = in[i * 4 + 0];
-            *a = in[i * 4 + 2];
+            size_t count = numpixels - i < chunkpixels ? numpixels - i : chunkpixels;
+            convert16To8SSE2(chunk, &in[i * channels * 2], count * channels);
+            getPixelColorsRGBA8SIMD(&buffer[i * 4], count, chunk, &mode8);
         }
+        return 1;
     }
-    else if (mode->colortype == LCT_RGBA)
+    if (mode->bitdepth != 8) return 0;
+
+    if (mode->colortype == LCT_GREY)
     {
-        if (mode->bitdepth == 8)
-        {
-            *r = in[i * 4 + 0];
-            *g = in[i * 4 + 1];
-            *b = in[i * 4 + 2];
-            *a = in[i * 4 + 3];
-        }
-        else
+        convertGreyToRGBA8SSE2(buffer, in, numpixels, mode->key_defined && mode->key_r < 256 ? (int)mode->key_r : -1);
+    }
+    else if (mode->colortype == LCT_GREY_ALPHA) convertGreyAlphaToRGBA8SSE2(buffer, in, numpixels);
+    else if (mode->colortype == LCT_RGB && (cpuFeatures() & CPU_SSSE3))
+    {
+        long key = -1;
+        if (mode->key_defined && mode->key_r < 256 && mode->key_g < 256 && mode->key_b < 256)
         {
-            *r = in[i * 8 + 0];
-            *g = in[i * 8 + 2];
-            *b = in[i * 8 + 4];
-            *a = in[i * 8 + 6];
+            key = (long)(mode->key_r | (mode->key_g << 8) | (mode->key_b << 16));
         }
+        convertRGBToRGBA8SSSE3(buffer, in, numpixels, key);
     }
-
-    return 0; /*no error*/
+    else if (mode->colortype == LCT_RGBA) memcpy(buffer, in, numpixels * 4);
+    else return 0;
+    return 1;
 }
+#endif /*LODEPNG_COMPILE_SIMD*/
 
 /*Similar to getPixelColorRGBA8, but with all the for loops inside of the color
 mode test cases, optimized to convert the colors much faster, when converting
@@ -3221,6 +4639,9 @@ static unsigned getPixelColorsRGBA8(unsigned char* buffer, size_t numpixels,
 {
     unsigned num_channels = has_alpha ? 4 : 3;
     size_t i;
+#ifdef LODEPNG_COMPILE_SIMD
+    if (has_alpha && getPixelColorsRGBA8SIMD(buffer, numpixels, in, mode)) return 0;
+#endif /*LODEPNG_COMPILE_SIMD*/
     if (mode->colortype == LCT_GREY)
     {
         if (mode->bitdepth == 8)
@@ -3242,13 +4663,14 @@ static unsigned getPixelColorsRGBA8(unsigned char* buffer, size_t numpixels,
         else
         {
             unsigned highest = ((1U << mode->bitdepth) - 1U); /*highest possible value for this bit depth*/
-            size_t j = 0;
-            for (i = 0; i < numpixels; i++, buffer += num_channels)
+            unsigned char colors[16 * 4];
+            unsigned value;
+            for (value = 0; value <= highest; value++)
             {
-                unsigned value = readBitsFromReversedStream(&j, in, mode->bitdepth);
-                buffer[0] = buffer[1] = buffer[2] = (value * 255) / highest;
-                if (has_alpha) buffer[3] = mode->key_defined && value == mode->key_r ? 0 : 255;
+                colors[value * 4 + 0] = colors[value * 4 + 1] = colors[value * 4 + 2] = (value * 255) / highest;
+                colors[value * 4 + 3] = mode->key_defined && value == mode->key_r ? 0 : 255;
             }
+            getPixelColorsFromTable(buffer, numpixels, has_alpha, in, mode->bitdepth, colors);
         }
     }
     else if (mode->colortype == LCT_RGB)
@@ -3280,28 +4702,31 @@ static unsigned getPixelColorsRGBA8(unsigned char* buffer, size_t numpixels,
     }
     else if (mode->colortype == LCT_PALETTE)
     {
+        /*every possible index gets a color, so that the lookup has no range test per pixel*/
+        unsigned char colors[256 * 4];
+        unsigned numcolors = 1u << mode->bitdepth;
         unsigned index;
-        size_t j = 0;
-        for (i = 0; i < numpixels; i++, buffer += num_channels)
+        for (index = 0; index < numcolors; index++)
         {
-            if (mode->bitdepth == 8) index = in[i];
-            else index = readBitsFromReversedStream(&j, in, mode->bitdepth);
-
-            if (index >= mode->palettesize)
+            if (index < mode->palettesize) memcpy(&colors[index * 4], &mode->palette[index * 4], 4);
+            else
             {
                 /*This is an error according to the PNG spec, but fix_png can ignore it*/
-                if (!fix_png) return (mode->bitdepth == 8 ? 46 : 47); /*index out of palette*/
-                buffer[0] = buffer[1] = buffer[2] = 0;
-                if (has_alpha) buffer[3] = 255;
+                colors[index * 4 + 0] = colors[index * 4 + 1] = colors[index * 4 + 2] = 0;
+                colors[index * 4 + 3] = 255;
             }
-            else
+        }
+        if (!fix_png && mode->palettesize < numcolors)
+        {
+            size_t j = 0;
+            for (i = 0; i < numpixels; i++)
             {
-                buffer[0] = mode->palette[index * 4 + 0];
-                buffer[1] = mode->palette[index * 4 + 1];
-                buffer[2] = mode->palette[index * 4 + 2];
-                if (has_alpha) buffer[3] = mode->palette[index * 4 + 3];
+                if (mode->bitdepth == 8) index = in[i];
+                else index = readBitsFromReversedStream(&j, in, mode->bitdepth);
+                if (index >= mode->palettesize) return (mode->bitdepth == 8 ? 46 : 47); /*index out of palette*/
             }
         }
+        getPixelColorsFromTable(buffer, numpixels, has_alpha, in, mode->bitdepth, colors);
     }
     else if (mode->colortype == LCT_GREY_ALPHA)
     {
@@ -3952,6 +5377,19 @@ static void Adam7_getpassvalues(unsigned passw[7], unsigned passh[7], size_t fil
 /* ////////////////////////////////////////////////////////////////////////// */
 
 /*read the information from the header and store it in the LodePNGInfo. return value is error*/
+/*
+Whether w * h pixels are too many for the sizes computed with unsigned, like in lodepng_get_raw_size,
+in the PNG color mode or in the raw one. The scanlines also have a filter type byte per row.
+*/
+static int pixelOverflow(unsigned w, unsigned h, const LodePNGColorMode* pngcolor, const LodePNGColorMode* rawcolor)
+{
+    unsigned bpp = lodepng_get_bpp(pngcolor);
+    unsigned long long bits;
+    if (lodepng_get_bpp(rawcolor) > bpp) bpp = lodepng_get_bpp(rawcolor);
+    bits = (unsigned long long)w * h * bpp;
+    return bits + 7 + 8ull * h > 0xffffffffull;
+}
+
 unsigned lodepng_inspect(unsigned* w, unsigned* h, LodePNGState* state,
                          const unsigned char* in, size_t insize)
 {
@@ -4006,9 +5444,167 @@ unsigned lodepng_inspect(unsigned* w, unsigned* h, LodePNGState* state,
     if (info->interlace_method > 1) CERROR_RETURN_ERROR(state->error, 34);
 
     state->error = checkColorValidity(info->color.colortype, info->color.bitdepth);
+    if (!state->error && pixelOverflow(*w, *h, &info->color, &state->info_raw))
+    {
+        CERROR_RETURN_ERROR(state->error, 92); /*error: the image sizes don't fit in an unsigned*/
+    }
     return state->error;
 }
 
+#ifdef LODEPNG_COMPILE_SIMD
+
+/*pixels of 3 or 4 bytes in the low bytes of a register, the other ones are 0*/
+static __m128i loadPixel(const unsigned char* p, size_t bytewidth)
+{
+    int value;
+    if (bytewidth == 4) memcpy(&value, p, 4);
+    else value = p[0] | (p[1] << 8) | (p[2] << 16);
+    return _mm_cvtsi32_si128(value);
+}
+
+static void storePixel(unsigned char* p, __m128i pixel, size_t bytewidth)
+{
+    int value = _mm_cvtsi128_si32(pixel);
+    if (bytewidth == 4) memcpy(p, &value, 4);
+    else
+    {
+        p[0] = (unsigned char)value;
+        p[1] = (unsigned char)(value >> 8);
+        p[2] = (unsigned char)(value >> 16);
+    }
+}
+
+/*
+The Sub, Average and Paeth filters depend on the pixel to the left, so these go one pixel at a
+time with all its channels side by side. Up has no such dependency and does 16 bytes at once.
+They load the input before storing the output, so recon may be before scanline in the same
+buffer like for unfilterScanline.
+*/
+static void unfilterSubSSE2(unsigned char* recon, const unsigned char* scanline, size_t bytewidth, size_t length)
+{
+    __m128i a = _mm_setzero_si128();
+    size_t i = 0;
+    if (bytewidth == 4)
+    {
+        /*prefix sum of 4 pixels at once, plus the last pixel of the previous ones*/
+        for (; i + 16 <= length; i += 16)
+        {
+            __m128i x = _mm_loadu_si128((const __m128i*)&scanline[i]);
+            x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+            x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+            x = _mm_add_epi8(x, a);
+            _mm_storeu_si128((__m128i*)&recon[i], x);
+            a = _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 3, 3));
+        }
+    }
+    for (; i < length; i += bytewidth)
+    {
+        a = _mm_add_epi8(a, loadPixel(&scanline[i], bytewidth));
+        storePixel(&recon[i], a, bytewidth);
+    }
+}
+
+static void unfilterUpSSE2(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon, size_t length)
+{
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i*)&scanline[i]);
+        __m128i b = _mm_loadu_si128((const __m128i*)&precon[i]);
+        _mm_storeu_si128((__m128i*)&recon[i], _mm_add_epi8(x, b));
+    }
+    for (; i < length; i++) recon[i] = scanline[i] + precon[i];
+}
+
+static void unfilterAverageSSE2(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
+                                size_t bytewidth, size_t length)
+{
+    const __m128i one = _mm_set1_epi8(1);
+    __m128i a = _mm_setzero_si128();
+    size_t i;
+    for (i = 0; i < length; i += bytewidth)
+    {
+        __m128i b = loadPixel(&precon[i], bytewidth);
+        /*_mm_avg_epu8 rounds up, (a + b) / 2 rounds down when a + b is odd*/
+        __m128i average = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+        a = _mm_add_epi8(average, loadPixel(&scanline[i], bytewidth));
+        storePixel(&recon[i], a, bytewidth);
+    }
+}
+
+/*
+Same choice as paethPredictor, in 16 bit lanes: a if pa is the smallest, else b if pb is the
+smallest, else c. The first pixel has a and c 0, which gives b like the scalar code.
+*/
+#define UNFILTER_PAETH(abs16) \
+{ \
+    const __m128i zero = _mm_setzero_si128(); \
+    __m128i a = zero, c = zero; \
+    size_t i; \
+    for (i = 0; i < length; i += bytewidth) \
+    { \
+        __m128i b = _mm_unpacklo_epi8(loadPixel(&precon[i], bytewidth), zero); \
+        __m128i x = _mm_unpacklo_epi8(loadPixel(&scanline[i], bytewidth), zero); \
+        __m128i pa = _mm_sub_epi16(b, c); \
+        __m128i pb = _mm_sub_epi16(a, c); \
+        __m128i pc = _mm_add_epi16(pa, pb); \
+        __m128i smallest, useA, useB, predictor; \
+        pa = abs16(pa); \
+        pb = abs16(pb); \
+        pc = abs16(pc); \
+        smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb)); \
+        useA = _mm_cmpeq_epi16(smallest, pa); \
+        useB = _mm_cmpeq_epi16(smallest, pb); \
+        predictor = _mm_or_si128(_mm_and_si128(useB, b), _mm_andnot_si128(useB, c)); \
+        predictor = _mm_or_si128(_mm_and_si128(useA, a), _mm_andnot_si128(useA, predictor)); \
+        /*the high bytes of the lanes stay 0, so this is the sum modulo 256*/ \
+        a = _mm_add_epi8(predictor, x); \
+        storePixel(&recon[i], _mm_packus_epi16(a, a), bytewidth); \
+        c = b; \
+    } \
+}
+
+static __m128i abs16SSE2(__m128i x)
+{
+    return _mm_max_epi16(x, _mm_sub_epi16(_mm_setzero_si128(), x));
+}
+
+static void unfilterPaethSSE2(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
+                              size_t bytewidth, size_t length)
+UNFILTER_PAETH(abs16SSE2)
+
+LODEPNG_TARGET_SSSE3
+static void unfilterPaethSSSE3(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
+                               size_t bytewidth, size_t length)
+UNFILTER_PAETH(_mm_abs_epi16)
+
+#undef UNFILTER_PAETH
+
+/*
+Unfilters the scanline like unfilterScanline if there's SIMD code for it: Up for any pixel size,
+and the other filters for 3 and 4 byte pixels. Returns 0 without doing anything otherwise.
+*/
+static int unfilterScanlineSIMD(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
+                                size_t bytewidth, unsigned char filterType, size_t length)
+{
+    if (filterType == 2 && precon)
+    {
+        unfilterUpSSE2(recon, scanline, precon, length);
+        return 1;
+    }
+    if (bytewidth != 3 && bytewidth != 4) return 0;
+    if (filterType == 1) unfilterSubSSE2(recon, scanline, bytewidth, length);
+    else if (filterType == 3 && precon) unfilterAverageSSE2(recon, scanline, precon, bytewidth, length);
+    else if (filterType == 4 && precon)
+    {
+        if (cpuFeatures() & CPU_SSSE3) unfilterPaethSSSE3(recon, scanline, precon, bytewidth, length);
+        else unfilterPaethSSE2(recon, scanline, precon, bytewidth, length);
+    }
+    else return 0;
+    return 1;
+}
+#endif /*LODEPNG_COMPILE_SIMD*/
+
 static unsigned unfilterScanline(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
                                  size_t bytewidth, unsigned char filterType, size_t length)
 {
@@ -4083,7 +5679,20 @@ static unsigned unfilterScanline(unsigned char* recon, const unsigned char* scan
     return 0;
 }
 
-static unsigned unfilter(unsigned char* out, const unsigned char* in, unsigned w, unsigned h, unsigned bpp)
+/*unfilterScanline, with the SIMD code when simd is 1 and there's some for the scanline*/
+static unsigned unfilterRow(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
+                            size_t bytewidth, unsigned char filterType, size_t length, unsigned simd)
+{
+#ifdef LODEPNG_COMPILE_SIMD
+    if (simd && unfilterScanlineSIMD(recon, scanline, precon, bytewidth, filterType, length)) return 0;
+#else /*LODEPNG_COMPILE_SIMD*/
+    (void)simd;
+#endif /*LODEPNG_COMPILE_SIMD*/
+    return unfilterScanline(recon, scanline, precon, bytewidth, filterType, length);
+}
+
+static unsigned unfilter(unsigned char* out, const unsigned char* in, unsigned w, unsigned h, unsigned bpp,
+                         unsigned simd)
 {
     /*
     For PNG filter method 0
@@ -4091,6 +5700,7 @@ static unsigned unfilter(unsigned char* out, const unsigned char* in, unsigned w
     out must have enough bytes allocated already, in must have the scanlines + 1 filtertype byte per scanline
     w and h are image dimensions or dimensions of reduced image, bpp is bits per pixel
     in and out are allowed to be the same memory address (but aren't the same size since in has the extra filter bytes)
+    simd allows the SIMD code, see unfilterRow
     */
 
     unsigned y;
@@ -4106,7 +5716,7 @@ static unsigned unfilter(unsigned char* out, const unsigned char* in, unsigned w
         size_t inindex = (1 + linebytes) * y; /*the extra filterbyte added to each row*/
         unsigned char filterType = in[inindex];
 
-        CERROR_TRY_RETURN(unfilterScanline(&out[outindex], &in[inindex + 1], prevline, bytewidth, filterType, linebytes));
+        CERROR_TRY_RETURN(unfilterRow(&out[outindex], &in[inindex + 1], prevline, bytewidth, filterType, linebytes, simd));
 
         prevline = &out[outindex];
     }
@@ -4202,11 +5812,26 @@ static void removePaddingBits(unsigned char* out, const unsigned char* in,
     }
 }
 
+/*size of the decompressed data from the IDAT chunks: the scanlines with their filter type bytes, of the 7
+passes if the image is interlaced*/
+static size_t getFilteredSize(unsigned w, unsigned h, const LodePNGInfo* info_png)
+{
+    unsigned bpp = lodepng_get_bpp(&info_png->color);
+    if (info_png->interlace_method == 1)
+    {
+        unsigned passw[7], passh[7];
+        size_t filter_passstart[8], padded_passstart[8], passstart[8];
+        Adam7_getpassvalues(passw, passh, filter_passstart, padded_passstart, passstart, w, h, bpp);
+        return filter_passstart[7];
+    }
+    return (size_t)h * (1 + (w * bpp + 7) / 8);
+}
+
 /*out must be buffer big enough to contain full image, and in must contain the full decompressed data from
 the IDAT chunks (with filter index bytes and possible padding bits)
 return value is error*/
 static unsigned postProcessScanlines(unsigned char* out, unsigned char* in,
-                                     unsigned w, unsigned h, const LodePNGInfo* info_png)
+                                     unsigned w, unsigned h, const LodePNGInfo* info_png, unsigned simd)
 {
     /*
     This function converts the filtered-padded-interlaced data into pure 2D image buffer with the PNG's colortype.
@@ -4222,11 +5847,11 @@ static unsigned postProcessScanlines(unsigned char* out, unsigned char* in,
     {
         if (bpp < 8 && w * bpp != ((w * bpp + 7) / 8) * 8)
         {
-            CERROR_TRY_RETURN(unfilter(in, in, w, h, bpp));
+            CERROR_TRY_RETURN(unfilter(in, in, w, h, bpp, simd));
             removePaddingBits(out, in, w * bpp, ((w * bpp + 7) / 8) * 8, h);
         }
         /*we can immediatly filter into the out buffer, no other steps needed*/
-        else CERROR_TRY_RETURN(unfilter(out, in, w, h, bpp));
+        else CERROR_TRY_RETURN(unfilter(out, in, w, h, bpp, simd));
     }
     else /*interlace_method is 1 (Adam7)*/
     {
@@ -4237,7 +5862,7 @@ static unsigned postProcessScanlines(unsigned char* out, unsigned char* in,
 
         for (i = 0; i < 7; i++)
         {
-            CERROR_TRY_RETURN(unfilter(&in[padded_passstart[i]], &in[filter_passstart[i]], passw[i], passh[i], bpp));
+            CERROR_TRY_RETURN(unfilter(&in[padded_passstart[i]], &in[filter_passstart[i]], passw[i], passh[i], bpp, simd));
             /*TODO: possible efficiency improvement: if in this reduced image the bits fit nicely in 1 scanline,
             move bytes instead of bits or move not at all*/
             if (bpp < 8)
@@ -4563,15 +6188,17 @@ static unsigned readChunk_pHYs(LodePNGInfo* info, const unsigned char* data, siz
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
 
 /*read a PNG, the result will be in the same color type as the PNG (hence "generic")*/
-static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
-                          LodePNGState* state,
-                          const unsigned char* in, size_t insize)
+/*
+reads all the chunks into state. The zlib data ends up in *idatdata and *idatsize: it points into in if
+there's only one IDAT chunk, otherwise the chunks are copied together into idat, which must be cleaned up
+*/
+static void decodeChunks(unsigned* w, unsigned* h, LodePNGState* state,
+                         const unsigned char* in, size_t insize,
+                         ucvector* idat, const unsigned char** idatdata, size_t* idatsize)
 {
     unsigned char IEND = 0;
     const unsigned char* chunk;
     size_t i;
-    ucvector idat; /*the data from idat chunks*/
-    ucvector scanlines;
 
     /*for unknown chunk order*/
     unsigned unknown = 0;
@@ -4579,13 +6206,13 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
     unsigned critical_pos = 1; /*1 = after IHDR, 2 = after PLTE, 3 = after IDAT*/
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
 
-    /*provide some proper output values if error will happen*/
-    *out = 0;
+    ucvector_init(idat);
+    *idatdata = 0;
+    *idatsize = 0;
 
     state->error = lodepng_inspect(w, h, state, in, insize); /*reads header and resets other parameters in state->info_png*/
     if (state->error) return;
 
-    ucvector_init(&idat);
     chunk = &in[33]; /*first byte of the first chunk after the header*/
 
     /*loop through the chunks, ignoring unknown chunks and stopping at IEND chunk.
@@ -4613,9 +6240,26 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
         /*IDAT chunk, containing compressed image data*/
         if (lodepng_chunk_type_equals(chunk, "IDAT"))
         {
-            size_t oldsize = idat.size;
-            if (!ucvector_resize(&idat, oldsize + chunkLength)) CERROR_BREAK(state->error, 83 /*alloc fail*/);
-            for (i = 0; i < chunkLength; i++) idat.data[oldsize + i] = data[i];
+            if (!*idatdata)
+            {
+                /*the first one doesn't need a copy, unless more follow*/
+                *idatdata = data;
+                *idatsize = chunkLength;
+            }
+            else
+            {
+                size_t oldsize = idat->size;
+                if (!oldsize)
+                {
+                    if (!ucvector_resize(idat, *idatsize)) CERROR_BREAK(state->error, 83 /*alloc fail*/);
+                    for (i = 0; i < *idatsize; i++) idat->data[i] = (*idatdata)[i];
+                    oldsize = *idatsize;
+                }
+                if (!ucvector_resize(idat, oldsize + chunkLength)) CERROR_BREAK(state->error, 83 /*alloc fail*/);
+                for (i = 0; i < chunkLength; i++) idat->data[oldsize + i] = data[i];
+                *idatdata = idat->data;
+                *idatsize = idat->size;
+            }
 #ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
             critical_pos = 3;
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
@@ -4708,7 +6352,33 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
 
         if (!IEND) chunk = lodepng_chunk_next_const(chunk);
     }
+}
+
+static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
+                          LodePNGState* state,
+                          const unsigned char* in, size_t insize)
+{
+    ucvector idat; /*the data from idat chunks, if there's more than one*/
+    const unsigned char* idatdata;
+    size_t idatsize;
+    ucvector scanlines;
+    ucvector outv;
+    LodePNGArena* previous;
+
+    /*provide some proper output values if error will happen*/
+    *out = 0;
+
+    decodeChunks(w, h, state, in, insize, &idat, &idatdata, &idatsize);
+
+    /*the image is given to the caller, so it's allocated before the arena is entered*/
+    ucvector_init(&outv);
+    if (!state->error)
+    {
+        if (!ucvector_resizev(&outv,
+            lodepng_get_raw_size(*w, *h, &state->info_png.color), 0)) state->error = 83; /*alloc fail*/
+    }
 
+    previous = arena_enter(state);
     ucvector_init(&scanlines);
     if (!state->error)
     {
@@ -4721,21 +6391,30 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
     if (!state->error)
     {
         /*decompress with the Zlib decompressor*/
-        state->error = zlib_decompress(&scanlines.data, &scanlines.size, idat.data,
-                                       idat.size, &state->decoder.zlibsettings);
+        state->error = zlib_decompress(&scanlines.data, &scanlines.size, idatdata,
+                                       idatsize, &state->decoder.zlibsettings);
     }
-    ucvector_cleanup(&idat);
 
     if (!state->error)
     {
-        ucvector outv;
-        ucvector_init(&outv);
-        if (!ucvector_resizev(&outv,
-            lodepng_get_raw_size(*w, *h, &state->info_png.color), 0)) state->error = 83; /*alloc fail*/
-        if (!state->error) state->error = postProcessScanlines(outv.data, scanlines.data, *w, *h, &state->info_png);
-        *out = outv.data;
+        /*too little image data gives zero scanlines instead of whatever was in the buffer. zlib_decompress
+        may have reallocated it without telling the vector, so it only trusts the size*/
+        size_t filteredsize = getFilteredSize(*w, *h, &state->info_png);
+        scanlines.allocsize = scanlines.size;
+        if (scanlines.size < filteredsize && !ucvector_resizev(&scanlines, filteredsize, 0)) state->error = 83;
+    }
+
+    if (!state->error)
+    {
+        state->error = postProcessScanlines(outv.data, scanlines.data, *w, *h, &state->info_png,
+                                            state->decoder.simd);
     }
     ucvector_cleanup(&scanlines);
+    arena_leave(state, previous);
+
+    ucvector_cleanup(&idat);
+    if (state->error) ucvector_cleanup(&outv);
+    *out = outv.data;
 }
 
 unsigned lodepng_decode(unsigned char** out, unsigned* w, unsigned* h,
@@ -4782,6 +6461,193 @@ unsigned lodepng_decode(unsigned char** out, unsigned* w, unsigned* h,
     return state->error;
 }
 
+#ifdef LODEPNG_COMPILE_ZLIB
+/*gets the inflated scanlines of a non-interlaced image while it's inflated, see lodepng_decode_into*/
+typedef struct ScanlineSink
+{
+    unsigned char* out;
+    size_t stride;
+    unsigned w, h, y;
+    size_t bytewidth, linebytes;
+    unsigned simd;
+    /*when set, scanlines are unfiltered into recon and then converted into out*/
+    const LodePNGColorMode* mode_out;
+    const LodePNGColorMode* mode_in;
+    unsigned fix_png;
+    unsigned char* recon;
+    unsigned char* prevrecon;
+    unsigned char* line; /*the filter type and scanline being collected, and how many bytes of it are there*/
+    size_t linesize;
+} ScanlineSink;
+
+/*line is the filter type byte followed by the scanline. return value is error*/
+static unsigned ScanlineSink_line(ScanlineSink* sink, const unsigned char* line)
+{
+    unsigned char* dest;
+    unsigned char* recon;
+    const unsigned char* precon;
+
+    if (sink->y >= sink->h) return 0; /*data after the last scanline is ignored, like lodepng_decode does*/
+    dest = &sink->out[sink->y * sink->stride];
+    recon = sink->mode_out ? sink->recon : dest;
+    precon = sink->y == 0 ? 0 : sink->mode_out ? sink->prevrecon : dest - sink->stride;
+    CERROR_TRY_RETURN(unfilterRow(recon, &line[1], precon, sink->bytewidth, line[0], sink->linebytes, sink->simd));
+    if (sink->mode_out)
+    {
+        CERROR_TRY_RETURN(lodepng_convert(dest, recon, (LodePNGColorMode*)sink->mode_out, sink->mode_in,
+                                          sink->w, 1, sink->fix_png));
+        sink->recon = sink->prevrecon;
+        sink->prevrecon = recon;
+    }
+    sink->y++;
+    return 0;
+}
+
+/*flush function of the zlib stream: unfilters and converts every complete scanline. return value is error*/
+static unsigned ScanlineSink_flush(void* context, const unsigned char* data, size_t size)
+{
+    ScanlineSink* sink = (ScanlineSink*)context;
+    size_t fullsize = sink->linebytes + 1;
+    while (size > 0)
+    {
+        if (sink->linesize == 0 && size >= fullsize)
+        {
+            /*whole scanlines are used right where they are*/
+            CERROR_TRY_RETURN(ScanlineSink_line(sink, data));
+            data += fullsize;
+            size -= fullsize;
+        }
+        else
+        {
+            size_t amount = fullsize - sink->linesize;
+            if (amount > size) amount = size;
+            memcpy(&sink->line[sink->linesize], data, amount);
+            sink->linesize += amount;
+            data += amount;
+            size -= amount;
+            if (sink->linesize == fullsize)
+            {
+                CERROR_TRY_RETURN(ScanlineSink_line(sink, sink->line));
+                sink->linesize = 0;
+            }
+        }
+    }
+    return 0;
+}
+#endif /*LODEPNG_COMPILE_ZLIB*/
+
+/*copies the image rows decoded by lodepng_decode into rows that are stride bytes apart*/
+static void copyRows(unsigned char* out, size_t stride, const unsigned char* in, unsigned w, unsigned h, unsigned bpp)
+{
+    size_t linebits = (size_t)w * bpp;
+    unsigned y;
+    for (y = 0; y < h; y++)
+    {
+        if (linebits % 8 == 0) memcpy(&out[y * stride], &in[y * linebits / 8], linebits / 8);
+        else
+        {
+            /*with less than 8 bits per pixel, the rows of lodepng_decode don't start at a byte*/
+            size_t ibp = y * linebits, obp = 0, x;
+            for (x = 0; x < linebits; x++)
+            {
+                unsigned char bit = readBitFromReversedStream(&ibp, in);
+                setBitOfReversedStream(&obp, &out[y * stride], bit);
+            }
+        }
+    }
+}
+
+unsigned lodepng_decode_into(unsigned char* out, size_t stride, LodePNGState* state,
+                             const unsigned char* in, size_t insize)
+{
+    unsigned w, h;
+    ucvector idat;
+    const unsigned char* idatdata;
+    size_t idatsize;
+    int stream = 1;
+
+    decodeChunks(&w, &h, state, in, insize, &idat, &idatdata, &idatsize);
+    if (state->error)
+    {
+        ucvector_cleanup(&idat);
+        return state->error;
+    }
+
+#ifdef LODEPNG_COMPILE_ZLIB
+    if (state->info_png.interlace_method != 0) stream = 0;
+    if (state->decoder.zlibsettings.custom_zlib || state->decoder.zlibsettings.custom_inflate) stream = 0;
+#else /*LODEPNG_COMPILE_ZLIB*/
+    stream = 0;
+#endif /*LODEPNG_COMPILE_ZLIB*/
+
+    if (!stream)
+    {
+        /*Adam7 needs the whole image, and custom decoders give all of it at once anyway*/
+        unsigned char* image = 0;
+        ucvector_cleanup(&idat);
+        state->error = lodepng_decode(&image, &w, &h, state, in, insize);
+        if (!state->error) copyRows(out, stride, image, w, h, lodepng_get_bpp(&state->info_raw));
+        lodepng_free(image);
+        return state->error;
+    }
+
+#ifdef LODEPNG_COMPILE_ZLIB
+    {
+        ScanlineSink sink;
+        ucvector buffer;
+        unsigned bpp = lodepng_get_bpp(&state->info_png.color);
+        LodePNGArena* previous;
+
+        sink.out = out;
+        sink.stride = stride;
+        sink.w = w;
+        sink.h = h;
+        sink.y = 0;
+        sink.bytewidth = (bpp + 7) / 8;
+        sink.linebytes = ((size_t)w * bpp + 7) / 8;
+        sink.simd = state->decoder.simd;
+        sink.mode_out = 0;
+        sink.mode_in = &state->info_png.color;
+        sink.fix_png = state->decoder.fix_png;
+        sink.linesize = 0;
+
+        if (!state->decoder.color_convert)
+        {
+            state->error = lodepng_color_mode_copy(&state->info_raw, &state->info_png.color);
+        }
+        else if (!lodepng_color_mode_equal(&state->info_raw, &state->info_png.color))
+        {
+            /*same check as lodepng_decode*/
+            if (!(state->info_raw.colortype == LCT_RGB || state->info_raw.colortype == LCT_RGBA)
+                && !(state->info_raw.bitdepth == 8))
+            {
+                state->error = 56; /*unsupported color mode conversion*/
+            }
+            sink.mode_out = &state->info_raw;
+        }
+
+        /*the scanline being collected, and 2 unfiltered ones if they need converting*/
+        previous = arena_enter(state);
+        ucvector_init(&buffer);
+        if (!state->error && !ucvector_resize(&buffer, sink.linebytes * 3 + 1)) state->error = 83; /*alloc fail*/
+        if (!state->error)
+        {
+            sink.line = buffer.data;
+            sink.recon = &buffer.data[sink.linebytes + 1];
+            sink.prevrecon = &buffer.data[sink.linebytes * 2 + 1];
+            state->error = zlib_decompress_stream(idatdata, idatsize, &state->decoder.zlibsettings,
+                                                  ScanlineSink_flush, &sink);
+        }
+        /*the rows that weren't there would be left as they were*/
+        if (!state->error && sink.y < h) state->error = 91;
+        ucvector_cleanup(&buffer);
+        arena_leave(state, previous);
+        ucvector_cleanup(&idat);
+    }
+#endif /*LODEPNG_COMPILE_ZLIB*/
+    return state->error;
+}
+
 unsigned lodepng_decode_memory(unsigned char** out, unsigned* w, unsigned* h, const unsigned char* in,
                                size_t insize, LodePNGColorType colortype, unsigned bitdepth)
 {
@@ -4838,6 +6704,7 @@ void lodepng_decoder_settings_init(LodePNGDecoderSettings* settings)
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
     settings->ignore_crc = 0;
     settings->fix_png = 0;
+    settings->simd = 1;
     lodepng_decompress_settings_init(&settings->zlibsettings);
 }
 
@@ -4856,18 +6723,24 @@ void lodepng_state_init(LodePNGState* state)
     lodepng_color_mode_init(&state->info_raw);
     lodepng_info_init(&state->info_png);
     state->error = 1;
+    state->use_arena = 0;
+    arena_init(&state->arena);
 }
 
 void lodepng_state_cleanup(LodePNGState* state)
 {
     lodepng_color_mode_cleanup(&state->info_raw);
     lodepng_info_cleanup(&state->info_png);
+    arena_cleanup(&state->arena);
 }
 
 void lodepng_state_copy(LodePNGState* dest, const LodePNGState* source)
 {
-    lodepng_state_cleanup(dest);
+    LodePNGArena arena = dest->arena; /*dest keeps its own arena, with the memory it grew to*/
+    lodepng_color_mode_cleanup(&dest->info_raw);
+    lodepng_info_cleanup(&dest->info_png);
     *dest = *source;
+    dest->arena = arena;
     lodepng_color_mode_init(&dest->info_raw);
     lodepng_info_init(&dest->info_png);
     dest->error = lodepng_color_mode_copy(&dest->info_raw, &source->info_raw); if (dest->error) return;
@@ -5662,9 +7535,9 @@ static unsigned addUnknownChunks(ucvector* out, unsigned char* data, size_t data
 }
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
 
-unsigned lodepng_encode(unsigned char** out, size_t* outsize,
-                        const unsigned char* image, unsigned w, unsigned h,
-                        LodePNGState* state)
+static unsigned encodeImage(unsigned char** out, size_t* outsize,
+                            const unsigned char* image, unsigned w, unsigned h,
+                            LodePNGState* state)
 {
     LodePNGInfo info;
     ucvector outv;
@@ -5856,6 +7729,26 @@ unsigned lodepng_encode(unsigned char** out, size_t* outsize,
     return state->error;
 }
 
+unsigned lodepng_encode(unsigned char** out, size_t* outsize,
+                        const unsigned char* image, unsigned w, unsigned h,
+                        LodePNGState* state)
+{
+    /*all of encoding is temporary buffers, except the PNG, which is moved out of the arena at the end*/
+    LodePNGArena* previous = arena_enter(state);
+    encodeImage(out, outsize, image, w, h, state);
+    if (*out)
+    {
+        *out = (unsigned char*)arena_release(*out, *outsize);
+        if (!*out)
+        {
+            *outsize = 0;
+            if (!state->error) state->error = 83; /*alloc fail*/
+        }
+    }
+    arena_leave(state, previous);
+    return state->error;
+}
+
 unsigned lodepng_encode_memory(unsigned char** out, size_t* outsize, const unsigned char* image,
                                unsigned w, unsigned h, LodePNGColorType colortype, unsigned bitdepth)
 {
@@ -6026,6 +7919,8 @@ const char* lodepng_error_text(unsigned code)
         case 89: return "text chunk keyword too short or long: must have size 1-79";
             /*the windowsize in the LodePNGCompressSettings. Requiring POT(==> & instead of %) makes encoding 12% faster.*/
         case 90: return "windowsize must be a power of two";
+        case 91: return "decompressed image data too small for the image size";
+        case 92: return "image too large, its size in bytes doesn't fit in 32 bits";
     }
     return "unknown error code";
 }
@@ -6182,6 +8077,87 @@ namespace lodepng
         return decode(out, w, h, state, in.empty() ? 0 : &in[0], in.size());
     }
 
+#ifdef LODEPNG_COMPILE_THREADS
+    BatchImage::BatchImage() : in(0), insize(0), w(0), h(0), error(0)
+    {
+    }
+
+    /*decodes into the vector without the copy of decode when rows don't need bit packing*/
+    static unsigned decodeBatchImage(BatchImage& image, State& state, const unsigned char* in, size_t insize)
+    {
+        const LodePNGColorMode* mode;
+        size_t linebits;
+        unsigned error = lodepng_inspect(&image.w, &image.h, &state, in, insize);
+        if (error) return error;
+        mode = state.decoder.color_convert ? &state.info_raw : &state.info_png.color;
+        linebits = (size_t)image.w * lodepng_get_bpp(mode);
+        if (linebits % 8 != 0) return decode(image.out, image.w, image.h, state, in, insize);
+        image.out.resize(linebits / 8 * image.h);
+        if (image.out.empty()) return decode(image.out, image.w, image.h, state, in, insize);
+        error = lodepng_decode_into(&image.out[0], linebits / 8, &state, in, insize);
+        if (error) image.out.clear();
+        return error;
+    }
+
+    static void decodeBatchWorker(std::vector<BatchImage>* images, const State* settings, std::atomic<size_t>* next)
+    {
+        State state; /*decoding writes the info of the image in it, so every thread has its own*/
+        std::vector<unsigned char> file; /*reused for all the files this thread loads*/
+        for (;;)
+        {
+            /*take the next image that isn't taken, so slow images don't hold back the others*/
+            size_t i = (*next)++;
+            if (i >= images->size()) break;
+            BatchImage& image = (*images)[i];
+            const unsigned char* in = image.in;
+            size_t insize = image.insize;
+
+            state = *settings;
+            image.out.clear();
+#ifdef LODEPNG_COMPILE_DISK
+            if (!image.filename.empty())
+            {
+                load_file(file, image.filename);
+                in = file.empty() ? 0 : &file[0];
+                insize = file.size();
+                if (!in)
+                {
+                    image.error = 78; /*failed to open file for reading*/
+                    continue;
+                }
+            }
+#endif //LODEPNG_COMPILE_DISK
+            image.error = decodeBatchImage(image, state, in, insize);
+        }
+    }
+
+    unsigned decode_batch(std::vector<BatchImage>& images, const State& state, unsigned threads)
+    {
+        std::atomic<size_t> next(0);
+        std::vector<std::thread> workers;
+        size_t i;
+
+        if (threads == 0) threads = std::thread::hardware_concurrency();
+        if (threads == 0) threads = 1;
+        if (threads > images.size()) threads = (unsigned)images.size();
+
+#ifdef LODEPNG_COMPILE_SIMD
+        cpuFeatures(); /*it caches the CPU check on the first call, have that done before the threads*/
+#endif /*LODEPNG_COMPILE_SIMD*/
+
+        /*the calling thread is one of the workers*/
+        for (i = 1; i < threads; i++) workers.push_back(std::thread(decodeBatchWorker, &images, &state, &next));
+        decodeBatchWorker(&images, &state, &next);
+        for (i = 0; i < workers.size(); i++) workers[i].join();
+
+        for (i = 0; i < images.size(); i++)
+        {
+            if (images[i].error) return images[i].error;
+        }
+        return 0;
+    }
+#endif //LODEPNG_COMPILE_THREADS
+
 #ifdef LODEPNG_COMPILE_DISK
     unsigned decode(std::vector<unsigned char>& out, unsigned& w, unsigned& h, const std::string& filename,
                     LodePNGColorType colortype, unsigned bitdepth)
@@ -81,6 +81,12 @@ source files with custom allocators.*/
 #define LODEPNG_COMPILE_CPP
 #endif
 #endif
+/*decoding many images and deflating on several threads (needs C++11 std::thread)*/
+#ifdef LODEPNG_COMPILE_CPP
+#ifndef LODEPNG_NO_COMPILE_THREADS
+#define LODEPNG_COMPILE_THREADS
+#endif
+#endif
 
 #ifdef LODEPNG_COMPILE_PNG
 /*The PNG color types (also used for raw).*/
@@ -263,6 +269,10 @@ struct LodePNGDecompressSettings
                               const LodePNGDecompressSettings*);
 
     const void* custom_context; /*optional custom settings for custom functions*/
+
+    /*if 1, decode Huffman blocks with lookup tables and a 64-bit bit buffer where possible (default: 1).
+    0 uses only the bit by bit decoder, the output is the same either way*/
+    unsigned fast_inflate;
 };
 
 extern const LodePNGDecompressSettings lodepng_default_decompress_settings;
@@ -270,6 +280,19 @@ void lodepng_decompress_settings_init(LodePNGDecompressSettings* settings);
 #endif /*LODEPNG_COMPILE_DECODER*/
 
 #ifdef LODEPNG_COMPILE_ENCODER
+/*LZ77 match finder used by the deflate encoder. Default: LCL_DEFAULT*/
+typedef enum LodePNGCompressLevel
+{
+    /*the hash chain search, tuned with windowsize, minmatch, nicematch and lazymatching*/
+    LCL_DEFAULT,
+    /*one look into a few recent positions with the same hash, greedy. Much faster,
+    somewhat bigger output. Always uses the full 32K window.*/
+    LCL_FAST,
+    /*longest matches over the full 32K window, then the cheapest parse into literals
+    and matches for the Huffman codes. Slow, smallest output.*/
+    LCL_BEST
+} LodePNGCompressLevel;
+
 /*
 Settings for zlib compression. Tweaking these settings tweaks the balance
 between speed and compression ratio.
@@ -297,6 +320,13 @@ struct LodePNGCompressSettings /*deflate = compress*/
                               const LodePNGCompressSettings*);
 
     const void* custom_context; /*optional custom settings for custom functions*/
+
+    /*deflate parts of the data on this many threads, with LODEPNG_COMPILE_THREADS. The
+    result is a bit bigger than with 1 thread but still standard zlib data. Default: 1*/
+    unsigned threads;
+
+    /*how to find the LZ77 matches, see LodePNGCompressLevel. Default: LCL_DEFAULT*/
+    LodePNGCompressLevel level;
 };
 
 extern const LodePNGCompressSettings lodepng_default_compress_settings;
@@ -525,6 +555,7 @@ typedef struct LodePNGDecoderSettings
     */
     unsigned fix_png;
     unsigned color_convert; /*whether to convert the PNG to the color type you want. Default: yes*/
+    unsigned simd; /*whether to unfilter with SSE2/SSSE3 code where there is some. Default: yes, same result*/
 
 #ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
     unsigned read_text_chunks; /*if false but remember_unknown_chunks is true, they're stored in the unknown chunks*/
@@ -627,6 +658,25 @@ void lodepng_encoder_settings_init(LodePNGEncoderSettings* settings);
 
 
 #if defined(LODEPNG_COMPILE_DECODER) || defined(LODEPNG_COMPILE_ENCODER)
+/*
+Bump allocator for the temporary buffers of one image, see use_arena in LodePNGState.
+It starts empty, so the first image takes its buffers from the heap, and after each
+image it is reset and grows to what that image needed. Only the allocators of
+LODEPNG_COMPILE_ALLOCATORS use it.
+*/
+typedef struct LodePNGArena
+{
+    unsigned char* data;
+    size_t size; /*bytes in use*/
+    size_t allocsize; /*bytes in data*/
+    size_t overflow; /*bytes the current image took from the heap because data was full*/
+    size_t peak; /*most bytes the current image needed at once, data grows to this at the reset*/
+    /*statistics: allocations asked of the arena since the state was made, and how many of
+    those still went to the heap*/
+    size_t allocations;
+    size_t fallbacks;
+} LodePNGArena;
+
 /*The settings, state and information for extended encoding and decoding.*/
 typedef struct LodePNGState
 {
@@ -639,6 +689,11 @@ typedef struct LodePNGState
     LodePNGColorMode info_raw; /*specifies the format in which you would like to get the raw pixel buffer*/
     LodePNGInfo info_png; /*info of the PNG image obtained after decoding*/
     unsigned error;
+    /*take the temporary buffers of decoding and encoding from arena instead of one malloc
+    each. Saves allocator calls, and lock contention when decoding on several threads.
+    The arena is not copied with the state. Default: 0*/
+    unsigned use_arena;
+    LodePNGArena arena;
 #ifdef LODEPNG_COMPILE_CPP
     //For the lodepng::State subclass.
     virtual ~LodePNGState() {}
@@ -660,6 +715,21 @@ unsigned lodepng_decode(unsigned char** out, unsigned* w, unsigned* h,
                         LodePNGState* state,
                         const unsigned char* in, size_t insize);
 
+/*
+Same as lodepng_decode, but decodes into a buffer given by the caller, and
+without keeping the whole image in memory twice: the zlib data is inflated in
+parts and every scanline is unfiltered and color converted as soon as it's there.
+out: the image in the color type of state->info_raw, rows are stride bytes apart
+     and all start at a byte. Get the size with lodepng_inspect first, this only
+     writes w * h pixels.
+Interlaced images, and custom zlib or inflate functions, go through lodepng_decode
+and are copied, that gives the same result without the memory saving.
+Unlike lodepng_decode, too little image data is error 91 instead of rows of zeros.
+*/
+unsigned lodepng_decode_into(unsigned char* out, size_t stride,
+                             LodePNGState* state,
+                             const unsigned char* in, size_t insize);
+
 /*
 Read the PNG header, but not the actual data. This returns only the information
 that is in the header chunk of the PNG, such as width, height and color type. The
@@ -839,6 +909,30 @@ namespace lodepng
     unsigned decode(std::vector<unsigned char>& out, unsigned& w, unsigned& h,
                     State& state,
                     const std::vector<unsigned char>& in);
+
+#ifdef LODEPNG_COMPILE_THREADS
+    //One image of decode_batch: the file filename if it's not empty, otherwise the PNG at in.
+    struct BatchImage
+    {
+        BatchImage();
+        const unsigned char* in;
+        size_t insize;
+        std::string filename;
+        //Same as the results of decode.
+        std::vector<unsigned char> out;
+        unsigned w, h;
+        unsigned error;
+    };
+
+    /*
+    Decodes all the images on threads threads, 0 for one per hardware thread, the
+    calling thread included. Every thread decodes with its own copy of state and
+    takes the next image as soon as it's done with one, so results stay in the
+    order of images whatever the order they finish in.
+    Returns the error of the first image that failed, or 0.
+    */
+    unsigned decode_batch(std::vector<BatchImage>& images, const State& state = State(), unsigned threads = 0);
+#endif /*LODEPNG_COMPILE_THREADS*/
 #endif /*LODEPNG_COMPILE_DECODER*/
 
 #ifdef LODEPNG_COMPILE_ENCODER
@@ -2,7 +2,10 @@
 #include <ft2build.h>
 #include FT_FREETYPE_H
 #include <assert.h>
+#include <string.h>
+#include <list>
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <locale>
 #include <codecvt>
@@ -10,11 +13,76 @@
 
 namespace dfr {
 
+	struct sFace {
+		FT_Face face;
+		int pixelSize = 0;	/** Pixel size currently set on face, 0 if none yet */
+		std::unordered_map<wchar_t, FT_UInt> charIndices;
+		std::map<int, int> lineHeights;	/** By pixel size */
+	};
+
+	struct sGlyphKey {
+		FT_Face face;
+		int		pixelSize;
+		FT_UInt	index;
+
+		bool operator==(const sGlyphKey& other) const {
+			return face == other.face && pixelSize == other.pixelSize && index == other.index;
+		}
+	};
+
+	struct sGlyphKeyHash {
+		size_t operator()(const sGlyphKey& key) const {
+			return std::hash<void*>()(key.face) ^ ((size_t) key.pixelSize << 20) ^ (size_t) key.index * 2654435761u;
+		}
+	};
+
+	struct sKerning {
+		FT_UInt	right;
+		int		x;
+	};
+
+	struct sGlyph {
+		sGlyphKey					key;
+		bool						loaded;		/** False if FreeType couldn't load or render it */
+		bool						rendered;	/** False while only the metrics were needed */
+		int							advance;
+		int							bearingX, bearingY;
+		int							width, rows;
+		std::vector<unsigned char>	coverage;	/** 8-bit, width * rows, once rendered */
+		std::vector<sKerning>		kernings;	/** With this glyph on the left */
+		size_t						bytes;		/** What it counts for in the cache size */
+		sGlyphAtlas					atlas;		/** Where layoutText put the coverage */
+		unsigned int				atlasEntry;	/** 0 if it's in no atlas */
+		unsigned int				layout;		/** Last layout that used it */
+	};
+
+	typedef std::list<sGlyph> GlyphList;
+
+	struct sLine {
+		int width = 0;
+		int from = 0;
+		int to = 0;
+	};
+
+	struct sLines {
+		int					pointSize = 0;	/** 0 until broken at a size */
+		int					lineHeight = 0;
+		int					maxWidth = 0;	/** Widest line */
+		std::vector<sLine>	lines;
+	};
+
 	std::mutex g_ttfFacesMutex;
 	FT_Library g_ttfLibrary;
-	std::map<std::string, FT_Face> g_faces;
+	std::map<std::string, sFace> g_faces;
 	bool g_isInitialized = false;
 
+	// The glyphs rendered at each size, most recently used first
+	GlyphList g_glyphs;
+	std::unordered_map<sGlyphKey, GlyphList::iterator, sGlyphKeyHash> g_glyphMap;
+	size_t g_glyphCacheSize = 4 * 1024 * 1024;
+	unsigned int g_layoutCount = 0;
+	sGlyphCacheStats g_glyphCacheStats = {};
+
 	void init() {
 		if (g_isInitialized) return;
 		assert(!FT_Init_FreeType(&g_ttfLibrary));
@@ -29,6 +97,145 @@ namespace dfr {
 		return a + (((b - a) >> 31) & (b - a));
 	}
 
+	// Drop the least recently used glyphs until the cache fits, but none of the
+	// current layout: the glyphs and the atlas entries of its quads are in use
+	void evictGlyphs() {
+		while (g_glyphCacheStats.bytes > g_glyphCacheSize && !g_glyphs.empty() && g_glyphs.back().layout != g_layoutCount) {
+			const sGlyph& glyph = g_glyphs.back();
+			if (glyph.atlasEntry && glyph.atlas.remove) glyph.atlas.remove(glyph.atlas.pContext, glyph.atlasEntry);
+			g_glyphCacheStats.bytes -= glyph.bytes;
+			g_glyphMap.erase(glyph.key);
+			g_glyphs.pop_back();
+		}
+		g_glyphCacheStats.glyphCount = g_glyphs.size();
+	}
+
+	void setGlyphCacheSize(size_t in_maxBytes) {
+		g_ttfFacesMutex.lock();
+		g_glyphCacheSize = in_maxBytes;
+		evictGlyphs();
+		g_ttfFacesMutex.unlock();
+	}
+
+	sGlyphCacheStats getGlyphCacheStats() {
+		g_ttfFacesMutex.lock();
+		sGlyphCacheStats stats = g_glyphCacheStats;
+		g_ttfFacesMutex.unlock();
+		return stats;
+	}
+
+	void setPixelSize(sFace& in_face, int in_pixelSize) {
+		if (in_face.pixelSize == in_pixelSize) return;
+		FT_Error error = FT_Set_Pixel_Sizes(in_face.face, 0, in_pixelSize);
+		assert(!error);
+		in_face.pixelSize = in_pixelSize;
+	}
+
+	FT_UInt getCharIndex(sFace& in_face, wchar_t in_char) {
+		const auto& it = in_face.charIndices.find(in_char);
+		if (it != in_face.charIndices.end()) return it->second;
+		FT_UInt index = FT_Get_Char_Index(in_face.face, in_char);
+		in_face.charIndices[in_char] = index;
+		return index;
+	}
+
+	int getLineHeight(sFace& in_face, int in_pixelSize) {
+		const auto& it = in_face.lineHeights.find(in_pixelSize);
+		if (it != in_face.lineHeights.end()) return it->second;
+		setPixelSize(in_face, in_pixelSize);
+		int lineHeight = in_face.face->size->metrics.height >> 6;
+		in_face.lineHeights[in_pixelSize] = lineHeight;
+		return lineHeight;
+	}
+
+	// Load the glyph into the face slot, and copy its metrics and, if
+	// in_render, its coverage
+	void loadGlyph(sFace& in_face, sGlyph& in_glyph, bool in_render) {
+		setPixelSize(in_face, in_glyph.key.pixelSize);
+		in_glyph.loaded = !FT_Load_Glyph(in_face.face, in_glyph.key.index, in_render ? FT_LOAD_RENDER : FT_LOAD_DEFAULT);
+		in_glyph.rendered = in_render;
+		if (!in_glyph.loaded) return;
+		FT_GlyphSlot slot = in_face.face->glyph;
+		in_glyph.advance = slot->advance.x >> 6;
+		in_glyph.bearingX = slot->metrics.horiBearingX >> 6;
+		in_glyph.bearingY = slot->metrics.horiBearingY >> 6;
+		if (!in_render) return;
+		FT_Bitmap* bitmap = &slot->bitmap;
+		in_glyph.width = (int) bitmap->width;
+		in_glyph.rows = (int) bitmap->rows;
+		in_glyph.coverage.resize(in_glyph.width * in_glyph.rows);
+		for (int y = 0; y < in_glyph.rows; ++y) {
+			memcpy(&in_glyph.coverage[y * in_glyph.width], &bitmap->buffer[y * bitmap->pitch], in_glyph.width);
+		}
+		in_glyph.bytes += in_glyph.coverage.size();
+		g_glyphCacheStats.bytes += in_glyph.coverage.size();
+	}
+
+	// The glyph from the cache, loaded on a miss. Only the metrics are loaded
+	// unless in_render, so measuring at many sizes doesn't rasterize. It stays
+	// until the end of the layout.
+	sGlyph& getGlyph(sFace& in_face, int in_pixelSize, FT_UInt in_index, bool in_render = false) {
+		sGlyphKey key = { in_face.face, in_pixelSize, in_index };
+		const auto& it = g_glyphMap.find(key);
+		if (it != g_glyphMap.end()) {
+			++g_glyphCacheStats.hits;
+			g_glyphs.splice(g_glyphs.begin(), g_glyphs, it->second);
+			sGlyph& glyph = *it->second;
+			glyph.layout = g_layoutCount;
+			if (in_render && glyph.loaded && !glyph.rendered) {
+				loadGlyph(in_face, glyph, true);
+				evictGlyphs();
+			}
+			return glyph;
+		}
+
+		++g_glyphCacheStats.misses;
+		g_glyphs.emplace_front();
+		sGlyph& glyph = g_glyphs.front();
+		glyph.key = key;
+		glyph.advance = glyph.bearingX = glyph.bearingY = glyph.width = glyph.rows = 0;
+		glyph.atlas = {};
+		glyph.atlasEntry = 0;
+		glyph.layout = g_layoutCount;
+
+		// The list and map nodes are about 64 bytes more
+		glyph.bytes = sizeof(sGlyph) + 64;
+		g_glyphCacheStats.bytes += glyph.bytes;
+		loadGlyph(in_face, glyph, in_render);
+		g_glyphMap[key] = g_glyphs.begin();
+		evictGlyphs();
+		return glyph;
+	}
+
+	// Kerning in pixels between two glyphs, cached with the left one
+	int getKerning(sFace& in_face, int in_pixelSize, FT_UInt in_left, FT_UInt in_right) {
+		if (!FT_HAS_KERNING(in_face.face)) return 0;
+		sGlyph& left = getGlyph(in_face, in_pixelSize, in_left);
+		for (const auto& kerning : left.kernings) {
+			if (kerning.right == in_right) return kerning.x;
+		}
+		setPixelSize(in_face, in_pixelSize);
+		FT_Vector kerning;
+		FT_Get_Kerning(in_face.face, in_left, in_right, FT_KERNING_DEFAULT, &kerning);
+		left.kernings.push_back({ in_right, (int) (kerning.x >> 6) });
+		left.bytes += sizeof(sKerning);
+		g_glyphCacheStats.bytes += sizeof(sKerning);
+		return (int) (kerning.x >> 6);
+	}
+
+	// The atlas entry of the glyph coverage, inserted the first time. A glyph
+	// moves if it was in another atlas.
+	unsigned int getAtlasEntry(sGlyph& in_glyph, const sGlyphAtlas& in_atlas) {
+		if (in_glyph.atlasEntry) {
+			if (in_glyph.atlas.pContext == in_atlas.pContext &&
+				in_glyph.atlas.insert == in_atlas.insert) return in_glyph.atlasEntry;
+			if (in_glyph.atlas.remove) in_glyph.atlas.remove(in_glyph.atlas.pContext, in_glyph.atlasEntry);
+		}
+		in_glyph.atlas = in_atlas;
+		in_glyph.atlasEntry = in_atlas.insert(in_atlas.pContext, in_glyph.width, in_glyph.rows, in_glyph.coverage.data());
+		return in_glyph.atlasEntry;
+	}
+
 	sRenderInfo drawText(
 		const std::string& in_text,
 		const sImage& in_outputImage,
@@ -42,267 +249,301 @@ namespace dfr {
 		return drawText(wText, in_outputImage, in_font, in_formating, in_color);
 	}
 
-	sRenderInfo drawText(
-		const std::wstring& in_text,
-		const sImage& in_outputImage,
-		const sFont& in_font,
-		const sFormating& in_formating,
-		const sColor& in_color) {
+	// The face of the font file, opened the first time. Needs the lock.
+	sFace& getFace(const std::string& in_filename) {
+		auto it = g_faces.find(in_filename);
+		if (it == g_faces.end()) {
+			FT_Face face;
+			assert(!FT_New_Face(
+				g_ttfLibrary,
+				in_filename.c_str(),
+				0,
+				&face));
+			it = g_faces.insert(std::make_pair(in_filename, sFace())).first;
+			it->second.face = face;
+		}
+		return it->second;
+	}
 
-		sRenderInfo result;
+	// Break the text in lines at a point size, from the glyph metrics only
+	void breakLines(
+		sFace& in_face,
+		const std::wstring& in_text,
+		const std::vector<FT_UInt>& in_glyphIndices,
+		int in_pointSize,
+		int in_width,
+		bool in_wordWrap,
+		sLines& out_lines) {
+
+		int				n;
+		int				num_chars = (int) in_text.size();
+		const wchar_t*	text = in_text.c_str();
+		int lineHeight = getLineHeight(in_face, in_pointSize);
+		int maxW = 0;
 		sPoint pen = { 0, 0 };
-		FT_Face face;
-
-		g_ttfFacesMutex.lock();
-		{
-			const auto& it = g_faces.find(in_font.filename);
-			if (it == g_faces.end()) {
-				assert(!FT_New_Face(
-					g_ttfLibrary,
-					in_font.filename.c_str(),
-					0,
-					&face));
-				g_faces[in_font.filename] = face;
+		int lastWordStart = -1;
+		int lastWordWidth = 0;
+		std::vector<sLine>& lines = out_lines.lines;
+		sLine currentLine;
+		lines.clear();
+
+		for (n = 0; n < num_chars; ++n) {
+			// Get the glyph metrics only
+			const sGlyph& glyph = getGlyph(in_face, in_pointSize, in_glyphIndices[n]);
+			if (!glyph.loaded) continue;
+
+			int advance = glyph.advance;
+			if (n > 0) {
+				advance += getKerning(in_face, in_pointSize, in_glyphIndices[n - 1], in_glyphIndices[n]);
 			}
-			else {
-				face = it->second;
+			int gW = advance;
+
+			if (text[n] == '\n') {
+				// We will new line and ignore that return
+				currentLine.width = pen.x;
+				currentLine.to = n - 1;
+				lines.push_back(currentLine);
+				currentLine.from = currentLine.to + 2;
+				lastWordWidth = 0;
+				pen.x = 0;
+				pen.y += lineHeight;
+				continue;
 			}
-		}
-		g_ttfFacesMutex.unlock();
 
-		int pointSize = in_font.pointSize;
-		struct sLine {
-			int width = 0;
-			int from = 0;
-			int to = 0;
-		};
-		while (true) {
-			assert(!FT_Set_Pixel_Sizes(
-				face,
-				0,
-				pointSize));
-
-			FT_GlyphSlot	slot = face->glyph;
-			int				n, x, y, k;
-			int				num_chars = (int) in_text.size();
-			wchar_t*			text = (wchar_t*) in_text.c_str();
-			unsigned char	alpha;
-			FT_Error		error;
-			int lineHeight = face->size->metrics.height >> 6;
-			int maxW = 0;
-			pen = { 0, 0 };
-			int alignOffsetX = 0;
-			int alignOffsetY = 0;
-			int lastWordStart = -1;
-			int lastWordWidth = 0;
-			std::vector<sLine> lines;
-			sLine currentLine;
-			result.renderedRect.x = in_outputImage.width;
-			result.renderedRect.y = in_outputImage.height;
-			result.renderedRect.w = 0;
-			result.renderedRect.h = 0;
-
-			for (n = 0; n < num_chars; ++n) {
-				// Get the glyph metrics only
-				FT_UInt  glyph_index;
-				glyph_index = FT_Get_Char_Index(face, text[n]);
-				error = FT_Load_Glyph(face, glyph_index, FT_LOAD_DEFAULT);
-				if (error) continue;
-
-				int advance = slot->advance.x >> 6;
-				if (n > 0) {
-					FT_UInt leftGlyph = FT_Get_Char_Index(face, text[n - 1]);
-					FT_Vector kerning;
-					FT_Get_Kerning(face, leftGlyph, glyph_index, FT_KERNING_DEFAULT, &kerning);
-					advance += kerning.x >> 6;
-				}
-				int gW = advance;
+			// A glyph wider than the area stays alone on its line, breaking
+			// before it would give an empty line forever
+			if (pen.x + gW >= in_width && in_wordWrap && pen.x > 0) {
+				maxW = dfr_max(maxW, pen.x);
 
-				if (text[n] == '\n') {
-					// We will new line and ignore that return
+				if (text[n] == ' ') {
+					// We will new line and ignore that space
 					currentLine.width = pen.x;
 					currentLine.to = n - 1;
 					lines.push_back(currentLine);
-					currentLine.from = currentLine.to + 2;
+					currentLine.from = currentLine.to + 1;
 					lastWordWidth = 0;
 					pen.x = 0;
 					pen.y += lineHeight;
 					continue;
 				}
 
-				if (pen.x + gW >= in_outputImage.width && in_formating.wordWrap) {
-					maxW = dfr_max(maxW, pen.x);
-
-					if (text[n] == ' ') {
-						// We will new line and ignore that space
-						currentLine.width = pen.x;
-						currentLine.to = n - 1;
-						lines.push_back(currentLine);
-						currentLine.from = currentLine.to + 1;
-						lastWordWidth = 0;
-						pen.x = 0;
-						pen.y += lineHeight;
-						continue;
-					}
-
-					// This character will go over, we will break line
-					if (lastWordStart == -1) {
-						// We have to cut this word in half, its bigger
-						// than the row!
-						currentLine.width = pen.x;
-						currentLine.to = n - 1;
-						lines.push_back(currentLine);
-						currentLine.from = currentLine.to + 1;
-						lastWordWidth = 0;
-						pen.x = 0;
-						pen.y += lineHeight;
-						--n;
-						continue;
-					}
-					else {
-						currentLine.width = lastWordWidth;
-						currentLine.to = lastWordStart - 1;
-						lines.push_back(currentLine);
-						currentLine.from = currentLine.to + 1;
-						pen.x = 0;
-						pen.y += lineHeight;
-						n = lastWordStart - 1;
-						lastWordWidth = 0;
-						lastWordStart = -1;
-						continue;
-					}
+				// This character will go over, we will break line
+				if (lastWordStart == -1) {
+					// We have to cut this word in half, its bigger
+					// than the row!
+					currentLine.width = pen.x;
+					currentLine.to = n - 1;
+					lines.push_back(currentLine);
+					currentLine.from = currentLine.to + 1;
+					lastWordWidth = 0;
+					pen.x = 0;
+					pen.y += lineHeight;
+					--n;
+					continue;
 				}
-
-				if (text[n] == ' ') {
-					lastWordWidth = pen.x;
-					lastWordStart = n + 1;
+				else {
+					currentLine.width = lastWordWidth;
+					currentLine.to = lastWordStart - 1;
+					lines.push_back(currentLine);
+					currentLine.from = currentLine.to + 1;
+					pen.x = 0;
+					pen.y += lineHeight;
+					n = lastWordStart - 1;
+					lastWordWidth = 0;
+					lastWordStart = -1;
+					continue;
 				}
+			}
 
-				pen.x += gW;
+			if (text[n] == ' ') {
+				lastWordWidth = pen.x;
+				lastWordStart = n + 1;
 			}
 
-			if (pen.x) {
-				maxW = dfr_max(maxW, pen.x);
-				currentLine.width = pen.x;
-				currentLine.to = n - 1;
-				lines.push_back(currentLine);
+			pen.x += gW;
+		}
+
+		if (pen.x) {
+			maxW = dfr_max(maxW, pen.x);
+			currentLine.width = pen.x;
+			currentLine.to = n - 1;
+			lines.push_back(currentLine);
+		}
+
+		out_lines.pointSize = in_pointSize;
+		out_lines.lineHeight = lineHeight;
+		out_lines.maxWidth = maxW;
+	}
+
+	// Break the text in lines at the largest point size that fits the area,
+	// between the minimum and the font point size. Bisects over the sizes,
+	// taking that a text that doesn't fit won't fit smaller either.
+	void fitLines(
+		sFace& in_face,
+		const std::wstring& in_text,
+		const std::vector<FT_UInt>& in_glyphIndices,
+		int in_width,
+		int in_height,
+		const sFont& in_font,
+		const sFormating& in_formating,
+		sLines& out_lines) {
+
+		auto fits = [&](int pointSize) {
+			breakLines(in_face, in_text, in_glyphIndices, pointSize, in_width, in_formating.wordWrap, out_lines);
+			return out_lines.maxWidth <= in_width &&
+				((int) out_lines.lines.size() * out_lines.lineHeight) <= in_height;
+		};
+
+		int pointSize = in_font.pointSize;
+		if (in_formating.minPointSize && pointSize > in_formating.minPointSize && !fits(pointSize)) {
+			// The minimum is used when nothing fits
+			int low = in_formating.minPointSize;
+			int high = pointSize - 1;
+			while (low < high) {
+				int mid = (low + high + 1) / 2;
+				if (fits(mid)) low = mid;
+				else high = mid - 1;
 			}
+			pointSize = low;
+		}
+
+		// The last size tried may not be the one kept
+		if (out_lines.pointSize != pointSize) {
+			breakLines(in_face, in_text, in_glyphIndices, pointSize, in_width, in_formating.wordWrap, out_lines);
+		}
+	}
+
+	// Lays the text out in a in_width x in_height area, and calls
+	// in_emitGlyph(glyph, x, y, limits) for each glyph, where limits is the
+	// part of the glyph inside the area. drawText and layoutText only differ
+	// by what they do with the glyphs.
+	template <typename EmitGlyph>
+	sRenderInfo layoutGlyphs(
+		const std::wstring& in_text,
+		int in_width,
+		int in_height,
+		const sFont& in_font,
+		const sFormating& in_formating,
+		EmitGlyph in_emitGlyph) {
+
+		sRenderInfo result;
+		sPoint pen = { 0, 0 };
+
+		// The faces aren't thread safe and the glyph cache is shared, so this
+		// holds the lock for the whole draw
+		g_ttfFacesMutex.lock();
+		sFace& cachedFace = getFace(in_font.filename);
+		FT_Face face = cachedFace.face;
+
+		// The glyphs of the previous layout can go now, their quads were drawn
+		++g_layoutCount;
+		evictGlyphs();
 
-			// Now render line by line
-			pen.x = 0;
-
-			// Align vertically
-			if (in_formating.align & ALIGNV_TOP)
-				pen.y = face->ascender >> 6;
-			else if (in_formating.align & ALIGNV_CENTER)
-				pen.y = (in_outputImage.height - (int) (lines.size() - 1) * lineHeight - (face->descender >> 6)) / 2;
-			else if (in_formating.align & ALIGNV_BOTTOM)
-				pen.y = in_outputImage.height + (face->descender >> 6) - ((int) lines.size() - 1) * (lineHeight >> 6);
-
-			// It is going to fit? Try a smaller fixe it not
-			if (in_formating.minPointSize && pointSize > in_formating.minPointSize) {
-				if (maxW > in_outputImage.width ||
-					((int) lines.size() * lineHeight) > in_outputImage.height) {
-					--pointSize;
+		// Layout and render only look up the glyph indices once
+		std::vector<FT_UInt> glyphIndices(in_text.size());
+		for (size_t i = 0; i < in_text.size(); ++i) {
+			glyphIndices[i] = getCharIndex(cachedFace, in_text[i]);
+		}
+
+		sLines fitted;
+		fitLines(cachedFace, in_text, glyphIndices, in_width, in_height, in_font, in_formating, fitted);
+		int pointSize = fitted.pointSize;
+		int lineHeight = fitted.lineHeight;
+		const std::vector<sLine>& lines = fitted.lines;
+		int n;
+		result.renderedRect.x = in_width;
+		result.renderedRect.y = in_height;
+		result.renderedRect.w = 0;
+		result.renderedRect.h = 0;
+
+		// Now render line by line
+		pen.x = 0;
+
+		// Align vertically
+		if (in_formating.align & ALIGNV_TOP)
+			pen.y = face->ascender >> 6;
+		else if (in_formating.align & ALIGNV_CENTER)
+			pen.y = (in_height - (int) (lines.size() - 1) * lineHeight - (face->descender >> 6)) / 2;
+		else if (in_formating.align & ALIGNV_BOTTOM)
+			pen.y = in_height + (face->descender >> 6) - ((int) lines.size() - 1) * (lineHeight >> 6);
+
+		size_t lineCpt = 0;
+		for (const auto& line : lines) {
+			if (in_formating.align & ALIGNH_LEFT)
+				pen.x = 0;
+			else if (in_formating.align & ALIGNH_CENTER)
+				pen.x = (in_width - line.width) / 2;
+			else if (in_formating.align & ALIGNH_RIGHT)
+				pen.x = in_width - line.width;
+			bool allowJustify = lineCpt < lines.size() - 1 && in_formating.align & ALIGNH_JUSTIFY;
+			if (allowJustify) {
+				if (lines[lineCpt + 1].to - lines[lineCpt + 1].from <= 0) allowJustify = false;
+			}
+			int leftOver = in_width - line.width;
+			int cCount = line.to - line.from + 1;
+			if (allowJustify) pen.x = 0;
+			// 	for (n = line.from; n <= line.to; ++n)
+			if (in_formating.rightToLeft) n = line.to;
+			else n = line.from;
+			while (true) {
+				if (in_formating.rightToLeft) { if (n < line.from) break; }
+				else if (n > line.to) break;
+
+				// Get the glyph, rendered
+				sGlyph& glyph = getGlyph(cachedFace, pointSize, glyphIndices[n], true);
+				if (!glyph.loaded) {
+					if (in_formating.rightToLeft) --n;
+					else ++n;
 					continue;
 				}
-			}
 
-			size_t lineCpt = 0;
-			for (const auto& line : lines) {
-				if (in_formating.align & ALIGNH_LEFT)
-					pen.x = 0;
-				else if (in_formating.align & ALIGNH_CENTER)
-					pen.x = (in_outputImage.width - line.width) / 2;
-				else if (in_formating.align & ALIGNH_RIGHT)
-					pen.x = in_outputImage.width - line.width;
-				bool allowJustify = lineCpt < lines.size() - 1 && in_formating.align & ALIGNH_JUSTIFY;
-				if (allowJustify) {
-					if (lines[lineCpt + 1].to - lines[lineCpt + 1].from <= 0) allowJustify = false;
-				}
-				int leftOver = in_outputImage.width - line.width;
-				int cCount = line.to - line.from + 1;
-				if (allowJustify) pen.x = 0;
-				// 	for (n = line.from; n <= line.to; ++n)
-				if (in_formating.rightToLeft) n = line.to;
-				else n = line.from;
-				while (true) {
-					if (in_formating.rightToLeft) { if (n < line.from) break; }
-					else if (n > line.to) break;
-
-					// Get the glyph
-					FT_UInt  glyph_index;
-					glyph_index = FT_Get_Char_Index(face, text[n]);
-					error = FT_Load_Glyph(face, glyph_index, FT_LOAD_DEFAULT);
-					if (error) continue;
-					error = FT_Render_Glyph(face->glyph, FT_RENDER_MODE_NORMAL);
-					if (error) continue;
-
-					int glyphX = pen.x + (slot->metrics.horiBearingX >> 6);
-					int glyphY = pen.y - (slot->metrics.horiBearingY >> 6);
-
-					// Justify
-					if (allowJustify) {
-						int i = n - line.from;
-						if (i > 0) {
-							glyphX += leftOver * i / cCount;
-						}
-					}
+				int glyphX = pen.x + glyph.bearingX;
+				int glyphY = pen.y - glyph.bearingY;
 
-					FT_Bitmap* bitmap = &slot->bitmap;
-
-					int limits[4] = {
-						dfr_max(0, glyphX) - glyphX,
-						dfr_max(0, glyphY) - glyphY,
-						dfr_min(in_outputImage.width, bitmap->width + glyphX) - glyphX,
-						dfr_min(in_outputImage.height, bitmap->rows + glyphY) - glyphY,
-					};
-					result.renderedRect.x = dfr_min(limits[0] + glyphX, result.renderedRect.x);
-					result.renderedRect.y = dfr_min(limits[1] + glyphY, result.renderedRect.y);
-					result.renderedRect.w = dfr_max(limits[2] + glyphX, result.renderedRect.w);
-					result.renderedRect.h = dfr_max(limits[3] + glyphY, result.renderedRect.h);
-					for (y = limits[1]; y < limits[3]; y++) {
-						for (x = limits[0]; x < limits[2]; x++) {
-							k = ((y + glyphY) * in_outputImage.width + x + glyphX) * 4;
-							alpha = dfr_max(in_outputImage.pData[k + 3], bitmap->buffer[y * bitmap->pitch + x]);
-							in_outputImage.pData[k + 0] = in_color.r * alpha / 255;
-							in_outputImage.pData[k + 1] = in_color.g * alpha / 255;
-							in_outputImage.pData[k + 2] = in_color.b * alpha / 255;
-							in_outputImage.pData[k + 3] = alpha;
-						}
+				// Justify
+				if (allowJustify) {
+					int i = n - line.from;
+					if (i > 0) {
+						glyphX += leftOver * i / cCount;
 					}
+				}
 
-					int advance = slot->advance.x >> 6;
-					if (in_formating.rightToLeft) {
-						if (n < line.to) {
-							FT_UInt leftGlyph = FT_Get_Char_Index(face, text[n + 1]);
-							FT_Vector kerning;
-							FT_Get_Kerning(face, leftGlyph, glyph_index, FT_KERNING_DEFAULT, &kerning);
-							advance += kerning.x;
-						}
+				int limits[4] = {
+					dfr_max(0, glyphX) - glyphX,
+					dfr_max(0, glyphY) - glyphY,
+					dfr_min(in_width, glyph.width + glyphX) - glyphX,
+					dfr_min(in_height, glyph.rows + glyphY) - glyphY,
+				};
+				result.renderedRect.x = dfr_min(limits[0] + glyphX, result.renderedRect.x);
+				result.renderedRect.y = dfr_min(limits[1] + glyphY, result.renderedRect.y);
+				result.renderedRect.w = dfr_max(limits[2] + glyphX, result.renderedRect.w);
+				result.renderedRect.h = dfr_max(limits[3] + glyphY, result.renderedRect.h);
+				int advance = glyph.advance;
+				in_emitGlyph(glyph, glyphX, glyphY, limits);
+
+				if (in_formating.rightToLeft) {
+					if (n < line.to) {
+						advance += getKerning(cachedFace, pointSize, glyphIndices[n + 1], glyphIndices[n]);
 					}
-					else {
-						if (n > line.from) {
-							FT_UInt leftGlyph = FT_Get_Char_Index(face, text[n - 1]);
-							FT_Vector kerning;
-							FT_Get_Kerning(face, leftGlyph, glyph_index, FT_KERNING_DEFAULT, &kerning);
-							advance += kerning.x >> 6;
-						}
-					}
-					pen.x += advance;
-
-					if (in_formating.rightToLeft) --n;
-					else ++n;
 				}
-				++lineCpt;
-				if (lineCpt < (int) lines.size()) {
-					pen.y += lineHeight;
+				else {
+					if (n > line.from) {
+						advance += getKerning(cachedFace, pointSize, glyphIndices[n - 1], glyphIndices[n]);
+					}
 				}
-			}
+				pen.x += advance;
 
-			break;
+				if (in_formating.rightToLeft) --n;
+				else ++n;
+			}
+			++lineCpt;
+			if (lineCpt < lines.size()) {
+				pen.y += lineHeight;
+			}
 		}
 
+		g_ttfFacesMutex.unlock();
+
 		result.renderedRect.w -= result.renderedRect.x;
 		result.renderedRect.h -= result.renderedRect.y;
 		result.renderedPointSize = pointSize;
@@ -310,4 +551,106 @@ namespace dfr {
 
 		return result;
 	}
+
+	sRenderInfo drawText(
+		const std::wstring& in_text,
+		const sImage& in_outputImage,
+		const sFont& in_font,
+		const sFormating& in_formating,
+		const sColor& in_color) {
+
+		return layoutGlyphs(in_text, in_outputImage.width, in_outputImage.height, in_font, in_formating,
+			[&](const sGlyph& glyph, int glyphX, int glyphY, const int* limits) {
+				for (int y = limits[1]; y < limits[3]; y++) {
+					for (int x = limits[0]; x < limits[2]; x++) {
+						int k = ((y + glyphY) * in_outputImage.width + x + glyphX) * 4;
+						unsigned char alpha = dfr_max(in_outputImage.pData[k + 3], glyph.coverage[y * glyph.width + x]);
+						in_outputImage.pData[k + 0] = in_color.r * alpha / 255;
+						in_outputImage.pData[k + 1] = in_color.g * alpha / 255;
+						in_outputImage.pData[k + 2] = in_color.b * alpha / 255;
+						in_outputImage.pData[k + 3] = alpha;
+					}
+				}
+			});
+	}
+
+	sRenderInfo layoutText(
+		const std::string& in_text,
+		int in_width,
+		int in_height,
+		const sFont& in_font,
+		const sFormating& in_formating,
+		const sGlyphAtlas& in_atlas,
+		std::vector<sGlyphQuad>& out_quads) {
+
+		std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
+		std::wstring wText = converter.from_bytes(in_text);
+
+		return layoutText(wText, in_width, in_height, in_font, in_formating, in_atlas, out_quads);
+	}
+
+	sRenderInfo layoutText(
+		const std::wstring& in_text,
+		int in_width,
+		int in_height,
+		const sFont& in_font,
+		const sFormating& in_formating,
+		const sGlyphAtlas& in_atlas,
+		std::vector<sGlyphQuad>& out_quads) {
+
+		out_quads.clear();
+		return layoutGlyphs(in_text, in_width, in_height, in_font, in_formating,
+			[&](sGlyph& glyph, int glyphX, int glyphY, const int*) {
+				// Spaces have no coverage
+				if (!glyph.width || !glyph.rows) return;
+				unsigned int entry = getAtlasEntry(glyph, in_atlas);
+				if (!entry) return;
+				sGlyphQuad quad = { { glyphX, glyphY, glyph.width, glyph.rows }, entry };
+				out_quads.push_back(quad);
+			});
+	}
+
+	sTextMetrics measureText(
+		const std::string& in_text,
+		int in_width,
+		int in_height,
+		const sFont& in_font,
+		const sFormating& in_formating) {
+
+		std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
+		std::wstring wText = converter.from_bytes(in_text);
+
+		return measureText(wText, in_width, in_height, in_font, in_formating);
+	}
+
+	sTextMetrics measureText(
+		const std::wstring& in_text,
+		int in_width,
+		int in_height,
+		const sFont& in_font,
+		const sFormating& in_formating) {
+
+		g_ttfFacesMutex.lock();
+		sFace& cachedFace = getFace(in_font.filename);
+
+		// Same as a layout for the glyph cache, without quads to keep
+		++g_layoutCount;
+		evictGlyphs();
+
+		std::vector<FT_UInt> glyphIndices(in_text.size());
+		for (size_t i = 0; i < in_text.size(); ++i) {
+			glyphIndices[i] = getCharIndex(cachedFace, in_text[i]);
+		}
+
+		sLines fitted;
+		fitLines(cachedFace, in_text, glyphIndices, in_width, in_height, in_font, in_formating, fitted);
+		g_ttfFacesMutex.unlock();
+
+		sTextMetrics result;
+		result.pointSize = fitted.pointSize;
+		result.width = fitted.maxWidth;
+		result.height = (int) fitted.lines.size() * fitted.lineHeight;
+		result.lineCount = (int) fitted.lines.size();
+		return result;
+	}
 };
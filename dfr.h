@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 namespace dfr {
 
@@ -73,8 +74,52 @@ namespace dfr {
 		bool	rightToLeft;	/** For arabic languages */
 	};
 
+	struct sGlyphAtlas {
+		void*			pContext;	/** Passed back to insert and remove */
+
+		/** Store the 8-bit coverage of a glyph, width * height bytes. Returns the entry ID, 0 if failed */
+		unsigned int	(*insert)(void* pContext, int width, int height, const unsigned char* pCoverage);
+
+		/** Drop an entry when its glyph leaves the glyph cache. Can be NULL */
+		void			(*remove)(void* pContext, unsigned int entry);
+	};
+
+	struct sGlyphQuad {
+		sRect			rect;		/** Where the glyph coverage goes in the layout area, in pixels. Not clipped to it */
+		unsigned int	entry;		/** Atlas entry of the glyph coverage */
+	};
+
+	struct sTextMetrics {
+		int		pointSize;	/** Point size the text fits at, after autoresize */
+		int		width;		/** Width of the widest line */
+		int		height;		/** Line count times the line height */
+		int		lineCount;	/** Lines after word wrap */
+	};
+
+	struct sGlyphCacheStats {
+		size_t	hits;		/** Glyph lookups that were in the cache */
+		size_t	misses;		/** Glyph lookups that had to load and render the glyph */
+		size_t	bytes;		/** Memory used by the cached glyphs */
+		size_t	glyphCount;	/** Glyphs in the cache */
+	};
+
 	void init();
 
+	/**
+		Set the memory the glyph cache can use. Glyph metrics, rendered coverage
+		and kerning pairs are cached by face, pixel size and glyph index, and the
+		least recently used glyphs are dropped when it's full. Default is 4 MB.
+
+		@param in_maxBytes Maximum size of the cache in bytes. It can go over while
+		a single text needs more. 0 keeps no glyph from one text to the next
+	*/
+	void setGlyphCacheSize(size_t in_maxBytes);
+
+	/**
+		@return Hit and miss counts since init, and the current size of the glyph cache
+	*/
+	sGlyphCacheStats getGlyphCacheStats();
+
 	/**
 		Draw text using specific font and point size onto an image buffer.
 
@@ -102,4 +147,61 @@ namespace dfr {
 		const sFont& in_font,
 		const sFormating& in_formating = {},
 		const sColor& in_color = { 255, 255, 255 });
+
+	/**
+		Lay out text like drawText, but give one quad per glyph instead of
+		drawing it. Glyphs are inserted in the atlas the first time they are
+		used, so changing the text only changes the quads. The quads drawn
+		with the coverage as alpha, max blended like drawText does, give the
+		same pixels as drawText into an image of in_width x in_height.
+
+		@param in_width, in_height Size of the area to lay the text out in, like the target image of drawText
+
+		@param in_atlas Where to put the glyphs. Must stay the same for the glyphs to be inserted only once
+
+		@param out_quads Receives the quads of the glyphs that have coverage, in drawing order.
+		Their entries stay in the atlas until the glyph cache drops them, which can
+		happen from the next drawText or layoutText call if the cache is full
+
+		@return sRenderInfo structure containing information about the layout, same as drawText.
+	*/
+	sRenderInfo layoutText(
+		const std::string& in_text,
+		int in_width,
+		int in_height,
+		const sFont& in_font,
+		const sFormating& in_formating,
+		const sGlyphAtlas& in_atlas,
+		std::vector<sGlyphQuad>& out_quads);
+	sRenderInfo layoutText(
+		const std::wstring& in_text,
+		int in_width,
+		int in_height,
+		const sFont& in_font,
+		const sFormating& in_formating,
+		const sGlyphAtlas& in_atlas,
+		std::vector<sGlyphQuad>& out_quads);
+
+	/**
+		Break text in lines and pick its point size like drawText, from the
+		glyph metrics only. Nothing is rasterized, so it's cheap to call at
+		several sizes or widths to find what fits.
+
+		@param in_width, in_height Size of the area, like the target image of drawText.
+		in_height is only used by autoresize
+
+		@return sTextMetrics structure with the point size used and the size of the lines
+	*/
+	sTextMetrics measureText(
+		const std::string& in_text,
+		int in_width,
+		int in_height,
+		const sFont& in_font,
+		const sFormating& in_formating = {});
+	sTextMetrics measureText(
+		const std::wstring& in_text,
+		int in_width,
+		int in_height,
+		const sFont& in_font,
+		const sFormating& in_formating = {});
 };
@@ -29,6 +29,11 @@ extern "C"
     */
     typedef uint32_t EGState;
 
+    /*! \typedef EGAtlas
+        ID of a texture atlas
+    */
+    typedef uint32_t EGAtlas;
+
     /*! \typedef EGFormat
         Representing a mix of EG_DATA_COMPONENT_COUNT and EG_DATA_TYPE
     */
@@ -209,7 +214,8 @@ extern "C"
 
         /*! Consider the data as heightmap, and generate a normal map from 
             it. If the incoming is more than one channel, average color will
-            be calculated to be used as height map. Alpha channel is ignored */
+            be calculated to be used as height map. Alpha channel is ignored.
+            The heightmap wraps around. See egSetNormalMapStrength. */
         EG_GENERATE_NORMAL_MAP = 0x02,
 
         /*! Consider the data as heightmap, and generate ambient occlusion 
@@ -218,11 +224,44 @@ extern "C"
         EG_NORMAL_MAP_OCCLUSION = 0x04,
 
         /*! Pre-multiply RGB channels with the alpha channel. Used when 
-            rendering 2D with pre-multipled alpha blend. */
+            rendering 2D with pre-multipled alpha blend. Done before mipmaps
+            are generated, and in linear space if EG_SRGB is set. Ignored
+            for normal maps. */
         EG_PRE_MULTIPLY = 0x08,
 
         /*! The texture can be used as a render target */
-        EG_RENDER_TARGET = 0x10
+        EG_RENDER_TARGET = 0x10,
+
+        /*! Color data is sRGB encoded. Mipmaps are filtered in linear space,
+            so they keep the same brightness. Alpha is always linear. */
+        EG_SRGB = 0x20,
+
+        /*! Generate mipmaps with a Kaiser windowed sinc filter instead of a
+            box filter. Sharper, but slower. */
+        EG_MIPMAP_KAISER = 0x40,
+
+        /*! Block compress the texture. BC1 is used for opaque colors, BC3
+            if there is alpha, BC4 for one channel data and BC5 for two
+            channels or normal maps. Width and height must be multiples of 4,
+            otherwise the texture is not compressed. */
+        EG_COMPRESS = 0x80,
+
+        /*! The data is a tangent space normal map. With EG_COMPRESS, only X
+            and Y are stored and Z is rebuilt in the shader. */
+        EG_NORMAL_MAP = 0x100,
+
+        /*! Faster compression, lower quality. Used with EG_COMPRESS. */
+        EG_COMPRESS_FAST = 0x200,
+
+        /*! Slower compression, higher quality. Used with EG_COMPRESS. */
+        EG_COMPRESS_HIGH_QUALITY = 0x400,
+
+        /*! egLoadTextureFile only. Save the processed texture, with its
+            mipmaps, compression and generated normals, to a .egt file next
+            to the image. Later loads map that file instead of decoding the
+            image, as long as the image content and the flags are the same.
+            */
+        EG_CACHE = 0x800
 
     } EG_TEXTURE_FLAGS;
 
@@ -465,6 +504,28 @@ extern "C"
 
     } EG_COMPARE;
 
+    /*! \enum EG_RESIDENCY
+        Video memory categories. See egGetResidentBytes
+    */
+    typedef enum
+    {
+        /*! Textures and atlas pages */
+        EG_RESIDENCY_TEXTURES = 0,
+
+        /*! Textures created with EG_RENDER_TARGET */
+        EG_RESIDENCY_RENDER_TARGETS = 1,
+
+        /*! G-Buffer and HDR accumulation buffer */
+        EG_RESIDENCY_G_BUFFER = 2,
+
+        /*! Bloom and blur buffers */
+        EG_RESIDENCY_BLUR_BUFFERS = 3,
+
+        /*! All of the above */
+        EG_RESIDENCY_ALL = 4
+
+    } EG_RESIDENCY;
+
     typedef enum
     {
         EG_RESOLUTION
@@ -646,6 +707,14 @@ extern "C"
     */
     void egGetProjection(float *pProjection);
 
+    /*!
+        Get the combined view projection matrix
+
+        \param pViewProj Pointer to an array of 16 floats that will contain
+        the matrix.
+    */
+    void egGetViewProj(float *pViewProj);
+
     /*!
         Get the current model matrix
 
@@ -1078,6 +1147,115 @@ extern "C"
                                 const void *pData, EGFormat dataFormat,
                                 EG_TEXTURE_FLAGS flags);
 
+    /*!
+        Set the strength of normal maps generated with 
+        EG_GENERATE_NORMAL_MAP. It also scales the heights used for 
+        EG_NORMAL_MAP_OCCLUSION.
+
+        \param strength Height of a white texel, in texels. Default is 2.
+    */
+    void egSetNormalMapStrength(float strength);
+
+    /*!
+        Create a 2D texture on a worker thread. Conversion, mipmaps and
+        compression happen in the background. The upload happens in egSwap
+        or egWaitForTextures. Until then, binding the texture binds the
+        default map for that slot.
+
+        pData is copied, so it can be freed right away.
+
+        \return The texture ID or 0 if failed.
+    */
+    EGTexture egCreateTexture2DAsync(uint32_t width, uint32_t height,
+                                     const void *pData, EGFormat dataFormat,
+                                     EG_TEXTURE_FLAGS flags);
+
+    /*! \typedef EGImageDecoder
+        Decodes an image file in memory to 32 bits RGBA. pPixels must be
+        allocated with malloc, EasyGraphix frees it. Called from worker
+        threads.
+
+        \return 0 on success
+    */
+    typedef uint32_t (*EGImageDecoder)(const void *pFileData,
+                                       uint32_t fileSize,
+                                       uint8_t **ppPixels,
+                                       uint32_t *pWidth,
+                                       uint32_t *pHeight);
+
+    /*!
+        Set the decoder used by egLoadTextureFile. EasyGraphix doesn't
+        decode image files by itself.
+
+        \param decoder Decoder function
+    */
+    void egSetImageDecoder(EGImageDecoder decoder);
+
+    /*! \typedef EGImageAllocator
+        Given to an EGStreamingImageDecoder. Returns where to write the
+        32 bits RGBA pixels, rows are width * 4 bytes apart. Call it once.
+
+        \return The pixels, or NULL if failed
+    */
+    typedef uint8_t *(*EGImageAllocator)(void *pContext,
+                                         uint32_t width,
+                                         uint32_t height);
+
+    /*! \typedef EGStreamingImageDecoder
+        Decodes an image file in memory to 32 bits RGBA, into pixels given
+        by allocate(pContext, width, height). They can be where the
+        mipmaps get generated, so the image isn't copied. Called from
+        worker threads.
+
+        \return 0 on success
+    */
+    typedef uint32_t (*EGStreamingImageDecoder)(const void *pFileData,
+                                                uint32_t fileSize,
+                                                EGImageAllocator allocate,
+                                                void *pContext);
+
+    /*!
+        Set a decoder used by egLoadTextureFile that writes into memory
+        EasyGraphix allocates. It's used instead of the one from
+        egSetImageDecoder. Set NULL to use that one again.
+
+        \param decoder Decoder function
+    */
+    void egSetStreamingImageDecoder(EGStreamingImageDecoder decoder);
+
+    /*!
+        Load a texture file asynchronously. Reading, decoding and the rest
+        of egCreateTexture2DAsync happen on a worker thread.
+
+        \param szFilename Image file
+
+        \param flags Texture flags
+
+        \return The texture ID or 0 if failed. If the file can't be loaded,
+        the texture keeps binding the default maps and egGetError tells why.
+    */
+    EGTexture egLoadTextureFile(const char *szFilename,
+                                EG_TEXTURE_FLAGS flags);
+
+    /*!
+        Set how many worker threads load textures. Waits for pending
+        textures if the count changes.
+
+        \param threadCount Thread count. 0 means one per hardware thread,
+        which is the default.
+    */
+    void egSetTextureLoaderThreadCount(uint32_t threadCount);
+
+    /*!
+        Wait for all pending textures to be loaded, and upload them.
+    */
+    void egWaitForTextures();
+
+    /*!
+        \return How many textures are still loading
+    */
+    uint32_t egGetPendingTextureCount();
+
     /*!
         Unimplemented
 
@@ -1103,6 +1281,121 @@ extern "C"
     */
     void egDestroyTexture(EGTexture *pTexture);
 
+    /*!
+        Set the video memory budget. When over budget, the least recently
+        bound textures are evicted, and reloaded the next time they are
+        bound. All categories count toward the budget, but only textures
+        can be evicted. Textures used in the current frame are never
+        evicted.
+
+        \param bytes Budget in bytes, 0 for no budget. This is the default.
+
+        \details Textures loaded with egLoadTextureFile reload from their
+        file, and bind the default maps until loaded. Other textures keep a
+        CPU copy of their data, but only if they are created while a budget
+        is set. Atlas pages and render targets are never evicted.
+    */
+    void egSetTextureBudget(uint64_t bytes);
+
+    /*!
+        \param category What to count
+
+        \return Video memory used by category, in bytes
+    */
+    uint64_t egGetResidentBytes(EG_RESIDENCY category);
+
+    /*!
+        \return How many times a texture was evicted
+    */
+    uint32_t egGetEvictionCount();
+
+    /*!
+        \return How many times an evicted texture was reloaded
+    */
+    uint32_t egGetReloadCount();
+
+    /*!
+        Create a texture atlas. Small images are packed into shared pages,
+        so they can be drawn without changing texture.
+
+        \param pageSize Width and height of the pages
+
+        \param padding Gutter around each image, filled with its edge
+        texels. With EG_GENERATE_MIPMAPS, the pages get log2(padding) + 1
+        mip levels.
+
+        \param flags Texture flags for the pages. EG_RENDER_TARGET is not
+        supported.
+
+        \return The atlas ID or 0 if failed.
+    */
+    EGAtlas egCreateAtlas(uint32_t pageSize, uint32_t padding,
+                          EG_TEXTURE_FLAGS flags);
+
+    /*!
+        Destroys an atlas and its pages
+
+        \param pAtlas Pointer to an atlas ID. It will be set to 0 upon
+        success.
+    */
+    void egDestroyAtlas(EGAtlas *pAtlas);
+
+    /*!
+        Add an image to an atlas. A new page is created if it doesn't fit
+        in the existing ones.
+
+        \param atlas Atlas ID
+
+        \param width Width of the image
+
+        \param height Height of the image
+
+        \param pData Image data
+
+        \param dataFormat Format of pData
+
+        \return The entry ID or 0 if failed.
+    */
+    uint32_t egAtlasInsert(EGAtlas atlas, uint32_t width, uint32_t height,
+                           const void *pData, EGFormat dataFormat);
+
+    /*!
+        Remove an image from an atlas. Its space is reclaimed by 
+        egAtlasDefragment.
+
+        \param atlas Atlas ID
+
+        \param pEntry Pointer to an entry ID. It will be set to 0 upon
+        success.
+    */
+    void egAtlasRemove(EGAtlas atlas, uint32_t *pEntry);
+
+    /*!
+        Repack all images of an atlas, tallest first. Entries keep their
+        ID, but can move to other pages. Call egAtlasGetEntry again after.
+
+        \param atlas Atlas ID
+    */
+    void egAtlasDefragment(EGAtlas atlas);
+
+    /*!
+        Get where an image lives. Uploads its page if it changed.
+
+        \param atlas Atlas ID
+
+        \param entry Entry ID
+
+        \param pUVs Receives u0, v0, u1, v1. Can be NULL.
+
+        \return The page texture, or 0 if failed.
+    */
+    EGTexture egAtlasGetEntry(EGAtlas atlas, uint32_t entry, float *pUVs);
+
+    /*!
+        \return Ratio of page area covered by images, gutters excluded.
+    */
+    float egAtlasGetOccupancy(EGAtlas atlas);
+
     /*!
         Bind diffuse texture.
 
@@ -1248,6 +1541,83 @@ extern "C"
     void egTube(float outterRadius, float innerRadius,
                 float height, uint32_t slices, float sfactor);
 
+    /*!
+        Draw a sphere primitive with automatic tessellation. Slice and stack
+        counts are derived from the size of the sphere on screen, using the
+        current view projection matrix, model matrix and viewport.
+
+        \param radius Radius of the sphere
+
+        \param edgeLength Target length of the triangle edges, in pixels.
+
+        \param sfactor Multiplyer to s texture coordinates
+
+        \details Counts are snapped to a fixed set of LOD levels, between 6 and
+        128 slices, so spheres at similar distances share the same
+        tessellation.
+    */
+    void egSphereAuto(float radius, float edgeLength, float sfactor);
+
+    /*!
+        Draw a cylinder primitive with automatic tessellation. The slice count
+        is derived from the size of the cylinder on screen, using the current
+        view projection matrix, model matrix and viewport.
+
+        \param bottomRadius Radius of the bottom cap
+
+        \param topRadius Radius of the top cap
+
+        \param height Height of the cylinder
+
+        \param edgeLength Target length of the triangle edges, in pixels.
+
+        \param sfactor Multiplyer to s texture coordinates
+    */
+    void egCylinderAuto(float bottomRadius, float topRadius,
+                        float height, float edgeLength, float sfactor);
+
+    /*!
+        Draw an icosphere. Triangles are evenly distributed over the surface,
+        unlike egSphere which concentrates them at the poles.
+
+        \param radius Radius of the sphere
+
+        \param subdivisions Number of times the icosahedron faces are split
+        in 4. 0 gives 20 triangles. Clamped to 6.
+
+        \param sfactor Multiplyer to s texture coordinates
+    */
+    void egIcosphere(float radius, uint32_t subdivisions, float sfactor);
+
+    /*!
+        Get the indexed geometry of an icosphere, for use in retained meshes.
+        Positions are shared between triangles, except along the texture seam
+        and at the poles.
+
+        \param radius Radius of the sphere
+
+        \param subdivisions Number of times the icosahedron faces are split
+        in 4. Clamped to 6.
+
+        \param sfactor Multiplyer to s texture coordinates
+
+        \param pVertices Receives 14 floats per vertex: position, normal,
+        tangent, binormal and texture coordinates. Can be NULL.
+
+        \param pVertexCount Receives the vertex count. Can be NULL.
+
+        \param pIndices Receives 3 indices per triangle, wound like the other
+        primitives.
+        Can be NULL.
+
+        \param pIndexCount Receives the index count. Can be NULL.
+
+        \details Call it with NULL arrays first to query the counts.
+    */
+    void egGetIcosphere(float radius, uint32_t subdivisions, float sfactor,
+                        float *pVertices, uint32_t *pVertexCount,
+                        uint32_t *pIndices, uint32_t *pIndexCount);
+
     /*!
         Set texture filtering mode. Default is 4x Anysotropic.
 
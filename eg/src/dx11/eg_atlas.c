@@ -0,0 +1,403 @@
+#include <stdlib.h>
+#include <string.h>
+#include "eg_atlas.h"
+#include "eg_device.h"
+#include "eg_error.h"
+#include "eg_format.h"
+#include "eg_normal.h"
+
+static uint32_t alignUp(uint32_t value, uint32_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static void releasePageTexture(EGTexture texture)
+{
+    SEGTexture2D *pTexture = poolGet(&pBoundDevice->textures, texture);
+    if (!pTexture) return;
+    untrackTexture(pTexture);
+    destroyTexture(pTexture);
+    poolFree(&pBoundDevice->textures, texture);
+}
+
+static SEGAtlasPage *addPage(SEGAtlas *pAtlas, EGTexture texture)
+{
+    SEGAtlasPage *pPages = (SEGAtlasPage *)realloc(pAtlas->pPages, sizeof(SEGAtlasPage) * (pAtlas->pageCount + 1));
+    if (!pPages) return NULL;
+    pAtlas->pPages = pPages;
+
+    SEGAtlasPage *pPage = pPages + pAtlas->pageCount;
+    memset(pPage, 0, sizeof(SEGAtlasPage));
+    pPage->pPixels = (uint8_t *)calloc(pAtlas->pageSize * pAtlas->pageSize, 4);
+    if (!pPage->pPixels) return NULL;
+    if (!texture)
+    {
+        // Empty until the first upload, so it binds the default maps
+        SEGTexture2D texture2D = {0};
+        texture2D.w = pAtlas->pageSize;
+        texture2D.h = pAtlas->pageSize;
+        texture = createTexture(&texture2D);
+        if (!texture)
+        {
+            free(pPage->pPixels);
+            return NULL;
+        }
+    }
+    pPage->texture = texture;
+    initSkyline(&pPage->skyline, pAtlas->pageSize, pAtlas->pageSize);
+    ++pAtlas->pageCount;
+    return pPage;
+}
+
+// Finds room for a slot, in the existing pages first
+static int placeSlot(SEGAtlas *pAtlas, uint32_t slotW, uint32_t slotH, uint32_t *pPage, uint32_t *pX, uint32_t *pY)
+{
+    for (uint32_t i = 0; i < pAtlas->pageCount; ++i)
+    {
+        if (skylineInsert(&pAtlas->pPages[i].skyline, slotW, slotH, pX, pY))
+        {
+            *pPage = i;
+            return 1;
+        }
+    }
+    SEGAtlasPage *pNewPage = addPage(pAtlas, 0);
+    if (!pNewPage) return 0;
+    *pPage = pAtlas->pageCount - 1;
+    return skylineInsert(&pNewPage->skyline, slotW, slotH, pX, pY);
+}
+
+// Write the image and extrude its edges into the gutter, so filtering and
+// mipmaps don't pick up the neighbours.
+static void writeSlot(SEGAtlas *pAtlas, const SEGAtlasEntry *pEntry, const uint8_t *pRGBA)
+{
+    uint32_t *pPixels = (uint32_t *)pAtlas->pPages[pEntry->page].pPixels;
+    uint32_t slotX = pEntry->x - pAtlas->padding;
+    uint32_t slotY = pEntry->y - pAtlas->padding;
+    uint32_t slotW = alignUp(pEntry->w + pAtlas->padding * 2, pAtlas->alignment);
+    uint32_t slotH = alignUp(pEntry->h + pAtlas->padding * 2, pAtlas->alignment);
+
+    for (uint32_t y = 0; y < slotH; ++y)
+    {
+        int srcY = (int)y - (int)pAtlas->padding;
+        if (srcY < 0) srcY = 0;
+        if (srcY >= (int)pEntry->h) srcY = (int)pEntry->h - 1;
+        const uint32_t *pSrc = (const uint32_t *)pRGBA + srcY * pEntry->w;
+        uint32_t *pDst = pPixels + (slotY + y) * pAtlas->pageSize + slotX;
+        for (uint32_t x = 0; x < pAtlas->padding; ++x) pDst[x] = pSrc[0];
+        memcpy(pDst + pAtlas->padding, pSrc, pEntry->w * 4);
+        for (uint32_t x = pAtlas->padding + pEntry->w; x < slotW; ++x) pDst[x] = pSrc[pEntry->w - 1];
+    }
+    pAtlas->pPages[pEntry->page].bDirty = 1;
+}
+
+static void uploadPage(SEGAtlas *pAtlas, SEGAtlasPage *pPage)
+{
+    SEGTexture2D *pTexture = poolGet(&pBoundDevice->textures, pPage->texture);
+    if (!pTexture) return;
+
+    SEGTextureData textureData;
+    prepareTextureData(&textureData, pPage->pPixels, pAtlas->pageSize, pAtlas->pageSize, EG_U8 | EG_RGBA,
+                       pAtlas->flags & ~(EG_GENERATE_NORMAL_MAP | EG_NORMAL_MAP_OCCLUSION), 0);
+
+    // Deeper levels would bleed through the gutters
+    if (textureData.mipLevels > pAtlas->mipLevels) textureData.mipLevels = pAtlas->mipLevels;
+
+    untrackTexture(pTexture);
+    destroyTexture(pTexture);
+    memset(pTexture, 0, sizeof(SEGTexture2D));
+    pTexture->w = pAtlas->pageSize;
+    pTexture->h = pAtlas->pageSize;
+    uploadTextureData(pTexture, &textureData);
+    freeTextureData(&textureData);
+    trackTexture(pTexture);
+    pPage->bDirty = 0;
+}
+
+EGAtlas egCreateAtlas(uint32_t pageSize, uint32_t padding, EG_TEXTURE_FLAGS flags)
+{
+    if (!pBoundDevice) return 0;
+    if (!pageSize) return 0;
+    if (flags & EG_RENDER_TARGET) return 0;
+
+    SEGAtlas *pAtlas;
+    EGAtlas atlas = poolAlloc(&pBoundDevice->atlases, (void **)&pAtlas);
+    if (!atlas)
+    {
+        setError("Too many atlases");
+        return 0;
+    }
+
+    // Gutters of padding texels protect mip levels up to log2(padding).
+    // Slots are aligned so their edges stay on texel boundaries on those
+    // levels, and on block boundaries when compressed.
+    pAtlas->mipLevels = 1;
+    if (flags & EG_GENERATE_MIPMAPS)
+    {
+        while ((2u << (pAtlas->mipLevels - 1)) <= padding) ++pAtlas->mipLevels;
+    }
+    pAtlas->alignment = 1 << (pAtlas->mipLevels - 1);
+    if (flags & EG_COMPRESS) pAtlas->alignment *= 4;
+    pAtlas->pageSize = alignUp(pageSize, pAtlas->alignment);
+    pAtlas->padding = padding;
+    pAtlas->flags = flags;
+    initPool(&pAtlas->entries, sizeof(SEGAtlasEntry));
+    return atlas;
+}
+
+void destroyAtlas(SEGAtlas *pAtlas)
+{
+    for (uint32_t i = 0; i < pAtlas->pageCount; ++i)
+    {
+        free(pAtlas->pPages[i].pPixels);
+        destroySkyline(&pAtlas->pPages[i].skyline);
+    }
+    if (pAtlas->pPages) free(pAtlas->pPages);
+    destroyPool(&pAtlas->entries);
+}
+
+void egDestroyAtlas(EGAtlas *pAtlas)
+{
+    if (!pBoundDevice) return;
+    if (!pAtlas) return;
+
+    SEGAtlas *pAtlasData = poolGet(&pBoundDevice->atlases, *pAtlas);
+    if (!pAtlasData) return;
+
+    for (uint32_t i = 0; i < pAtlasData->pageCount; ++i)
+    {
+        releasePageTexture(pAtlasData->pPages[i].texture);
+    }
+    destroyAtlas(pAtlasData);
+    poolFree(&pBoundDevice->atlases, *pAtlas);
+    *pAtlas = 0;
+}
+
+uint32_t egAtlasInsert(EGAtlas atlas, uint32_t width, uint32_t height, const void *pData, EGFormat dataFormat)
+{
+    if (!pBoundDevice) return 0;
+    if (width == 0 || height == 0) return 0;
+    SEGAtlas *pAtlas = poolGet(&pBoundDevice->atlases, atlas);
+    if (!pAtlas) return 0;
+
+    uint32_t slotW = alignUp(width + pAtlas->padding * 2, pAtlas->alignment);
+    uint32_t slotH = alignUp(height + pAtlas->padding * 2, pAtlas->alignment);
+    if (slotW > pAtlas->pageSize || slotH > pAtlas->pageSize)
+    {
+        setError("Image too big for atlas");
+        return 0;
+    }
+
+    const uint8_t *pRGBA = (const uint8_t *)pData;
+    if (dataFormat != (EG_U8 | EG_RGBA))
+    {
+        EGFormatConverter converter = getFormatConverter(dataFormat);
+        if (!converter)
+        {
+            setError("Invalid data format");
+            return 0;
+        }
+        pRGBA = (const uint8_t *)malloc(width * height * 4);
+        if (!pRGBA) return 0;
+        converter(pData, (uint8_t *)pRGBA, width * height);
+    }
+
+    // Per image, so the kernels don't see the neighbours
+    if (pAtlas->flags & EG_GENERATE_NORMAL_MAP)
+    {
+        uint8_t *pNormals = (uint8_t *)malloc(width * height * 4);
+        if (!pNormals)
+        {
+            if (pRGBA != pData) free((void *)pRGBA);
+            return 0;
+        }
+        generateNormalMap(pRGBA, pNormals, width, height, dataFormat & 0x0f, pBoundDevice->normalMapStrength,
+                          (pAtlas->flags & EG_NORMAL_MAP_OCCLUSION) ? NORMAL_OCCLUSION : 0);
+        if (pRGBA != pData) free((void *)pRGBA);
+        pRGBA = pNormals;
+    }
+
+    SEGAtlasEntry *pEntry;
+    uint32_t entry = poolAlloc(&pAtlas->entries, (void **)&pEntry);
+    uint32_t slotX, slotY;
+    if (!entry || !placeSlot(pAtlas, slotW, slotH, &pEntry->page, &slotX, &slotY))
+    {
+        if (entry) poolFree(&pAtlas->entries, entry);
+        if (pRGBA != pData) free((void *)pRGBA);
+        setError("Failed to insert in atlas");
+        return 0;
+    }
+    pEntry->x = slotX + pAtlas->padding;
+    pEntry->y = slotY + pAtlas->padding;
+    pEntry->w = width;
+    pEntry->h = height;
+    writeSlot(pAtlas, pEntry, pRGBA);
+    pAtlas->usedArea += (uint64_t)width * height;
+
+    if (pRGBA != pData) free((void *)pRGBA);
+    return entry;
+}
+
+void egAtlasRemove(EGAtlas atlas, uint32_t *pEntry)
+{
+    if (!pBoundDevice) return;
+    if (!pEntry) return;
+    SEGAtlas *pAtlas = poolGet(&pBoundDevice->atlases, atlas);
+    if (!pAtlas) return;
+
+    // The space is reclaimed by egAtlasDefragment
+    SEGAtlasEntry *pEntryData = poolGet(&pAtlas->entries, *pEntry);
+    if (!pEntryData) return;
+    pAtlas->usedArea -= (uint64_t)pEntryData->w * pEntryData->h;
+    poolFree(&pAtlas->entries, *pEntry);
+    *pEntry = 0;
+}
+
+static int compareSlotHeight(const void *pA, const void *pB)
+{
+    const SEGAtlasEntry *pEntryA = *(const SEGAtlasEntry **)pA;
+    const SEGAtlasEntry *pEntryB = *(const SEGAtlasEntry **)pB;
+    if (pEntryA->h != pEntryB->h) return (pEntryA->h < pEntryB->h) ? 1 : -1;
+    return (pEntryA->w < pEntryB->w) ? 1 : (pEntryA->w > pEntryB->w) ? -1 : 0;
+}
+
+void egAtlasDefragment(EGAtlas atlas)
+{
+    if (!pBoundDevice) return;
+    SEGAtlas *pAtlas = poolGet(&pBoundDevice->atlases, atlas);
+    if (!pAtlas) return;
+
+    // Tallest first packs a skyline much tighter than insertion order
+    SEGAtlasEntry **ppEntries = (SEGAtlasEntry **)malloc(sizeof(SEGAtlasEntry *) * (pAtlas->entries.itemCount + 1));
+    if (!ppEntries) return;
+    uint32_t entryCount = 0;
+    for (uint32_t i = 0; i < pAtlas->entries.slotCount; ++i)
+    {
+        SEGAtlasEntry *pEntry = poolGetAt(&pAtlas->entries, i);
+        if (pEntry) ppEntries[entryCount++] = pEntry;
+    }
+    qsort(ppEntries, entryCount, sizeof(SEGAtlasEntry *), compareSlotHeight);
+
+    // New page, x and y of each entry. Entries only move once all of them
+    // found a place, so a failed repack leaves the atlas as it was.
+    uint32_t *pPlaces = (uint32_t *)malloc(sizeof(uint32_t) * 3 * (entryCount + 1));
+    if (!pPlaces)
+    {
+        free(ppEntries);
+        return;
+    }
+
+    // Repack into new pages, keeping the old page textures
+    SEGAtlasPage *pOldPages = pAtlas->pPages;
+    uint32_t oldPageCount = pAtlas->pageCount;
+    pAtlas->pPages = NULL;
+    pAtlas->pageCount = 0;
+    int bFailed = 0;
+    for (uint32_t i = 0; i < entryCount; ++i)
+    {
+        SEGAtlasEntry *pEntry = ppEntries[i];
+        uint32_t slotW = alignUp(pEntry->w + pAtlas->padding * 2, pAtlas->alignment);
+        uint32_t slotH = alignUp(pEntry->h + pAtlas->padding * 2, pAtlas->alignment);
+        uint32_t page = 0, slotX = 0, slotY = 0;
+
+        int bPlaced = 0;
+        for (uint32_t k = 0; k < pAtlas->pageCount && !bPlaced; ++k)
+        {
+            bPlaced = skylineInsert(&pAtlas->pPages[k].skyline, slotW, slotH, &slotX, &slotY);
+            page = k;
+        }
+        if (!bPlaced)
+        {
+            EGTexture texture = (pAtlas->pageCount < oldPageCount) ? pOldPages[pAtlas->pageCount].texture : 0;
+            SEGAtlasPage *pPage = addPage(pAtlas, texture);
+            if (!pPage)
+            {
+                bFailed = 1;
+                break;
+            }
+            page = pAtlas->pageCount - 1;
+            skylineInsert(&pPage->skyline, slotW, slotH, &slotX, &slotY);
+        }
+
+        // Copy the slot, gutter included
+        const uint8_t *pSrc = pOldPages[pEntry->page].pPixels;
+        uint8_t *pDst = pAtlas->pPages[page].pPixels;
+        uint32_t oldX = pEntry->x - pAtlas->padding;
+        uint32_t oldY = pEntry->y - pAtlas->padding;
+        for (uint32_t y = 0; y < slotH; ++y)
+        {
+            memcpy(pDst + ((slotY + y) * pAtlas->pageSize + slotX) * 4,
+                   pSrc + ((oldY + y) * pAtlas->pageSize + oldX) * 4,
+                   slotW * 4);
+        }
+        pPlaces[i * 3 + 0] = page;
+        pPlaces[i * 3 + 1] = slotX + pAtlas->padding;
+        pPlaces[i * 3 + 2] = slotY + pAtlas->padding;
+    }
+
+    if (bFailed)
+    {
+        // Out of memory, drop the new pages and keep the old packing. Only
+        // pages past the old page count have a texture of their own.
+        for (uint32_t i = 0; i < pAtlas->pageCount; ++i)
+        {
+            if (i >= oldPageCount) releasePageTexture(pAtlas->pPages[i].texture);
+            free(pAtlas->pPages[i].pPixels);
+            destroySkyline(&pAtlas->pPages[i].skyline);
+        }
+        if (pAtlas->pPages) free(pAtlas->pPages);
+        pAtlas->pPages = pOldPages;
+        pAtlas->pageCount = oldPageCount;
+        free(pPlaces);
+        free(ppEntries);
+        return;
+    }
+
+    for (uint32_t i = 0; i < entryCount; ++i)
+    {
+        ppEntries[i]->page = pPlaces[i * 3 + 0];
+        ppEntries[i]->x = pPlaces[i * 3 + 1];
+        ppEntries[i]->y = pPlaces[i * 3 + 2];
+    }
+    free(pPlaces);
+    free(ppEntries);
+
+    for (uint32_t i = 0; i < pAtlas->pageCount; ++i) pAtlas->pPages[i].bDirty = 1;
+    for (uint32_t i = 0; i < oldPageCount; ++i)
+    {
+        if (i >= pAtlas->pageCount) releasePageTexture(pOldPages[i].texture);
+        free(pOldPages[i].pPixels);
+        destroySkyline(&pOldPages[i].skyline);
+    }
+    if (pOldPages) free(pOldPages);
+}
+
+EGTexture egAtlasGetEntry(EGAtlas atlas, uint32_t entry, float *pUVs)
+{
+    if (!pBoundDevice) return 0;
+    SEGAtlas *pAtlas = poolGet(&pBoundDevice->atlases, atlas);
+    if (!pAtlas) return 0;
+    SEGAtlasEntry *pEntry = poolGet(&pAtlas->entries, entry);
+    if (!pEntry) return 0;
+
+    SEGAtlasPage *pPage = pAtlas->pPages + pEntry->page;
+    if (pPage->bDirty) uploadPage(pAtlas, pPage);
+
+    if (pUVs)
+    {
+        float invSize = 1.f / (float)pAtlas->pageSize;
+        pUVs[0] = (float)pEntry->x * invSize;
+        pUVs[1] = (float)pEntry->y * invSize;
+        pUVs[2] = (float)(pEntry->x + pEntry->w) * invSize;
+        pUVs[3] = (float)(pEntry->y + pEntry->h) * invSize;
+    }
+    return pPage->texture;
+}
+
+float egAtlasGetOccupancy(EGAtlas atlas)
+{
+    if (!pBoundDevice) return 0;
+    SEGAtlas *pAtlas = poolGet(&pBoundDevice->atlases, atlas);
+    if (!pAtlas) return 0;
+    if (!pAtlas->pageCount) return 0;
+    return (float)((double)pAtlas->usedArea / ((double)pAtlas->pageSize * pAtlas->pageSize * pAtlas->pageCount));
+}
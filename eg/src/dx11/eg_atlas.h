@@ -0,0 +1,40 @@
+#pragma once
+
+#ifndef EG_ATLAS_H_INCLUDED
+#define EG_ATLAS_H_INCLUDED
+
+#include "eg.h"
+#include "eg_pool.h"
+#include "eg_skyline.h"
+
+typedef struct
+{
+    EGTexture                   texture;
+    SEGSkyline                  skyline;
+    uint8_t                    *pPixels;    // RGBA8 copy of the page
+    int                         bDirty;     // Needs upload
+} SEGAtlasPage;
+
+typedef struct
+{
+    uint32_t                    page;
+    uint32_t                    x, y, w, h; // Image, gutter excluded
+} SEGAtlasEntry;
+
+typedef struct
+{
+    uint32_t                    pageSize;
+    uint32_t                    padding;
+    uint32_t                    alignment;
+    uint32_t                    mipLevels;
+    EG_TEXTURE_FLAGS            flags;
+    SEGAtlasPage               *pPages;
+    uint32_t                    pageCount;
+    SEGPool                     entries;    // SEGAtlasEntry
+    uint64_t                    usedArea;
+} SEGAtlas;
+
+// Frees the CPU side. Page textures are left to the texture pool.
+void destroyAtlas(SEGAtlas *pAtlas);
+
+#endif /* EG_ATLAS_H_INCLUDED */
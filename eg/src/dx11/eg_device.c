@@ -57,6 +57,11 @@ EGDevice egCreateDevice(HWND windowHandle)
     devices = realloc(devices, sizeof(SEGDevice) * (deviceCount + 1));
     memset(devices + deviceCount, 0, sizeof(SEGDevice));
     pBoundDevice = devices + deviceCount;
+    initPool(&pBoundDevice->textures, sizeof(SEGTexture2D));
+    initPool(&pBoundDevice->states, sizeof(SEGState));
+    initPool(&pBoundDevice->atlases, sizeof(SEGAtlas));
+    pBoundDevice->normalMapStrength = 2.f;
+    initResidency(&pBoundDevice->residency);
     ++deviceCount;
     ret = deviceCount;
 
@@ -306,7 +311,7 @@ EGDevice egCreateDevice(HWND windowHandle)
     // Create default textures
     {
         uint8_t pixel[4] = {255, 255, 255, 255};
-        texture2DFromData(pBoundDevice->pDefaultTextureMaps + DIFFUSE_MAP, pixel, 1, 1, FALSE);
+        texture2DFromData(pBoundDevice->pDefaultTextureMaps + DIFFUSE_MAP, pixel, 1, 1, EG_U8 | EG_RGBA, 0);
         if (!pBoundDevice->pDefaultTextureMaps[DIFFUSE_MAP].pTexture)
         {
             egDestroyDevice(&ret);
@@ -315,7 +320,7 @@ EGDevice egCreateDevice(HWND windowHandle)
     }
     {
         uint8_t pixel[4] = {128, 128, 255, 255};
-        texture2DFromData(pBoundDevice->pDefaultTextureMaps + NORMAL_MAP, pixel, 1, 1, FALSE);
+        texture2DFromData(pBoundDevice->pDefaultTextureMaps + NORMAL_MAP, pixel, 1, 1, EG_U8 | EG_RGBA, 0);
         if (!pBoundDevice->pDefaultTextureMaps[NORMAL_MAP].pTexture)
         {
             egDestroyDevice(&ret);
@@ -324,7 +329,7 @@ EGDevice egCreateDevice(HWND windowHandle)
     }
     {
         uint8_t pixel[4] = {0, 1, 0, 0};
-        texture2DFromData(pBoundDevice->pDefaultTextureMaps + MATERIAL_MAP, pixel, 1, 1, FALSE);
+        texture2DFromData(pBoundDevice->pDefaultTextureMaps + MATERIAL_MAP, pixel, 1, 1, EG_U8 | EG_RGBA, 0);
         if (!pBoundDevice->pDefaultTextureMaps[MATERIAL_MAP].pTexture)
         {
             egDestroyDevice(&ret);
@@ -333,7 +338,7 @@ EGDevice egCreateDevice(HWND windowHandle)
     }
     {
         uint8_t pixel[4] = {0, 0, 0, 0};
-        texture2DFromData(&pBoundDevice->transparentBlackTexture, pixel, 1, 1, FALSE);
+        texture2DFromData(&pBoundDevice->transparentBlackTexture, pixel, 1, 1, EG_U8 | EG_RGBA, 0);
         if (!pBoundDevice->transparentBlackTexture.pTexture)
         {
             egDestroyDevice(&ret);
@@ -344,7 +349,7 @@ EGDevice egCreateDevice(HWND windowHandle)
     // Create our G-Buffer
     result = createRenderTarget(pBoundDevice->gBuffer + G_DIFFUSE,
                                 pBoundDevice->backBufferDesc.Width, pBoundDevice->backBufferDesc.Height,
-                                DXGI_FORMAT_R8G8B8A8_UNORM);
+                                DXGI_FORMAT_R8G8B8A8_UNORM, RESIDENCY_G_BUFFER);
     if (result != S_OK)
     {
         egDestroyDevice(&ret);
@@ -352,7 +357,7 @@ EGDevice egCreateDevice(HWND windowHandle)
     }
     result = createRenderTarget(pBoundDevice->gBuffer + G_DEPTH,
                                 pBoundDevice->backBufferDesc.Width, pBoundDevice->backBufferDesc.Height,
-                                DXGI_FORMAT_R32_FLOAT);
+                                DXGI_FORMAT_R32_FLOAT, RESIDENCY_G_BUFFER);
     if (result != S_OK)
     {
         egDestroyDevice(&ret);
@@ -360,7 +365,7 @@ EGDevice egCreateDevice(HWND windowHandle)
     }
     result = createRenderTarget(pBoundDevice->gBuffer + G_NORMAL,
                                 pBoundDevice->backBufferDesc.Width, pBoundDevice->backBufferDesc.Height,
-                                DXGI_FORMAT_R8G8B8A8_UNORM);
+                                DXGI_FORMAT_R8G8B8A8_UNORM, RESIDENCY_G_BUFFER);
     if (result != S_OK)
     {
         egDestroyDevice(&ret);
@@ -368,7 +373,7 @@ EGDevice egCreateDevice(HWND windowHandle)
     }
     result = createRenderTarget(pBoundDevice->gBuffer + G_MATERIAL,
                                 pBoundDevice->backBufferDesc.Width, pBoundDevice->backBufferDesc.Height,
-                                DXGI_FORMAT_R8G8B8A8_UNORM);
+                                DXGI_FORMAT_R8G8B8A8_UNORM, RESIDENCY_G_BUFFER);
     if (result != S_OK)
     {
         egDestroyDevice(&ret);
@@ -378,7 +383,7 @@ EGDevice egCreateDevice(HWND windowHandle)
     // Accumulation buffer. This is an HDR texture
     result = createRenderTarget(&pBoundDevice->accumulationBuffer,
                                 pBoundDevice->backBufferDesc.Width, pBoundDevice->backBufferDesc.Height,
-                                DXGI_FORMAT_R16G16B16A16_FLOAT); // DXGI_FORMAT_R11G11B10_FLOAT
+                                DXGI_FORMAT_R16G16B16A16_FLOAT, RESIDENCY_G_BUFFER); // DXGI_FORMAT_R11G11B10_FLOAT
     if (result != S_OK)
     {
         egDestroyDevice(&ret);
@@ -395,7 +400,7 @@ EGDevice egCreateDevice(HWND windowHandle)
             UINT h = pBoundDevice->backBufferDesc.Height / divider;
             result = createRenderTarget(&pBoundDevice->blurBuffers[i][k],
                                         w, h,
-                                        DXGI_FORMAT_R8G8B8A8_UNORM);
+                                        DXGI_FORMAT_R8G8B8A8_UNORM, RESIDENCY_BLUR_BUFFERS);
             if (result != S_OK)
             {
                 egDestroyDevice(&ret);
@@ -414,9 +419,9 @@ EGDevice egCreateDevice(HWND windowHandle)
         pBoundDevice->passStates[EG_AMBIENT_PASS] = egCreateState();
         pBoundDevice->passStates[EG_OMNI_PASS] = egCreateState();
 
-        SEGState *pState = pBoundDevice->states + (pBoundDevice->passStates[EG_AMBIENT_PASS] - 1);
+        SEGState *pState = poolGet(&pBoundDevice->states, pBoundDevice->passStates[EG_AMBIENT_PASS]);
         pState->ignoreBits = STATE_ALPHA_TEST | STATE_VIGNETTE;
-        pState = pBoundDevice->states + (pBoundDevice->passStates[EG_OMNI_PASS] - 1);
+        pState = poolGet(&pBoundDevice->states, pBoundDevice->passStates[EG_OMNI_PASS]);
         pState->ignoreBits = STATE_ALPHA_TEST | STATE_VIGNETTE;
     }
     {
@@ -429,7 +434,7 @@ EGDevice egCreateDevice(HWND windowHandle)
         pState->samplerState.desc.ComparisonFunc = D3D11_COMPARISON_ALWAYS;
         pState->samplerState.desc.MaxLOD = D3D11_FLOAT32_MAX;
         pBoundDevice->passStates[EG_POST_PROCESS_PASS] = egCreateState();
-        pState = pBoundDevice->states + (pBoundDevice->passStates[EG_POST_PROCESS_PASS] - 1);
+        pState = poolGet(&pBoundDevice->states, pBoundDevice->passStates[EG_POST_PROCESS_PASS]);
         pState->ignoreBits = STATE_ALPHA_TEST | STATE_VIGNETTE;
     }
 
@@ -473,6 +478,10 @@ void destroyTexture(SEGTexture2D *pTexture)
         {
             pTexture->pResourceView->lpVtbl->Release(pTexture->pResourceView);
         }
+        if (pTexture->pRenderTargetView)
+        {
+            pTexture->pRenderTargetView->lpVtbl->Release(pTexture->pRenderTargetView);
+        }
     }
 }
 
@@ -490,13 +499,22 @@ void egDestroyDevice(EGDevice *pDeviceID)
     SEGDevice *pDevice = devices + (*pDeviceID - 1);
     if (pDevice->bIsInBatch) return;
 
-    // Textures
-    for (uint32_t i = 0; i < pDevice->textureCount; ++i)
+    // Textures. Atlas pages are in the texture pool.
+    destroyTextureLoader(pDevice->pTextureLoader);
+    for (uint32_t i = 0; i < pDevice->atlases.slotCount; ++i)
+    {
+        SEGAtlas *pAtlas = poolGetAt(&pDevice->atlases, i);
+        if (pAtlas) destroyAtlas(pAtlas);
+    }
+    destroyPool(&pDevice->atlases);
+    for (uint32_t i = 0; i < pDevice->textures.slotCount; ++i)
     {
-        SEGTexture2D *pTexture = pDevice->textures + i;
+        SEGTexture2D *pTexture = poolGetAt(&pDevice->textures, i);
+        if (!pTexture) continue;
+        freeTextureSource(pTexture);
         destroyTexture(pTexture);
     }
-    free(pDevice->textures);
+    destroyPool(&pDevice->textures);
     for (uint32_t i = 0; i < 3; ++i)
     {
         SEGTexture2D *pTexture = pDevice->pDefaultTextureMaps + i;
@@ -559,12 +577,12 @@ void egDestroyDevice(EGDevice *pDeviceID)
     }
 
     // States
-    for (uint32_t i = 0; i < pDevice->stateCount; ++i)
+    for (uint32_t i = 0; i < pDevice->states.slotCount; ++i)
     {
-        SEGState *pState = pDevice->states + i;
-        destroyState(pState);
+        SEGState *pState = poolGetAt(&pDevice->states, i);
+        if (pState) destroyState(pState);
     }
-    free(pDevice->states);
+    destroyPool(&pDevice->states);
 
     // Device
     if (pDevice->pDepthStencilView) pDevice->pDepthStencilView->lpVtbl->Release(pDevice->pDepthStencilView);
@@ -658,6 +676,7 @@ void egResize()
     for (uint32_t i = 0; i < 4; ++i)
     {
         SEGRenderTarget2D *pRenderTarget = pBoundDevice->gBuffer + i;
+        untrackResident(&pBoundDevice->residency, &pRenderTarget->texture.resident);
         destroyRenderTarget(pRenderTarget);
     }
     for (uint32_t i = 0; i < 8; ++i)
@@ -665,9 +684,11 @@ void egResize()
         for (uint32_t k = 0; k < 2; ++k)
         {
             SEGRenderTarget2D *pRenderTarget = &pBoundDevice->blurBuffers[i][k];
+            untrackResident(&pBoundDevice->residency, &pRenderTarget->texture.resident);
             destroyRenderTarget(pRenderTarget);
         }
     }
+    untrackResident(&pBoundDevice->residency, &pBoundDevice->accumulationBuffer.texture.resident);
     destroyRenderTarget(&pBoundDevice->accumulationBuffer);
 
     ID3D11Texture2D        *pBackBuffer;
@@ -685,21 +706,21 @@ void egResize()
     // Create our G-Buffer
     createRenderTarget(pBoundDevice->gBuffer + G_DIFFUSE,
                        pBoundDevice->backBufferDesc.Width, pBoundDevice->backBufferDesc.Height,
-                       DXGI_FORMAT_R8G8B8A8_UNORM);
+                       DXGI_FORMAT_R8G8B8A8_UNORM, RESIDENCY_G_BUFFER);
     createRenderTarget(pBoundDevice->gBuffer + G_DEPTH,
                        pBoundDevice->backBufferDesc.Width, pBoundDevice->backBufferDesc.Height,
-                       DXGI_FORMAT_R32_FLOAT);
+                       DXGI_FORMAT_R32_FLOAT, RESIDENCY_G_BUFFER);
     createRenderTarget(pBoundDevice->gBuffer + G_NORMAL,
                        pBoundDevice->backBufferDesc.Width, pBoundDevice->backBufferDesc.Height,
-                       DXGI_FORMAT_R8G8B8A8_UNORM);
+                       DXGI_FORMAT_R8G8B8A8_UNORM, RESIDENCY_G_BUFFER);
     createRenderTarget(pBoundDevice->gBuffer + G_MATERIAL,
                        pBoundDevice->backBufferDesc.Width, pBoundDevice->backBufferDesc.Height,
-                       DXGI_FORMAT_R8G8B8A8_UNORM);
+                       DXGI_FORMAT_R8G8B8A8_UNORM, RESIDENCY_G_BUFFER);
 
     // Accumulation buffer. This is an HDR texture
     createRenderTarget(&pBoundDevice->accumulationBuffer,
                        pBoundDevice->backBufferDesc.Width, pBoundDevice->backBufferDesc.Height,
-                       DXGI_FORMAT_R16G16B16A16_FLOAT); // DXGI_FORMAT_R11G11B10_FLOAT
+                       DXGI_FORMAT_R16G16B16A16_FLOAT, RESIDENCY_G_BUFFER); // DXGI_FORMAT_R11G11B10_FLOAT
 
     // Create blur buffers
     for (int i = 0; i < 8; ++i)
@@ -711,7 +732,7 @@ void egResize()
             UINT h = pBoundDevice->backBufferDesc.Height / divider;
             createRenderTarget(&pBoundDevice->blurBuffers[i][k],
                                w, h,
-                               DXGI_FORMAT_R8G8B8A8_UNORM);
+                               DXGI_FORMAT_R8G8B8A8_UNORM, RESIDENCY_BLUR_BUFFERS);
         }
     }
 }
@@ -5,9 +5,12 @@
 
 #include <d3d11.h>
 #include <inttypes.h>
+#include "eg_atlas.h"
 #include "eg_batch.h"
+#include "eg_loader.h"
 #include "eg_math.h"
 #include "eg_pass.h"
+#include "eg_pool.h"
 #include "eg_rt.h"
 #include "eg_state.h"
 
@@ -72,10 +75,13 @@ typedef struct
     uint32_t                    worldMatricesStackCount;
 
     // Textures
-    SEGTexture2D               *textures;
-    uint32_t                    textureCount;
+    SEGPool                     textures; // SEGTexture2D
     SEGTexture2D                pDefaultTextureMaps[3];
     SEGTexture2D                transparentBlackTexture;
+    SEGTextureLoader           *pTextureLoader;
+    SEGPool                     atlases; // SEGAtlas
+    float                       normalMapStrength;
+    SEGResidency                residency;
 
     // States
     uint32_t                    viewPort[4];
@@ -83,8 +89,7 @@ typedef struct
     uint32_t                    statesStackCount;
     float                       clearColor[4];
     EG_PASS                     pass;
-    SEGState                   *states;
-    uint32_t                    stateCount;
+    SEGPool                     states; // SEGState
     EGState                     passStates[EG_PASS_COUNT];
     int                         postProcessCount;
 
@@ -99,6 +104,9 @@ typedef struct
 
 extern SEGDevice *pBoundDevice;
 
+void destroyTexture(SEGTexture2D *pTexture);
+void destroyState(SEGState *pState);
+
 void updateViewProjCB();
 void updateInvViewProjCB();
 void updateModelCB();
@@ -0,0 +1,521 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "eg_bc.h"
+#include "eg_cache.h"
+#include "eg_device.h"
+#include "eg_error.h"
+#include "eg_format.h"
+#include "eg_loader.h"
+#include "eg_mip.h"
+
+struct SEGTextureJob
+{
+    SEGTextureLoader           *pLoader;
+    EGTexture                   texture;
+    char                       *szFilename;     // Decode this file,
+    uint8_t                    *pSource;        // or convert this data
+    uint32_t                    w, h;
+    EGFormat                    dataFormat;
+    EG_TEXTURE_FLAGS            flags;
+    EGImageDecoder              decoder;
+    EGStreamingImageDecoder     streamingDecoder;   // Preferred over decoder
+    float                       normalStrength;
+    uint8_t                    *pPixels;        // RGBA8, textureData can point into it
+    SEGTextureData              textureData;
+    const char                 *szError;        // Reported on the render thread
+    SEGTextureJob              *pNext;
+};
+
+static EGImageDecoder imageDecoder = NULL;
+static EGStreamingImageDecoder streamingImageDecoder = NULL;
+
+static uint32_t getPixelSize(EGFormat dataFormat)
+{
+    uint32_t channelCount = dataFormat & 0x0f;
+    switch (dataFormat & 0xf0)
+    {
+        case EG_U8: case EG_S8: return channelCount;
+        case EG_U16: case EG_S16: return channelCount * 2;
+        case EG_U32: case EG_S32: case EG_F32: return channelCount * 4;
+        case EG_U64: case EG_S64: case EG_F64: return channelCount * 8;
+    }
+    return 0;
+}
+
+static uint8_t *readFile(const char *szFilename, uint32_t *pSize)
+{
+    FILE *pFile = NULL;
+    if (fopen_s(&pFile, szFilename, "rb") || !pFile) return NULL;
+    fseek(pFile, 0, SEEK_END);
+    long size = ftell(pFile);
+    fseek(pFile, 0, SEEK_SET);
+    uint8_t *pData = NULL;
+    if (size > 0) pData = (uint8_t *)malloc(size);
+    if (pData && fread(pData, 1, size, pFile) != (size_t)size)
+    {
+        free(pData);
+        pData = NULL;
+    }
+    fclose(pFile);
+    *pSize = (uint32_t)size;
+    return pData;
+}
+
+static char *getCacheFilename(const char *szFilename)
+{
+    size_t len = strlen(szFilename);
+    char *szCacheFilename = (char *)malloc(len + 5);
+    if (!szCacheFilename) return NULL;
+    memcpy(szCacheFilename, szFilename, len);
+    memcpy(szCacheFilename + len, ".egt", 5);
+    return szCacheFilename;
+}
+
+// Normal strength only changes generated normal maps
+static float getCacheNormalStrength(const SEGTextureJob *pJob)
+{
+    return (pJob->flags & EG_GENERATE_NORMAL_MAP) ? pJob->normalStrength : 0.f;
+}
+
+// The level sizes and pitches are what CreateTexture2D reads from the
+// mapping, so they must be exactly what the format and size give. Only the
+// formats prepareTextureData produces are accepted.
+static int checkCachedLevels(const SEGTextureCache *pCache)
+{
+    uint32_t bcFormat;
+    switch (pCache->format)
+    {
+        case DXGI_FORMAT_R8G8B8A8_UNORM: bcFormat = 0; break;
+        case DXGI_FORMAT_BC1_UNORM: bcFormat = BC_FORMAT_BC1; break;
+        case DXGI_FORMAT_BC3_UNORM: bcFormat = BC_FORMAT_BC3; break;
+        case DXGI_FORMAT_BC4_UNORM: bcFormat = BC_FORMAT_BC4; break;
+        case DXGI_FORMAT_BC5_UNORM: bcFormat = BC_FORMAT_BC5; break;
+        default: return 0;
+    }
+    if (pCache->w < 1 || pCache->w > D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION) return 0;
+    if (pCache->h < 1 || pCache->h > D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION) return 0;
+    if (pCache->mipLevels > getMipLevelCount(pCache->w, pCache->h)) return 0;
+
+    UINT mipW = pCache->w;
+    UINT mipH = pCache->h;
+    for (uint32_t i = 0; i < pCache->mipLevels; ++i)
+    {
+        uint32_t pitch = bcFormat ? getBCPitch(bcFormat, mipW) : mipW * 4;
+        if (pCache->pitches[i] != pitch) return 0;
+        if (pCache->sizes[i] != getTextureBytes((DXGI_FORMAT)pCache->format, mipW, mipH, 1)) return 0;
+        mipW = max(1, mipW / 2);
+        mipH = max(1, mipH / 2);
+    }
+    return 1;
+}
+
+// Points the texture data into the mapped cache file, if it was made from
+// the same file content with the same flags.
+static int loadCachedTexture(SEGTextureJob *pJob, uint64_t sourceHash)
+{
+    char *szCacheFilename = getCacheFilename(pJob->szFilename);
+    if (!szCacheFilename) return 0;
+    const uint8_t *pFileData;
+    uint64_t fileSize;
+    SEGMappedFile *pMapped = mapFile(szCacheFilename, &pFileData, &fileSize);
+    free(szCacheFilename);
+    if (!pMapped) return 0;
+
+    SEGTextureCache cache;
+    if (!readTextureCache(pFileData, fileSize, &cache) ||
+        !checkCachedLevels(&cache) ||
+        cache.sourceHash != sourceHash ||
+        cache.flags != (uint32_t)(pJob->flags & ~EG_CACHE) ||
+        cache.normalStrength != getCacheNormalStrength(pJob))
+    {
+        unmapFile(pMapped);
+        return 0;
+    }
+
+    SEGTextureData *pData = &pJob->textureData;
+    pData->mipsData = (D3D11_SUBRESOURCE_DATA *)malloc(sizeof(D3D11_SUBRESOURCE_DATA) * cache.mipLevels);
+    if (!pData->mipsData)
+    {
+        unmapFile(pMapped);
+        return 0;
+    }
+    for (uint32_t i = 0; i < cache.mipLevels; ++i)
+    {
+        pData->mipsData[i].pSysMem = cache.pLevels[i];
+        pData->mipsData[i].SysMemPitch = cache.pitches[i];
+        pData->mipsData[i].SysMemSlicePitch = 0;
+    }
+    pData->w = cache.w;
+    pData->h = cache.h;
+    pData->mipLevels = cache.mipLevels;
+    pData->format = (DXGI_FORMAT)cache.format;
+    pData->pMapped = pMapped;
+    pJob->w = cache.w;
+    pJob->h = cache.h;
+    return 1;
+}
+
+static void saveCachedTexture(const SEGTextureJob *pJob, uint64_t sourceHash)
+{
+    const SEGTextureData *pData = &pJob->textureData;
+    if (pData->mipLevels > TEXTURE_CACHE_MAX_LEVELS) return;
+
+    SEGTextureCache cache;
+    memset(&cache, 0, sizeof(SEGTextureCache));
+    cache.sourceHash = sourceHash;
+    cache.flags = (uint32_t)(pJob->flags & ~EG_CACHE);
+    cache.normalStrength = getCacheNormalStrength(pJob);
+    cache.w = pData->w;
+    cache.h = pData->h;
+    cache.format = (uint32_t)pData->format;
+    cache.mipLevels = pData->mipLevels;
+    UINT mipW = pData->w;
+    UINT mipH = pData->h;
+    for (UINT i = 0; i < pData->mipLevels; ++i)
+    {
+        cache.pLevels[i] = (const uint8_t *)pData->mipsData[i].pSysMem;
+        cache.pitches[i] = pData->mipsData[i].SysMemPitch;
+        cache.sizes[i] = (uint32_t)getTextureBytes(pData->format, mipW, mipH, 1);
+        mipW = max(1, mipW / 2);
+        mipH = max(1, mipH / 2);
+    }
+
+    // Failing to write only costs the next load
+    char *szCacheFilename = getCacheFilename(pJob->szFilename);
+    if (!szCacheFilename) return;
+    writeTextureCache(szCacheFilename, &cache);
+    free(szCacheFilename);
+}
+
+// EGImageAllocator of the streaming decoder
+static uint8_t *allocateJobPixels(void *pContext, uint32_t width, uint32_t height)
+{
+    SEGTextureJob *pJob = (SEGTextureJob *)pContext;
+    if (pJob->pPixels || width == 0 || height == 0) return NULL;
+    pJob->pPixels = allocateTexturePixels(width, height, pJob->flags);
+    pJob->w = width;
+    pJob->h = height;
+    return pJob->pPixels;
+}
+
+static uint32_t decodeFile(SEGTextureJob *pJob, const uint8_t *pFileData, uint32_t fileSize)
+{
+    if (pJob->streamingDecoder) return pJob->streamingDecoder(pFileData, fileSize, allocateJobPixels, pJob);
+    return pJob->decoder(pFileData, fileSize, &pJob->pPixels, &pJob->w, &pJob->h);
+}
+
+// Worker thread. Everything up to the upload.
+static void runTextureJob(void *pData)
+{
+    SEGTextureJob *pJob = (SEGTextureJob *)pData;
+    uint64_t sourceHash = 0;
+    int bCached = 0;
+
+    if (pJob->szFilename)
+    {
+        uint32_t fileSize = 0;
+        uint8_t *pFileData = readFile(pJob->szFilename, &fileSize);
+        if (!pFileData)
+        {
+            pJob->szError = "Failed to read texture file";
+        }
+        else
+        {
+            if (pJob->flags & EG_CACHE)
+            {
+                sourceHash = hashData(pFileData, fileSize);
+                bCached = loadCachedTexture(pJob, sourceHash);
+            }
+            if (!bCached && (decodeFile(pJob, pFileData, fileSize) || !pJob->pPixels))
+            {
+                pJob->szError = "Failed to decode texture file";
+                if (pJob->pPixels) free(pJob->pPixels);
+                pJob->pPixels = NULL;
+            }
+            free(pFileData);
+        }
+    }
+    else if (pJob->dataFormat == (EG_U8 | EG_RGBA))
+    {
+        pJob->pPixels = pJob->pSource;
+        pJob->pSource = NULL;
+    }
+    else
+    {
+        pJob->pPixels = (uint8_t *)malloc(pJob->w * pJob->h * 4);
+        getFormatConverter(pJob->dataFormat)(pJob->pSource, pJob->pPixels, pJob->w * pJob->h);
+    }
+
+    if (pJob->pPixels && pJob->streamingDecoder)
+    {
+        // The texture data takes the pixels
+        prepareTexturePixels(&pJob->textureData, pJob->pPixels, pJob->w, pJob->h, pJob->flags, pJob->normalStrength);
+        pJob->pPixels = NULL;
+        if (pJob->flags & EG_CACHE) saveCachedTexture(pJob, sourceHash);
+    }
+    else if (pJob->pPixels)
+    {
+        prepareTextureData(&pJob->textureData, pJob->pPixels, pJob->w, pJob->h, pJob->szFilename ? (EG_U8 | EG_RGBA) : pJob->dataFormat, pJob->flags, pJob->normalStrength);
+        if (pJob->szFilename && (pJob->flags & EG_CACHE)) saveCachedTexture(pJob, sourceHash);
+    }
+
+    SEGTextureLoader *pLoader = pJob->pLoader;
+    lockMutex(pLoader->pMutex);
+    pJob->pNext = pLoader->pDoneJobs;
+    pLoader->pDoneJobs = pJob;
+    unlockMutex(pLoader->pMutex);
+}
+
+static void freeTextureJob(SEGTextureJob *pJob)
+{
+    freeTextureData(&pJob->textureData);
+    if (pJob->pPixels) free(pJob->pPixels);
+    if (pJob->pSource) free(pJob->pSource);
+    if (pJob->szFilename) free(pJob->szFilename);
+    free(pJob);
+}
+
+static SEGTextureLoader *getTextureLoader()
+{
+    if (!pBoundDevice->pTextureLoader)
+    {
+        SEGTextureLoader *pLoader = (SEGTextureLoader *)calloc(1, sizeof(SEGTextureLoader));
+        if (!pLoader) return NULL;
+        pLoader->pMutex = createMutex();
+        if (!pLoader->pMutex)
+        {
+            free(pLoader);
+            return NULL;
+        }
+        pBoundDevice->pTextureLoader = pLoader;
+    }
+    return pBoundDevice->pTextureLoader;
+}
+
+// Reserve the texture slot, and queue the job. The slot stays empty until
+// the upload, so it binds the default maps. Reloads already have a slot.
+static EGTexture pushTextureJob(SEGTextureJob *pJob)
+{
+    SEGTextureLoader *pLoader = getTextureLoader();
+    if (pLoader && !pLoader->pWorkers) pLoader->pWorkers = createWorkerPool(pLoader->threadCount);
+    if (!pLoader || !pLoader->pWorkers)
+    {
+        freeTextureJob(pJob);
+        setError("Failed to create texture loader");
+        return 0;
+    }
+
+    if (!pJob->texture)
+    {
+        SEGTexture2D texture2D = {0};
+        texture2D.w = pJob->w;
+        texture2D.h = pJob->h;
+        pJob->texture = createTexture(&texture2D);
+        if (!pJob->texture)
+        {
+            freeTextureJob(pJob);
+            return 0;
+        }
+        pJob->normalStrength = pBoundDevice->normalMapStrength;
+    }
+    pJob->pLoader = pLoader;
+    ++pLoader->pendingCount;
+    pushJob(pLoader->pWorkers, runTextureJob, pJob);
+    return pJob->texture;
+}
+
+EGTexture egCreateTexture2DAsync(uint32_t width, uint32_t height, const void *pData, EGFormat dataFormat, EG_TEXTURE_FLAGS flags)
+{
+    if (!pBoundDevice) return 0;
+    if (width == 0 || height == 0) return 0;
+    if (flags & EG_RENDER_TARGET) return egCreateTexture2D(width, height, pData, dataFormat, flags);
+    if (!getFormatConverter(dataFormat))
+    {
+        setError("Invalid data format");
+        return 0;
+    }
+
+    SEGTextureJob *pJob = (SEGTextureJob *)calloc(1, sizeof(SEGTextureJob));
+    if (!pJob) return 0;
+    size_t size = (size_t)width * height * getPixelSize(dataFormat);
+    pJob->pSource = (uint8_t *)malloc(size);
+    if (!pJob->pSource)
+    {
+        free(pJob);
+        return 0;
+    }
+    memcpy(pJob->pSource, pData, size);
+    pJob->w = width;
+    pJob->h = height;
+    pJob->dataFormat = dataFormat;
+    pJob->flags = flags;
+    return pushTextureJob(pJob);
+}
+
+void egSetImageDecoder(EGImageDecoder decoder)
+{
+    imageDecoder = decoder;
+}
+
+void egSetStreamingImageDecoder(EGStreamingImageDecoder decoder)
+{
+    streamingImageDecoder = decoder;
+}
+
+static char *copyString(const char *szString)
+{
+    size_t len = strlen(szString);
+    char *szCopy = (char *)malloc(len + 1);
+    if (szCopy) memcpy(szCopy, szString, len + 1);
+    return szCopy;
+}
+
+static SEGTextureJob *createFileJob(const char *szFilename, EG_TEXTURE_FLAGS flags)
+{
+    if (!imageDecoder && !streamingImageDecoder)
+    {
+        setError("No image decoder set");
+        return NULL;
+    }
+
+    SEGTextureJob *pJob = (SEGTextureJob *)calloc(1, sizeof(SEGTextureJob));
+    if (!pJob) return NULL;
+    pJob->szFilename = copyString(szFilename);
+    if (!pJob->szFilename)
+    {
+        free(pJob);
+        return NULL;
+    }
+    pJob->dataFormat = EG_U8 | EG_RGBA;
+    pJob->flags = flags & ~EG_RENDER_TARGET;
+    pJob->decoder = imageDecoder;
+    pJob->streamingDecoder = streamingImageDecoder;
+    return pJob;
+}
+
+EGTexture egLoadTextureFile(const char *szFilename, EG_TEXTURE_FLAGS flags)
+{
+    if (!pBoundDevice) return 0;
+    if (!szFilename) return 0;
+
+    SEGTextureJob *pJob = createFileJob(szFilename, flags);
+    if (!pJob) return 0;
+    EGTexture texture = pushTextureJob(pJob);
+
+    // Evicted file textures load from the file again
+    SEGTexture2D *pTexture = poolGet(&pBoundDevice->textures, texture);
+    if (pTexture)
+    {
+        SEGTextureSource *pSource = (SEGTextureSource *)calloc(1, sizeof(SEGTextureSource));
+        if (pSource) pSource->szFilename = copyString(szFilename);
+        if (pSource && pSource->szFilename)
+        {
+            pSource->flags = flags & ~EG_RENDER_TARGET;
+            pSource->normalStrength = pBoundDevice->normalMapStrength;
+            pTexture->pSource = pSource;
+        }
+        else if (pSource)
+        {
+            free(pSource);
+        }
+    }
+    return texture;
+}
+
+void reloadTextureFile(EGTexture texture, const SEGTextureSource *pSource)
+{
+    SEGTextureJob *pJob = createFileJob(pSource->szFilename, pSource->flags);
+    if (!pJob) return;
+    pJob->texture = texture;
+    pJob->normalStrength = pSource->normalStrength;
+    pushTextureJob(pJob);
+}
+
+void egSetTextureLoaderThreadCount(uint32_t threadCount)
+{
+    if (!pBoundDevice) return;
+    SEGTextureLoader *pLoader = getTextureLoader();
+    if (!pLoader) return;
+    if (pLoader->threadCount == threadCount) return;
+
+    // The new pool is created with the next job
+    if (pLoader->pWorkers)
+    {
+        destroyWorkerPool(pLoader->pWorkers);
+        pLoader->pWorkers = NULL;
+        uploadLoadedTextures();
+    }
+    pLoader->threadCount = threadCount;
+}
+
+void uploadLoadedTextures()
+{
+    SEGTextureLoader *pLoader = pBoundDevice->pTextureLoader;
+    if (!pLoader) return;
+
+    lockMutex(pLoader->pMutex);
+    SEGTextureJob *pJob = pLoader->pDoneJobs;
+    pLoader->pDoneJobs = NULL;
+    unlockMutex(pLoader->pMutex);
+
+    while (pJob)
+    {
+        SEGTextureJob *pNext = pJob->pNext;
+
+        // The texture might have been destroyed while loading
+        SEGTexture2D *pTexture = poolGet(&pBoundDevice->textures, pJob->texture);
+        if (pJob->szError)
+        {
+            setError(pJob->szError);
+        }
+        else if (pTexture)
+        {
+            pTexture->w = pJob->w;
+            pTexture->h = pJob->h;
+            uploadTextureData(pTexture, &pJob->textureData);
+            if (pTexture->pTexture && !pTexture->pSource && pBoundDevice->residency.budget)
+            {
+                pTexture->pSource = createTextureSource(&pJob->textureData, pJob->pPixels);
+            }
+            trackTexture(pTexture);
+        }
+
+        --pLoader->pendingCount;
+        freeTextureJob(pJob);
+        pJob = pNext;
+    }
+}
+
+void egWaitForTextures()
+{
+    if (!pBoundDevice) return;
+    SEGTextureLoader *pLoader = pBoundDevice->pTextureLoader;
+    if (!pLoader) return;
+
+    if (pLoader->pWorkers) waitWorkerPool(pLoader->pWorkers);
+    uploadLoadedTextures();
+}
+
+uint32_t egGetPendingTextureCount()
+{
+    if (!pBoundDevice) return 0;
+    if (!pBoundDevice->pTextureLoader) return 0;
+    return pBoundDevice->pTextureLoader->pendingCount;
+}
+
+void destroyTextureLoader(SEGTextureLoader *pLoader)
+{
+    if (!pLoader) return;
+    if (pLoader->pWorkers) destroyWorkerPool(pLoader->pWorkers);
+
+    SEGTextureJob *pJob = pLoader->pDoneJobs;
+    while (pJob)
+    {
+        SEGTextureJob *pNext = pJob->pNext;
+        freeTextureJob(pJob);
+        pJob = pNext;
+    }
+    destroyMutex(pLoader->pMutex);
+    free(pLoader);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#ifndef EG_LOADER_H_INCLUDED
+#define EG_LOADER_H_INCLUDED
+
+#include "eg_texture.h"
+#include "eg_thread.h"
+
+typedef struct SEGTextureJob SEGTextureJob;
+
+// Per device. Heap allocated so jobs can point to it while the device
+// array moves.
+typedef struct
+{
+    SEGWorkerPool              *pWorkers;
+    uint32_t                    threadCount;
+    SEGMutex                   *pMutex;
+    SEGTextureJob              *pDoneJobs;      // Guarded by pMutex
+    uint32_t                    pendingCount;   // Render thread only
+} SEGTextureLoader;
+
+// Upload textures finished by the workers. Render thread only.
+void uploadLoadedTextures();
+
+// Queue an evicted texture to load from its file again
+void reloadTextureFile(EGTexture texture, const SEGTextureSource *pSource);
+
+// Waits for the jobs in flight
+void destroyTextureLoader(SEGTextureLoader *pLoader);
+
+#endif /* EG_LOADER_H_INCLUDED */
@@ -1,7 +1,7 @@
 #include "eg_device.h"
 #include "eg_error.h"
 
-HRESULT createRenderTarget(SEGRenderTarget2D *pRenderTarget, UINT w, UINT h, DXGI_FORMAT format)
+HRESULT createRenderTarget(SEGRenderTarget2D *pRenderTarget, UINT w, UINT h, DXGI_FORMAT format, uint32_t category)
 {
     memset(pRenderTarget, 0, sizeof(SEGRenderTarget2D));
     D3D11_TEXTURE2D_DESC textureDesc = {0};
@@ -79,6 +79,10 @@ HRESULT createRenderTarget(SEGRenderTarget2D *pRenderTarget, UINT w, UINT h, DXG
     }
     pTextureRes->lpVtbl->Release(pTextureRes);
 
+    pRenderTarget->texture.resident.category = category;
+    pRenderTarget->texture.resident.bytes = getTextureBytes(format, w, h, 1);
+    trackResident(&pBoundDevice->residency, &pRenderTarget->texture.resident, 0);
+
     return S_OK;
 }
 
@@ -160,5 +164,9 @@ HRESULT createTextureRenderTarget(SEGTexture2D *pRenderTarget, UINT w, UINT h, D
     }
     pTextureRes->lpVtbl->Release(pTextureRes);
 
+    // Tracked once it's in the texture pool
+    pRenderTarget->resident.category = RESIDENCY_RENDER_TARGETS;
+    pRenderTarget->resident.bytes = getTextureBytes(format, w, h, 1);
+
     return S_OK;
 }
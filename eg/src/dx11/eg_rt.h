@@ -11,7 +11,8 @@ typedef struct
     ID3D11RenderTargetView     *pRenderTargetView;
 } SEGRenderTarget2D;
 
-HRESULT createRenderTarget(SEGRenderTarget2D *pRenderTarget, UINT w, UINT h, DXGI_FORMAT format);
+// category is the RESIDENCY_ category the memory is accounted in
+HRESULT createRenderTarget(SEGRenderTarget2D *pRenderTarget, UINT w, UINT h, DXGI_FORMAT format, uint32_t category);
 HRESULT createTextureRenderTarget(SEGTexture2D *pRenderTarget, UINT w, UINT h, DXGI_FORMAT format);
 
 #endif /* EG_RT_H_INCLUDED */
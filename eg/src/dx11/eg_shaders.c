@@ -127,7 +127,8 @@ const char *g_vs = MULTILINE(
     "    sOutput output;" \
     "    output.diffuse = xdiffuse * input.color;" \
     "    output.depth = input.depth.x / input.depth.y;" \
-    "    xnormal.xyz = xnormal.xyz * 2 - 1;" \
+    "    xnormal.xy = xnormal.xy * 2 - 1;" \
+    "    xnormal.z = sqrt(saturate(1 - dot(xnormal.xy, xnormal.xy)));" \
     "    output.normal.xyz = normalize(xnormal.x * input.tangent + xnormal.y * input.binormal + xnormal.z * input.normal);" \
     "    output.normal.xyz = output.normal.xyz * .5 + .5;" \
     "    output.normal.a = 0;" \
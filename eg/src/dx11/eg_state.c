@@ -416,10 +416,10 @@ EGState egCreateState()
 {
     if (!pBoundDevice) return 0;
 
-    SEGState *pState = pBoundDevice->stateStack + pBoundDevice->statesStackCount;
-    pBoundDevice->states = realloc(pBoundDevice->states, sizeof(SEGState) * (pBoundDevice->stateCount + 1));
-    memcpy(pBoundDevice->states + pBoundDevice->stateCount, pState, sizeof(SEGState));
-    pState = pBoundDevice->states + pBoundDevice->stateCount;
+    SEGState *pState;
+    EGState state = poolAlloc(&pBoundDevice->states, (void **)&pState);
+    if (!state) return 0;
+    memcpy(pState, pBoundDevice->stateStack + pBoundDevice->statesStackCount, sizeof(SEGState));
 
     // Create static objects for it
     pBoundDevice->pDevice->lpVtbl->CreateDepthStencilState(pBoundDevice->pDevice, &pState->depthState.desc, &pState->depthState.pState);
@@ -433,12 +433,20 @@ EGState egCreateState()
         pBoundDevice->pDevice->lpVtbl->CreateBuffer(pBoundDevice->pDevice, &cbDesc, &initialData, &pState->alphaTestState.pCB);
     }
 
-    return ++pBoundDevice->stateCount;
+    return state;
 }
 
 void egDestroyState(EGState *pState)
 {
     if (!pBoundDevice) return;
+    if (!pState) return;
+
+    SEGState *pStaticState = poolGet(&pBoundDevice->states, *pState);
+    if (!pStaticState) return;
+
+    destroyState(pStaticState);
+    poolFree(&pBoundDevice->states, *pState);
+    *pState = 0;
 }
 
 void applyStaticState(SEGState *pState)
@@ -476,10 +484,11 @@ void applyStaticState(SEGState *pState)
 void egBindState(EGState state)
 {
     if (!pBoundDevice) return;
-    if (!state) return;
-    if (state > pBoundDevice->stateCount) return;
 
-    applyStaticState(&pBoundDevice->states[state - 1]);
+    SEGState *pState = poolGet(&pBoundDevice->states, state);
+    if (!pState) return;
+
+    applyStaticState(pState);
 }
 
 //--- New features
@@ -1,97 +1,188 @@
 #include <inttypes.h>
+#include <stddef.h>
+#include "eg_bc.h"
 #include "eg_error.h"
 #include "eg_device.h"
+#include "eg_format.h"
+#include "eg_mip.h"
+#include "eg_normal.h"
 #include "eg_rt.h"
 
-void texture2DFromData(SEGTexture2D *pOut, const uint8_t* pData, UINT w, UINT h, BOOL bGenerateMipMaps)
+static uint32_t getBCFormat(const uint8_t *pData, UINT w, UINT h, EGFormat dataFormat, EG_TEXTURE_FLAGS flags)
 {
-    HRESULT result;
+    if (flags & (EG_NORMAL_MAP | EG_GENERATE_NORMAL_MAP))
+    {
+        // Occlusion lives in alpha, so it needs BC3
+        return (flags & EG_NORMAL_MAP_OCCLUSION) ? BC_FORMAT_BC3 : BC_FORMAT_BC5;
+    }
+    if ((dataFormat & 0x0f) == EG_R) return BC_FORMAT_BC4;
+    if ((dataFormat & 0x0f) == EG_RG) return BC_FORMAT_BC5;
+    for (UINT i = 0; i < w * h; ++i)
+    {
+        if (pData[i * 4 + 3] != 255) return BC_FORMAT_BC3;
+    }
+    return BC_FORMAT_BC1;
+}
+
+// pMipChain, if not NULL, already holds pData as its top level and is taken
+static void prepare(SEGTextureData *pOut, const uint8_t* pData, UINT w, UINT h, EGFormat dataFormat, EG_TEXTURE_FLAGS flags, float normalStrength, uint8_t *pMipChain)
+{
+    memset(pOut, 0, sizeof(SEGTextureData));
+    pOut->w = w;
+    pOut->h = h;
+    pOut->mipLevels = 1;
+    pOut->format = DXGI_FORMAT_R8G8B8A8_UNORM;
 
-    // Manually generate mip levels
-    BOOL allowMipMaps = TRUE;
-    UINT w2 = 1;
-    UINT h2 = 1;
-    while (w2 < (UINT)w) w2 *= 2;
-    if (w != w2) allowMipMaps = FALSE;
-    while (h2 < (UINT)h) h2 *= 2;
-    if (h != h2) allowMipMaps = FALSE;
-    uint8_t *pMipMaps = NULL;
-    int mipLevels = 1;
-    D3D11_SUBRESOURCE_DATA *mipsData = NULL;
-    allowMipMaps = allowMipMaps & bGenerateMipMaps;
-    if (allowMipMaps)
+    // The rest works on the generated normal map
+    if (flags & EG_GENERATE_NORMAL_MAP)
     {
-        UINT biggest = max(w2, h2);
-        UINT w2t = w2;
-        UINT h2t = h2;
-        UINT totalSize = w2t * h2t * 4;
-        while (!(w2t == 1 && h2t == 1))
+        pOut->pGenerated = (uint8_t *)malloc(w * h * 4);
+        generateNormalMap(pData, pOut->pGenerated, w, h, dataFormat & 0x0f, normalStrength,
+                          (flags & EG_NORMAL_MAP_OCCLUSION) ? NORMAL_OCCLUSION : 0);
+        pData = pOut->pGenerated;
+        flags &= ~EG_SRGB;
+    }
+
+    // Alpha in a normal map isn't coverage
+    int bPremultiply = (flags & EG_PRE_MULTIPLY) && !(flags & (EG_NORMAL_MAP | EG_GENERATE_NORMAL_MAP));
+
+    if (flags & EG_GENERATE_MIPMAPS)
+    {
+        uint32_t mipFlags = 0;
+        if (flags & EG_SRGB) mipFlags |= MIP_SRGB;
+        if (flags & EG_MIPMAP_KAISER) mipFlags |= MIP_KAISER;
+
+        // Premultiply while copying the top level, so the mips filter
+        // premultiplied colors and don't bleed transparent texels
+        pOut->mipLevels = getMipLevelCount(w, h);
+        if (pMipChain)
         {
-            ++mipLevels;
-            w2t /= 2;
-            if (w2t < 1) w2t = 1;
-            h2t /= 2;
-            if (h2t < 1) h2t = 1;
-            totalSize += w2t * h2t * 4;
+            pOut->pMipMaps = pMipChain;
+            if (bPremultiply) premultiplyAlpha(pMipChain, pMipChain, w * h, flags & EG_SRGB);
         }
-        pMipMaps = (uint8_t *)malloc(totalSize);
-        memcpy(pMipMaps, pData, w * h * 4);
-
-        mipsData = (D3D11_SUBRESOURCE_DATA *)malloc(sizeof(D3D11_SUBRESOURCE_DATA) * mipLevels);
-
-        w2t = w2;
-        h2t = h2;
-        totalSize = 0;
-        int mipTarget = mipLevels;
-        mipLevels = 0;
-        byte* prev;
-        byte* cur;
-        while (mipLevels != mipTarget)
+        else
         {
-            prev = pMipMaps + totalSize;
-            mipsData[mipLevels].pSysMem = prev;
-            mipsData[mipLevels].SysMemPitch = w2t * 4;
-            mipsData[mipLevels].SysMemSlicePitch = 0;
-            totalSize += w2t * h2t * 4;
-            cur = pMipMaps + totalSize;
-            w2t /= 2;
-            if (w2t < 1) w2t = 1;
-            h2t /= 2;
-            if (h2t < 1) h2t = 1;
-            ++mipLevels;
-            if (mipLevels == mipTarget) break;
-            int accum;
-
-            // Generate the mips
-            int multX = w2 / w2t;
-            int multY = h2 / h2t;
-            for (UINT y = 0; y < h2t; ++y)
-            {
-                for (UINT x = 0; x < w2t; ++x)
-                {
-                    for (UINT k = 0; k < 4; ++k)
-                    {
-                        accum = 0;
-                        accum += prev[(y * multY * w2 + x * multX) * 4 + k];
-                        accum += prev[(y * multY * w2 + (x + multX / 2) * multX) * 4 + k];
-                        accum += prev[((y + multY / 2) * multY * w2 + x * multX) * 4 + k];
-                        accum += prev[((y + multY / 2) * multY * w2 + (x + multX / 2) * multX) * 4 + k];
-                        cur[(y * w2t + x) * 4 + k] = accum / 4;
-                    }
-                }
-            }
+            pOut->pMipMaps = (uint8_t *)malloc(getMipChainSize(w, h, pOut->mipLevels));
+            if (bPremultiply) premultiplyAlpha(pData, pOut->pMipMaps, w * h, flags & EG_SRGB);
+            else memcpy(pOut->pMipMaps, pData, w * h * 4);
+        }
+        generateMipChain(pOut->pMipMaps, w, h, pOut->mipLevels, mipFlags);
+        pData = pOut->pMipMaps;
+    }
+    else if (bPremultiply)
+    {
+        pOut->pGenerated = (uint8_t *)malloc(w * h * 4);
+        premultiplyAlpha(pData, pOut->pGenerated, w * h, flags & EG_SRGB);
+        pData = pOut->pGenerated;
+    }
 
-            w2 = w2t;
-            h2 = h2t;
+    // Block compression needs the top level to be made of whole blocks
+    uint32_t bcFormat = 0;
+    uint32_t bcQuality = BC_QUALITY_NORMAL;
+    UINT compressedOffset = 0;
+    if ((flags & EG_COMPRESS) && w % 4 == 0 && h % 4 == 0)
+    {
+        bcFormat = getBCFormat(pData, w, h, dataFormat, flags);
+        if (flags & EG_COMPRESS_FAST) bcQuality = BC_QUALITY_FAST;
+        else if (flags & EG_COMPRESS_HIGH_QUALITY) bcQuality = BC_QUALITY_HIGH;
+
+        UINT compressedSize = 0;
+        UINT mipW = w;
+        UINT mipH = h;
+        for (UINT i = 0; i < pOut->mipLevels; ++i)
+        {
+            compressedSize += getBCSize(bcFormat, mipW, mipH);
+            mipW = max(1, mipW / 2);
+            mipH = max(1, mipH / 2);
+        }
+        pOut->pCompressed = (uint8_t *)malloc(compressedSize);
+        switch (bcFormat)
+        {
+            case BC_FORMAT_BC1: pOut->format = DXGI_FORMAT_BC1_UNORM; break;
+            case BC_FORMAT_BC3: pOut->format = DXGI_FORMAT_BC3_UNORM; break;
+            case BC_FORMAT_BC4: pOut->format = DXGI_FORMAT_BC4_UNORM; break;
+            case BC_FORMAT_BC5: pOut->format = DXGI_FORMAT_BC5_UNORM; break;
         }
     }
 
+    pOut->mipsData = (D3D11_SUBRESOURCE_DATA *)malloc(sizeof(D3D11_SUBRESOURCE_DATA) * pOut->mipLevels);
+    const uint8_t *pLevel = (pOut->pMipMaps) ? pOut->pMipMaps : pData;
+    UINT mipW = w;
+    UINT mipH = h;
+    for (UINT i = 0; i < pOut->mipLevels; ++i)
+    {
+        if (pOut->pCompressed)
+        {
+            uint8_t *pBlocks = pOut->pCompressed + compressedOffset;
+            compressBC(pLevel, mipW, mipH, pBlocks, bcFormat, bcQuality);
+            pOut->mipsData[i].pSysMem = pBlocks;
+            pOut->mipsData[i].SysMemPitch = getBCPitch(bcFormat, mipW);
+            compressedOffset += getBCSize(bcFormat, mipW, mipH);
+        }
+        else
+        {
+            pOut->mipsData[i].pSysMem = pLevel;
+            pOut->mipsData[i].SysMemPitch = mipW * 4;
+        }
+        pOut->mipsData[i].SysMemSlicePitch = 0;
+        pLevel += mipW * mipH * 4;
+        mipW = max(1, mipW / 2);
+        mipH = max(1, mipH / 2);
+    }
+}
+
+void prepareTextureData(SEGTextureData *pOut, const uint8_t* pData, UINT w, UINT h, EGFormat dataFormat, EG_TEXTURE_FLAGS flags, float normalStrength)
+{
+    prepare(pOut, pData, w, h, dataFormat, flags, normalStrength, NULL);
+}
+
+// The mips can be generated right where the pixels were decoded
+static int isMipChainInPlace(EG_TEXTURE_FLAGS flags)
+{
+    return (flags & EG_GENERATE_MIPMAPS) && !(flags & EG_GENERATE_NORMAL_MAP);
+}
+
+uint8_t *allocateTexturePixels(UINT w, UINT h, EG_TEXTURE_FLAGS flags)
+{
+    if (isMipChainInPlace(flags)) return (uint8_t *)malloc(getMipChainSize(w, h, getMipLevelCount(w, h)));
+    return (uint8_t *)malloc(w * h * 4);
+}
+
+void prepareTexturePixels(SEGTextureData *pOut, uint8_t *pPixels, UINT w, UINT h, EG_TEXTURE_FLAGS flags, float normalStrength)
+{
+    if (isMipChainInPlace(flags))
+    {
+        prepare(pOut, pPixels, w, h, EG_U8 | EG_RGBA, flags, normalStrength, pPixels);
+        return;
+    }
+    prepare(pOut, pPixels, w, h, EG_U8 | EG_RGBA, flags, normalStrength, NULL);
+
+    // Uncompressed levels point into the pixels, then they're kept like a
+    // generated top level
+    if (pOut->mipsData[0].pSysMem == pPixels) pOut->pGenerated = pPixels;
+    else free(pPixels);
+}
+
+void freeTextureData(SEGTextureData *pData)
+{
+    if (pData->pGenerated) free(pData->pGenerated);
+    if (pData->pMipMaps) free(pData->pMipMaps);
+    if (pData->pCompressed) free(pData->pCompressed);
+    if (pData->pMapped) unmapFile(pData->pMapped);
+    if (pData->mipsData) free(pData->mipsData);
+    memset(pData, 0, sizeof(SEGTextureData));
+}
+
+void uploadTextureData(SEGTexture2D *pOut, const SEGTextureData *pData)
+{
+    HRESULT result;
+
     D3D11_TEXTURE2D_DESC desc;
-    desc.Width = w;
-    desc.Height = h;
-    desc.MipLevels = mipLevels;
+    desc.Width = pData->w;
+    desc.Height = pData->h;
+    desc.MipLevels = pData->mipLevels;
     desc.ArraySize = 1;
-    desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    desc.Format = pData->format;
     desc.SampleDesc.Count = 1;
     desc.SampleDesc.Quality = 0;
     desc.Usage = D3D11_USAGE_IMMUTABLE;
@@ -99,12 +190,7 @@ void texture2DFromData(SEGTexture2D *pOut, const uint8_t* pData, UINT w, UINT h,
     desc.CPUAccessFlags = 0;
     desc.MiscFlags = 0;
 
-    D3D11_SUBRESOURCE_DATA data;
-    data.pSysMem = (pMipMaps) ? pMipMaps : pData;
-    data.SysMemPitch = w * 4;
-    data.SysMemSlicePitch = 0;
-
-    result = pBoundDevice->pDevice->lpVtbl->CreateTexture2D(pBoundDevice->pDevice, &desc, (mipsData) ? mipsData : &data, &pOut->pTexture);
+    result = pBoundDevice->pDevice->lpVtbl->CreateTexture2D(pBoundDevice->pDevice, &desc, pData->mipsData, &pOut->pTexture);
     if (result != S_OK)
     {
         setError("Failed CreateTexture2D");
@@ -130,60 +216,151 @@ void texture2DFromData(SEGTexture2D *pOut, const uint8_t* pData, UINT w, UINT h,
     }
     pResource->lpVtbl->Release(pResource);
 
-    if (pMipMaps) free(pMipMaps);
-    if (mipsData) free(mipsData);
+    pOut->resident.category = RESIDENCY_TEXTURES;
+    pOut->resident.bytes = getTextureBytes(pData->format, pData->w, pData->h, pData->mipLevels);
 }
 
-EGTexture createTexture(SEGTexture2D *pTexture)
+void texture2DFromData(SEGTexture2D *pOut, const uint8_t* pData, UINT w, UINT h, EGFormat dataFormat, EG_TEXTURE_FLAGS flags)
 {
-    pBoundDevice->textures = realloc(pBoundDevice->textures, sizeof(SEGTexture2D) * (pBoundDevice->textureCount + 1));
-    memcpy(pBoundDevice->textures + pBoundDevice->textureCount, pTexture, sizeof(SEGTexture2D));
-    return ++pBoundDevice->textureCount;
+    SEGTextureData textureData;
+    prepareTextureData(&textureData, pData, w, h, dataFormat, flags, pBoundDevice->normalMapStrength);
+    uploadTextureData(pOut, &textureData);
+    freeTextureData(&textureData);
 }
 
-uint8_t colorFromDataFormat(EGFormat dataFormat, const void *pData, uint32_t pos)
+uint64_t getTextureBytes(DXGI_FORMAT format, UINT w, UINT h, UINT mipLevels)
 {
-    if (dataFormat & EG_U8)
-    {
-        return *((uint8_t *)pData + pos);
-    }
-    else if (dataFormat & EG_U16)
-    {
-        return (uint8_t)((*((uint16_t *)pData + pos) >> 8) & 0xffffffff);
-    }
-    else if (dataFormat & EG_U32)
-    {
-        return (uint8_t)((*((uint32_t *)pData + pos) >> 24) & 0xffffffff);
-    }
-    else if (dataFormat & EG_U64)
+    uint64_t bytes = 0;
+    for (UINT i = 0; i < mipLevels; ++i)
     {
-        return (uint8_t)((*((uint64_t *)pData + pos) >> 56) & 0xffffffff);
+        uint64_t blockCount = (uint64_t)((w + 3) / 4) * ((h + 3) / 4);
+        switch (format)
+        {
+            case DXGI_FORMAT_BC1_UNORM:
+            case DXGI_FORMAT_BC4_UNORM: bytes += blockCount * 8; break;
+            case DXGI_FORMAT_BC3_UNORM:
+            case DXGI_FORMAT_BC5_UNORM: bytes += blockCount * 16; break;
+            case DXGI_FORMAT_R16G16B16A16_FLOAT: bytes += (uint64_t)w * h * 8; break;
+            default: bytes += (uint64_t)w * h * 4; break;
+        }
+        w = max(1, w / 2);
+        h = max(1, h / 2);
     }
-    else if (dataFormat & EG_S8)
+    return bytes;
+}
+
+SEGTextureSource *createTextureSource(SEGTextureData *pData, const uint8_t *pPixels)
+{
+    SEGTextureSource *pSource = (SEGTextureSource *)calloc(1, sizeof(SEGTextureSource));
+    if (!pSource) return NULL;
+    SEGTextureData *pKept = &pSource->data;
+    memcpy(pKept, pData, sizeof(SEGTextureData));
+    memset(pData, 0, sizeof(SEGTextureData));
+
+    // Only keep the buffers the levels point into
+    if (pKept->pGenerated && (pKept->pCompressed || pKept->pMipMaps))
     {
-        return (uint8_t)(*((int8_t *)pData + pos)) + INT8_MAX + 1;
+        free(pKept->pGenerated);
+        pKept->pGenerated = NULL;
     }
-    else if (dataFormat & EG_S16)
+    if (pKept->pMipMaps && pKept->pCompressed)
     {
-        return (uint8_t)((((uint16_t)(*((int16_t *)pData + pos)) + INT16_MAX + 1) >> 8) & 0xffffffff);
+        free(pKept->pMipMaps);
+        pKept->pMipMaps = NULL;
     }
-    else if (dataFormat & EG_S32)
+    if (pKept->mipsData[0].pSysMem == pPixels)
     {
-        return (uint8_t)((((uint32_t)(*((int32_t *)pData + pos)) + INT32_MAX + 1) >> 24) & 0xffffffff);
+        pKept->pGenerated = (uint8_t *)malloc(pKept->w * pKept->h * 4);
+        if (!pKept->pGenerated)
+        {
+            freeTextureData(pKept);
+            free(pSource);
+            return NULL;
+        }
+        memcpy(pKept->pGenerated, pPixels, pKept->w * pKept->h * 4);
+        pKept->mipsData[0].pSysMem = pKept->pGenerated;
     }
-    else if (dataFormat & EG_S64)
+    return pSource;
+}
+
+void freeTextureSource(SEGTexture2D *pTexture)
+{
+    SEGTextureSource *pSource = pTexture->pSource;
+    if (!pSource) return;
+    freeTextureData(&pSource->data);
+    if (pSource->szFilename) free(pSource->szFilename);
+    free(pSource);
+    pTexture->pSource = NULL;
+}
+
+void trackTexture(SEGTexture2D *pTexture)
+{
+    if (!pTexture->pTexture) return; // Not uploaded yet
+    trackResident(&pBoundDevice->residency, &pTexture->resident, pTexture->pSource != NULL);
+    enforceTextureBudget();
+}
+
+void untrackTexture(SEGTexture2D *pTexture)
+{
+    untrackResident(&pBoundDevice->residency, &pTexture->resident);
+}
+
+void enforceTextureBudget()
+{
+    SEGResidency *pResidency = &pBoundDevice->residency;
+    SEGResident *pResident;
+    while ((pResident = getEvictionCandidate(pResidency)) != NULL)
     {
-        return (uint8_t)((((uint64_t)(*((int64_t *)pData + pos)) + INT64_MAX + 1) >> 56) & 0xffffffff);
+        // Only textures with a source are evictable
+        SEGTexture2D *pTexture = (SEGTexture2D *)((uint8_t *)pResident - offsetof(SEGTexture2D, resident));
+        untrackResident(pResidency, pResident);
+        destroyTexture(pTexture);
+        pTexture->pTexture = NULL;
+        pTexture->pResourceView = NULL;
+        pTexture->pSource->bEvicted = 1;
+        ++pResidency->evictionCount;
     }
-    else if (dataFormat & EG_F32)
+}
+
+SEGTexture2D *useTexture(EGTexture texture)
+{
+    SEGTexture2D *pTexture = poolGet(&pBoundDevice->textures, texture);
+    if (!pTexture) return NULL;
+
+    SEGTextureSource *pSource = pTexture->pSource;
+    if (pSource && pSource->bEvicted)
     {
-        return (uint8_t)((*((float *)pData + pos)) * 255.f);
+        pSource->bEvicted = 0;
+        ++pBoundDevice->residency.reloadCount;
+        if (pSource->szFilename)
+        {
+            // Binds the default maps until it's loaded again
+            reloadTextureFile(texture, pSource);
+        }
+        else
+        {
+            uploadTextureData(pTexture, &pSource->data);
+            trackTexture(pTexture);
+        }
     }
-    else if (dataFormat & EG_F64)
+    touchResident(&pBoundDevice->residency, &pTexture->resident);
+    return pTexture;
+}
+
+EGTexture createTexture(SEGTexture2D *pTexture)
+{
+    SEGTexture2D *pSlot;
+    EGTexture texture = poolAlloc(&pBoundDevice->textures, (void **)&pSlot);
+    if (!texture)
     {
-        return (uint8_t)((*((double *)pData + pos)) * 255.0);
+        destroyTexture(pTexture);
+        freeTextureSource(pTexture);
+        setError("Too many textures");
+        return 0;
     }
-    return 255;
+    memcpy(pSlot, pTexture, sizeof(SEGTexture2D));
+    trackTexture(pSlot);
+    return texture;
 }
 
 EGTexture egCreateTexture1D(uint32_t dimension, const void *pData, EGFormat dataFormat)
@@ -214,42 +391,26 @@ EGTexture egCreateTexture2D(uint32_t width, uint32_t height, const void *pData,
         }
         else
         {
-            uint32_t size = width * height;
-            pConvertedData = (uint8_t *)malloc(size * 4);
-            for (uint32_t i = 0; i < size; ++i)
+            EGFormatConverter converter = getFormatConverter(dataFormat);
+            if (!converter)
             {
-                if (dataFormat & EG_R)
-                {
-                    pConvertedData[i * 4 + 0] = colorFromDataFormat(dataFormat, pData, i);
-                    pConvertedData[i * 4 + 1] = 0;
-                    pConvertedData[i * 4 + 2] = 0;
-                    pConvertedData[i * 4 + 3] = 255;
-                }
-                else if (dataFormat & EG_RG)
-                {
-                    pConvertedData[i * 4 + 0] = colorFromDataFormat(dataFormat, pData, i * 2 + 0);
-                    pConvertedData[i * 4 + 1] = colorFromDataFormat(dataFormat, pData, i * 2 + 1);
-                    pConvertedData[i * 4 + 2] = 0;
-                    pConvertedData[i * 4 + 3] = 255;
-                }
-                else if (dataFormat & EG_RGB)
-                {
-                    pConvertedData[i * 4 + 0] = colorFromDataFormat(dataFormat, pData, i * 3 + 0);
-                    pConvertedData[i * 4 + 1] = colorFromDataFormat(dataFormat, pData, i * 3 + 1);
-                    pConvertedData[i * 4 + 2] = colorFromDataFormat(dataFormat, pData, i * 3 + 2);
-                    pConvertedData[i * 4 + 3] = 255;
-                }
-                else if (dataFormat & EG_RGBA)
-                {
-                    pConvertedData[i * 4 + 0] = colorFromDataFormat(dataFormat, pData, i * 4 + 0);
-                    pConvertedData[i * 4 + 1] = colorFromDataFormat(dataFormat, pData, i * 4 + 1);
-                    pConvertedData[i * 4 + 2] = colorFromDataFormat(dataFormat, pData, i * 4 + 2);
-                    pConvertedData[i * 4 + 3] = colorFromDataFormat(dataFormat, pData, i * 4 + 3);
-                }
+                setError("Invalid data format");
+                return 0;
             }
+            pConvertedData = (uint8_t *)malloc(width * height * 4);
+            converter(pData, pConvertedData, width * height);
         }
 
-        texture2DFromData(&texture2D, pConvertedData, width, height, (flags & EG_GENERATE_MIPMAPS) ? TRUE : FALSE);
+        SEGTextureData textureData;
+        prepareTextureData(&textureData, pConvertedData, width, height, dataFormat, flags, pBoundDevice->normalMapStrength);
+        uploadTextureData(&texture2D, &textureData);
+
+        // Without a budget nothing gets evicted, so there is no need for a copy
+        if (texture2D.pTexture && pBoundDevice->residency.budget)
+        {
+            texture2D.pSource = createTextureSource(&textureData, pConvertedData);
+        }
+        freeTextureData(&textureData);
 
         if (dataFormat != (EG_U8 | EG_RGBA))
         {
@@ -261,6 +422,39 @@ EGTexture egCreateTexture2D(uint32_t width, uint32_t height, const void *pData,
     return createTexture(&texture2D);
 }
 
+void egSetNormalMapStrength(float strength)
+{
+    if (!pBoundDevice) return;
+    pBoundDevice->normalMapStrength = strength;
+}
+
+void egSetTextureBudget(uint64_t bytes)
+{
+    if (!pBoundDevice) return;
+    pBoundDevice->residency.budget = bytes;
+    enforceTextureBudget();
+}
+
+uint64_t egGetResidentBytes(EG_RESIDENCY category)
+{
+    if (!pBoundDevice) return 0;
+    if (category == EG_RESIDENCY_ALL) return getResidentBytes(&pBoundDevice->residency);
+    if ((uint32_t)category >= RESIDENCY_CATEGORY_COUNT) return 0;
+    return pBoundDevice->residency.bytes[category];
+}
+
+uint32_t egGetEvictionCount()
+{
+    if (!pBoundDevice) return 0;
+    return pBoundDevice->residency.evictionCount;
+}
+
+uint32_t egGetReloadCount()
+{
+    if (!pBoundDevice) return 0;
+    return pBoundDevice->residency.reloadCount;
+}
+
 EGTexture egCreateTexture3D(uint32_t width, uint32_t height, uint32_t depth, const void *pData, EGFormat dataFormat)
 {
     return 0;
@@ -273,4 +467,20 @@ EGTexture egCreateCubeMap(uint32_t dimension, const void *pData, EGFormat dataFo
 
 void egDestroyTexture(EGTexture *pTexture)
 {
+    if (!pBoundDevice) return;
+    if (!pTexture) return;
+
+    SEGTexture2D *pTexture2D = poolGet(&pBoundDevice->textures, *pTexture);
+    if (!pTexture2D) return;
+
+    // Don't leave a dangling render target bound
+    if (pTexture2D->pRenderTargetView && pBoundDevice->pRenderTargetView == pTexture2D->pRenderTargetView)
+    {
+        egBindRenderTarget(0);
+    }
+    untrackTexture(pTexture2D);
+    freeTextureSource(pTexture2D);
+    destroyTexture(pTexture2D);
+    poolFree(&pBoundDevice->textures, *pTexture);
+    *pTexture = 0;
 }
@@ -5,6 +5,34 @@
 
 #include <d3d11.h>
 #include "eg.h"
+#include "eg_file.h"
+#include "eg_residency.h"
+
+// Texture ready to be uploaded. mipsData can point into the source pixels,
+// so they must outlive it.
+typedef struct
+{
+    UINT                        w, h;
+    UINT                        mipLevels;
+    DXGI_FORMAT                 format;
+    D3D11_SUBRESOURCE_DATA     *mipsData;
+    uint8_t                    *pGenerated;
+    uint8_t                    *pMipMaps;
+    uint8_t                    *pCompressed;
+    SEGMappedFile              *pMapped;    // Levels point into a cache file
+} SEGTextureData;
+
+// What an evicted texture reloads from: its prepared data, or the file it
+// was loaded from.
+typedef struct
+{
+    SEGTextureData              data;
+    char                       *szFilename;
+    EG_TEXTURE_FLAGS            flags;
+    float                       normalStrength;
+    int                         bEvicted;
+    int                         bReloading;
+} SEGTextureSource;
 
 typedef struct
 {
@@ -12,9 +40,42 @@ typedef struct
     ID3D11ShaderResourceView   *pResourceView;
     uint32_t                    w, h;
     ID3D11RenderTargetView     *pRenderTargetView;
+    SEGTextureSource           *pSource;    // NULL if it can't be evicted
+    SEGResident                 resident;
 } SEGTexture2D;
 
 EGTexture createTexture(SEGTexture2D *pTexture);
-void texture2DFromData(SEGTexture2D *pOut, const uint8_t* pData, UINT w, UINT h, BOOL bGenerateMipMaps);
+
+// CPU side of texture creation: normal map generation, mips and
+// compression. Does not touch the device, so it can run on any thread.
+void prepareTextureData(SEGTextureData *pOut, const uint8_t* pData, UINT w, UINT h, EGFormat dataFormat, EG_TEXTURE_FLAGS flags, float normalStrength);
+
+// RGBA8 pixels for prepareTexturePixels. With mipmaps, this is room for the
+// whole chain, so decoders write the top level right into it.
+uint8_t *allocateTexturePixels(UINT w, UINT h, EG_TEXTURE_FLAGS flags);
+// Same as prepareTextureData, but takes the pixels from allocateTexturePixels
+// instead of copying them.
+void prepareTexturePixels(SEGTextureData *pOut, uint8_t *pPixels, UINT w, UINT h, EG_TEXTURE_FLAGS flags, float normalStrength);
+void freeTextureData(SEGTextureData *pData);
+void uploadTextureData(SEGTexture2D *pOut, const SEGTextureData *pData);
+void texture2DFromData(SEGTexture2D *pOut, const uint8_t* pData, UINT w, UINT h, EGFormat dataFormat, EG_TEXTURE_FLAGS flags);
+
+// Video memory used by a texture
+uint64_t getTextureBytes(DXGI_FORMAT format, UINT w, UINT h, UINT mipLevels);
+
+// Takes the prepared data, so it can be uploaded again after an eviction.
+// pPixels are the pixels it was prepared from.
+SEGTextureSource *createTextureSource(SEGTextureData *pData, const uint8_t *pPixels);
+void freeTextureSource(SEGTexture2D *pTexture);
+
+// Residency of textures in the pool. Tracking can evict other textures to
+// stay in the budget.
+void trackTexture(SEGTexture2D *pTexture);
+void untrackTexture(SEGTexture2D *pTexture);
+void enforceTextureBudget();
+
+// Texture to bind, reloaded first if it was evicted. NULL if the handle is
+// stale.
+SEGTexture2D *useTexture(EGTexture texture);
 
 #endif /* EG_TEXTURE_H_INCLUDED */
@@ -11,6 +11,12 @@ void egSwap()
     if (pBoundDevice->bIsInBatch) return;
     if (!pBoundDevice) return;
     pBoundDevice->pSwapChain->lpVtbl->Present(pBoundDevice->pSwapChain, 1, 0);
+    uploadLoadedTextures();
+
+    // Textures not used in the frame are now up for eviction
+    nextResidencyFrame(&pBoundDevice->residency);
+    enforceTextureBudget();
+
     pBoundDevice->worldMatricesStackCount = 0;
     pBoundDevice->statesStackCount = 0;
     pBoundDevice->postProcessCount = 0;
@@ -155,6 +161,12 @@ void egGetProjection(float *pProjection)
     memcpy(pProjection, pBoundDevice->projectionMatrix.m, sizeof(float) * 16);
 }
 
+void egGetViewProj(float *pViewProj)
+{
+    if (!pBoundDevice) return;
+    memcpy(pViewProj, pBoundDevice->viewProjMatrix.m, sizeof(float) * 16);
+}
+
 void egGetModel(float *pModel)
 {
     if (!pBoundDevice) return;
@@ -288,8 +300,10 @@ void egBindDiffuse(EGTexture texture)
         pBoundDevice->pDeviceContext->lpVtbl->PSSetShaderResources(pBoundDevice->pDeviceContext, 0, 1, &pBoundDevice->pDefaultTextureMaps[DIFFUSE_MAP].pResourceView);
         return;
     }
-    if (texture > pBoundDevice->textureCount) return;
-    pBoundDevice->pDeviceContext->lpVtbl->PSSetShaderResources(pBoundDevice->pDeviceContext, 0, 1, &pBoundDevice->textures[texture - 1].pResourceView);
+    SEGTexture2D *pTexture = useTexture(texture);
+    if (!pTexture) return;
+    if (!pTexture->pResourceView) pTexture = &pBoundDevice->pDefaultTextureMaps[DIFFUSE_MAP]; // Still loading
+    pBoundDevice->pDeviceContext->lpVtbl->PSSetShaderResources(pBoundDevice->pDeviceContext, 0, 1, &pTexture->pResourceView);
 }
 
 void egBindNormal(EGTexture texture)
@@ -300,8 +314,10 @@ void egBindNormal(EGTexture texture)
         pBoundDevice->pDeviceContext->lpVtbl->PSSetShaderResources(pBoundDevice->pDeviceContext, 1, 1, &pBoundDevice->pDefaultTextureMaps[NORMAL_MAP].pResourceView);
         return;
     }
-    if (texture > pBoundDevice->textureCount) return;
-    pBoundDevice->pDeviceContext->lpVtbl->PSSetShaderResources(pBoundDevice->pDeviceContext, 1, 1, &pBoundDevice->textures[texture - 1].pResourceView);
+    SEGTexture2D *pTexture = useTexture(texture);
+    if (!pTexture) return;
+    if (!pTexture->pResourceView) pTexture = &pBoundDevice->pDefaultTextureMaps[NORMAL_MAP]; // Still loading
+    pBoundDevice->pDeviceContext->lpVtbl->PSSetShaderResources(pBoundDevice->pDeviceContext, 1, 1, &pTexture->pResourceView);
 }
 
 void egBindMaterial(EGTexture texture)
@@ -312,8 +328,10 @@ void egBindMaterial(EGTexture texture)
         pBoundDevice->pDeviceContext->lpVtbl->PSSetShaderResources(pBoundDevice->pDeviceContext, 2, 1, &pBoundDevice->pDefaultTextureMaps[MATERIAL_MAP].pResourceView);
         return;
     }
-    if (texture > pBoundDevice->textureCount) return;
-    pBoundDevice->pDeviceContext->lpVtbl->PSSetShaderResources(pBoundDevice->pDeviceContext, 2, 1, &pBoundDevice->textures[texture - 1].pResourceView);
+    SEGTexture2D *pTexture = useTexture(texture);
+    if (!pTexture) return;
+    if (!pTexture->pResourceView) pTexture = &pBoundDevice->pDefaultTextureMaps[MATERIAL_MAP]; // Still loading
+    pBoundDevice->pDeviceContext->lpVtbl->PSSetShaderResources(pBoundDevice->pDeviceContext, 2, 1, &pTexture->pResourceView);
 }
 
 void egBindRenderTarget(EGTexture texture)
@@ -329,10 +347,13 @@ void egBindRenderTarget(EGTexture texture)
     }
     else
     {
+        SEGTexture2D *pTexture = poolGet(&pBoundDevice->textures, texture);
+        if (!pTexture) return;
+        if (!pTexture->pRenderTargetView) return;
         if (!pBoundDevice->pOldRenderTargetView)
         {
             pBoundDevice->pOldRenderTargetView = pBoundDevice->pRenderTargetView;
         }
-        pBoundDevice->pRenderTargetView = pBoundDevice->textures[texture - 1].pRenderTargetView;
+        pBoundDevice->pRenderTargetView = pTexture->pRenderTargetView;
     }
 }
@@ -0,0 +1,473 @@
+#include <emmintrin.h>
+#include <math.h>
+#include <string.h>
+#include "eg_bc.h"
+#include "eg_thread.h"
+
+#define PARALLEL_MIN_BLOCK_ROWS 4
+#define REFINE_ITERATIONS_NORMAL 1
+#define REFINE_ITERATIONS_HIGH 4
+
+typedef struct
+{
+    const uint8_t  *pRGBA;
+    uint32_t        w, h;
+    uint8_t        *pOut;
+    uint32_t        bcFormat;
+    uint32_t        quality;
+} SEGBCJob;
+
+// 4x4 pixels, one array per channel
+typedef struct
+{
+    float   r[16];
+    float   g[16];
+    float   b[16];
+    float   a[16];
+} SEGBCBlock;
+
+uint32_t getBCBlockSize(uint32_t bcFormat)
+{
+    return (bcFormat == BC_FORMAT_BC1 || bcFormat == BC_FORMAT_BC4) ? 8 : 16;
+}
+
+uint32_t getBCPitch(uint32_t bcFormat, uint32_t w)
+{
+    return ((w + 3) / 4) * getBCBlockSize(bcFormat);
+}
+
+uint32_t getBCSize(uint32_t bcFormat, uint32_t w, uint32_t h)
+{
+    return getBCPitch(bcFormat, w) * ((h + 3) / 4);
+}
+
+static void readBlock(const SEGBCJob *pJob, uint32_t bx, uint32_t by, SEGBCBlock *pBlock)
+{
+    for (uint32_t y = 0; y < 4; ++y)
+    {
+        uint32_t py = by * 4 + y;
+        if (py >= pJob->h) py = pJob->h - 1;
+        for (uint32_t x = 0; x < 4; ++x)
+        {
+            uint32_t px = bx * 4 + x;
+            const uint8_t *pPixel;
+            if (px >= pJob->w) px = pJob->w - 1;
+            pPixel = pJob->pRGBA + (py * pJob->w + px) * 4;
+            pBlock->r[y * 4 + x] = (float)pPixel[0];
+            pBlock->g[y * 4 + x] = (float)pPixel[1];
+            pBlock->b[y * 4 + x] = (float)pPixel[2];
+            pBlock->a[y * 4 + x] = (float)pPixel[3];
+        }
+    }
+}
+
+//--- BC1 color block ---
+
+static uint16_t packRGB565(const float *pColor)
+{
+    int r = (int)(pColor[0] * 31.f / 255.f + .5f);
+    int g = (int)(pColor[1] * 63.f / 255.f + .5f);
+    int b = (int)(pColor[2] * 31.f / 255.f + .5f);
+    r = r < 0 ? 0 : (r > 31 ? 31 : r);
+    g = g < 0 ? 0 : (g > 63 ? 63 : g);
+    b = b < 0 ? 0 : (b > 31 ? 31 : b);
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static void unpackRGB565(uint16_t color, float *pColor)
+{
+    int r = (color >> 11) & 31;
+    int g = (color >> 5) & 63;
+    int b = color & 31;
+    pColor[0] = (float)((r << 3) | (r >> 2));
+    pColor[1] = (float)((g << 2) | (g >> 4));
+    pColor[2] = (float)((b << 3) | (b >> 2));
+}
+
+// Pick the closest of the 4 palette colors for each pixel. Returns the error
+static float fitColorIndices(const SEGBCBlock *pBlock, const float palette[4][3], uint32_t *pIndices)
+{
+    __m128 totalError = _mm_setzero_ps();
+    float errors[4];
+    *pIndices = 0;
+    for (int i = 0; i < 16; i += 4)
+    {
+        __m128 r = _mm_loadu_ps(pBlock->r + i);
+        __m128 g = _mm_loadu_ps(pBlock->g + i);
+        __m128 b = _mm_loadu_ps(pBlock->b + i);
+        __m128 best = _mm_set1_ps(1e30f);
+        __m128i bestIndex = _mm_setzero_si128();
+        int32_t indices[4];
+        for (int k = 0; k < 4; ++k)
+        {
+            __m128 dr = _mm_sub_ps(r, _mm_set1_ps(palette[k][0]));
+            __m128 dg = _mm_sub_ps(g, _mm_set1_ps(palette[k][1]));
+            __m128 db = _mm_sub_ps(b, _mm_set1_ps(palette[k][2]));
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)), _mm_mul_ps(db, db));
+            __m128i closer = _mm_castps_si128(_mm_cmplt_ps(d, best));
+            best = _mm_min_ps(d, best);
+            bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(k)), _mm_andnot_si128(closer, bestIndex));
+        }
+        totalError = _mm_add_ps(totalError, best);
+        _mm_storeu_si128((__m128i *)indices, bestIndex);
+        for (int j = 0; j < 4; ++j) *pIndices |= (uint32_t)indices[j] << ((i + j) * 2);
+    }
+    _mm_storeu_ps(errors, totalError);
+    return errors[0] + errors[1] + errors[2] + errors[3];
+}
+
+static float quantizeColorEndpoints(const SEGBCBlock *pBlock, const float *pMax, const float *pMin,
+                                    uint16_t *pColor0, uint16_t *pColor1, uint32_t *pIndices)
+{
+    float palette[4][3];
+    *pColor0 = packRGB565(pMax);
+    *pColor1 = packRGB565(pMin);
+    unpackRGB565(*pColor0, palette[0]);
+    unpackRGB565(*pColor1, palette[1]);
+    for (int c = 0; c < 3; ++c)
+    {
+        palette[2][c] = (palette[0][c] * 2 + palette[1][c]) / 3.f;
+        palette[3][c] = (palette[0][c] + palette[1][c] * 2) / 3.f;
+    }
+    return fitColorIndices(pBlock, palette, pIndices);
+}
+
+static void boundingBoxEndpoints(const SEGBCBlock *pBlock, float *pMax, float *pMin)
+{
+    pMin[0] = pMin[1] = pMin[2] = 255;
+    pMax[0] = pMax[1] = pMax[2] = 0;
+    for (int i = 0; i < 16; ++i)
+    {
+        if (pBlock->r[i] < pMin[0]) pMin[0] = pBlock->r[i];
+        if (pBlock->g[i] < pMin[1]) pMin[1] = pBlock->g[i];
+        if (pBlock->b[i] < pMin[2]) pMin[2] = pBlock->b[i];
+        if (pBlock->r[i] > pMax[0]) pMax[0] = pBlock->r[i];
+        if (pBlock->g[i] > pMax[1]) pMax[1] = pBlock->g[i];
+        if (pBlock->b[i] > pMax[2]) pMax[2] = pBlock->b[i];
+    }
+
+    // Inset, so the interpolated colors land closer to the pixels
+    for (int c = 0; c < 3; ++c)
+    {
+        float inset = (pMax[c] - pMin[c]) / 16.f;
+        pMax[c] -= inset;
+        pMin[c] += inset;
+    }
+}
+
+static void principalAxisEndpoints(const SEGBCBlock *pBlock, float *pMax, float *pMin)
+{
+    float mean[3] = {0, 0, 0};
+    float cov[6] = {0, 0, 0, 0, 0, 0};
+    float axis[3];
+    float minT = 1e30f, maxT = -1e30f;
+    float length;
+
+    for (int i = 0; i < 16; ++i)
+    {
+        mean[0] += pBlock->r[i];
+        mean[1] += pBlock->g[i];
+        mean[2] += pBlock->b[i];
+    }
+    mean[0] /= 16.f;
+    mean[1] /= 16.f;
+    mean[2] /= 16.f;
+    for (int i = 0; i < 16; ++i)
+    {
+        float r = pBlock->r[i] - mean[0];
+        float g = pBlock->g[i] - mean[1];
+        float b = pBlock->b[i] - mean[2];
+        cov[0] += r * r;
+        cov[1] += r * g;
+        cov[2] += r * b;
+        cov[3] += g * g;
+        cov[4] += g * b;
+        cov[5] += b * b;
+    }
+
+    // Power iteration, starting from the bounding box diagonal
+    boundingBoxEndpoints(pBlock, pMax, pMin);
+    axis[0] = pMax[0] - pMin[0];
+    axis[1] = pMax[1] - pMin[1];
+    axis[2] = pMax[2] - pMin[2];
+    for (int k = 0; k < 8; ++k)
+    {
+        float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+        float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+        float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+        float scale = fabsf(x) > fabsf(y) ? fabsf(x) : fabsf(y);
+        if (fabsf(z) > scale) scale = fabsf(z);
+        if (scale < 1e-8f) break;
+        axis[0] = x / scale;
+        axis[1] = y / scale;
+        axis[2] = z / scale;
+    }
+    length = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+    if (length < 1e-8f) return; // Flat block, keep the bounding box
+    length = 1.f / sqrtf(length);
+    axis[0] *= length;
+    axis[1] *= length;
+    axis[2] *= length;
+
+    for (int i = 0; i < 16; ++i)
+    {
+        float t = (pBlock->r[i] - mean[0]) * axis[0] +
+                  (pBlock->g[i] - mean[1]) * axis[1] +
+                  (pBlock->b[i] - mean[2]) * axis[2];
+        if (t < minT) minT = t;
+        if (t > maxT) maxT = t;
+    }
+    for (int c = 0; c < 3; ++c)
+    {
+        pMax[c] = mean[c] + axis[c] * maxT;
+        pMin[c] = mean[c] + axis[c] * minT;
+        pMax[c] = pMax[c] < 0 ? 0 : (pMax[c] > 255 ? 255 : pMax[c]);
+        pMin[c] = pMin[c] < 0 ? 0 : (pMin[c] > 255 ? 255 : pMin[c]);
+    }
+}
+
+// Solve the endpoints that best fit the current indices
+static int refineColorEndpoints(const SEGBCBlock *pBlock, uint32_t indices, float *pMax, float *pMin)
+{
+    static const float weights[4] = {1.f, 0.f, 2.f / 3.f, 1.f / 3.f};
+    float aa = 0, ab = 0, bb = 0;
+    float ax[3] = {0, 0, 0};
+    float bx[3] = {0, 0, 0};
+    float det;
+
+    for (int i = 0; i < 16; ++i)
+    {
+        float a = weights[(indices >> (i * 2)) & 3];
+        float b = 1 - a;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        ax[0] += a * pBlock->r[i];
+        ax[1] += a * pBlock->g[i];
+        ax[2] += a * pBlock->b[i];
+        bx[0] += b * pBlock->r[i];
+        bx[1] += b * pBlock->g[i];
+        bx[2] += b * pBlock->b[i];
+    }
+    det = aa * bb - ab * ab;
+    if (fabsf(det) < 1e-6f) return 0;
+    det = 1.f / det;
+    for (int c = 0; c < 3; ++c)
+    {
+        pMax[c] = (ax[c] * bb - bx[c] * ab) * det;
+        pMin[c] = (bx[c] * aa - ax[c] * ab) * det;
+        pMax[c] = pMax[c] < 0 ? 0 : (pMax[c] > 255 ? 255 : pMax[c]);
+        pMin[c] = pMin[c] < 0 ? 0 : (pMin[c] > 255 ? 255 : pMin[c]);
+    }
+    return 1;
+}
+
+static void compressColorBlock(const SEGBCBlock *pBlock, uint32_t quality, uint8_t *pOut)
+{
+    float colorMax[3], colorMin[3];
+    uint16_t color0, color1;
+    uint32_t indices;
+    float error;
+
+    boundingBoxEndpoints(pBlock, colorMax, colorMin);
+    error = quantizeColorEndpoints(pBlock, colorMax, colorMin, &color0, &color1, &indices);
+
+    // Keep the principal axis only if it does better than the box
+    if (quality != BC_QUALITY_FAST && error > 0)
+    {
+        float axisMax[3], axisMin[3];
+        uint16_t axisColor0, axisColor1;
+        uint32_t axisIndices;
+        float axisError;
+        principalAxisEndpoints(pBlock, axisMax, axisMin);
+        axisError = quantizeColorEndpoints(pBlock, axisMax, axisMin, &axisColor0, &axisColor1, &axisIndices);
+        if (axisError < error)
+        {
+            memcpy(colorMax, axisMax, sizeof(axisMax));
+            memcpy(colorMin, axisMin, sizeof(axisMin));
+            color0 = axisColor0;
+            color1 = axisColor1;
+            indices = axisIndices;
+            error = axisError;
+        }
+    }
+
+    if (quality != BC_QUALITY_FAST)
+    {
+        int iterations = (quality == BC_QUALITY_HIGH) ? REFINE_ITERATIONS_HIGH : REFINE_ITERATIONS_NORMAL;
+        for (int k = 0; k < iterations && error > 0; ++k)
+        {
+            uint16_t newColor0, newColor1;
+            uint32_t newIndices;
+            float newError;
+            if (!refineColorEndpoints(pBlock, indices, colorMax, colorMin)) break;
+            newError = quantizeColorEndpoints(pBlock, colorMax, colorMin, &newColor0, &newColor1, &newIndices);
+            if (newError >= error) break;
+            error = newError;
+            color0 = newColor0;
+            color1 = newColor1;
+            indices = newIndices;
+        }
+    }
+
+    // color0 > color1 selects the 4 color mode. Swap the ends if needed
+    if (color0 < color1)
+    {
+        uint16_t temp = color0;
+        color0 = color1;
+        color1 = temp;
+        indices ^= 0x55555555;
+    }
+    else if (color0 == color1)
+    {
+        indices = 0;
+    }
+
+    pOut[0] = (uint8_t)(color0 & 0xff);
+    pOut[1] = (uint8_t)(color0 >> 8);
+    pOut[2] = (uint8_t)(color1 & 0xff);
+    pOut[3] = (uint8_t)(color1 >> 8);
+    memcpy(pOut + 4, &indices, 4);
+}
+
+//--- BC4 single channel block ---
+
+// Closest of the 8 values for each pixel. Returns the error
+static float fitAlphaIndices(const float *pValues, int value0, int value1, uint64_t *pIndices)
+{
+    float range = (float)(value0 - value1);
+    __m128 scale = _mm_set1_ps(range > 0 ? 7.f / range : 0);
+    __m128 offset = _mm_set1_ps((float)value1);
+    __m128 seven = _mm_set1_ps(7.f);
+    float error = 0;
+    *pIndices = 0;
+
+    for (int i = 0; i < 16; i += 4)
+    {
+        int32_t steps[4];
+        __m128 t = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(pValues + i), offset), scale);
+        t = _mm_min_ps(_mm_max_ps(t, _mm_setzero_ps()), seven);
+        _mm_storeu_si128((__m128i *)steps, _mm_cvtps_epi32(t));
+        for (int j = 0; j < 4; ++j)
+        {
+            // steps is 0 at value1 and 7 at value0
+            int step = steps[j];
+            uint64_t index = (step == 7) ? 0 : ((step == 0) ? 1 : (uint64_t)(8 - step));
+            float decoded = (float)(step * value0 + (7 - step) * value1) / 7.f;
+            float d = decoded - pValues[i + j];
+            error += d * d;
+            *pIndices |= index << ((i + j) * 3);
+        }
+    }
+    return error;
+}
+
+static void compressAlphaBlock(const float *pValues, uint32_t quality, uint8_t *pOut)
+{
+    float minValue = 255, maxValue = 0;
+    int value0, value1;
+    uint64_t indices;
+    float error;
+
+    for (int i = 0; i < 16; ++i)
+    {
+        if (pValues[i] < minValue) minValue = pValues[i];
+        if (pValues[i] > maxValue) maxValue = pValues[i];
+    }
+    value0 = (int)maxValue;
+    value1 = (int)minValue;
+    error = fitAlphaIndices(pValues, value0, value1, &indices);
+
+    // Least squares on the endpoints, for the current steps
+    if (quality != BC_QUALITY_FAST)
+    {
+        int iterations = (quality == BC_QUALITY_HIGH) ? REFINE_ITERATIONS_HIGH : REFINE_ITERATIONS_NORMAL;
+        for (int k = 0; k < iterations && error > 0; ++k)
+        {
+            float aa = 0, ab = 0, bb = 0, ax = 0, bx = 0, det;
+            int newValue0, newValue1;
+            uint64_t newIndices;
+            float newError;
+            for (int i = 0; i < 16; ++i)
+            {
+                uint32_t index = (uint32_t)(indices >> (i * 3)) & 7;
+                float a = (index == 0) ? 1.f : ((index == 1) ? 0.f : (float)(8 - index) / 7.f);
+                float b = 1 - a;
+                aa += a * a;
+                ab += a * b;
+                bb += b * b;
+                ax += a * pValues[i];
+                bx += b * pValues[i];
+            }
+            det = aa * bb - ab * ab;
+            if (fabsf(det) < 1e-6f) break;
+            newValue0 = (int)((ax * bb - bx * ab) / det + .5f);
+            newValue1 = (int)((bx * aa - ax * ab) / det + .5f);
+            newValue0 = newValue0 < 0 ? 0 : (newValue0 > 255 ? 255 : newValue0);
+            newValue1 = newValue1 < 0 ? 0 : (newValue1 > 255 ? 255 : newValue1);
+            if (newValue0 <= newValue1) break;
+            newError = fitAlphaIndices(pValues, newValue0, newValue1, &newIndices);
+            if (newError >= error) break;
+            error = newError;
+            value0 = newValue0;
+            value1 = newValue1;
+            indices = newIndices;
+        }
+    }
+
+    // value0 == value1 would select the 6 value mode, where index 0 is still value0
+    if (value0 == value1) indices = 0;
+
+    pOut[0] = (uint8_t)value0;
+    pOut[1] = (uint8_t)value1;
+    for (int i = 0; i < 6; ++i)
+    {
+        pOut[2 + i] = (uint8_t)(indices >> (i * 8));
+    }
+}
+
+static void compressRows(void *pData, uint32_t begin, uint32_t end)
+{
+    SEGBCJob *pJob = (SEGBCJob *)pData;
+    uint32_t blockSize = getBCBlockSize(pJob->bcFormat);
+    uint32_t blocksW = (pJob->w + 3) / 4;
+    SEGBCBlock block;
+
+    for (uint32_t by = begin; by < end; ++by)
+    {
+        uint8_t *pOut = pJob->pOut + by * blocksW * blockSize;
+        for (uint32_t bx = 0; bx < blocksW; ++bx, pOut += blockSize)
+        {
+            readBlock(pJob, bx, by, &block);
+            switch (pJob->bcFormat)
+            {
+                case BC_FORMAT_BC1:
+                    compressColorBlock(&block, pJob->quality, pOut);
+                    break;
+                case BC_FORMAT_BC3:
+                    compressAlphaBlock(block.a, pJob->quality, pOut);
+                    compressColorBlock(&block, pJob->quality, pOut + 8);
+                    break;
+                case BC_FORMAT_BC4:
+                    compressAlphaBlock(block.r, pJob->quality, pOut);
+                    break;
+                case BC_FORMAT_BC5:
+                    compressAlphaBlock(block.r, pJob->quality, pOut);
+                    compressAlphaBlock(block.g, pJob->quality, pOut + 8);
+                    break;
+            }
+        }
+    }
+}
+
+void compressBC(const uint8_t *pRGBA, uint32_t w, uint32_t h, uint8_t *pOut, uint32_t bcFormat, uint32_t quality)
+{
+    SEGBCJob job;
+    job.pRGBA = pRGBA;
+    job.w = w;
+    job.h = h;
+    job.pOut = pOut;
+    job.bcFormat = bcFormat;
+    job.quality = quality;
+    parallelFor((h + 3) / 4, PARALLEL_MIN_BLOCK_ROWS, compressRows, &job);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#ifndef EG_BC_H_INCLUDED
+#define EG_BC_H_INCLUDED
+
+#include <inttypes.h>
+
+// Block compression formats
+#define BC_FORMAT_BC1   1 // RGB, 8 bytes per block
+#define BC_FORMAT_BC3   3 // RGB + alpha, 16 bytes per block
+#define BC_FORMAT_BC4   4 // R, 8 bytes per block
+#define BC_FORMAT_BC5   5 // RG, 16 bytes per block
+
+// Encoder quality
+#define BC_QUALITY_FAST     0 // Bounding box endpoints
+#define BC_QUALITY_NORMAL   1 // Best of bounding box and principal axis
+#define BC_QUALITY_HIGH     2 // Normal, then refined with least squares
+
+uint32_t getBCBlockSize(uint32_t bcFormat);
+uint32_t getBCPitch(uint32_t bcFormat, uint32_t w);
+uint32_t getBCSize(uint32_t bcFormat, uint32_t w, uint32_t h);
+
+// Compress a RGBA8 image. Sizes don't need to be multiple of 4, edge pixels
+// are repeated to fill the blocks.
+void compressBC(const uint8_t *pRGBA, uint32_t w, uint32_t h, uint8_t *pOut, uint32_t bcFormat, uint32_t quality);
+
+#endif /* EG_BC_H_INCLUDED */
@@ -0,0 +1,217 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "eg_cache.h"
+
+#define CACHE_MAGIC     0x31544745 // "EGT1"
+#define CACHE_VERSION   1
+#define CACHE_ALIGNMENT 16
+
+typedef struct
+{
+    uint32_t    magic;
+    uint32_t    version;
+    uint64_t    sourceHash;
+    uint32_t    flags;
+    float       normalStrength;
+    uint32_t    w, h;
+    uint32_t    format;
+    uint32_t    mipLevels;
+} SEGCacheHeader;
+
+typedef struct
+{
+    uint64_t    offset;
+    uint32_t    size;
+    uint32_t    pitch;
+} SEGCacheLevel;
+
+#define PRIME64_1   0x9E3779B185EBCA87ULL
+#define PRIME64_2   0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3   0x165667B19E3779F9ULL
+#define PRIME64_4   0x85EBCA77C2B2AE63ULL
+#define PRIME64_5   0x27D4EB2F165667C5ULL
+
+#define ROTL64(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+static uint64_t read64(const uint8_t *p)
+{
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static uint32_t read32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static uint64_t hashRound(uint64_t acc, uint64_t input)
+{
+    acc += input * PRIME64_2;
+    acc = ROTL64(acc, 31);
+    return acc * PRIME64_1;
+}
+
+static uint64_t hashMerge(uint64_t acc, uint64_t value)
+{
+    acc ^= hashRound(0, value);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+uint64_t hashData(const void *pData, size_t size)
+{
+    const uint8_t *p = (const uint8_t *)pData;
+    const uint8_t *pEnd = p + size;
+    uint64_t h;
+
+    if (size >= 32)
+    {
+        // 4 independent lanes
+        uint64_t v1 = PRIME64_1 + PRIME64_2;
+        uint64_t v2 = PRIME64_2;
+        uint64_t v3 = 0;
+        uint64_t v4 = 0 - PRIME64_1;
+        const uint8_t *pLimit = pEnd - 32;
+        do
+        {
+            v1 = hashRound(v1, read64(p));
+            v2 = hashRound(v2, read64(p + 8));
+            v3 = hashRound(v3, read64(p + 16));
+            v4 = hashRound(v4, read64(p + 24));
+            p += 32;
+        } while (p <= pLimit);
+
+        h = ROTL64(v1, 1) + ROTL64(v2, 7) + ROTL64(v3, 12) + ROTL64(v4, 18);
+        h = hashMerge(h, v1);
+        h = hashMerge(h, v2);
+        h = hashMerge(h, v3);
+        h = hashMerge(h, v4);
+    }
+    else
+    {
+        h = PRIME64_5;
+    }
+    h += (uint64_t)size;
+
+    for (; p + 8 <= pEnd; p += 8)
+    {
+        h ^= hashRound(0, read64(p));
+        h = ROTL64(h, 27) * PRIME64_1 + PRIME64_4;
+    }
+    if (p + 4 <= pEnd)
+    {
+        h ^= (uint64_t)read32(p) * PRIME64_1;
+        h = ROTL64(h, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+    for (; p < pEnd; ++p)
+    {
+        h ^= (*p) * PRIME64_5;
+        h = ROTL64(h, 11) * PRIME64_1;
+    }
+
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+int readTextureCache(const uint8_t *pFileData, uint64_t fileSize, SEGTextureCache *pCache)
+{
+    SEGCacheHeader header;
+    if (fileSize < sizeof(SEGCacheHeader)) return 0;
+    memcpy(&header, pFileData, sizeof(SEGCacheHeader));
+    if (header.magic != CACHE_MAGIC || header.version != CACHE_VERSION) return 0;
+    if (header.mipLevels < 1 || header.mipLevels > TEXTURE_CACHE_MAX_LEVELS) return 0;
+    if (fileSize < sizeof(SEGCacheHeader) + sizeof(SEGCacheLevel) * header.mipLevels) return 0;
+
+    memset(pCache, 0, sizeof(SEGTextureCache));
+    pCache->sourceHash = header.sourceHash;
+    pCache->flags = header.flags;
+    pCache->normalStrength = header.normalStrength;
+    pCache->w = header.w;
+    pCache->h = header.h;
+    pCache->format = header.format;
+    pCache->mipLevels = header.mipLevels;
+
+    for (uint32_t i = 0; i < header.mipLevels; ++i)
+    {
+        SEGCacheLevel level;
+        memcpy(&level, pFileData + sizeof(SEGCacheHeader) + sizeof(SEGCacheLevel) * i, sizeof(SEGCacheLevel));
+        if (level.offset > fileSize || level.size > fileSize - level.offset) return 0;
+        pCache->pLevels[i] = pFileData + level.offset;
+        pCache->sizes[i] = level.size;
+        pCache->pitches[i] = level.pitch;
+    }
+    return 1;
+}
+
+int writeTextureCache(const char *szFilename, const SEGTextureCache *pCache)
+{
+    static const uint8_t padding[CACHE_ALIGNMENT] = {0};
+    SEGCacheHeader header;
+    SEGCacheLevel levels[TEXTURE_CACHE_MAX_LEVELS];
+    FILE *pFile = NULL;
+    int bWritten = 1;
+
+    if (pCache->mipLevels < 1 || pCache->mipLevels > TEXTURE_CACHE_MAX_LEVELS) return 0;
+
+    memset(&header, 0, sizeof(SEGCacheHeader));
+    header.magic = CACHE_MAGIC;
+    header.version = CACHE_VERSION;
+    header.sourceHash = pCache->sourceHash;
+    header.flags = pCache->flags;
+    header.normalStrength = pCache->normalStrength;
+    header.w = pCache->w;
+    header.h = pCache->h;
+    header.format = pCache->format;
+    header.mipLevels = pCache->mipLevels;
+
+    uint64_t headerSize = sizeof(SEGCacheHeader) + sizeof(SEGCacheLevel) * pCache->mipLevels;
+    uint64_t offset = headerSize;
+    for (uint32_t i = 0; i < pCache->mipLevels; ++i)
+    {
+        offset = (offset + CACHE_ALIGNMENT - 1) & ~(uint64_t)(CACHE_ALIGNMENT - 1);
+        levels[i].offset = offset;
+        levels[i].size = pCache->sizes[i];
+        levels[i].pitch = pCache->pitches[i];
+        offset += pCache->sizes[i];
+    }
+
+    // Unique per call, two loads of the same image can write at once
+    size_t tempSize = strlen(szFilename) + 32;
+    char *szTempFilename = (char *)malloc(tempSize);
+    if (!szTempFilename) return 0;
+    snprintf(szTempFilename, tempSize, "%s.%p.tmp", szFilename, (const void *)pCache);
+
+    if (fopen_s(&pFile, szTempFilename, "wb") || !pFile)
+    {
+        free(szTempFilename);
+        return 0;
+    }
+    bWritten &= fwrite(&header, sizeof(SEGCacheHeader), 1, pFile) == 1;
+    bWritten &= fwrite(levels, sizeof(SEGCacheLevel), pCache->mipLevels, pFile) == pCache->mipLevels;
+    offset = headerSize;
+    for (uint32_t i = 0; i < pCache->mipLevels && bWritten; ++i)
+    {
+        if (levels[i].offset > offset) bWritten &= fwrite(padding, (size_t)(levels[i].offset - offset), 1, pFile) == 1;
+        bWritten &= fwrite(pCache->pLevels[i], pCache->sizes[i], 1, pFile) == 1;
+        offset = levels[i].offset + pCache->sizes[i];
+    }
+    bWritten &= fclose(pFile) == 0;
+
+    // rename doesn't replace an existing file on Windows
+    if (bWritten)
+    {
+        remove(szFilename);
+        bWritten = rename(szTempFilename, szFilename) == 0;
+    }
+    if (!bWritten) remove(szTempFilename);
+    free(szTempFilename);
+    return bWritten;
+}
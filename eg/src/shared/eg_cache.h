@@ -0,0 +1,40 @@
+#pragma once
+
+#ifndef EG_CACHE_H_INCLUDED
+#define EG_CACHE_H_INCLUDED
+
+#include <inttypes.h>
+#include <stddef.h>
+
+#define TEXTURE_CACHE_MAX_LEVELS    16
+
+// Preprocessed texture stored in a .egt file: a header, a level table,
+// then the levels ready to upload, 16 bytes aligned. Native byte order,
+// it's a local cache.
+typedef struct
+{
+    uint64_t        sourceHash;     // hashData of the source file
+    uint32_t        flags;          // Flags it was processed with
+    float           normalStrength;
+    uint32_t        w, h;
+    uint32_t        format;         // DXGI_FORMAT
+    uint32_t        mipLevels;
+    const uint8_t  *pLevels[TEXTURE_CACHE_MAX_LEVELS];
+    uint32_t        sizes[TEXTURE_CACHE_MAX_LEVELS];
+    uint32_t        pitches[TEXTURE_CACHE_MAX_LEVELS];
+} SEGTextureCache;
+
+// 64 bits content hash (xxHash64, seed 0)
+uint64_t hashData(const void *pData, size_t size);
+
+// Fills pCache from a .egt file in memory, the levels point into it.
+// Returns 0 if the file is not valid. Levels are only checked to lie within
+// the file: checking their sizes against the format, which is a graphics API
+// value, and matching the source are up to the caller.
+int readTextureCache(const uint8_t *pFileData, uint64_t fileSize, SEGTextureCache *pCache);
+
+// Writes to a temporary file first, so readers never see a partial file.
+// Returns 0 if failed.
+int writeTextureCache(const char *szFilename, const SEGTextureCache *pCache);
+
+#endif /* EG_CACHE_H_INCLUDED */
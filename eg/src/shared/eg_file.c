@@ -0,0 +1,99 @@
+#include <stdlib.h>
+#if defined(WIN32) || defined(_WIN32)
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "eg_file.h"
+
+struct SEGMappedFile
+{
+#if defined(WIN32) || defined(_WIN32)
+    HANDLE      hFile;
+    HANDLE      hMapping;
+#endif
+    void       *pData;
+    uint64_t    size;
+};
+
+#if defined(WIN32) || defined(_WIN32)
+SEGMappedFile *mapFile(const char *szFilename, const uint8_t **ppData, uint64_t *pSize)
+{
+    LARGE_INTEGER size;
+    HANDLE hFile = CreateFileA(szFilename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) return NULL;
+    if (!GetFileSizeEx(hFile, &size) || size.QuadPart <= 0)
+    {
+        CloseHandle(hFile);
+        return NULL;
+    }
+    HANDLE hMapping = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!hMapping)
+    {
+        CloseHandle(hFile);
+        return NULL;
+    }
+    void *pData = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+    SEGMappedFile *pFile = pData ? (SEGMappedFile *)malloc(sizeof(SEGMappedFile)) : NULL;
+    if (!pFile)
+    {
+        if (pData) UnmapViewOfFile(pData);
+        CloseHandle(hMapping);
+        CloseHandle(hFile);
+        return NULL;
+    }
+    pFile->hFile = hFile;
+    pFile->hMapping = hMapping;
+    pFile->pData = pData;
+    pFile->size = (uint64_t)size.QuadPart;
+    *ppData = (const uint8_t *)pData;
+    *pSize = pFile->size;
+    return pFile;
+}
+
+void unmapFile(SEGMappedFile *pFile)
+{
+    if (!pFile) return;
+    UnmapViewOfFile(pFile->pData);
+    CloseHandle(pFile->hMapping);
+    CloseHandle(pFile->hFile);
+    free(pFile);
+}
+#else
+SEGMappedFile *mapFile(const char *szFilename, const uint8_t **ppData, uint64_t *pSize)
+{
+    struct stat info;
+    int fd = open(szFilename, O_RDONLY);
+    if (fd < 0) return NULL;
+    if (fstat(fd, &info) || info.st_size <= 0)
+    {
+        close(fd);
+        return NULL;
+    }
+    // The mapping stays valid after closing
+    void *pData = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (pData == MAP_FAILED) return NULL;
+    SEGMappedFile *pFile = (SEGMappedFile *)malloc(sizeof(SEGMappedFile));
+    if (!pFile)
+    {
+        munmap(pData, (size_t)info.st_size);
+        return NULL;
+    }
+    pFile->pData = pData;
+    pFile->size = (uint64_t)info.st_size;
+    *ppData = (const uint8_t *)pData;
+    *pSize = pFile->size;
+    return pFile;
+}
+
+void unmapFile(SEGMappedFile *pFile)
+{
+    if (!pFile) return;
+    munmap(pFile->pData, (size_t)pFile->size);
+    free(pFile);
+}
+#endif
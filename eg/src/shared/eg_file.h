@@ -0,0 +1,15 @@
+#pragma once
+
+#ifndef EG_FILE_H_INCLUDED
+#define EG_FILE_H_INCLUDED
+
+#include <inttypes.h>
+
+typedef struct SEGMappedFile SEGMappedFile;
+
+// Read only mapping of a whole file. Returns NULL if the file can't be
+// opened or is empty.
+SEGMappedFile *mapFile(const char *szFilename, const uint8_t **ppData, uint64_t *pSize);
+void unmapFile(SEGMappedFile *pFile);
+
+#endif /* EG_FILE_H_INCLUDED */
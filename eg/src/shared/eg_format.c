@@ -0,0 +1,200 @@
+#include <emmintrin.h>
+#include <math.h>
+#include "eg_format.h"
+#include "eg_thread.h"
+
+// Per value conversion to 8 bits. Signed types are offset to unsigned first.
+#define CONVERT_U8(v)   ((uint8_t)(v))
+#define CONVERT_U16(v)  ((uint8_t)((v) >> 8))
+#define CONVERT_U32(v)  ((uint8_t)((v) >> 24))
+#define CONVERT_U64(v)  ((uint8_t)((v) >> 56))
+#define CONVERT_S8(v)   ((uint8_t)((uint8_t)(v) ^ 0x80))
+#define CONVERT_S16(v)  ((uint8_t)(((uint16_t)(v) ^ 0x8000) >> 8))
+#define CONVERT_S32(v)  ((uint8_t)(((uint32_t)(v) ^ 0x80000000) >> 24))
+#define CONVERT_S64(v)  ((uint8_t)(((uint64_t)(v) ^ 0x8000000000000000ull) >> 56))
+#define CONVERT_F32(v)  ((uint8_t)(int32_t)((v) * 255.f))
+#define CONVERT_F64(v)  ((uint8_t)(int32_t)((v) * 255.0))
+
+// One function per data type and channel count
+#define DEFINE_CONVERTERS(name, type)                                                   \
+    static void convert##name##R(const void *pIn, uint8_t *pOut, uint32_t pixelCount)     \
+    {                                                                                   \
+        const type *pSrc = (const type *)pIn;                                           \
+        for (uint32_t i = 0; i < pixelCount; ++i, pSrc += 1, pOut += 4)                 \
+        {                                                                               \
+            pOut[0] = CONVERT_##name(pSrc[0]);                                          \
+            pOut[1] = 0;                                                                \
+            pOut[2] = 0;                                                                \
+            pOut[3] = 255;                                                              \
+        }                                                                               \
+    }                                                                                   \
+    static void convert##name##RG(const void *pIn, uint8_t *pOut, uint32_t pixelCount)    \
+    {                                                                                   \
+        const type *pSrc = (const type *)pIn;                                           \
+        for (uint32_t i = 0; i < pixelCount; ++i, pSrc += 2, pOut += 4)                 \
+        {                                                                               \
+            pOut[0] = CONVERT_##name(pSrc[0]);                                          \
+            pOut[1] = CONVERT_##name(pSrc[1]);                                          \
+            pOut[2] = 0;                                                                \
+            pOut[3] = 255;                                                              \
+        }                                                                               \
+    }                                                                                   \
+    static void convert##name##RGB(const void *pIn, uint8_t *pOut, uint32_t pixelCount)   \
+    {                                                                                   \
+        const type *pSrc = (const type *)pIn;                                           \
+        for (uint32_t i = 0; i < pixelCount; ++i, pSrc += 3, pOut += 4)                 \
+        {                                                                               \
+            pOut[0] = CONVERT_##name(pSrc[0]);                                          \
+            pOut[1] = CONVERT_##name(pSrc[1]);                                          \
+            pOut[2] = CONVERT_##name(pSrc[2]);                                          \
+            pOut[3] = 255;                                                              \
+        }                                                                               \
+    }                                                                                   \
+    static void convert##name##RGBA(const void *pIn, uint8_t *pOut, uint32_t pixelCount)  \
+    {                                                                                   \
+        const type *pSrc = (const type *)pIn;                                           \
+        for (uint32_t i = 0; i < pixelCount; ++i, pSrc += 4, pOut += 4)                 \
+        {                                                                               \
+            pOut[0] = CONVERT_##name(pSrc[0]);                                          \
+            pOut[1] = CONVERT_##name(pSrc[1]);                                          \
+            pOut[2] = CONVERT_##name(pSrc[2]);                                          \
+            pOut[3] = CONVERT_##name(pSrc[3]);                                          \
+        }                                                                               \
+    }
+
+DEFINE_CONVERTERS(U8, uint8_t)
+DEFINE_CONVERTERS(U16, uint16_t)
+DEFINE_CONVERTERS(U32, uint32_t)
+DEFINE_CONVERTERS(U64, uint64_t)
+DEFINE_CONVERTERS(S8, int8_t)
+DEFINE_CONVERTERS(S16, int16_t)
+DEFINE_CONVERTERS(S32, int32_t)
+DEFINE_CONVERTERS(S64, int64_t)
+DEFINE_CONVERTERS(F32, float)
+DEFINE_CONVERTERS(F64, double)
+
+// SSE2 versions of the most common ones. Same results as the scalar code.
+static void convertU16RGBASSE2(const void *pIn, uint8_t *pOut, uint32_t pixelCount)
+{
+    const uint16_t *pSrc = (const uint16_t *)pIn;
+    uint32_t i = 0;
+    for (; i + 4 <= pixelCount; i += 4, pSrc += 16, pOut += 16)
+    {
+        __m128i lo = _mm_srli_epi16(_mm_loadu_si128((const __m128i *)pSrc), 8);
+        __m128i hi = _mm_srli_epi16(_mm_loadu_si128((const __m128i *)(pSrc + 8)), 8);
+        _mm_storeu_si128((__m128i *)pOut, _mm_packus_epi16(lo, hi));
+    }
+    convertU16RGBA(pSrc, pOut, pixelCount - i);
+}
+
+static void convertF32RGBASSE2(const void *pIn, uint8_t *pOut, uint32_t pixelCount)
+{
+    const float *pSrc = (const float *)pIn;
+    const __m128 scale = _mm_set1_ps(255.f);
+    const __m128i mask = _mm_set1_epi32(0xff);
+    uint32_t i = 0;
+    for (; i + 4 <= pixelCount; i += 4, pSrc += 16, pOut += 16)
+    {
+        // Truncate, then keep the low byte like the scalar cast does
+        __m128i c0 = _mm_and_si128(_mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(pSrc + 0), scale)), mask);
+        __m128i c1 = _mm_and_si128(_mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(pSrc + 4), scale)), mask);
+        __m128i c2 = _mm_and_si128(_mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(pSrc + 8), scale)), mask);
+        __m128i c3 = _mm_and_si128(_mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(pSrc + 12), scale)), mask);
+        _mm_storeu_si128((__m128i *)pOut, _mm_packus_epi16(_mm_packs_epi32(c0, c1), _mm_packs_epi32(c2, c3)));
+    }
+    convertF32RGBA(pSrc, pOut, pixelCount - i);
+}
+
+#define CONVERTER_ROW(name) {convert##name##R, convert##name##RG, convert##name##RGB, convert##name##RGBA}
+
+static const EGFormatConverter converters[10][4] = {
+    CONVERTER_ROW(U8),
+    {convertU16R, convertU16RG, convertU16RGB, convertU16RGBASSE2},
+    CONVERTER_ROW(U32),
+    CONVERTER_ROW(U64),
+    CONVERTER_ROW(S8),
+    CONVERTER_ROW(S16),
+    CONVERTER_ROW(S32),
+    CONVERTER_ROW(S64),
+    {convertF32R, convertF32RG, convertF32RGB, convertF32RGBASSE2},
+    CONVERTER_ROW(F64),
+};
+
+EGFormatConverter getFormatConverter(EGFormat dataFormat)
+{
+    uint32_t channels = dataFormat & 0x0f;
+    uint32_t type = (dataFormat & 0xf0) >> 4;
+    if (channels < EG_R || channels > EG_RGBA) return NULL;
+    if (type < (EG_U8 >> 4) || type > (EG_F64 >> 4)) return NULL;
+    return converters[type - 1][channels - 1];
+}
+
+// sRGB premultiply, indexed by [alpha][color]
+static uint8_t premultipliedSRGB[256][256];
+static EGOnce premultipliedSRGBOnce = EG_ONCE_INIT;
+
+static void initPremultipliedSRGB()
+{
+    for (int c = 0; c < 256; ++c)
+    {
+        double encoded = (double)c / 255.0;
+        double linear = (encoded <= 0.04045) ? encoded / 12.92 : pow((encoded + 0.055) / 1.055, 2.4);
+        for (int a = 0; a < 256; ++a)
+        {
+            double premultiplied = linear * (double)a / 255.0;
+            premultiplied = (premultiplied <= 0.0031308) ? premultiplied * 12.92 : 1.055 * pow(premultiplied, 1.0 / 2.4) - 0.055;
+            premultipliedSRGB[a][c] = (uint8_t)(premultiplied * 255.0 + .5);
+        }
+    }
+}
+
+void premultiplyAlpha(const uint8_t *pIn, uint8_t *pOut, uint32_t pixelCount, int bSRGB)
+{
+    uint32_t i = 0;
+
+    if (bSRGB)
+    {
+        callOnce(&premultipliedSRGBOnce, initPremultipliedSRGB);
+        for (; i < pixelCount; ++i, pIn += 4, pOut += 4)
+        {
+            const uint8_t *pTable = premultipliedSRGB[pIn[3]];
+            pOut[0] = pTable[pIn[0]];
+            pOut[1] = pTable[pIn[1]];
+            pOut[2] = pTable[pIn[2]];
+            pOut[3] = pIn[3];
+        }
+        return;
+    }
+
+    // 4 pixels at a time in 16 bits lanes. t = c * a + 128, then
+    // (t + (t >> 8)) >> 8 is exactly (c * a + 127) / 255.
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i bias = _mm_set1_epi16(128);
+        const __m128i alphaMask = _mm_set1_epi32(0xff000000);
+        for (; i + 4 <= pixelCount; i += 4, pIn += 16, pOut += 16)
+        {
+            __m128i rgba = _mm_loadu_si128((const __m128i *)pIn);
+            __m128i lo = _mm_unpacklo_epi8(rgba, zero);
+            __m128i hi = _mm_unpackhi_epi8(rgba, zero);
+            __m128i alphaLo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+            __m128i alphaHi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+            lo = _mm_add_epi16(_mm_mullo_epi16(lo, alphaLo), bias);
+            hi = _mm_add_epi16(_mm_mullo_epi16(hi, alphaHi), bias);
+            lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+            hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+            __m128i result = _mm_packus_epi16(lo, hi);
+            result = _mm_or_si128(_mm_andnot_si128(alphaMask, result), _mm_and_si128(alphaMask, rgba));
+            _mm_storeu_si128((__m128i *)pOut, result);
+        }
+    }
+    for (; i < pixelCount; ++i, pIn += 4, pOut += 4)
+    {
+        uint32_t a = pIn[3];
+        uint32_t t;
+        t = pIn[0] * a + 128; pOut[0] = (uint8_t)((t + (t >> 8)) >> 8);
+        t = pIn[1] * a + 128; pOut[1] = (uint8_t)((t + (t >> 8)) >> 8);
+        t = pIn[2] * a + 128; pOut[2] = (uint8_t)((t + (t >> 8)) >> 8);
+        pOut[3] = (uint8_t)a;
+    }
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#ifndef EG_FORMAT_H_INCLUDED
+#define EG_FORMAT_H_INCLUDED
+
+#include "eg.h"
+
+// Convert pixelCount pixels to RGBA8. Missing channels are 0, and alpha 255.
+typedef void (*EGFormatConverter)(const void *pIn, uint8_t *pOut, uint32_t pixelCount);
+
+// Returns NULL if the format is not valid
+EGFormatConverter getFormatConverter(EGFormat dataFormat);
+
+// Multiply RGB by alpha, rounded to nearest: (c * a + 127) / 255. With bSRGB,
+// RGB is sRGB encoded and the multiply happens in linear space. pIn and pOut
+// can be the same.
+void premultiplyAlpha(const uint8_t *pIn, uint8_t *pOut, uint32_t pixelCount, int bSRGB);
+
+#endif /* EG_FORMAT_H_INCLUDED */
@@ -187,7 +187,7 @@ void setProjectionMatrix(SEGMatrix *pMatrix, float fov, float aspect, float near
         0, 0, (farDist + nearDist) / nearmfar, -1,
         0, 0, 2 * farDist * nearDist / nearmfar, 0
     };
-    memcpy(pMatrix->m, m, sizeof(double) * 16);
+    memcpy(pMatrix->m, m, sizeof(float) * 16);
     transposeMatrix(pMatrix);
 }
 
@@ -0,0 +1,347 @@
+#include <emmintrin.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "eg_math.h"
+#include "eg_mip.h"
+#include "eg_thread.h"
+
+#define KAISER_WIDTH 3.f
+#define KAISER_ALPHA 4.f
+#define LINEAR_TO_SRGB_SIZE 16384
+#define PARALLEL_MIN_ROWS 32
+
+// A filter tap list for each destination column or row
+typedef struct
+{
+    uint32_t    offset; // In pIndices and pWeights
+    uint32_t    count;
+} SEGMipTaps;
+
+typedef struct
+{
+    SEGMipTaps *pTaps;
+    uint32_t   *pIndices;
+    float      *pWeights;
+} SEGMipFilter;
+
+typedef struct
+{
+    const uint8_t  *pIn;
+    const __m128   *pSrc;
+    uint32_t        srcW, srcH;
+    __m128         *pDst;
+    uint8_t        *pOut;
+    uint32_t        dstW, dstH;
+    SEGMipFilter    filterX;
+    SEGMipFilter    filterY;
+    uint32_t        mipFlags;
+} SEGMipJob;
+
+static float srgbToLinear[256];
+static uint8_t linearToSrgb[LINEAR_TO_SRGB_SIZE];
+static EGOnce tablesOnce = EG_ONCE_INIT;
+
+static void initTables()
+{
+    for (int i = 0; i < 256; ++i)
+    {
+        float c = (float)i / 255.f;
+        srgbToLinear[i] = (c <= 0.04045f) ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+    }
+    for (int i = 0; i < LINEAR_TO_SRGB_SIZE; ++i)
+    {
+        float c = (float)i / (float)(LINEAR_TO_SRGB_SIZE - 1);
+        c = (c <= 0.0031308f) ? c * 12.92f : 1.055f * powf(c, 1.f / 2.4f) - 0.055f;
+        linearToSrgb[i] = (uint8_t)(c * 255.f + .5f);
+    }
+}
+
+uint32_t getMipLevelCount(uint32_t w, uint32_t h)
+{
+    uint32_t levelCount = 1;
+    while (w > 1 || h > 1)
+    {
+        w = (w > 1) ? w / 2 : 1;
+        h = (h > 1) ? h / 2 : 1;
+        ++levelCount;
+    }
+    return levelCount;
+}
+
+uint32_t getMipChainSize(uint32_t w, uint32_t h, uint32_t levelCount)
+{
+    uint32_t size = 0;
+    for (uint32_t i = 0; i < levelCount; ++i)
+    {
+        size += w * h * 4;
+        w = (w > 1) ? w / 2 : 1;
+        h = (h > 1) ? h / 2 : 1;
+    }
+    return size;
+}
+
+static float besselI0(float x)
+{
+    float sum = 1;
+    float term = 1;
+    for (int k = 1; k < 32; ++k)
+    {
+        term *= (x * .5f / (float)k) * (x * .5f / (float)k);
+        sum += term;
+        if (term < sum * 1e-8f) break;
+    }
+    return sum;
+}
+
+static float kaiser(float x)
+{
+    float t = x / KAISER_WIDTH;
+    float sinc = (fabsf(x) < 1e-5f) ? 1 : sinf(EG_PI * x) / (EG_PI * x);
+    if (t <= -1 || t >= 1) return 0;
+    return sinc * besselI0(KAISER_ALPHA * sqrtf(1 - t * t)) / besselI0(KAISER_ALPHA);
+}
+
+// Weights for each destination pixel along one axis. The box filter takes the
+// exact coverage of the source pixels: 2 taps of 1/2 for even sizes, and
+// 3 taps of (n-x)/(2n+1), n/(2n+1), (x+1)/(2n+1) for odd ones.
+static void buildFilter(SEGMipFilter *pFilter, uint32_t srcSize, uint32_t dstSize, uint32_t mipFlags)
+{
+    float scale = (float)srcSize / (float)dstSize;
+    float support = (mipFlags & MIP_KAISER) ? KAISER_WIDTH * scale : scale * .5f;
+    uint32_t maxTaps = (uint32_t)ceilf(support * 2) + 2;
+    uint32_t count = 0;
+
+    pFilter->pTaps = (SEGMipTaps *)malloc(sizeof(SEGMipTaps) * dstSize);
+    pFilter->pIndices = (uint32_t *)malloc(sizeof(uint32_t) * dstSize * maxTaps);
+    pFilter->pWeights = (float *)malloc(sizeof(float) * dstSize * maxTaps);
+
+    for (uint32_t i = 0; i < dstSize; ++i)
+    {
+        float center = ((float)i + .5f) * scale;
+        int first = (int)floorf(center - support);
+        int last = (int)ceilf(center + support);
+        float total = 0;
+        SEGMipTaps *pTaps = pFilter->pTaps + i;
+
+        pTaps->offset = count;
+        pTaps->count = 0;
+        for (int j = first; j < last; ++j)
+        {
+            float weight;
+            if (mipFlags & MIP_KAISER)
+            {
+                weight = kaiser(((float)j + .5f - center) / scale);
+                if (weight == 0) continue;
+            }
+            else
+            {
+                float left = ((float)j > center - support) ? (float)j : center - support;
+                float right = ((float)(j + 1) < center + support) ? (float)(j + 1) : center + support;
+                weight = right - left;
+                if (weight <= 0) continue;
+            }
+
+            // Clamp to edge
+            pFilter->pIndices[count] = (j < 0) ? 0 : ((j >= (int)srcSize) ? srcSize - 1 : (uint32_t)j);
+            pFilter->pWeights[count] = weight;
+            total += weight;
+            ++count;
+            ++pTaps->count;
+        }
+        for (uint32_t k = 0; k < pTaps->count; ++k)
+        {
+            pFilter->pWeights[pTaps->offset + k] /= total;
+        }
+    }
+}
+
+static void freeFilter(SEGMipFilter *pFilter)
+{
+    free(pFilter->pTaps);
+    free(pFilter->pIndices);
+    free(pFilter->pWeights);
+}
+
+static void decodeRows(void *pData, uint32_t begin, uint32_t end)
+{
+    SEGMipJob *pJob = (SEGMipJob *)pData;
+    const float *pTable = srgbToLinear;
+    float linearTable[256];
+
+    if (!(pJob->mipFlags & MIP_SRGB))
+    {
+        for (int i = 0; i < 256; ++i) linearTable[i] = (float)i / 255.f;
+        pTable = linearTable;
+    }
+
+    for (uint32_t y = begin; y < end; ++y)
+    {
+        const uint8_t *pIn = pJob->pIn + y * pJob->srcW * 4;
+        __m128 *pDst = pJob->pDst + y * pJob->srcW;
+        for (uint32_t x = 0; x < pJob->srcW; ++x, pIn += 4)
+        {
+            pDst[x] = _mm_set_ps((float)pIn[3] / 255.f, pTable[pIn[2]], pTable[pIn[1]], pTable[pIn[0]]);
+        }
+    }
+}
+
+static void encodeRow(const __m128 *pSrc, uint8_t *pOut, uint32_t w, uint32_t mipFlags)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.f);
+    const __m128 half = _mm_set1_ps(.5f);
+
+    if (mipFlags & MIP_SRGB)
+    {
+        const __m128 tableScale = _mm_set_ps(255.f, (float)(LINEAR_TO_SRGB_SIZE - 1), (float)(LINEAR_TO_SRGB_SIZE - 1), (float)(LINEAR_TO_SRGB_SIZE - 1));
+        int32_t indices[4];
+        for (uint32_t x = 0; x < w; ++x, pOut += 4)
+        {
+            __m128 c = _mm_min_ps(_mm_max_ps(pSrc[x], zero), one);
+            _mm_storeu_si128((__m128i *)indices, _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(c, tableScale), half)));
+            pOut[0] = linearToSrgb[indices[0]];
+            pOut[1] = linearToSrgb[indices[1]];
+            pOut[2] = linearToSrgb[indices[2]];
+            pOut[3] = (uint8_t)indices[3];
+        }
+    }
+    else
+    {
+        const __m128 scale = _mm_set1_ps(255.f);
+        uint32_t x = 0;
+
+        // 4 pixels at a time
+        for (; x + 4 <= w; x += 4, pOut += 16)
+        {
+            __m128i c0 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(pSrc[x + 0], zero), one), scale), half));
+            __m128i c1 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(pSrc[x + 1], zero), one), scale), half));
+            __m128i c2 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(pSrc[x + 2], zero), one), scale), half));
+            __m128i c3 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(pSrc[x + 3], zero), one), scale), half));
+            _mm_storeu_si128((__m128i *)pOut, _mm_packus_epi16(_mm_packs_epi32(c0, c1), _mm_packs_epi32(c2, c3)));
+        }
+        for (; x < w; ++x, pOut += 4)
+        {
+            __m128i c = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(pSrc[x], zero), one), scale), half));
+            c = _mm_packus_epi16(_mm_packs_epi32(c, c), c);
+            *(int32_t *)pOut = _mm_cvtsi128_si32(c);
+        }
+    }
+}
+
+static void filterRows(void *pData, uint32_t begin, uint32_t end)
+{
+    SEGMipJob *pJob = (SEGMipJob *)pData;
+    uint32_t srcW = pJob->srcW;
+    uint32_t dstW = pJob->dstW;
+    int bHalfBox = !(pJob->mipFlags & MIP_KAISER) &&
+                   srcW == dstW * 2 && pJob->srcH == pJob->dstH * 2;
+    __m128 *pRow = bHalfBox ? NULL : (__m128 *)_mm_malloc(sizeof(__m128) * srcW, 16);
+
+    for (uint32_t y = begin; y < end; ++y)
+    {
+        __m128 *pDst = pJob->pDst + y * dstW;
+
+        if (bHalfBox)
+        {
+            // 2x2 average
+            const __m128 quarter = _mm_set1_ps(.25f);
+            const __m128 *pTop = pJob->pSrc + y * 2 * srcW;
+            const __m128 *pBottom = pTop + srcW;
+            for (uint32_t x = 0; x < dstW; ++x)
+            {
+                __m128 sum = _mm_add_ps(_mm_add_ps(pTop[x * 2], pTop[x * 2 + 1]),
+                                        _mm_add_ps(pBottom[x * 2], pBottom[x * 2 + 1]));
+                pDst[x] = _mm_mul_ps(sum, quarter);
+            }
+        }
+        else
+        {
+            const SEGMipTaps *pTapsY = pJob->filterY.pTaps + y;
+            const SEGMipTaps *pTapsX = pJob->filterX.pTaps;
+            const __m128 zero = _mm_setzero_ps();
+            const __m128 one = _mm_set1_ps(1.f);
+
+            // Vertical pass in a row of source width
+            for (uint32_t x = 0; x < srcW; ++x) pRow[x] = _mm_setzero_ps();
+            for (uint32_t k = 0; k < pTapsY->count; ++k)
+            {
+                const __m128 *pSrc = pJob->pSrc + pJob->filterY.pIndices[pTapsY->offset + k] * srcW;
+                __m128 weight = _mm_set1_ps(pJob->filterY.pWeights[pTapsY->offset + k]);
+                for (uint32_t x = 0; x < srcW; ++x)
+                {
+                    pRow[x] = _mm_add_ps(pRow[x], _mm_mul_ps(pSrc[x], weight));
+                }
+            }
+
+            // Horizontal pass. Clamp so negative lobes don't build up in the next levels
+            for (uint32_t x = 0; x < dstW; ++x, ++pTapsX)
+            {
+                __m128 sum = _mm_setzero_ps();
+                for (uint32_t k = 0; k < pTapsX->count; ++k)
+                {
+                    __m128 weight = _mm_set1_ps(pJob->filterX.pWeights[pTapsX->offset + k]);
+                    sum = _mm_add_ps(sum, _mm_mul_ps(pRow[pJob->filterX.pIndices[pTapsX->offset + k]], weight));
+                }
+                pDst[x] = _mm_min_ps(_mm_max_ps(sum, zero), one);
+            }
+        }
+
+        encodeRow(pDst, pJob->pOut + y * dstW * 4, dstW, pJob->mipFlags);
+    }
+
+    if (pRow) _mm_free(pRow);
+}
+
+void generateMipChain(uint8_t *pChain, uint32_t w, uint32_t h, uint32_t levelCount, uint32_t mipFlags)
+{
+    SEGMipJob job;
+    __m128 *pSrc;
+    __m128 *pDst;
+
+    if (levelCount < 2) return;
+    callOnce(&tablesOnce, initTables);
+
+    memset(&job, 0, sizeof(job));
+    job.mipFlags = mipFlags;
+
+    // Work in float linear space. Only two levels are kept around
+    pSrc = (__m128 *)_mm_malloc(sizeof(__m128) * w * h, 16);
+    pDst = (__m128 *)_mm_malloc(sizeof(__m128) * ((w > 1) ? w / 2 : 1) * ((h > 1) ? h / 2 : 1), 16);
+
+    job.pIn = pChain;
+    job.pDst = pSrc;
+    job.srcW = w;
+    job.srcH = h;
+    parallelFor(h, PARALLEL_MIN_ROWS, decodeRows, &job);
+
+    for (uint32_t level = 1; level < levelCount; ++level)
+    {
+        __m128 *pTemp;
+
+        job.pOut = pChain + w * h * 4;
+        job.pSrc = pSrc;
+        job.pDst = pDst;
+        job.srcW = w;
+        job.srcH = h;
+        job.dstW = (w > 1) ? w / 2 : 1;
+        job.dstH = (h > 1) ? h / 2 : 1;
+        buildFilter(&job.filterX, job.srcW, job.dstW, mipFlags);
+        buildFilter(&job.filterY, job.srcH, job.dstH, mipFlags);
+
+        parallelFor(job.dstH, PARALLEL_MIN_ROWS, filterRows, &job);
+
+        freeFilter(&job.filterX);
+        freeFilter(&job.filterY);
+
+        pChain = job.pOut;
+        w = job.dstW;
+        h = job.dstH;
+        pTemp = pSrc;
+        pSrc = pDst;
+        pDst = pTemp;
+    }
+
+    _mm_free(pSrc);
+    _mm_free(pDst);
+}
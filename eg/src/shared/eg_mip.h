@@ -0,0 +1,22 @@
+#pragma once
+
+#ifndef EG_MIP_H_INCLUDED
+#define EG_MIP_H_INCLUDED
+
+#include <inttypes.h>
+
+// Mip generation flags
+#define MIP_SRGB    0x01 // RGB is sRGB encoded, filter it in linear space
+#define MIP_KAISER  0x02 // Kaiser windowed sinc instead of a box filter
+
+// Number of levels down to 1x1. Each level is max(1, previous / 2)
+uint32_t getMipLevelCount(uint32_t w, uint32_t h);
+
+// Size in bytes of levelCount RGBA8 levels, packed one after the other
+uint32_t getMipChainSize(uint32_t w, uint32_t h, uint32_t levelCount);
+
+// pChain holds the first RGBA8 level of w * h. The next levels are written
+// right after it, each one filtered from the previous one.
+void generateMipChain(uint8_t *pChain, uint32_t w, uint32_t h, uint32_t levelCount, uint32_t mipFlags);
+
+#endif /* EG_MIP_H_INCLUDED */
@@ -0,0 +1,165 @@
+#include <emmintrin.h>
+#include <math.h>
+#include <stdlib.h>
+#include "eg_normal.h"
+#include "eg_thread.h"
+
+#define PARALLEL_MIN_ROWS   16
+#define DIRECTION_COUNT     8
+#define STEP_COUNT          8
+#define OCCLUSION_RADIUS    16 // Texels
+
+// Distances of the occlusion samples, denser close to the texel
+static const float stepDistances[STEP_COUNT] = {1, 2, 3, 5, 7, 10, 13, 16};
+
+typedef struct
+{
+    const float    *pHeights;   // Scaled by strength, padded on all sides
+    uint32_t        stride;
+    uint32_t        border;
+    uint8_t        *pOut;
+    uint32_t        w, h;
+    uint32_t        normalFlags;
+    int32_t         offsets[DIRECTION_COUNT][STEP_COUNT];   // In pHeights
+    float           invDistances[DIRECTION_COUNT][STEP_COUNT];
+} SEGNormalJob;
+
+static void normalRows(void *pData, uint32_t begin, uint32_t end)
+{
+    SEGNormalJob *pJob = (SEGNormalJob *)pData;
+    const __m128 scharrSide = _mm_set1_ps(3.f / 32.f);
+    const __m128 scharrCenter = _mm_set1_ps(10.f / 32.f);
+    const __m128 one = _mm_set1_ps(1.f);
+    const __m128 half = _mm_set1_ps(.5f);
+    const __m128 three = _mm_set1_ps(3.f);
+    const __m128 encode = _mm_set1_ps(127.5f);
+    const __m128 occlusionScale = _mm_set1_ps(255.f / (float)DIRECTION_COUNT);
+    const __m128i alphaMask = _mm_set1_epi32(0xff000000);
+
+    for (uint32_t y = begin; y < end; ++y)
+    {
+        const float *pRow = pJob->pHeights + (y + pJob->border) * pJob->stride + pJob->border;
+        uint32_t *pOut = (uint32_t *)pJob->pOut + y * pJob->w;
+
+        // The padded rows are long enough to read 4 texels past the end
+        for (uint32_t x = 0; x < pJob->w; x += 4)
+        {
+            const float *p = pRow + x;
+            __m128 a0 = _mm_loadu_ps(p - pJob->stride - 1);
+            __m128 a1 = _mm_loadu_ps(p - pJob->stride);
+            __m128 a2 = _mm_loadu_ps(p - pJob->stride + 1);
+            __m128 b0 = _mm_loadu_ps(p - 1);
+            __m128 b2 = _mm_loadu_ps(p + 1);
+            __m128 c0 = _mm_loadu_ps(p + pJob->stride - 1);
+            __m128 c1 = _mm_loadu_ps(p + pJob->stride);
+            __m128 c2 = _mm_loadu_ps(p + pJob->stride + 1);
+
+            // Scharr, normalized to a slope per texel
+            __m128 dx = _mm_add_ps(_mm_mul_ps(scharrSide, _mm_add_ps(_mm_sub_ps(a2, a0), _mm_sub_ps(c2, c0))),
+                                   _mm_mul_ps(scharrCenter, _mm_sub_ps(b2, b0)));
+            __m128 dy = _mm_add_ps(_mm_mul_ps(scharrSide, _mm_add_ps(_mm_sub_ps(c0, a0), _mm_sub_ps(c2, a2))),
+                                   _mm_mul_ps(scharrCenter, _mm_sub_ps(c1, a1)));
+
+            // normalize(-dx, -dy, 1), rsqrt refined with one Newton step
+            __m128 lenSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), one);
+            __m128 invLen = _mm_rsqrt_ps(lenSq);
+            invLen = _mm_mul_ps(_mm_mul_ps(half, invLen), _mm_sub_ps(three, _mm_mul_ps(_mm_mul_ps(lenSq, invLen), invLen)));
+            __m128 nx = _mm_sub_ps(encode, _mm_mul_ps(_mm_mul_ps(dx, invLen), encode));
+            __m128 ny = _mm_sub_ps(encode, _mm_mul_ps(_mm_mul_ps(dy, invLen), encode));
+            __m128 nz = _mm_add_ps(encode, _mm_mul_ps(invLen, encode));
+
+            __m128i rgba = _mm_or_si128(_mm_cvtps_epi32(nx),
+                           _mm_or_si128(_mm_slli_epi32(_mm_cvtps_epi32(ny), 8),
+                                        _mm_slli_epi32(_mm_cvtps_epi32(nz), 16)));
+
+            if (pJob->normalFlags & NORMAL_OCCLUSION)
+            {
+                // For each direction, the highest horizon as sin(elevation).
+                // Occlusion is the average of those.
+                __m128 center = _mm_loadu_ps(p);
+                __m128 occlusion = _mm_setzero_ps();
+                for (uint32_t d = 0; d < DIRECTION_COUNT; ++d)
+                {
+                    __m128 maxTan = _mm_setzero_ps();
+                    for (uint32_t s = 0; s < STEP_COUNT; ++s)
+                    {
+                        __m128 rise = _mm_sub_ps(_mm_loadu_ps(p + pJob->offsets[d][s]), center);
+                        maxTan = _mm_max_ps(maxTan, _mm_mul_ps(rise, _mm_set1_ps(pJob->invDistances[d][s])));
+                    }
+                    __m128 tanSq = _mm_add_ps(_mm_mul_ps(maxTan, maxTan), one);
+                    __m128 invSec = _mm_rsqrt_ps(tanSq);
+                    invSec = _mm_mul_ps(_mm_mul_ps(half, invSec), _mm_sub_ps(three, _mm_mul_ps(_mm_mul_ps(tanSq, invSec), invSec)));
+                    occlusion = _mm_add_ps(occlusion, _mm_mul_ps(maxTan, invSec));
+                }
+                __m128 alpha = _mm_sub_ps(_mm_set1_ps(255.f), _mm_mul_ps(occlusion, occlusionScale));
+                rgba = _mm_or_si128(rgba, _mm_slli_epi32(_mm_cvtps_epi32(alpha), 24));
+            }
+            else
+            {
+                rgba = _mm_or_si128(rgba, alphaMask);
+            }
+
+            if (x + 4 <= pJob->w)
+            {
+                _mm_storeu_si128((__m128i *)(pOut + x), rgba);
+            }
+            else
+            {
+                uint32_t texels[4];
+                _mm_storeu_si128((__m128i *)texels, rgba);
+                for (uint32_t i = 0; x + i < pJob->w; ++i) pOut[x + i] = texels[i];
+            }
+        }
+    }
+}
+
+void generateNormalMap(const uint8_t *pIn, uint8_t *pOut, uint32_t w, uint32_t h, uint32_t channelCount, float strength, uint32_t normalFlags)
+{
+    SEGNormalJob job;
+    job.border = (normalFlags & NORMAL_OCCLUSION) ? OCCLUSION_RADIUS : 1;
+    job.stride = w + job.border * 2 + 4;
+    job.pOut = pOut;
+    job.w = w;
+    job.h = h;
+    job.normalFlags = normalFlags;
+
+    if (channelCount < 1) channelCount = 1;
+    if (channelCount > 3) channelCount = 3;
+
+    // Heights in texels, with a wrapped border so the kernels don't need
+    // bounds checks
+    uint32_t paddedH = h + job.border * 2;
+    float *pHeights = (float *)_mm_malloc(sizeof(float) * job.stride * paddedH, 16);
+    if (!pHeights) return;
+    float scale = strength / (255.f * (float)channelCount);
+    for (uint32_t y = 0; y < paddedH; ++y)
+    {
+        uint32_t srcY = (y + h * OCCLUSION_RADIUS - job.border) % h;
+        const uint8_t *pSrcRow = pIn + srcY * w * 4;
+        float *pDst = pHeights + y * job.stride;
+        for (uint32_t x = 0; x < job.stride; ++x)
+        {
+            const uint8_t *pSrc = pSrcRow + ((x + w * OCCLUSION_RADIUS - job.border) % w) * 4;
+            uint32_t sum = pSrc[0];
+            if (channelCount > 1) sum += pSrc[1];
+            if (channelCount > 2) sum += pSrc[2];
+            pDst[x] = (float)sum * scale;
+        }
+    }
+    job.pHeights = pHeights;
+
+    for (uint32_t d = 0; d < DIRECTION_COUNT; ++d)
+    {
+        float angle = (float)d * 6.2831853f / (float)DIRECTION_COUNT;
+        for (uint32_t s = 0; s < STEP_COUNT; ++s)
+        {
+            int32_t ox = (int32_t)floorf(cosf(angle) * stepDistances[s] + .5f);
+            int32_t oy = (int32_t)floorf(sinf(angle) * stepDistances[s] + .5f);
+            job.offsets[d][s] = oy * (int32_t)job.stride + ox;
+            job.invDistances[d][s] = 1.f / sqrtf((float)(ox * ox + oy * oy));
+        }
+    }
+
+    parallelFor(h, PARALLEL_MIN_ROWS, normalRows, &job);
+    _mm_free(pHeights);
+}
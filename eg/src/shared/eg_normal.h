@@ -0,0 +1,17 @@
+#pragma once
+
+#ifndef EG_NORMAL_H_INCLUDED
+#define EG_NORMAL_H_INCLUDED
+
+#include <inttypes.h>
+
+// Normal map generation flags
+#define NORMAL_OCCLUSION    0x01 // Bake horizon based occlusion in alpha
+
+// Treat pIn as a heightmap, the average of its first channelCount channels,
+// and write a tangent space normal map to pOut. Both are RGBA8 w * h. X goes
+// along +u and Y along +v. The heightmap wraps around.
+// strength is the height of a white texel, in texels.
+void generateNormalMap(const uint8_t *pIn, uint8_t *pOut, uint32_t w, uint32_t h, uint32_t channelCount, float strength, uint32_t normalFlags);
+
+#endif /* EG_NORMAL_H_INCLUDED */
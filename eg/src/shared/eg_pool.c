@@ -0,0 +1,123 @@
+#include <stdlib.h>
+#include <string.h>
+#include "eg_pool.h"
+
+#define SLOT_USED           0xffffffff
+#define GENERATION_MASK     ((1 << (32 - POOL_INDEX_BITS)) - 1)
+
+typedef struct
+{
+    uint32_t    generation;
+    uint32_t    nextFree; // SLOT_USED while the slot holds an item
+} SEGPoolSlot;
+
+// The item follows the slot header, aligned for pointers and doubles
+#define SLOT_HEADER_SIZE    ((sizeof(SEGPoolSlot) + 7) & ~7)
+
+static SEGPoolSlot *getSlot(const SEGPool *pPool, uint32_t index)
+{
+    return (SEGPoolSlot *)(pPool->ppChunks[index / POOL_CHUNK_SIZE] + (index % POOL_CHUNK_SIZE) * pPool->slotSize);
+}
+
+void initPool(SEGPool *pPool, uint32_t itemSize)
+{
+    memset(pPool, 0, sizeof(SEGPool));
+    pPool->slotSize = (uint32_t)((SLOT_HEADER_SIZE + itemSize + 7) & ~7);
+}
+
+void destroyPool(SEGPool *pPool)
+{
+    for (uint32_t i = 0; i < pPool->chunkCount; ++i)
+    {
+        free(pPool->ppChunks[i]);
+    }
+    free(pPool->ppChunks);
+    initPool(pPool, pPool->slotSize - SLOT_HEADER_SIZE);
+}
+
+uint32_t poolAlloc(SEGPool *pPool, void **ppItem)
+{
+    uint32_t index;
+    SEGPoolSlot *pSlot;
+
+    if (pPool->freeCount >= POOL_MIN_FREE_SLOTS || (pPool->freeHead && pPool->slotCount == POOL_MAX_ITEMS))
+    {
+        index = pPool->freeHead - 1;
+        pSlot = getSlot(pPool, index);
+        pPool->freeHead = pSlot->nextFree;
+        if (!pPool->freeHead) pPool->freeTail = 0;
+        --pPool->freeCount;
+    }
+    else
+    {
+        if (pPool->slotCount == POOL_MAX_ITEMS) return 0;
+        index = pPool->slotCount;
+        if (index / POOL_CHUNK_SIZE == pPool->chunkCount)
+        {
+            // Only the chunk pointers move, never the items
+            uint8_t **ppChunks = (uint8_t **)realloc(pPool->ppChunks, sizeof(uint8_t *) * (pPool->chunkCount + 1));
+            if (!ppChunks) return 0;
+            pPool->ppChunks = ppChunks;
+            pPool->ppChunks[pPool->chunkCount] = (uint8_t *)malloc(pPool->slotSize * POOL_CHUNK_SIZE);
+            if (!pPool->ppChunks[pPool->chunkCount]) return 0;
+            ++pPool->chunkCount;
+        }
+        ++pPool->slotCount;
+        pSlot = getSlot(pPool, index);
+        pSlot->generation = 1;
+    }
+
+    pSlot->nextFree = SLOT_USED;
+    ++pPool->itemCount;
+    *ppItem = (uint8_t *)pSlot + SLOT_HEADER_SIZE;
+    memset(*ppItem, 0, pPool->slotSize - SLOT_HEADER_SIZE);
+    return (pSlot->generation << POOL_INDEX_BITS) | index;
+}
+
+static SEGPoolSlot *getLiveSlot(const SEGPool *pPool, uint32_t handle)
+{
+    uint32_t index = handle & (POOL_MAX_ITEMS - 1);
+    SEGPoolSlot *pSlot;
+
+    if (index >= pPool->slotCount) return NULL;
+    pSlot = getSlot(pPool, index);
+    if (pSlot->nextFree != SLOT_USED) return NULL;
+    if (pSlot->generation != handle >> POOL_INDEX_BITS) return NULL;
+    return pSlot;
+}
+
+int poolFree(SEGPool *pPool, uint32_t handle)
+{
+    uint32_t index = handle & (POOL_MAX_ITEMS - 1);
+    SEGPoolSlot *pSlot = getLiveSlot(pPool, handle);
+    if (!pSlot) return 0;
+
+    // Bump the generation so old handles stop matching. Skip 0.
+    pSlot->generation = (pSlot->generation + 1) & GENERATION_MASK;
+    if (!pSlot->generation) pSlot->generation = 1;
+
+    // Queued at the tail, so it's the last free slot to be reused
+    pSlot->nextFree = 0;
+    if (pPool->freeTail) getSlot(pPool, pPool->freeTail - 1)->nextFree = index + 1;
+    else pPool->freeHead = index + 1;
+    pPool->freeTail = index + 1;
+    ++pPool->freeCount;
+    --pPool->itemCount;
+    return 1;
+}
+
+void *poolGet(const SEGPool *pPool, uint32_t handle)
+{
+    SEGPoolSlot *pSlot = getLiveSlot(pPool, handle);
+    if (!pSlot) return NULL;
+    return (uint8_t *)pSlot + SLOT_HEADER_SIZE;
+}
+
+void *poolGetAt(const SEGPool *pPool, uint32_t index)
+{
+    SEGPoolSlot *pSlot;
+    if (index >= pPool->slotCount) return NULL;
+    pSlot = getSlot(pPool, index);
+    if (pSlot->nextFree == SLOT_USED) return (uint8_t *)pSlot + SLOT_HEADER_SIZE;
+    return NULL;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#ifndef EG_POOL_H_INCLUDED
+#define EG_POOL_H_INCLUDED
+
+#include <inttypes.h>
+
+// Handles are 32 bits: the slot generation in the high bits, and the slot
+// index in the low bits. The generation is never 0, so neither is a handle.
+#define POOL_INDEX_BITS         20
+#define POOL_MAX_ITEMS          (1 << POOL_INDEX_BITS)
+#define POOL_CHUNK_SIZE         256
+
+// The generation has 32 - POOL_INDEX_BITS bits and wraps, so a stale handle
+// matches again once its slot went through that many frees. Free slots are
+// reused first in, first out, and only once this many are waiting, so that
+// takes over a million creates and destroys instead of 4095.
+#define POOL_MIN_FREE_SLOTS     256
+
+// Slot pool. Items are stored in fixed size chunks, so they never move.
+typedef struct
+{
+    uint8_t   **ppChunks;
+    uint32_t    chunkCount;
+    uint32_t    slotSize;
+    uint32_t    slotCount;  // Slots used at least once
+    uint32_t    freeHead;   // Index + 1 of the oldest free slot, 0 if none
+    uint32_t    freeTail;   // Index + 1 of the newest free slot, 0 if none
+    uint32_t    freeCount;
+    uint32_t    itemCount;  // Live items
+} SEGPool;
+
+void initPool(SEGPool *pPool, uint32_t itemSize);
+
+// Items must be released by the caller first
+void destroyPool(SEGPool *pPool);
+
+// Returns the handle, or 0 if the pool is full. ppItem receives the item.
+uint32_t poolAlloc(SEGPool *pPool, void **ppItem);
+
+// Returns 0 if the handle is stale or invalid
+int poolFree(SEGPool *pPool, uint32_t handle);
+
+// Returns NULL if the handle is stale or invalid
+void *poolGet(const SEGPool *pPool, uint32_t handle);
+
+// Item in slot index, or NULL if the slot is free. Used to walk the pool
+// with index < slotCount.
+void *poolGetAt(const SEGPool *pPool, uint32_t index);
+
+#endif /* EG_POOL_H_INCLUDED */
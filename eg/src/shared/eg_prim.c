@@ -1,6 +1,104 @@
+#include <float.h>
+#include <stdlib.h>
+#include <string.h>
 #include "eg.h"
 #include "eg_math.h"
 
+// Slice counts used by the automatic tessellation. Stacks are half of that.
+#define LOD_LEVEL_COUNT 10
+#define LOD_MAX_SLICES 128
+static const uint32_t lodSlices[LOD_LEVEL_COUNT] = {6, 8, 12, 16, 24, 32, 48, 64, 96, 128};
+
+// Cached ring for each lod level, built on first use
+typedef struct
+{
+    uint32_t    slices;
+    float       cosTheta[LOD_MAX_SLICES + 1];
+    float       sinTheta[LOD_MAX_SLICES + 1];
+} SEGLodRing;
+
+static SEGLodRing lodRings[LOD_LEVEL_COUNT] = {0};
+
+static const SEGLodRing *getLodRing(uint32_t level)
+{
+    SEGLodRing *pRing = lodRings + level;
+    if (!pRing->slices)
+    {
+        uint32_t slices = lodSlices[level];
+        for (uint32_t i = 0; i <= slices; ++i)
+        {
+            pRing->cosTheta[i] = cosf((float)i / (float)slices * EG_PI * 2);
+            pRing->sinTheta[i] = sinf((float)i / (float)slices * EG_PI * 2);
+        }
+        pRing->slices = slices;
+    }
+    return pRing;
+}
+
+// Radius in pixels of a model space sphere, using the current matrices.
+// Returns FLT_MAX if part of it is behind the camera.
+static float getProjectedRadius(float x, float y, float z, float radius)
+{
+    float model[16];
+    float viewProj[16];
+    uint32_t viewport[4];
+    float world[4];
+    float clip[4];
+    float scale = 0;
+    float maxDist = 0;
+
+    egGetModel(model);
+    egGetViewProj(viewProj);
+    egGetViewport(viewport);
+
+    // Center in world space. Scale the radius by the biggest axis
+    for (int i = 0; i < 3; ++i)
+    {
+        float len = sqrtf(model[i * 4 + 0] * model[i * 4 + 0] +
+                          model[i * 4 + 1] * model[i * 4 + 1] +
+                          model[i * 4 + 2] * model[i * 4 + 2]);
+        if (len > scale) scale = len;
+        world[i] = x * model[i] + y * model[4 + i] + z * model[8 + i] + model[12 + i];
+    }
+    world[3] = 1;
+    radius *= scale;
+
+    for (int i = 0; i < 4; ++i)
+    {
+        clip[i] = viewProj[i * 4 + 0] * world[0] + viewProj[i * 4 + 1] * world[1] +
+                  viewProj[i * 4 + 2] * world[2] + viewProj[i * 4 + 3];
+    }
+    if (clip[3] <= 0) return FLT_MAX;
+
+    // Offset the center along each world axis and take the biggest distance on screen
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        float ox = clip[0] + viewProj[0 + axis] * radius;
+        float oy = clip[1] + viewProj[4 + axis] * radius;
+        float ow = clip[3] + viewProj[12 + axis] * radius;
+        float dx, dy, dist;
+        if (ow <= 0) return FLT_MAX;
+        dx = (ox / ow - clip[0] / clip[3]) * (float)viewport[2] * .5f;
+        dy = (oy / ow - clip[1] / clip[3]) * (float)viewport[3] * .5f;
+        dist = sqrtf(dx * dx + dy * dy);
+        if (dist > maxDist) maxDist = dist;
+    }
+
+    return maxDist;
+}
+
+static uint32_t getLodLevel(float projectedRadius, float edgeLength)
+{
+    float slices;
+    if (edgeLength <= 0) return LOD_LEVEL_COUNT - 1;
+    slices = ceilf(2 * EG_PI * projectedRadius / edgeLength);
+    for (uint32_t level = 0; level < LOD_LEVEL_COUNT; ++level)
+    {
+        if ((float)lodSlices[level] >= slices) return level;
+    }
+    return LOD_LEVEL_COUNT - 1;
+}
+
 void egCube(float size)
 {
     float hSize = size * .5f;
@@ -82,26 +180,26 @@ void egCube(float size)
     egEnd();
 }
 
-void egSphere(float radius, uint32_t slices, uint32_t stacks, float sfactor)
+// The sphere and the cylinder take cos and sin of the slice angles, and of
+// the stack angles for the sphere, from tables. The fixed versions fill them
+// with cosf and sinf, the automatic ones use the cached lod rings.
+static void emitSphere(float radius, uint32_t slices, uint32_t stacks,
+                       const float *pCosTheta, const float *pSinTheta,
+                       const float *pCosPhi, const float *pSinPhi, float sfactor)
 {
-    if (slices < 3) return;
-    if (stacks < 2) return;
-
     // Sides
     egBegin(EG_TRIANGLE_STRIP);
     {
         for (uint32_t j = 0; j < stacks; ++j)
         {
-            float cosB = -cosf(((float)j / (float)stacks) * EG_PI);
-            float cosT = -cosf(((float)(j + 1) / (float)stacks) * EG_PI);
-            float sinB = sinf(((float)j / (float)stacks) * EG_PI);
-            float sinT = sinf(((float)(j + 1) / (float)stacks) * EG_PI);
-            float aSinB = fabsf(sinB);
-            float aSinT = fabsf(sinT);
+            float cosB = -pCosPhi[j];
+            float cosT = -pCosPhi[j + 1];
+            float aSinB = fabsf(pSinPhi[j]);
+            float aSinT = fabsf(pSinPhi[j + 1]);
             for (uint32_t i = 0; i <= slices; ++i)
             {
-                float cosTheta = cosf((float)i / (float)slices * EG_PI * 2);
-                float sinTheta = sinf((float)i / (float)slices * EG_PI * 2);
+                float cosTheta = pCosTheta[i];
+                float sinTheta = pSinTheta[i];
 
                 egNormal(cosTheta * aSinB, -sinTheta * aSinB, cosB);
                 egTangent(-sinTheta, -cosTheta, 0);
@@ -124,10 +222,9 @@ void egSphere(float radius, uint32_t slices, uint32_t stacks, float sfactor)
     egEnd();
 }
 
-void egCylinder(float bottomRadius, float topRadius, float height, uint32_t slices, float sfactor)
+static void emitCylinder(float bottomRadius, float topRadius, float height, uint32_t slices,
+                         const float *pCosTheta, const float *pSinTheta, float sfactor)
 {
-    if (slices < 3) return;
-
     // Caps
     egBegin(EG_POLYGON);
     {
@@ -136,8 +233,8 @@ void egCylinder(float bottomRadius, float topRadius, float height, uint32_t slic
         egBinormal(0, -1, 0);
         for (uint32_t i = 0; i < slices; ++i)
         {
-            float cosTheta = cosf((float)i / (float)slices * EG_PI * 2);
-            float sinTheta = sinf((float)i / (float)slices * EG_PI * 2);
+            float cosTheta = pCosTheta[i];
+            float sinTheta = pSinTheta[i];
             egTexCoord(cosTheta * .5f + .5f, (sinTheta * .5f) + .5f);
             egPosition3(cosTheta * topRadius, -sinTheta * topRadius, height);
         }
@@ -151,8 +248,8 @@ void egCylinder(float bottomRadius, float topRadius, float height, uint32_t slic
         egBinormal(0, 1, 0);
         for (uint32_t i = 0; i < slices; ++i)
         {
-            float cosTheta = cosf((float)i / (float)slices * EG_PI * 2);
-            float sinTheta = sinf((float)i / (float)slices * EG_PI * 2);
+            float cosTheta = pCosTheta[i];
+            float sinTheta = pSinTheta[i];
             egTexCoord(cosTheta * .5f + .5f, sinTheta * .5f + .5f);
             egPosition3(cosTheta * bottomRadius, sinTheta * bottomRadius, 0);
         }
@@ -164,8 +261,8 @@ void egCylinder(float bottomRadius, float topRadius, float height, uint32_t slic
     {
         for (uint32_t i = 0; i <= slices; ++i)
         {
-            float cosTheta = cosf((float)i / (float)slices * EG_PI * 2);
-            float sinTheta = sinf((float)i / (float)slices * EG_PI * 2);
+            float cosTheta = pCosTheta[i];
+            float sinTheta = pSinTheta[i];
             egNormal(cosTheta, -sinTheta, 0);
             egTangent(-sinTheta, -cosTheta, 0);
             egBinormal(0, 0, -1);
@@ -178,6 +275,49 @@ void egCylinder(float bottomRadius, float topRadius, float height, uint32_t slic
     egEnd();
 }
 
+// count + 1 angles from 0 to range, pCos and pSin are then count + 1 floats each
+static float *allocAngles(uint32_t count, float range, float **ppSin)
+{
+    float *pCos = (float *)malloc(sizeof(float) * 2 * (count + 1));
+    if (!pCos) return NULL;
+    *ppSin = pCos + count + 1;
+    for (uint32_t i = 0; i <= count; ++i)
+    {
+        pCos[i] = cosf((float)i / (float)count * range);
+        (*ppSin)[i] = sinf((float)i / (float)count * range);
+    }
+    return pCos;
+}
+
+void egSphere(float radius, uint32_t slices, uint32_t stacks, float sfactor)
+{
+    float *pCosTheta, *pSinTheta, *pCosPhi, *pSinPhi;
+
+    if (slices < 3) return;
+    if (stacks < 2) return;
+
+    pCosTheta = allocAngles(slices, EG_PI * 2, &pSinTheta);
+    pCosPhi = allocAngles(stacks, EG_PI, &pSinPhi);
+    if (pCosTheta && pCosPhi)
+    {
+        emitSphere(radius, slices, stacks, pCosTheta, pSinTheta, pCosPhi, pSinPhi, sfactor);
+    }
+    free(pCosTheta);
+    free(pCosPhi);
+}
+
+void egCylinder(float bottomRadius, float topRadius, float height, uint32_t slices, float sfactor)
+{
+    float *pCosTheta, *pSinTheta;
+
+    if (slices < 3) return;
+
+    pCosTheta = allocAngles(slices, EG_PI * 2, &pSinTheta);
+    if (!pCosTheta) return;
+    emitCylinder(bottomRadius, topRadius, height, slices, pCosTheta, pSinTheta, sfactor);
+    free(pCosTheta);
+}
+
 void egTube(float outterRadius, float innerRadius, float height, uint32_t slices, float sfactor)
 {
     if (slices < 3) return;
@@ -252,3 +392,300 @@ void egTube(float outterRadius, float innerRadius, float height, uint32_t slices
     }
     egEnd();
 }
+
+void egSphereAuto(float radius, float edgeLength, float sfactor)
+{
+    const SEGLodRing *pRing = getLodRing(getLodLevel(getProjectedRadius(0, 0, 0, radius), edgeLength));
+
+    // Stack angles are j * PI / stacks, which land on the ring angles
+    emitSphere(radius, pRing->slices, pRing->slices / 2, pRing->cosTheta, pRing->sinTheta,
+               pRing->cosTheta, pRing->sinTheta, sfactor);
+}
+
+void egCylinderAuto(float bottomRadius, float topRadius, float height, float edgeLength, float sfactor)
+{
+    float radius = bottomRadius > topRadius ? bottomRadius : topRadius;
+    const SEGLodRing *pRing = getLodRing(getLodLevel(getProjectedRadius(0, 0, height * .5f, radius), edgeLength));
+    emitCylinder(bottomRadius, topRadius, height, pRing->slices, pRing->cosTheta, pRing->sinTheta, sfactor);
+}
+
+// Icosphere. Generated once per subdivision level at unit radius, then scaled
+#define ICOSPHERE_MAX_SUBDIVISIONS 6
+#define ICOSPHERE_VERTEX_SIZE 14
+#define ICOSPHERE_CHUNK_SIZE 30000 // Multiple of 3, under the batch size
+
+typedef struct
+{
+    float      *pVertices;
+    uint32_t    vertexCount;
+    uint32_t   *pIndices;
+    uint32_t    indexCount;
+} SEGIcosphere;
+
+static SEGIcosphere icospheres[ICOSPHERE_MAX_SUBDIVISIONS + 1] = {0};
+
+typedef struct
+{
+    uint64_t    key;
+    uint32_t    index;
+} SEGEdgeEntry;
+
+static uint32_t getMidPoint(SEGEdgeEntry *pEdges, uint32_t edgeMask,
+                            float *pPositions, uint32_t *pPositionCount,
+                            uint32_t a, uint32_t b)
+{
+    uint64_t key = a < b ? ((uint64_t)a << 32 | b) : ((uint64_t)b << 32 | a);
+    uint32_t slot = (uint32_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & edgeMask;
+    float *pA = pPositions + a * 3;
+    float *pB = pPositions + b * 3;
+    float *pMid;
+
+    // Linear probing. Keys are never 0 since a != b
+    while (pEdges[slot].key)
+    {
+        if (pEdges[slot].key == key) return pEdges[slot].index;
+        slot = (slot + 1) & edgeMask;
+    }
+
+    pMid = pPositions + *pPositionCount * 3;
+    pMid[0] = pA[0] + pB[0];
+    pMid[1] = pA[1] + pB[1];
+    pMid[2] = pA[2] + pB[2];
+    v3normalize(pMid);
+
+    pEdges[slot].key = key;
+    pEdges[slot].index = (*pPositionCount)++;
+    return pEdges[slot].index;
+}
+
+static float getU(const float *pPosition)
+{
+    float u = atan2f(-pPosition[1], pPosition[0]) / (EG_PI * 2);
+    if (u < 0) u += 1;
+    return u;
+}
+
+static uint32_t addIcosphereVertex(float *pVertices, uint32_t *pVertexCount, const float *pPosition, float u)
+{
+    float *pVertex = pVertices + *pVertexCount * ICOSPHERE_VERTEX_SIZE;
+    float cosTheta = cosf(u * EG_PI * 2);
+    float sinTheta = sinf(u * EG_PI * 2);
+
+    // Position and normal
+    memcpy(pVertex, pPosition, sizeof(float) * 3);
+    memcpy(pVertex + 3, pPosition, sizeof(float) * 3);
+
+    // Tangent follows u, binormal completes the frame
+    pVertex[6] = -sinTheta;
+    pVertex[7] = -cosTheta;
+    pVertex[8] = 0;
+    v3cross(pVertex + 6, pVertex + 3, pVertex + 9);
+
+    // Same mapping as egSphere
+    pVertex[12] = u;
+    pVertex[13] = 1 - pPosition[2] * .5f + .5f;
+
+    return (*pVertexCount)++;
+}
+
+static SEGIcosphere *getIcosphere(uint32_t subdivisions)
+{
+    SEGIcosphere *pIcosphere = icospheres + subdivisions;
+    uint32_t faceCount = 20;
+    uint32_t positionCount = 12;
+    uint32_t maxPositions;
+    uint32_t *pFaces;
+    float *pPositions;
+    uint32_t *pSeamCopies;
+    uint32_t *pVertexOf;
+    float ringZ = 1.f / sqrtf(5.f);
+    float ringA = 2.f / sqrtf(5.f);
+
+    if (pIcosphere->pVertices) return pIcosphere;
+
+    for (uint32_t i = 0; i < subdivisions; ++i) faceCount *= 4;
+    maxPositions = faceCount / 2 + 2;
+
+    pFaces = (uint32_t *)malloc(sizeof(uint32_t) * 3 * faceCount);
+    pPositions = (float *)malloc(sizeof(float) * 3 * maxPositions);
+
+    // Icosahedron with a vertex on each pole, so the poles land on vertices
+    pPositions[0] = 0; pPositions[1] = 0; pPositions[2] = 1;
+    for (uint32_t i = 0; i < 5; ++i)
+    {
+        float top = (float)i / 5.f * EG_PI * 2;
+        float bottom = ((float)i + .5f) / 5.f * EG_PI * 2;
+        pPositions[(1 + i) * 3 + 0] = cosf(top) * ringA;
+        pPositions[(1 + i) * 3 + 1] = -sinf(top) * ringA;
+        pPositions[(1 + i) * 3 + 2] = ringZ;
+        pPositions[(6 + i) * 3 + 0] = cosf(bottom) * ringA;
+        pPositions[(6 + i) * 3 + 1] = -sinf(bottom) * ringA;
+        pPositions[(6 + i) * 3 + 2] = -ringZ;
+    }
+    pPositions[33] = 0; pPositions[34] = 0; pPositions[35] = -1;
+    for (uint32_t i = 0; i < 5; ++i)
+    {
+        uint32_t next = (i + 1) % 5;
+        uint32_t *pFace = pFaces + i * 12;
+        pFace[0] = 0;        pFace[1] = 1 + next; pFace[2] = 1 + i;
+        pFace[3] = 1 + i;    pFace[4] = 1 + next; pFace[5] = 6 + i;
+        pFace[6] = 1 + next; pFace[7] = 6 + next; pFace[8] = 6 + i;
+        pFace[9] = 6 + i;    pFace[10] = 6 + next; pFace[11] = 11;
+    }
+
+    // Split every triangle in 4. Midpoints are shared through an edge hash
+    faceCount = 20;
+    for (uint32_t level = 0; level < subdivisions; ++level)
+    {
+        uint32_t edgeCapacity = 64;
+        SEGEdgeEntry *pEdges;
+        while (edgeCapacity < faceCount * 3) edgeCapacity *= 2;
+        pEdges = (SEGEdgeEntry *)calloc(edgeCapacity, sizeof(SEGEdgeEntry));
+
+        // Work backward so the new faces don't overwrite unread ones
+        for (int f = (int)faceCount - 1; f >= 0; --f)
+        {
+            uint32_t a = pFaces[f * 3 + 0];
+            uint32_t b = pFaces[f * 3 + 1];
+            uint32_t c = pFaces[f * 3 + 2];
+            uint32_t ab = getMidPoint(pEdges, edgeCapacity - 1, pPositions, &positionCount, a, b);
+            uint32_t bc = getMidPoint(pEdges, edgeCapacity - 1, pPositions, &positionCount, b, c);
+            uint32_t ca = getMidPoint(pEdges, edgeCapacity - 1, pPositions, &positionCount, c, a);
+            uint32_t *pFace = pFaces + f * 12;
+            pFace[0] = a;  pFace[1] = ab;  pFace[2] = ca;
+            pFace[3] = ab; pFace[4] = b;   pFace[5] = bc;
+            pFace[6] = ca; pFace[7] = bc;  pFace[8] = c;
+            pFace[9] = ab; pFace[10] = bc; pFace[11] = ca;
+        }
+
+        free(pEdges);
+        faceCount *= 4;
+    }
+
+    // Build the final vertices. Positions are welded, except across the
+    // texture seam, and at the poles which get one copy per triangle.
+    pIcosphere->pVertices = (float *)malloc(sizeof(float) * ICOSPHERE_VERTEX_SIZE * (positionCount * 2 + faceCount));
+    pIcosphere->pIndices = (uint32_t *)malloc(sizeof(uint32_t) * 3 * faceCount);
+    pSeamCopies = (uint32_t *)malloc(sizeof(uint32_t) * positionCount * 2);
+    pVertexOf = pSeamCopies + positionCount;
+    for (uint32_t i = 0; i < positionCount; ++i)
+    {
+        pSeamCopies[i] = 0xffffffff;
+        pVertexOf[i] = 0xffffffff;
+    }
+
+    for (uint32_t f = 0; f < faceCount; ++f)
+    {
+        uint32_t *pFace = pFaces + f * 3;
+        uint32_t *pOut = pIcosphere->pIndices + f * 3;
+        float u[3];
+        float minU = 1, maxU = 0, sumU = 0;
+        int poleCorner = -1;
+
+        for (int i = 0; i < 3; ++i)
+        {
+            if (pFace[i] == 0 || pFace[i] == 11)
+            {
+                poleCorner = i;
+                continue;
+            }
+            u[i] = getU(pPositions + pFace[i] * 3);
+            if (u[i] < minU) minU = u[i];
+            if (u[i] > maxU) maxU = u[i];
+        }
+
+        // Wrap the corners that are across the seam
+        for (int i = 0; i < 3; ++i)
+        {
+            uint32_t index = pFace[i];
+            if (i == poleCorner) continue;
+            if (maxU - minU > .5f && u[i] < .5f)
+            {
+                u[i] += 1;
+                if (pSeamCopies[index] == 0xffffffff)
+                {
+                    pSeamCopies[index] = addIcosphereVertex(pIcosphere->pVertices, &pIcosphere->vertexCount, pPositions + index * 3, u[i]);
+                }
+                pOut[i] = pSeamCopies[index];
+            }
+            else
+            {
+                if (pVertexOf[index] == 0xffffffff)
+                {
+                    pVertexOf[index] = addIcosphereVertex(pIcosphere->pVertices, &pIcosphere->vertexCount, pPositions + index * 3, u[i]);
+                }
+                pOut[i] = pVertexOf[index];
+            }
+            sumU += u[i];
+        }
+
+        if (poleCorner >= 0)
+        {
+            pOut[poleCorner] = addIcosphereVertex(pIcosphere->pVertices, &pIcosphere->vertexCount, pPositions + pFace[poleCorner] * 3, sumU * .5f);
+        }
+    }
+    pIcosphere->indexCount = faceCount * 3;
+
+    free(pSeamCopies);
+    free(pPositions);
+    free(pFaces);
+
+    return pIcosphere;
+}
+
+void egGetIcosphere(float radius, uint32_t subdivisions, float sfactor,
+                    float *pVertices, uint32_t *pVertexCount,
+                    uint32_t *pIndices, uint32_t *pIndexCount)
+{
+    SEGIcosphere *pIcosphere;
+
+    if (subdivisions > ICOSPHERE_MAX_SUBDIVISIONS) subdivisions = ICOSPHERE_MAX_SUBDIVISIONS;
+    pIcosphere = getIcosphere(subdivisions);
+
+    if (pVertexCount) *pVertexCount = pIcosphere->vertexCount;
+    if (pIndexCount) *pIndexCount = pIcosphere->indexCount;
+    if (pVertices)
+    {
+        memcpy(pVertices, pIcosphere->pVertices, sizeof(float) * ICOSPHERE_VERTEX_SIZE * pIcosphere->vertexCount);
+        for (uint32_t i = 0; i < pIcosphere->vertexCount; ++i)
+        {
+            float *pVertex = pVertices + i * ICOSPHERE_VERTEX_SIZE;
+            pVertex[0] *= radius;
+            pVertex[1] *= radius;
+            pVertex[2] *= radius;
+            pVertex[12] *= sfactor;
+        }
+    }
+    if (pIndices)
+    {
+        memcpy(pIndices, pIcosphere->pIndices, sizeof(uint32_t) * pIcosphere->indexCount);
+    }
+}
+
+void egIcosphere(float radius, uint32_t subdivisions, float sfactor)
+{
+    SEGIcosphere *pIcosphere;
+
+    if (subdivisions > ICOSPHERE_MAX_SUBDIVISIONS) subdivisions = ICOSPHERE_MAX_SUBDIVISIONS;
+    pIcosphere = getIcosphere(subdivisions);
+
+    // The batch has no index buffer, expand the triangles
+    egBegin(EG_TRIANGLES);
+    {
+        for (uint32_t i = 0; i < pIcosphere->indexCount; ++i)
+        {
+            const float *pVertex = pIcosphere->pVertices + pIcosphere->pIndices[i] * ICOSPHERE_VERTEX_SIZE;
+            if (i && i % ICOSPHERE_CHUNK_SIZE == 0)
+            {
+                egEnd();
+                egBegin(EG_TRIANGLES);
+            }
+            egNormal(pVertex[3], pVertex[4], pVertex[5]);
+            egTangent(pVertex[6], pVertex[7], pVertex[8]);
+            egBinormal(pVertex[9], pVertex[10], pVertex[11]);
+            egTexCoord(pVertex[12] * sfactor, pVertex[13]);
+            egPosition3(pVertex[0] * radius, pVertex[1] * radius, pVertex[2] * radius);
+        }
+    }
+    egEnd();
+}
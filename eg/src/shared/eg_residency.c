@@ -0,0 +1,86 @@
+#include <string.h>
+#include "eg_residency.h"
+
+static void unlinkResident(SEGResidency *pResidency, SEGResident *pResident)
+{
+    if (pResident->pPrev) pResident->pPrev->pNext = pResident->pNext;
+    else pResidency->pLeastRecent = pResident->pNext;
+    if (pResident->pNext) pResident->pNext->pPrev = pResident->pPrev;
+    else pResidency->pMostRecent = pResident->pPrev;
+    pResident->pPrev = NULL;
+    pResident->pNext = NULL;
+}
+
+static void linkMostRecent(SEGResidency *pResidency, SEGResident *pResident)
+{
+    pResident->pPrev = pResidency->pMostRecent;
+    pResident->pNext = NULL;
+    if (pResidency->pMostRecent) pResidency->pMostRecent->pNext = pResident;
+    else pResidency->pLeastRecent = pResident;
+    pResidency->pMostRecent = pResident;
+}
+
+void initResidency(SEGResidency *pResidency)
+{
+    memset(pResidency, 0, sizeof(SEGResidency));
+}
+
+void trackResident(SEGResidency *pResidency, SEGResident *pResident, int bEvictable)
+{
+    if (pResident->bTracked) untrackResident(pResidency, pResident);
+    if (pResident->category >= RESIDENCY_CATEGORY_COUNT) return;
+
+    pResidency->bytes[pResident->category] += pResident->bytes;
+    ++pResidency->counts[pResident->category];
+    pResident->trackedBytes = pResident->bytes;
+    pResident->bTracked = 1;
+    pResident->bEvictable = bEvictable;
+    pResident->lastUseFrame = pResidency->frame;
+    if (bEvictable) linkMostRecent(pResidency, pResident);
+}
+
+void untrackResident(SEGResidency *pResidency, SEGResident *pResident)
+{
+    if (!pResident->bTracked) return;
+
+    pResidency->bytes[pResident->category] -= pResident->trackedBytes;
+    --pResidency->counts[pResident->category];
+    if (pResident->bEvictable) unlinkResident(pResidency, pResident);
+    pResident->bTracked = 0;
+    pResident->bEvictable = 0;
+}
+
+void touchResident(SEGResidency *pResidency, SEGResident *pResident)
+{
+    if (!pResident->bTracked) return;
+
+    pResident->lastUseFrame = pResidency->frame;
+    if (pResident->bEvictable && pResidency->pMostRecent != pResident)
+    {
+        unlinkResident(pResidency, pResident);
+        linkMostRecent(pResidency, pResident);
+    }
+}
+
+void nextResidencyFrame(SEGResidency *pResidency)
+{
+    ++pResidency->frame;
+}
+
+uint64_t getResidentBytes(const SEGResidency *pResidency)
+{
+    uint64_t bytes = 0;
+    for (uint32_t i = 0; i < RESIDENCY_CATEGORY_COUNT; ++i) bytes += pResidency->bytes[i];
+    return bytes;
+}
+
+SEGResident *getEvictionCandidate(const SEGResidency *pResidency)
+{
+    if (!pResidency->budget) return NULL;
+    if (getResidentBytes(pResidency) <= pResidency->budget) return NULL;
+
+    // The list is in use order, so the head is the only candidate
+    SEGResident *pResident = pResidency->pLeastRecent;
+    if (!pResident || pResident->lastUseFrame == pResidency->frame) return NULL;
+    return pResident;
+}
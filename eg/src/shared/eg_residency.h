@@ -0,0 +1,59 @@
+#pragma once
+
+#ifndef EG_RESIDENCY_H_INCLUDED
+#define EG_RESIDENCY_H_INCLUDED
+
+#include <inttypes.h>
+
+#define RESIDENCY_TEXTURES          0
+#define RESIDENCY_RENDER_TARGETS    1
+#define RESIDENCY_G_BUFFER          2
+#define RESIDENCY_BLUR_BUFFERS      3
+#define RESIDENCY_CATEGORY_COUNT    4
+
+// Embedded in the tracked object. Only evictable residents are linked, and
+// they must not move while tracked. Nothing points back to the SEGResidency,
+// so it can move.
+typedef struct SEGResident
+{
+    struct SEGResident *pPrev;
+    struct SEGResident *pNext;
+    uint64_t            bytes;
+    uint64_t            trackedBytes;   // What bytes was when tracked
+    uint64_t            lastUseFrame;
+    uint32_t            category;
+    int                 bTracked;
+    int                 bEvictable;
+} SEGResident;
+
+// Memory accounting, with a least recently used list of what can be evicted
+typedef struct
+{
+    SEGResident    *pLeastRecent;
+    SEGResident    *pMostRecent;
+    uint64_t        bytes[RESIDENCY_CATEGORY_COUNT];
+    uint32_t        counts[RESIDENCY_CATEGORY_COUNT];
+    uint64_t        budget;         // 0 for no budget
+    uint64_t        frame;
+    uint32_t        evictionCount;
+    uint32_t        reloadCount;
+} SEGResidency;
+
+void initResidency(SEGResidency *pResidency);
+
+// Accounts for pResident->bytes in pResident->category. Tracking again
+// updates the size.
+void trackResident(SEGResidency *pResidency, SEGResident *pResident, int bEvictable);
+void untrackResident(SEGResidency *pResidency, SEGResident *pResident);
+
+// Marks as used this frame
+void touchResident(SEGResidency *pResidency, SEGResident *pResident);
+
+void nextResidencyFrame(SEGResidency *pResidency);
+uint64_t getResidentBytes(const SEGResidency *pResidency);
+
+// Least recently used evictable resident while over budget. Residents used
+// this frame are never returned. NULL when nothing should be evicted.
+SEGResident *getEvictionCandidate(const SEGResidency *pResidency);
+
+#endif /* EG_RESIDENCY_H_INCLUDED */
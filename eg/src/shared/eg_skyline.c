@@ -0,0 +1,126 @@
+#include <stdlib.h>
+#include <string.h>
+#include "eg_skyline.h"
+
+void initSkyline(SEGSkyline *pSkyline, uint32_t w, uint32_t h)
+{
+    memset(pSkyline, 0, sizeof(SEGSkyline));
+    pSkyline->w = w;
+    pSkyline->h = h;
+    resetSkyline(pSkyline);
+}
+
+void destroySkyline(SEGSkyline *pSkyline)
+{
+    if (pSkyline->pNodes) free(pSkyline->pNodes);
+    memset(pSkyline, 0, sizeof(SEGSkyline));
+}
+
+void resetSkyline(SEGSkyline *pSkyline)
+{
+    if (!pSkyline->pNodes)
+    {
+        pSkyline->nodeCapacity = 16;
+        pSkyline->pNodes = (SEGSkylineNode *)malloc(sizeof(SEGSkylineNode) * pSkyline->nodeCapacity);
+    }
+    pSkyline->pNodes[0].x = 0;
+    pSkyline->pNodes[0].y = 0;
+    pSkyline->pNodes[0].w = pSkyline->w;
+    pSkyline->nodeCount = 1;
+    pSkyline->usedArea = 0;
+}
+
+// Lowest y a w x h rectangle can sit at, starting on node index. Returns
+// 0xffffffff if it doesn't fit.
+static uint32_t fitSkyline(const SEGSkyline *pSkyline, uint32_t index, uint32_t w, uint32_t h)
+{
+    const SEGSkylineNode *pNode = pSkyline->pNodes + index;
+    if (pNode->x + w > pSkyline->w) return 0xffffffff;
+
+    uint32_t y = 0;
+    uint32_t remaining = w;
+    while (remaining)
+    {
+        if (pNode->y > y) y = pNode->y;
+        if (y + h > pSkyline->h) return 0xffffffff;
+        if (pNode->w >= remaining) break;
+        remaining -= pNode->w;
+        ++pNode;
+    }
+    return y;
+}
+
+int skylineInsert(SEGSkyline *pSkyline, uint32_t w, uint32_t h, uint32_t *pX, uint32_t *pY)
+{
+    uint32_t bestIndex = 0xffffffff;
+    uint32_t bestTop = 0xffffffff;
+    uint32_t bestWidth = 0xffffffff;
+    uint32_t bestY = 0;
+
+    if (!w || !h) return 0;
+
+    // Lowest top first, then the narrowest segment to waste less
+    for (uint32_t i = 0; i < pSkyline->nodeCount; ++i)
+    {
+        uint32_t y = fitSkyline(pSkyline, i, w, h);
+        if (y == 0xffffffff) continue;
+        if (y + h < bestTop || (y + h == bestTop && pSkyline->pNodes[i].w < bestWidth))
+        {
+            bestIndex = i;
+            bestTop = y + h;
+            bestWidth = pSkyline->pNodes[i].w;
+            bestY = y;
+        }
+    }
+    if (bestIndex == 0xffffffff) return 0;
+
+    if (pSkyline->nodeCount == pSkyline->nodeCapacity)
+    {
+        SEGSkylineNode *pNodes = (SEGSkylineNode *)realloc(pSkyline->pNodes, sizeof(SEGSkylineNode) * pSkyline->nodeCapacity * 2);
+        if (!pNodes) return 0;
+        pSkyline->pNodes = pNodes;
+        pSkyline->nodeCapacity *= 2;
+    }
+
+    // Insert the new segment, then trim the ones it covers
+    SEGSkylineNode *pNodes = pSkyline->pNodes;
+    uint32_t x = pNodes[bestIndex].x;
+    memmove(pNodes + bestIndex + 1, pNodes + bestIndex, sizeof(SEGSkylineNode) * (pSkyline->nodeCount - bestIndex));
+    pNodes[bestIndex].x = x;
+    pNodes[bestIndex].y = bestY + h;
+    pNodes[bestIndex].w = w;
+    ++pSkyline->nodeCount;
+
+    uint32_t i = bestIndex + 1;
+    while (i < pSkyline->nodeCount)
+    {
+        uint32_t right = pNodes[bestIndex].x + pNodes[bestIndex].w;
+        if (pNodes[i].x >= right) break;
+        uint32_t shrink = right - pNodes[i].x;
+        if (shrink < pNodes[i].w)
+        {
+            pNodes[i].x += shrink;
+            pNodes[i].w -= shrink;
+            break;
+        }
+        memmove(pNodes + i, pNodes + i + 1, sizeof(SEGSkylineNode) * (pSkyline->nodeCount - i - 1));
+        --pSkyline->nodeCount;
+    }
+
+    // Merge neighbours at the same height
+    for (i = 0; i + 1 < pSkyline->nodeCount;)
+    {
+        if (pNodes[i].y == pNodes[i + 1].y)
+        {
+            pNodes[i].w += pNodes[i + 1].w;
+            memmove(pNodes + i + 1, pNodes + i + 2, sizeof(SEGSkylineNode) * (pSkyline->nodeCount - i - 2));
+            --pSkyline->nodeCount;
+        }
+        else ++i;
+    }
+
+    pSkyline->usedArea += (uint64_t)w * h;
+    *pX = x;
+    *pY = bestY;
+    return 1;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#ifndef EG_SKYLINE_H_INCLUDED
+#define EG_SKYLINE_H_INCLUDED
+
+#include <inttypes.h>
+
+typedef struct
+{
+    uint32_t    x, y, w;
+} SEGSkylineNode;
+
+// Skyline rectangle packer. Space is never given back, repack to reclaim it.
+typedef struct
+{
+    uint32_t        w, h;
+    SEGSkylineNode *pNodes;
+    uint32_t        nodeCount;
+    uint32_t        nodeCapacity;
+    uint64_t        usedArea;
+} SEGSkyline;
+
+void initSkyline(SEGSkyline *pSkyline, uint32_t w, uint32_t h);
+void destroySkyline(SEGSkyline *pSkyline);
+void resetSkyline(SEGSkyline *pSkyline);
+
+// Bottom-left placement. Returns 0 if the rectangle doesn't fit.
+int skylineInsert(SEGSkyline *pSkyline, uint32_t w, uint32_t h, uint32_t *pX, uint32_t *pY);
+
+#endif /* EG_SKYLINE_H_INCLUDED */
@@ -0,0 +1,323 @@
+#include <stdlib.h>
+#if defined(WIN32) || defined(_WIN32)
+#include <Windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+#include "eg_thread.h"
+
+#define MAX_THREADS 64
+
+#if defined(WIN32) || defined(_WIN32)
+typedef CRITICAL_SECTION    EGLock;
+typedef CONDITION_VARIABLE  EGCondition;
+typedef HANDLE              EGThread;
+#define initLock(pLock)             InitializeCriticalSection(pLock)
+#define deleteLock(pLock)           DeleteCriticalSection(pLock)
+#define enterLock(pLock)            EnterCriticalSection(pLock)
+#define leaveLock(pLock)            LeaveCriticalSection(pLock)
+#define initCondition(pCond)        InitializeConditionVariable(pCond)
+#define deleteCondition(pCond)
+#define waitCondition(pCond, pLock) SleepConditionVariableCS(pCond, pLock, INFINITE)
+#define wakeAll(pCond)              WakeAllConditionVariable(pCond)
+#define THREAD_LOCAL                __declspec(thread)
+#else
+typedef pthread_mutex_t     EGLock;
+typedef pthread_cond_t      EGCondition;
+typedef pthread_t           EGThread;
+#define initLock(pLock)             pthread_mutex_init(pLock, NULL)
+#define deleteLock(pLock)           pthread_mutex_destroy(pLock)
+#define enterLock(pLock)            pthread_mutex_lock(pLock)
+#define leaveLock(pLock)            pthread_mutex_unlock(pLock)
+#define initCondition(pCond)        pthread_cond_init(pCond, NULL)
+#define deleteCondition(pCond)      pthread_cond_destroy(pCond)
+#define waitCondition(pCond, pLock) pthread_cond_wait(pCond, pLock)
+#define wakeAll(pCond)              pthread_cond_broadcast(pCond)
+#define THREAD_LOCAL                __thread
+#endif
+
+// Set on the threads of a worker pool
+static THREAD_LOCAL int bWorkerThread = 0;
+
+typedef struct
+{
+    EGParallelForFn fn;
+    void           *pData;
+    uint32_t        begin;
+    uint32_t        end;
+} SEGParallelRange;
+
+#if defined(WIN32) || defined(_WIN32)
+static DWORD WINAPI parallelRangeProc(LPVOID pParam)
+{
+    SEGParallelRange *pRange = (SEGParallelRange *)pParam;
+    pRange->fn(pRange->pData, pRange->begin, pRange->end);
+    return 0;
+}
+#else
+static void *parallelRangeProc(void *pParam)
+{
+    SEGParallelRange *pRange = (SEGParallelRange *)pParam;
+    pRange->fn(pRange->pData, pRange->begin, pRange->end);
+    return NULL;
+}
+#endif
+
+#if defined(WIN32) || defined(_WIN32)
+static BOOL CALLBACK onceProc(PINIT_ONCE pInitOnce, PVOID pParam, PVOID *ppContext)
+{
+    ((EGOnceFn)pParam)();
+    return TRUE;
+}
+#endif
+
+void callOnce(EGOnce *pOnce, EGOnceFn fn)
+{
+#if defined(WIN32) || defined(_WIN32)
+    InitOnceExecuteOnce((PINIT_ONCE)pOnce, onceProc, (PVOID)fn, NULL);
+#else
+    pthread_once(pOnce, fn);
+#endif
+}
+
+static uint32_t hardwareThreadCount = 1;
+static EGOnce hardwareThreadCountOnce = EG_ONCE_INIT;
+
+static void initHardwareThreadCount()
+{
+#if defined(WIN32) || defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    hardwareThreadCount = (uint32_t)info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    hardwareThreadCount = count > 0 ? (uint32_t)count : 1;
+#endif
+    if (hardwareThreadCount < 1) hardwareThreadCount = 1;
+    if (hardwareThreadCount > MAX_THREADS) hardwareThreadCount = MAX_THREADS;
+}
+
+uint32_t getHardwareThreadCount()
+{
+    callOnce(&hardwareThreadCountOnce, initHardwareThreadCount);
+    return hardwareThreadCount;
+}
+
+void parallelFor(uint32_t count, uint32_t minBatch, EGParallelForFn fn, void *pData)
+{
+    SEGParallelRange ranges[MAX_THREADS];
+#if defined(WIN32) || defined(_WIN32)
+    HANDLE threads[MAX_THREADS];
+#else
+    pthread_t threads[MAX_THREADS];
+#endif
+    uint32_t threadCount = getHardwareThreadCount();
+    uint32_t started = 0;
+
+    if (!count) return;
+    if (minBatch < 1) minBatch = 1;
+    if (threadCount > count / minBatch) threadCount = count / minBatch;
+    if (threadCount <= 1 || bWorkerThread)
+    {
+        fn(pData, 0, count);
+        return;
+    }
+
+    for (uint32_t i = 0; i < threadCount; ++i)
+    {
+        ranges[i].fn = fn;
+        ranges[i].pData = pData;
+        ranges[i].begin = (uint32_t)((uint64_t)count * i / threadCount);
+        ranges[i].end = (uint32_t)((uint64_t)count * (i + 1) / threadCount);
+    }
+
+    // Last range runs here. If a thread fails to start, its range also runs here
+    for (uint32_t i = 0; i < threadCount - 1; ++i)
+    {
+#if defined(WIN32) || defined(_WIN32)
+        threads[started] = CreateThread(NULL, 0, parallelRangeProc, ranges + i, 0, NULL);
+        if (threads[started]) ++started;
+#else
+        if (pthread_create(threads + started, NULL, parallelRangeProc, ranges + i) == 0) ++started;
+#endif
+        else fn(pData, ranges[i].begin, ranges[i].end);
+    }
+    fn(pData, ranges[threadCount - 1].begin, ranges[threadCount - 1].end);
+
+#if defined(WIN32) || defined(_WIN32)
+    WaitForMultipleObjects(started, threads, TRUE, INFINITE);
+    for (uint32_t i = 0; i < started; ++i) CloseHandle(threads[i]);
+#else
+    for (uint32_t i = 0; i < started; ++i) pthread_join(threads[i], NULL);
+#endif
+}
+
+struct SEGMutex
+{
+    EGLock  lock;
+};
+
+SEGMutex *createMutex()
+{
+    SEGMutex *pMutex = (SEGMutex *)malloc(sizeof(SEGMutex));
+    if (!pMutex) return NULL;
+    initLock(&pMutex->lock);
+    return pMutex;
+}
+
+void destroyMutex(SEGMutex *pMutex)
+{
+    if (!pMutex) return;
+    deleteLock(&pMutex->lock);
+    free(pMutex);
+}
+
+void lockMutex(SEGMutex *pMutex)
+{
+    enterLock(&pMutex->lock);
+}
+
+void unlockMutex(SEGMutex *pMutex)
+{
+    leaveLock(&pMutex->lock);
+}
+
+typedef struct SEGJob
+{
+    EGJobFn         fn;
+    void           *pData;
+    struct SEGJob  *pNext;
+} SEGJob;
+
+struct SEGWorkerPool
+{
+    EGLock          lock;
+    EGCondition     hasJobs;
+    EGCondition     isIdle;
+    SEGJob         *pHead;
+    SEGJob         *pTail;
+    uint32_t        runningCount;
+    int             bQuit;
+    EGThread        threads[MAX_THREADS];
+    uint32_t        threadCount;
+};
+
+static void workerLoop(SEGWorkerPool *pPool)
+{
+    bWorkerThread = 1;
+    enterLock(&pPool->lock);
+    while (1)
+    {
+        while (!pPool->pHead && !pPool->bQuit) waitCondition(&pPool->hasJobs, &pPool->lock);
+        if (!pPool->pHead) break; // Quit once the queue is drained
+
+        SEGJob *pJob = pPool->pHead;
+        pPool->pHead = pJob->pNext;
+        if (!pPool->pHead) pPool->pTail = NULL;
+        ++pPool->runningCount;
+        leaveLock(&pPool->lock);
+
+        pJob->fn(pJob->pData);
+        free(pJob);
+
+        enterLock(&pPool->lock);
+        --pPool->runningCount;
+        if (!pPool->pHead && !pPool->runningCount) wakeAll(&pPool->isIdle);
+    }
+    leaveLock(&pPool->lock);
+}
+
+#if defined(WIN32) || defined(_WIN32)
+static DWORD WINAPI workerProc(LPVOID pParam)
+{
+    workerLoop((SEGWorkerPool *)pParam);
+    return 0;
+}
+#else
+static void *workerProc(void *pParam)
+{
+    workerLoop((SEGWorkerPool *)pParam);
+    return NULL;
+}
+#endif
+
+SEGWorkerPool *createWorkerPool(uint32_t threadCount)
+{
+    SEGWorkerPool *pPool = (SEGWorkerPool *)calloc(1, sizeof(SEGWorkerPool));
+    if (!pPool) return NULL;
+    initLock(&pPool->lock);
+    initCondition(&pPool->hasJobs);
+    initCondition(&pPool->isIdle);
+
+    if (!threadCount) threadCount = getHardwareThreadCount();
+    if (threadCount > MAX_THREADS) threadCount = MAX_THREADS;
+    for (uint32_t i = 0; i < threadCount; ++i)
+    {
+#if defined(WIN32) || defined(_WIN32)
+        pPool->threads[pPool->threadCount] = CreateThread(NULL, 0, workerProc, pPool, 0, NULL);
+        if (pPool->threads[pPool->threadCount]) ++pPool->threadCount;
+#else
+        if (pthread_create(pPool->threads + pPool->threadCount, NULL, workerProc, pPool) == 0) ++pPool->threadCount;
+#endif
+    }
+    return pPool;
+}
+
+void destroyWorkerPool(SEGWorkerPool *pPool)
+{
+    if (!pPool) return;
+
+    enterLock(&pPool->lock);
+    pPool->bQuit = 1;
+    wakeAll(&pPool->hasJobs);
+    leaveLock(&pPool->lock);
+
+#if defined(WIN32) || defined(_WIN32)
+    for (uint32_t i = 0; i < pPool->threadCount; ++i)
+    {
+        WaitForSingleObject(pPool->threads[i], INFINITE);
+        CloseHandle(pPool->threads[i]);
+    }
+#else
+    for (uint32_t i = 0; i < pPool->threadCount; ++i) pthread_join(pPool->threads[i], NULL);
+#endif
+
+    deleteCondition(&pPool->isIdle);
+    deleteCondition(&pPool->hasJobs);
+    deleteLock(&pPool->lock);
+    free(pPool);
+}
+
+uint32_t getWorkerCount(const SEGWorkerPool *pPool)
+{
+    return pPool->threadCount;
+}
+
+void pushJob(SEGWorkerPool *pPool, EGJobFn fn, void *pData)
+{
+    SEGJob *pJob = NULL;
+    if (pPool->threadCount) pJob = (SEGJob *)malloc(sizeof(SEGJob));
+    if (!pJob)
+    {
+        fn(pData);
+        return;
+    }
+    pJob->fn = fn;
+    pJob->pData = pData;
+    pJob->pNext = NULL;
+
+    enterLock(&pPool->lock);
+    if (pPool->pTail) pPool->pTail->pNext = pJob;
+    else pPool->pHead = pJob;
+    pPool->pTail = pJob;
+    wakeAll(&pPool->hasJobs);
+    leaveLock(&pPool->lock);
+}
+
+void waitWorkerPool(SEGWorkerPool *pPool)
+{
+    enterLock(&pPool->lock);
+    while (pPool->pHead || pPool->runningCount) waitCondition(&pPool->isIdle, &pPool->lock);
+    leaveLock(&pPool->lock);
+}
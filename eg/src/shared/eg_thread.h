@@ -0,0 +1,62 @@
+#pragma once
+
+#ifndef EG_THREAD_H_INCLUDED
+#define EG_THREAD_H_INCLUDED
+
+#include <inttypes.h>
+#if !defined(WIN32) && !defined(_WIN32)
+#include <pthread.h>
+#endif
+
+// Process items [begin, end)
+typedef void (*EGParallelForFn)(void *pData, uint32_t begin, uint32_t end);
+
+uint32_t getHardwareThreadCount();
+
+// Split count items in ranges of at least minBatch items, and run them on
+// worker threads. The calling thread takes a range too, and returns when
+// all ranges are done. On a worker pool thread, the pool already keeps the
+// cores busy, so all items run on the calling thread.
+void parallelFor(uint32_t count, uint32_t minBatch, EGParallelForFn fn, void *pData);
+
+// One time initialization. Threads calling callOnce at the same time wait
+// until fn has returned.
+#if defined(WIN32) || defined(_WIN32)
+typedef struct { void *pState; } EGOnce; // Same layout as INIT_ONCE
+#define EG_ONCE_INIT {NULL}
+#else
+typedef pthread_once_t EGOnce;
+#define EG_ONCE_INIT PTHREAD_ONCE_INIT
+#endif
+
+typedef void (*EGOnceFn)(void);
+
+void callOnce(EGOnce *pOnce, EGOnceFn fn);
+
+typedef struct SEGMutex SEGMutex;
+
+SEGMutex *createMutex();
+void destroyMutex(SEGMutex *pMutex);
+void lockMutex(SEGMutex *pMutex);
+void unlockMutex(SEGMutex *pMutex);
+
+typedef void (*EGJobFn)(void *pData);
+
+// Persistent threads running jobs in the order they were pushed
+typedef struct SEGWorkerPool SEGWorkerPool;
+
+// threadCount 0 uses one thread per hardware thread
+SEGWorkerPool *createWorkerPool(uint32_t threadCount);
+
+// Finishes the queued jobs, then joins the threads
+void destroyWorkerPool(SEGWorkerPool *pPool);
+
+uint32_t getWorkerCount(const SEGWorkerPool *pPool);
+
+// If the pool has no thread, the job runs right away on the calling thread
+void pushJob(SEGWorkerPool *pPool, EGJobFn fn, void *pData);
+
+// Returns when the queue is empty and no job is running
+void waitWorkerPool(SEGWorkerPool *pPool);
+
+#endif /* EG_THREAD_H_INCLUDED */
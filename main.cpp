@@ -1,7 +1,9 @@
 #include <assert.h>
+#include <stdio.h>
 #include <Windows.h>
 #include "eg.h"
 #include "LodePNG.h"
+#include "dfr.h"
 
 #define RESOLUTION_W 1280
 #define RESOLUTION_H 720
@@ -36,75 +38,136 @@ struct sMesh
 
 sMesh ogreMesh;
 
-void init()
+uint32_t decodePNG(const void *pFileData, uint32_t fileSize, uint8_t **ppPixels, uint32_t *pWidth, uint32_t *pHeight)
 {
-    // Create device
-    device = egCreateDevice(windowHandle);
+    unsigned int w, h;
+    unsigned int ret = lodepng_decode32(ppPixels, &w, &h, (const unsigned char *)pFileData, fileSize);
+    *pWidth = w;
+    *pHeight = h;
+    return ret;
+}
 
-    // Load textures
+uint32_t decodePNGInto(const void *pFileData, uint32_t fileSize, EGImageAllocator allocate, void *pContext)
+{
     unsigned int w, h;
+    lodepng::State pngState;
+    unsigned int ret = lodepng_inspect(&w, &h, &pngState, (const unsigned char *)pFileData, fileSize);
+    if (ret) return ret;
+    uint8_t *pPixels = allocate(pContext, w, h);
+    if (!pPixels) return 83;
+    return lodepng_decode_into(pPixels, w * 4, &pngState, (const unsigned char *)pFileData, fileSize);
+}
+
+// Glyphs of dfr::layoutText go in an atlas, white with the coverage as alpha
+unsigned int insertGlyph(void *pContext, int width, int height, const unsigned char *pCoverage)
+{
+    std::vector<uint32_t> pixels((size_t)width * height);
+    for (size_t i = 0; i < pixels.size(); ++i) pixels[i] = ((uint32_t)pCoverage[i] << 24) | 0xffffff;
+    return egAtlasInsert(*(EGAtlas *)pContext, width, height, pixels.data(), (EGFormat)(EG_U8 | EG_RGBA));
+}
+
+void removeGlyph(void *pContext, unsigned int entry)
+{
+    egAtlasRemove(*(EGAtlas *)pContext, &entry);
+}
+
+// One quad per glyph, with a texture change only when the glyphs are on
+// different atlas pages. Blending is up to the bound state.
+void drawGlyphQuads(EGAtlas atlas, const std::vector<dfr::sGlyphQuad> &quads, float x, float y)
+{
+    // Get the entries first, their pages upload if they changed
+    std::vector<float> uvs(quads.size() * 4);
+    std::vector<EGTexture> pages(quads.size());
+    for (size_t i = 0; i < quads.size(); ++i) pages[i] = egAtlasGetEntry(atlas, quads[i].entry, &uvs[i * 4]);
+
+    EGTexture page = 0;
+    for (size_t i = 0; i < quads.size(); ++i)
     {
-        std::vector<unsigned char> image;
-        auto ret = lodepng::decode(image, w, h, "d01.png");
-        assert(!ret);
-        diffuseFloor = egCreateTexture2D(w, h, image.data(), EG_U8 | EG_RGBA, EG_GENERATE_MIPMAPS);
-    }
-    {
-        std::vector<unsigned char> image;
-        auto ret = lodepng::decode(image, w, h, "n01.png");
-        assert(!ret);
-        normalFloor = egCreateTexture2D(w, h, image.data(), EG_U8 | EG_RGBA, EG_GENERATE_MIPMAPS);
-    }
-    {
-        std::vector<unsigned char> image;
-        auto ret = lodepng::decode(image, w, h, "m01.png");
-        assert(!ret);
-        materialFloor = egCreateTexture2D(w, h, image.data(), EG_U8 | EG_RGBA, EG_GENERATE_MIPMAPS);
-    }
-    {
-        std::vector<unsigned char> image;
-        auto ret = lodepng::decode(image, w, h, "d02.png");
-        assert(!ret);
-        diffuse = egCreateTexture2D(w, h, image.data(), EG_U8 | EG_RGBA, EG_GENERATE_MIPMAPS);
-    }
-    {
-        std::vector<unsigned char> image;
-        auto ret = lodepng::decode(image, w, h, "n02.png");
-        assert(!ret);
-        normal = egCreateTexture2D(w, h, image.data(), EG_U8 | EG_RGBA, EG_GENERATE_MIPMAPS);
-    }
-    {
-        std::vector<unsigned char> image;
-        auto ret = lodepng::decode(image, w, h, "m02.png");
-        assert(!ret);
-        material = egCreateTexture2D(w, h, image.data(), EG_U8 | EG_RGBA, EG_GENERATE_MIPMAPS);
+        if (!pages[i]) continue;
+        if (pages[i] != page)
+        {
+            if (page) egEnd();
+            page = pages[i];
+            egBindDiffuse(page);
+            egBegin(EG_QUADS);
+        }
+        const dfr::sRect &rect = quads[i].rect;
+        const float *pUV = &uvs[i * 4];
+        egTexCoord(pUV[0], pUV[1]);
+        egPosition2(x + rect.x, y + rect.y);
+        egTexCoord(pUV[0], pUV[3]);
+        egPosition2(x + rect.x, y + rect.y + rect.h);
+        egTexCoord(pUV[2], pUV[3]);
+        egPosition2(x + rect.x + rect.w, y + rect.y + rect.h);
+        egTexCoord(pUV[2], pUV[1]);
+        egPosition2(x + rect.x + rect.w, y + rect.y);
     }
+    if (page) egEnd();
+}
+
+void init()
+{
+    // Create device
+    device = egCreateDevice(windowHandle);
+
+    // Load textures. They decode on worker threads, and bind the default
+    // maps until they are uploaded.
+    egSetImageDecoder(decodePNG);
+    egSetStreamingImageDecoder(decodePNGInto);
+#if 0 // Async loading test
+    // Load all the PNGs serially, then with 1, 2, 4 and 8 loader threads
     {
-        std::vector<unsigned char> image;
-        auto ret = lodepng::decode(image, w, h, "alphatest.png");
-        assert(!ret);
-        alphaTest = egCreateTexture2D(w, h, image.data(), EG_U8 | EG_RGBA, EG_GENERATE_MIPMAPS);
+        static const char *szFilenames[] = {
+            "alphatest.png", "d01.png", "d02.png", "m01.png", "m02.png",
+            "n01.png", "n02.png", "ogre_dif.png", "ogre_hammer_dif.png",
+            "ogre_hammer_normal.png", "ogre_hammer_spec.png",
+            "ogre_normal.png", "ogre_spec.png", "stone.png"};
+        const int fileCount = sizeof(szFilenames) / sizeof(szFilenames[0]);
+        EGTexture textures[fileCount];
+        LARGE_INTEGER freq, start, end;
+        char text[128];
+        QueryPerformanceFrequency(&freq);
+
+        QueryPerformanceCounter(&start);
+        for (int i = 0; i < fileCount; ++i)
+        {
+            std::vector<unsigned char> image;
+            unsigned int w, h;
+            lodepng::decode(image, w, h, szFilenames[i]);
+            textures[i] = egCreateTexture2D(w, h, image.data(), EG_U8 | EG_RGBA, EG_GENERATE_MIPMAPS);
+        }
+        QueryPerformanceCounter(&end);
+        for (int i = 0; i < fileCount; ++i) egDestroyTexture(&textures[i]);
+        sprintf_s(text, "serial: %.3f ms\n", (double)(end.QuadPart - start.QuadPart) * 1000.0 / (double)freq.QuadPart);
+        OutputDebugStringA(text);
+
+        for (uint32_t threadCount = 1; threadCount <= 8; threadCount *= 2)
+        {
+            egSetTextureLoaderThreadCount(threadCount);
+            QueryPerformanceCounter(&start);
+            for (int i = 0; i < fileCount; ++i) textures[i] = egLoadTextureFile(szFilenames[i], EG_GENERATE_MIPMAPS);
+            egWaitForTextures();
+            QueryPerformanceCounter(&end);
+            for (int i = 0; i < fileCount; ++i) egDestroyTexture(&textures[i]);
+            sprintf_s(text, "%u threads: %.3f ms\n", threadCount, (double)(end.QuadPart - start.QuadPart) * 1000.0 / (double)freq.QuadPart);
+            OutputDebugStringA(text);
+        }
+        egSetTextureLoaderThreadCount(0);
     }
+#endif
+    diffuseFloor = egLoadTextureFile("d01.png", (EG_TEXTURE_FLAGS)(EG_GENERATE_MIPMAPS | EG_SRGB));
+    normalFloor = egLoadTextureFile("n01.png", EG_GENERATE_MIPMAPS);
+    materialFloor = egLoadTextureFile("m01.png", EG_GENERATE_MIPMAPS);
+    diffuse = egLoadTextureFile("d02.png", (EG_TEXTURE_FLAGS)(EG_GENERATE_MIPMAPS | EG_SRGB));
+    normal = egLoadTextureFile("n02.png", EG_GENERATE_MIPMAPS);
+    material = egLoadTextureFile("m02.png", EG_GENERATE_MIPMAPS);
+    alphaTest = egLoadTextureFile("alphatest.png", (EG_TEXTURE_FLAGS)(EG_GENERATE_MIPMAPS | EG_SRGB));
 
     // Ogre resources
-    {
-        std::vector<unsigned char> image;
-        auto ret = lodepng::decode(image, w, h, "ogre_dif.png");
-        assert(!ret);
-        ogreTextures[0] = egCreateTexture2D(w, h, image.data(), EG_U8 | EG_RGBA, EG_GENERATE_MIPMAPS);
-    }
-    {
-        std::vector<unsigned char> image;
-        auto ret = lodepng::decode(image, w, h, "ogre_normal.png");
-        assert(!ret);
-        ogreTextures[1] = egCreateTexture2D(w, h, image.data(), EG_U8 | EG_RGBA, EG_GENERATE_MIPMAPS);
-    }
-    {
-        std::vector<unsigned char> image;
-        auto ret = lodepng::decode(image, w, h, "ogre_spec.png");
-        assert(!ret);
-        ogreTextures[2] = egCreateTexture2D(w, h, image.data(), EG_U8 | EG_RGBA, EG_GENERATE_MIPMAPS);
-    }
+    ogreTextures[0] = egLoadTextureFile("ogre_dif.png", (EG_TEXTURE_FLAGS)(EG_GENERATE_MIPMAPS | EG_SRGB | EG_COMPRESS));
+    ogreTextures[1] = egLoadTextureFile("ogre_normal.png", (EG_TEXTURE_FLAGS)(EG_GENERATE_MIPMAPS | EG_NORMAL_MAP | EG_COMPRESS));
+    ogreTextures[2] = egLoadTextureFile("ogre_spec.png", (EG_TEXTURE_FLAGS)(EG_GENERATE_MIPMAPS | EG_COMPRESS));
+
     {
         FILE *pFic;
         fopen_s(&pFic, "ogre.mesh", "rb");
@@ -134,6 +197,141 @@ void init()
     egEnable(EG_BLUR);
     egBlur(16);
     state2d = egCreateState();
+
+#if 0 // Handle pool benchmark
+    // Create and destroy 100k textures and states. The handle checks are in
+    // test/pool_test.cpp.
+    {
+        LARGE_INTEGER freq, start, end;
+        char text[128];
+        static EGTexture textures[100000];
+        static EGState states[100000];
+        uint32_t pixel = 0xffffffff;
+        QueryPerformanceFrequency(&freq);
+
+        QueryPerformanceCounter(&start);
+        for (int i = 0; i < 100000; ++i) textures[i] = egCreateTexture2D(1, 1, &pixel, EG_U8 | EG_RGBA, (EG_TEXTURE_FLAGS)0);
+        for (int i = 0; i < 100000; ++i) egDestroyTexture(&textures[i]);
+        QueryPerformanceCounter(&end);
+        sprintf_s(text, "100k textures: %.3f ms\n", (double)(end.QuadPart - start.QuadPart) * 1000.0 / (double)freq.QuadPart);
+        OutputDebugStringA(text);
+
+        QueryPerformanceCounter(&start);
+        for (int i = 0; i < 100000; ++i) states[i] = egCreateState();
+        for (int i = 0; i < 100000; ++i) egDestroyState(&states[i]);
+        QueryPerformanceCounter(&end);
+        sprintf_s(text, "100k states: %.3f ms\n", (double)(end.QuadPart - start.QuadPart) * 1000.0 / (double)freq.QuadPart);
+        OutputDebugStringA(text);
+    }
+#endif
+
+#if 0 // Pre-multiply test
+    // Upload a 2048x2048 texture with and without pre-multiplied alpha
+    {
+        LARGE_INTEGER freq, start, end;
+        char text[128];
+        std::vector<unsigned char> image(2048 * 2048 * 4);
+        for (size_t i = 0; i < image.size(); ++i) image[i] = (unsigned char)rand();
+        QueryPerformanceFrequency(&freq);
+
+        for (int i = 0; i < 3; ++i)
+        {
+            EG_TEXTURE_FLAGS flags = (EG_TEXTURE_FLAGS)((i ? EG_PRE_MULTIPLY : 0) | (i == 2 ? EG_SRGB : 0));
+            QueryPerformanceCounter(&start);
+            EGTexture texture = egCreateTexture2D(2048, 2048, image.data(), EG_U8 | EG_RGBA, flags);
+            QueryPerformanceCounter(&end);
+            double ms = (double)(end.QuadPart - start.QuadPart) * 1000.0 / (double)freq.QuadPart;
+            sprintf_s(text, "%s: %.3f ms, %.0f MB/s\n", i == 0 ? "copy" : i == 1 ? "pre-multiply" : "pre-multiply sRGB", ms, (double)image.size() / (ms * 1000.0));
+            OutputDebugStringA(text);
+            egDestroyTexture(&texture);
+        }
+    }
+#endif
+
+#if 0 // Residency test
+    // 32 textures of 4 MB with a 96 MB budget, bound one per frame
+    {
+        char text[256];
+        std::vector<unsigned char> image(1024 * 1024 * 4, 255);
+        static EGTexture textures[32];
+        egSetTextureBudget(96 * 1024 * 1024);
+        for (int i = 0; i < 32; ++i) textures[i] = egCreateTexture2D(1024, 1024, image.data(), EG_U8 | EG_RGBA, (EG_TEXTURE_FLAGS)0);
+        for (int frame = 0; frame < 64; ++frame)
+        {
+            egBindDiffuse(textures[frame % 32]);
+            egSwap();
+        }
+        sprintf_s(text, "textures %.1f MB, g-buffer %.1f MB, blur %.1f MB, total %.1f MB, %u evictions, %u reloads\n",
+                  (double)egGetResidentBytes(EG_RESIDENCY_TEXTURES) / 1048576.0,
+                  (double)egGetResidentBytes(EG_RESIDENCY_G_BUFFER) / 1048576.0,
+                  (double)egGetResidentBytes(EG_RESIDENCY_BLUR_BUFFERS) / 1048576.0,
+                  (double)egGetResidentBytes(EG_RESIDENCY_ALL) / 1048576.0,
+                  egGetEvictionCount(), egGetReloadCount());
+        OutputDebugStringA(text);
+        for (int i = 0; i < 32; ++i) egDestroyTexture(textures + i);
+        egSetTextureBudget(0);
+    }
+#endif
+
+#if 0 // Texture cache test
+    // Load all the PNGs without .egt files (cold), then again from them (warm)
+    {
+        static const char *szFilenames[] = {
+            "alphatest.png", "d01.png", "d02.png", "m01.png", "m02.png",
+            "n01.png", "n02.png", "ogre_dif.png", "ogre_hammer_dif.png",
+            "ogre_hammer_normal.png", "ogre_hammer_spec.png",
+            "ogre_normal.png", "ogre_spec.png", "stone.png"};
+        const int fileCount = sizeof(szFilenames) / sizeof(szFilenames[0]);
+        EGTexture textures[fileCount];
+        LARGE_INTEGER freq, start, end;
+        char text[128];
+        QueryPerformanceFrequency(&freq);
+
+        for (int i = 0; i < fileCount; ++i)
+        {
+            sprintf_s(text, "%s.egt", szFilenames[i]);
+            remove(text);
+        }
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            QueryPerformanceCounter(&start);
+            for (int i = 0; i < fileCount; ++i) textures[i] = egLoadTextureFile(szFilenames[i], (EG_TEXTURE_FLAGS)(EG_GENERATE_MIPMAPS | EG_COMPRESS | EG_CACHE));
+            egWaitForTextures();
+            QueryPerformanceCounter(&end);
+            for (int i = 0; i < fileCount; ++i) egDestroyTexture(&textures[i]);
+            sprintf_s(text, "%s: %.3f ms\n", pass ? "warm" : "cold", (double)(end.QuadPart - start.QuadPart) * 1000.0 / (double)freq.QuadPart);
+            OutputDebugStringA(text);
+        }
+    }
+#endif
+
+#if 0 // Atlas test
+    // Pack 2000 random sized images, remove half of them and defragment
+    {
+        LARGE_INTEGER freq, start, end;
+        char text[128];
+        static uint32_t entries[2000];
+        static uint32_t pixels[64 * 64];
+        QueryPerformanceFrequency(&freq);
+        srand(1);
+        for (int i = 0; i < 64 * 64; ++i) pixels[i] = 0xff000000 | rand();
+
+        EGAtlas atlas = egCreateAtlas(1024, 2, EG_GENERATE_MIPMAPS);
+        QueryPerformanceCounter(&start);
+        for (int i = 0; i < 2000; ++i) entries[i] = egAtlasInsert(atlas, 8 + rand() % 57, 8 + rand() % 57, pixels, EG_U8 | EG_RGBA);
+        QueryPerformanceCounter(&end);
+        sprintf_s(text, "insert: %.3f ms, occupancy %.1f%%\n", (double)(end.QuadPart - start.QuadPart) * 1000.0 / (double)freq.QuadPart, egAtlasGetOccupancy(atlas) * 100.f);
+        OutputDebugStringA(text);
+
+        for (int i = 0; i < 2000; i += 2) egAtlasRemove(atlas, &entries[i]);
+        QueryPerformanceCounter(&start);
+        egAtlasDefragment(atlas);
+        QueryPerformanceCounter(&end);
+        sprintf_s(text, "defragment: %.3f ms, occupancy %.1f%%\n", (double)(end.QuadPart - start.QuadPart) * 1000.0 / (double)freq.QuadPart, egAtlasGetOccupancy(atlas) * 100.f);
+        OutputDebugStringA(text);
+        egDestroyAtlas(&atlas);
+    }
+#endif
 }
 
 void shutdown()
@@ -370,6 +568,88 @@ void draw()
 #endif
 #endif
 
+#if 0 // LOD test
+    // Hundreds of spheres going into the distance. Toggle bAutoLod to compare
+    // against fixed 24x12 tessellation.
+    {
+        static bool bAutoLod = true;
+        static LARGE_INTEGER freq = {0};
+        static LARGE_INTEGER lastTime = {0};
+        static int frameCount = 0;
+        if (!freq.QuadPart) QueryPerformanceFrequency(&freq);
+
+        egModelIdentity();
+        egSet3DViewProj(0, -5, 3, 0, 10, 0, 0, 0, 1, 70, .1f, 10000.f);
+        egBindState(state3d);
+        egBindDiffuse(diffuse);
+        egBindNormal(normal);
+        egBindMaterial(material);
+        egColor3(1, 1, 1);
+
+        for (int y = 0; y < 40; ++y)
+        {
+            for (int x = -5; x <= 5; ++x)
+            {
+                egModelPush();
+                egModelTranslate((float)x * 3, (float)y * 6, 0);
+                if (bAutoLod) egSphereAuto(1, 12, 2);
+                else egSphere(1, 24, 12, 2);
+                egModelPop();
+            }
+        }
+
+        egBegin(EG_AMBIENTS);
+        egColor3(.5f, .5f, .5f);
+        egEnd();
+
+        egPostProcess();
+
+        if (++frameCount == 100)
+        {
+            LARGE_INTEGER now;
+            QueryPerformanceCounter(&now);
+            if (lastTime.QuadPart)
+            {
+                char text[128];
+                sprintf_s(text, "%s: %.3f ms/frame\n", bAutoLod ? "auto" : "fixed",
+                          (double)(now.QuadPart - lastTime.QuadPart) * 1000.0 / (double)freq.QuadPart / 100.0);
+                OutputDebugStringA(text);
+            }
+            lastTime = now;
+            frameCount = 0;
+        }
+    }
+#endif
+
+#if 0 // Atlas text test
+    // A label that changes every frame. The glyphs are rendered into the
+    // atlas once, after that only the quads change.
+    {
+        static EGAtlas textAtlas = 0;
+        static int frame = 0;
+        if (!textAtlas)
+        {
+            dfr::init();
+            textAtlas = egCreateAtlas(512, 1, (EG_TEXTURE_FLAGS)0);
+        }
+        char text[64];
+        sprintf_s(text, "Frame %d", frame++);
+        dfr::sFont font = { "C:\\Windows\\Fonts\\arial.ttf", 32 };
+        dfr::sFormating formating = { false, dfr::ALIGN_TOP_LEFT, 0, false };
+        dfr::sGlyphAtlas glyphAtlas = { &textAtlas, insertGlyph, removeGlyph };
+        std::vector<dfr::sGlyphQuad> quads;
+        dfr::layoutText(text, 400, 64, font, formating, glyphAtlas, quads);
+
+        egSet2DViewProj(-999, 999);
+        egBindState(state2d);
+        egEnable(EG_BLEND);
+        egBlendFunc(EG_SRC_ALPHA, EG_ONE_MINUS_SRC_ALPHA);
+        egColor3(1, 1, 1);
+        drawGlyphQuads(textAtlas, quads, 20, 20);
+        egDisable(EG_BLEND);
+    }
+#endif
+
     egSwap();
 }
 
@@ -0,0 +1,130 @@
+#pragma once
+
+// Reference BC decoder for the BC tests and benchmarks. Blocks are decoded to
+// doubles, with the palettes of the Direct3D spec, and compared with the
+// source channels the format keeps: RGB for BC1, RGBA for BC3, R for BC4 and
+// RG for BC5.
+
+#include <math.h>
+#include "test.h"
+extern "C" {
+#include "eg_bc.h"
+}
+
+inline void decodeColor565(uint16_t color, double *pOut)
+{
+    uint32_t r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+    pOut[0] = (double)((r << 3) | (r >> 2));
+    pOut[1] = (double)((g << 2) | (g >> 4));
+    pOut[2] = (double)((b << 3) | (b >> 2));
+}
+
+// BC1 color block. BC3 color blocks always use the 4 color palette.
+inline void decodeColorBlock(const uint8_t *pBlock, bool bFourColors, double out[16][3])
+{
+    uint16_t color0 = (uint16_t)(pBlock[0] | (pBlock[1] << 8));
+    uint16_t color1 = (uint16_t)(pBlock[2] | (pBlock[3] << 8));
+    double palette[4][3];
+    decodeColor565(color0, palette[0]);
+    decodeColor565(color1, palette[1]);
+    for (int c = 0; c < 3; ++c)
+    {
+        if (color0 > color1 || bFourColors)
+        {
+            palette[2][c] = (2.0 * palette[0][c] + palette[1][c]) / 3.0;
+            palette[3][c] = (palette[0][c] + 2.0 * palette[1][c]) / 3.0;
+        }
+        else
+        {
+            palette[2][c] = (palette[0][c] + palette[1][c]) / 2.0;
+            palette[3][c] = 0.0;
+        }
+    }
+    uint32_t indices = pBlock[4] | (pBlock[5] << 8) | (pBlock[6] << 16) | ((uint32_t)pBlock[7] << 24);
+    for (int i = 0; i < 16; ++i)
+    {
+        for (int c = 0; c < 3; ++c) out[i][c] = palette[(indices >> (2 * i)) & 3][c];
+    }
+}
+
+// BC3 alpha, BC4 and BC5 channel block
+inline void decodeChannelBlock(const uint8_t *pBlock, double out[16])
+{
+    double palette[8];
+    palette[0] = pBlock[0];
+    palette[1] = pBlock[1];
+    if (pBlock[0] > pBlock[1])
+    {
+        for (int i = 2; i < 8; ++i) palette[i] = ((8 - i) * palette[0] + (i - 1) * palette[1]) / 7.0;
+    }
+    else
+    {
+        for (int i = 2; i < 6; ++i) palette[i] = ((6 - i) * palette[0] + (i - 1) * palette[1]) / 5.0;
+        palette[6] = 0.0;
+        palette[7] = 255.0;
+    }
+    uint64_t indices = 0;
+    for (int i = 0; i < 6; ++i) indices |= (uint64_t)pBlock[2 + i] << (8 * i);
+    for (int i = 0; i < 16; ++i) out[i] = palette[(indices >> (3 * i)) & 7];
+}
+
+// Decoded block as RGBA, channels the format doesn't keep are left at 0
+inline void decodeBlock(const uint8_t *pBlock, uint32_t bcFormat, double out[16][4])
+{
+    memset(out, 0, sizeof(double) * 16 * 4);
+    double color[16][3];
+    double channel[16];
+    switch (bcFormat)
+    {
+    case BC_FORMAT_BC1:
+        decodeColorBlock(pBlock, false, color);
+        for (int i = 0; i < 16; ++i) memcpy(out[i], color[i], sizeof(color[i]));
+        break;
+    case BC_FORMAT_BC3:
+        decodeChannelBlock(pBlock, channel);
+        decodeColorBlock(pBlock + 8, true, color);
+        for (int i = 0; i < 16; ++i)
+        {
+            memcpy(out[i], color[i], sizeof(color[i]));
+            out[i][3] = channel[i];
+        }
+        break;
+    case BC_FORMAT_BC4:
+        decodeChannelBlock(pBlock, channel);
+        for (int i = 0; i < 16; ++i) out[i][0] = channel[i];
+        break;
+    case BC_FORMAT_BC5:
+        decodeChannelBlock(pBlock, channel);
+        for (int i = 0; i < 16; ++i) out[i][0] = channel[i];
+        decodeChannelBlock(pBlock + 8, channel);
+        for (int i = 0; i < 16; ++i) out[i][1] = channel[i];
+        break;
+    }
+}
+
+inline double getPSNR(const unsigned char *pImage, uint32_t w, uint32_t h, const uint8_t *pBlocks, uint32_t bcFormat)
+{
+    uint32_t channelCount = (bcFormat == BC_FORMAT_BC1) ? 3 : (bcFormat == BC_FORMAT_BC3) ? 4 : (bcFormat == BC_FORMAT_BC4) ? 1 : 2;
+    uint32_t blockW = (w + 3) / 4, blockH = (h + 3) / 4;
+    double squaredError = 0.0;
+    for (uint32_t by = 0; by < blockH; ++by)
+    {
+        for (uint32_t bx = 0; bx < blockW; ++bx)
+        {
+            double decoded[16][4];
+            decodeBlock(pBlocks + (by * blockW + bx) * getBCBlockSize(bcFormat), bcFormat, decoded);
+            for (uint32_t i = 0; i < 16; ++i)
+            {
+                uint32_t x = bx * 4 + i % 4, y = by * 4 + i / 4;
+                if (x >= w || y >= h) continue;
+                for (uint32_t c = 0; c < channelCount; ++c)
+                {
+                    double diff = decoded[i][c] - (double)pImage[(y * w + x) * 4 + c];
+                    squaredError += diff * diff;
+                }
+            }
+        }
+    }
+    double mse = squaredError / ((double)w * (double)h * (double)channelCount);
+    return (mse == 0.0) ? 99.0 : 10.0 * log10(255.0 * 255.0 / mse);
+}
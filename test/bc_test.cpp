@@ -0,0 +1,173 @@
+// compressBC against the reference decoder: a PSNR floor for every repo PNG,
+// format and quality, edge pixels repeated in the blocks of sizes that aren't
+// multiples of 4, and the normals of a BC5 normal map.
+
+#include "bc_reference.h"
+
+static const uint32_t bcFormats[] = {BC_FORMAT_BC1, BC_FORMAT_BC3, BC_FORMAT_BC4, BC_FORMAT_BC5};
+
+// Measured PSNR less 0.5 to 1 dB, by format then fast, normal and high
+// quality. Lossless blocks count as 60 dB.
+static const double psnrFloors[][4][3] = {
+    {{32.5, 60.0, 60.0}, {34.0, 52.5, 53.0}, {60.0, 60.0, 60.0}, {60.0, 60.0, 60.0}}, // alphatest.png
+    {{34.5, 35.0, 35.0}, {35.5, 36.0, 36.5}, {41.0, 42.0, 42.0}, {41.5, 42.0, 42.5}}, // d01.png
+    {{33.5, 34.5, 34.5}, {35.0, 35.5, 35.5}, {40.5, 41.0, 41.5}, {40.5, 41.0, 41.5}}, // d02.png
+    {{28.0, 30.5, 30.5}, {29.0, 32.0, 32.0}, {35.0, 35.5, 36.0}, {38.0, 38.5, 39.0}}, // m01.png
+    {{27.5, 30.0, 30.0}, {28.5, 31.0, 31.0}, {36.5, 37.0, 37.0}, {39.5, 40.0, 40.0}}, // m02.png
+    {{23.5, 29.5, 29.5}, {25.0, 30.5, 30.5}, {39.0, 40.0, 40.5}, {40.0, 41.0, 41.0}}, // n01.png
+    {{23.0, 28.5, 29.0}, {24.5, 30.0, 30.0}, {38.5, 39.0, 39.5}, {38.5, 39.5, 40.0}}, // n02.png
+    {{39.0, 42.0, 42.0}, {40.0, 43.5, 43.5}, {42.0, 44.0, 44.0}, {42.0, 44.0, 44.0}}, // ogre_dif.png
+    {{39.5, 44.5, 44.5}, {41.0, 46.0, 46.0}, {43.0, 44.5, 44.5}, {43.0, 45.0, 45.0}}, // ogre_hammer_dif.png
+    {{27.0, 30.5, 31.0}, {28.0, 32.0, 32.0}, {41.0, 41.5, 42.0}, {40.5, 41.5, 41.5}}, // ogre_hammer_normal.png
+    {{41.5, 48.0, 48.0}, {43.0, 49.5, 49.5}, {45.5, 47.0, 47.0}, {45.5, 47.0, 47.0}}, // ogre_hammer_spec.png
+    {{26.0, 30.5, 30.5}, {27.0, 31.5, 31.5}, {40.5, 41.5, 41.5}, {40.5, 41.0, 41.5}}, // ogre_normal.png
+    {{40.0, 48.5, 48.5}, {41.0, 49.5, 49.5}, {41.0, 42.5, 42.5}, {41.0, 42.5, 42.5}}, // ogre_spec.png
+    {{31.0, 31.5, 32.0}, {32.0, 33.0, 33.0}, {38.0, 38.5, 39.0}, {38.0, 38.5, 39.0}}, // stone.png
+};
+
+static void checkPSNRFloors()
+{
+    assert(sizeof(psnrFloors) / sizeof(psnrFloors[0]) == (size_t)repoPNGCount);
+    for (int i = 0; i < repoPNGCount; ++i)
+    {
+        unsigned int w, h;
+        std::vector<unsigned char> image = loadPNG(szRepoPNGs[i], &w, &h);
+        for (int f = 0; f < 4; ++f)
+        {
+            std::vector<uint8_t> blocks(getBCSize(bcFormats[f], w, h));
+            for (uint32_t quality = BC_QUALITY_FAST; quality <= BC_QUALITY_HIGH; ++quality)
+            {
+                compressBC(image.data(), w, h, blocks.data(), bcFormats[f], quality);
+                double psnr = getPSNR(image.data(), w, h, blocks.data(), bcFormats[f]);
+                if (psnr < psnrFloors[i][f][quality])
+                {
+                    printf("%s BC%u quality %u: PSNR %.2f dB, under %.1f dB\n", szRepoPNGs[i], bcFormats[f], quality,
+                           psnr, psnrFloors[i][f][quality]);
+                }
+                assert(psnr >= psnrFloors[i][f][quality]);
+            }
+        }
+    }
+    printf("PSNR floors: passed\n");
+}
+
+// A crop of w x h compresses to the same blocks as the crop padded to
+// multiples of 4 by repeating its last column and row
+static void checkEdgePixels()
+{
+    static const uint32_t sizes[][2] = {{1, 1}, {2, 7}, {3, 3}, {5, 4}, {4, 5}, {37, 23}, {130, 66}};
+    unsigned int ogreW, ogreH, alphaW, alphaH;
+    std::vector<unsigned char> ogre = loadPNG("ogre_dif.png", &ogreW, &ogreH);
+    std::vector<unsigned char> alpha = loadPNG("alphatest.png", &alphaW, &alphaH);
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+    {
+        uint32_t w = sizes[s][0], h = sizes[s][1];
+        uint32_t paddedW = (w + 3) / 4 * 4, paddedH = (h + 3) / 4 * 4;
+        // Busy pixels from the middle of the ogre, alpha from alphatest
+        std::vector<unsigned char> crop(w * h * 4), padded(paddedW * paddedH * 4);
+        for (uint32_t y = 0; y < h; ++y)
+        {
+            for (uint32_t x = 0; x < w; ++x)
+            {
+                memcpy(&crop[(y * w + x) * 4], &ogre[((y + 400) * ogreW + x + 400) * 4], 3);
+                crop[(y * w + x) * 4 + 3] = alpha[((y % alphaH) * alphaW + x % alphaW) * 4 + 3];
+            }
+        }
+        for (uint32_t y = 0; y < paddedH; ++y)
+        {
+            for (uint32_t x = 0; x < paddedW; ++x)
+            {
+                uint32_t cx = x < w ? x : w - 1, cy = y < h ? y : h - 1;
+                memcpy(&padded[(y * paddedW + x) * 4], &crop[(cy * w + cx) * 4], 4);
+            }
+        }
+        for (int f = 0; f < 4; ++f)
+        {
+            assert(getBCSize(bcFormats[f], w, h) == getBCSize(bcFormats[f], paddedW, paddedH));
+            std::vector<uint8_t> cropBlocks(getBCSize(bcFormats[f], w, h)), paddedBlocks(cropBlocks.size());
+            for (uint32_t quality = BC_QUALITY_FAST; quality <= BC_QUALITY_HIGH; ++quality)
+            {
+                compressBC(crop.data(), w, h, cropBlocks.data(), bcFormats[f], quality);
+                compressBC(padded.data(), paddedW, paddedH, paddedBlocks.data(), bcFormats[f], quality);
+                assert(cropBlocks == paddedBlocks);
+            }
+        }
+    }
+    printf("edge pixels: passed\n");
+}
+
+// Mean angle in degrees between the normals of a normal map and the ones
+// decoded from its blocks. z is rebuilt from x and y like the shader does,
+// for the source too, so that only the compression error counts. Also the
+// fraction of pixels more than 5 degrees off.
+static double getMeanNormalAngle(const std::vector<unsigned char> &image, uint32_t w, uint32_t h,
+                                 const std::vector<uint8_t> &blocks, uint32_t bcFormat, double *pOver5)
+{
+    uint32_t blocksW = (w + 3) / 4;
+    double angleSum = 0;
+    uint32_t over5Count = 0;
+    for (uint32_t by = 0; by < (h + 3) / 4; ++by)
+    {
+        for (uint32_t bx = 0; bx < blocksW; ++bx)
+        {
+            double decoded[16][4];
+            decodeBlock(&blocks[(by * blocksW + bx) * getBCBlockSize(bcFormat)], bcFormat, decoded);
+            for (uint32_t i = 0; i < 16; ++i)
+            {
+                uint32_t x = bx * 4 + i % 4, y = by * 4 + i / 4;
+                if (x >= w || y >= h) continue;
+                const unsigned char *pPixel = &image[(y * w + x) * 4];
+                double n[2][3];
+                for (int k = 0; k < 2; ++k)
+                {
+                    n[k][0] = (k ? decoded[i][0] : (double)pPixel[0]) / 255.0 * 2.0 - 1.0;
+                    n[k][1] = (k ? decoded[i][1] : (double)pPixel[1]) / 255.0 * 2.0 - 1.0;
+                    double zz = 1.0 - n[k][0] * n[k][0] - n[k][1] * n[k][1];
+                    n[k][2] = zz > 0 ? sqrt(zz) : 0;
+                    double len = sqrt(n[k][0] * n[k][0] + n[k][1] * n[k][1] + n[k][2] * n[k][2]);
+                    for (int c = 0; c < 3; ++c) n[k][c] /= len;
+                }
+                double d = n[0][0] * n[1][0] + n[0][1] * n[1][1] + n[0][2] * n[1][2];
+                double angle = acos(d > 1 ? 1 : d) * 180.0 / 3.14159265358979;
+                angleSum += angle;
+                if (angle > 5.0) ++over5Count;
+            }
+        }
+    }
+    *pOver5 = (double)over5Count / ((double)w * h);
+    return angleSum / ((double)w * h);
+}
+
+// BC5 keeps x and y of a normal map in two channels with 3 bit indices, it
+// must stay around a degree on average and be far better than BC1
+static void checkBC5Normals()
+{
+    // Measured 0.98, 0.93 and 0.90 degrees, with 2.2%, 1.8% and 1.6% over 5
+    static const double maxMeanAngles[] = {1.1, 1.0, 1.0};
+    static const double maxOver5[] = {.025, .02, .02};
+    unsigned int w, h;
+    std::vector<unsigned char> image = loadPNG("ogre_normal.png", &w, &h);
+    std::vector<uint8_t> bc5(getBCSize(BC_FORMAT_BC5, w, h)), bc1(getBCSize(BC_FORMAT_BC1, w, h));
+    for (uint32_t quality = BC_QUALITY_FAST; quality <= BC_QUALITY_HIGH; ++quality)
+    {
+        double over5[2];
+        compressBC(image.data(), w, h, bc5.data(), BC_FORMAT_BC5, quality);
+        compressBC(image.data(), w, h, bc1.data(), BC_FORMAT_BC1, quality);
+        double bc5Angle = getMeanNormalAngle(image, w, h, bc5, BC_FORMAT_BC5, &over5[0]);
+        double bc1Angle = getMeanNormalAngle(image, w, h, bc1, BC_FORMAT_BC1, &over5[1]);
+        printf("ogre_normal.png quality %u: BC5 %.3f degrees, %.4f%% over 5, BC1 %.3f degrees, %.4f%% over 5\n", quality,
+               bc5Angle, over5[0] * 100.0, bc1Angle, over5[1] * 100.0);
+        assert(bc5Angle <= maxMeanAngles[quality] && over5[0] <= maxOver5[quality]);
+        assert(bc5Angle * 3 < bc1Angle);
+    }
+    printf("BC5 normal map: passed\n");
+}
+
+int main()
+{
+    checkPSNRFloors();
+    checkEdgePixels();
+    checkBC5Normals();
+    printf("bc_test: passed\n");
+    return 0;
+}
@@ -0,0 +1,122 @@
+// Loading the repo PNGs without .egt files (cold) and from them (warm), the
+// way the loader does with EG_GENERATE_MIPMAPS | EG_COMPRESS | EG_CACHE,
+// minus the upload: read the file, hash it, then either decode, mip, compress
+// to BC1 or BC3 and write the cache, or map and read the cache and copy the
+// levels as the upload would.
+
+#include "test.h"
+extern "C" {
+#include "eg_bc.h"
+#include "eg_cache.h"
+#include "eg_file.h"
+#include "eg_mip.h"
+}
+
+static std::vector<unsigned char> readSource(const char *szFilename)
+{
+    std::vector<unsigned char> data;
+    lodepng::load_file(data, szFilename);
+    assert(!data.empty());
+    return data;
+}
+
+static void loadCold(const char *szFilename, const char *szCacheFilename)
+{
+    std::vector<unsigned char> source = readSource(szFilename);
+    uint64_t sourceHash = hashData(source.data(), source.size());
+    std::vector<unsigned char> image;
+    unsigned int w, h;
+    unsigned int error = lodepng::decode(image, w, h, source);
+    assert(error == 0);
+
+    uint32_t levelCount = getMipLevelCount(w, h);
+    std::vector<uint8_t> chain(getMipChainSize(w, h, levelCount));
+    memcpy(chain.data(), image.data(), image.size());
+    generateMipChain(chain.data(), w, h, levelCount, MIP_SRGB);
+
+    uint32_t bcFormat = BC_FORMAT_BC1;
+    for (size_t i = 3; i < image.size(); i += 4)
+    {
+        if (image[i] != 255)
+        {
+            bcFormat = BC_FORMAT_BC3;
+            break;
+        }
+    }
+    uint32_t blocksSize = 0;
+    for (uint32_t i = 0, mipW = w, mipH = h; i < levelCount; ++i, mipW = mipW > 1 ? mipW / 2 : 1, mipH = mipH > 1 ? mipH / 2 : 1)
+    {
+        blocksSize += getBCSize(bcFormat, mipW, mipH);
+    }
+    std::vector<uint8_t> blocks(blocksSize);
+
+    SEGTextureCache cache;
+    memset(&cache, 0, sizeof(SEGTextureCache));
+    cache.sourceHash = sourceHash;
+    cache.w = w;
+    cache.h = h;
+    cache.format = bcFormat == BC_FORMAT_BC1 ? 71 : 77; // DXGI_FORMAT_BC1_UNORM, DXGI_FORMAT_BC3_UNORM
+    cache.mipLevels = levelCount;
+    const uint8_t *pLevel = chain.data();
+    uint8_t *pBlocks = blocks.data();
+    for (uint32_t i = 0, mipW = w, mipH = h; i < levelCount; ++i, mipW = mipW > 1 ? mipW / 2 : 1, mipH = mipH > 1 ? mipH / 2 : 1)
+    {
+        compressBC(pLevel, mipW, mipH, pBlocks, bcFormat, BC_QUALITY_NORMAL);
+        cache.pLevels[i] = pBlocks;
+        cache.sizes[i] = getBCSize(bcFormat, mipW, mipH);
+        cache.pitches[i] = getBCPitch(bcFormat, mipW);
+        pLevel += mipW * mipH * 4;
+        pBlocks += cache.sizes[i];
+    }
+    int bWritten = writeTextureCache(szCacheFilename, &cache);
+    assert(bWritten);
+}
+
+static size_t loadWarm(const char *szFilename, const char *szCacheFilename, std::vector<uint8_t> &staging)
+{
+    std::vector<unsigned char> source = readSource(szFilename);
+    uint64_t sourceHash = hashData(source.data(), source.size());
+    const uint8_t *pFileData;
+    uint64_t fileSize;
+    SEGMappedFile *pMapped = mapFile(szCacheFilename, &pFileData, &fileSize);
+    assert(pMapped);
+    SEGTextureCache cache;
+    int bRead = readTextureCache(pFileData, fileSize, &cache);
+    assert(bRead && cache.sourceHash == sourceHash);
+    size_t size = 0;
+    for (uint32_t i = 0; i < cache.mipLevels; ++i)
+    {
+        if (staging.size() < size + cache.sizes[i]) staging.resize(size + cache.sizes[i]);
+        memcpy(staging.data() + size, cache.pLevels[i], cache.sizes[i]);
+        size += cache.sizes[i];
+    }
+    unmapFile(pMapped);
+    return size;
+}
+
+int main()
+{
+    char szCacheFilenames[repoPNGCount][64];
+    for (int i = 0; i < repoPNGCount; ++i) snprintf(szCacheFilenames[i], 64, "test/build/%s.egt", szRepoPNGs[i]);
+
+    double start = getSeconds();
+    for (int i = 0; i < repoPNGCount; ++i) loadCold(szRepoPNGs[i], szCacheFilenames[i]);
+    double cold = getSeconds() - start;
+
+    // The cache files are in the page cache now, like on a second run
+    std::vector<uint8_t> staging;
+    const int runCount = 5;
+    size_t levelBytes = 0;
+    start = getSeconds();
+    for (int run = 0; run < runCount; ++run)
+    {
+        levelBytes = 0;
+        for (int i = 0; i < repoPNGCount; ++i) levelBytes += loadWarm(szRepoPNGs[i], szCacheFilenames[i], staging);
+    }
+    double warm = (getSeconds() - start) / runCount;
+
+    for (int i = 0; i < repoPNGCount; ++i) remove(szCacheFilenames[i]);
+    printf("%d PNGs, %.1f MB of levels: cold %.1f ms, warm %.2f ms, %.0fx\n", repoPNGCount, levelBytes / 1e6,
+        cold * 1000.0, warm * 1000.0, cold / warm);
+    return 0;
+}
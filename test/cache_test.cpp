@@ -0,0 +1,250 @@
+// .egt texture cache: hashData against the reference xxHash64 (seed 0), a
+// write, map and read round trip with every level aligned, and files cut
+// short or pointing past their end are rejected.
+
+#include "test.h"
+extern "C" {
+#include "eg_cache.h"
+#include "eg_file.h"
+}
+
+// Layout written by eg_cache.c: 40 bytes of header, then 16 bytes per level
+// with the 64 bits offset first and the 32 bits size next
+static const size_t headerSize = 40;
+static const size_t levelSize = 16;
+static const size_t levelCountOffset = 36;
+
+static const char *szCacheFilename = "test/build/cache_test.egt";
+
+static void checkHashVectors()
+{
+    // Prefixes of this text, the values are from the xxHash reference
+    static const char szText[] =
+        "Nobody inspects the spammish repetition. The quick brown fox jumps over the lazy dog, 0123456789abcdef!";
+    static const struct { size_t size; uint64_t hash; } vectors[] = {
+        {0, 0xEF46DB3751D8E999ULL},
+        {1, 0x16B6310EBD34BD7CULL},
+        {3, 0xC9836C0B0560CCBAULL},
+        {4, 0x265FAA35D7AFEC64ULL},
+        {5, 0x55EF587A70D0A5DCULL},
+        {7, 0xB0E815555CF3E789ULL},
+        {8, 0x93FC083B5A3F012CULL},
+        {9, 0x9AD43E84F12D75B0ULL},
+        {11, 0x3CC9EE98E148BA2CULL},
+        {12, 0xA45D439F3F93E297ULL},
+        {13, 0x0E2FB61FD1706533ULL},
+        {15, 0xBBB5DF1CA276FF74ULL},
+        {16, 0xC9AF09F9668B54FAULL},
+        {31, 0xC1A0E0AE86E1D78CULL},
+        {32, 0x96F5BFCBFE7F0D1AULL},
+        {33, 0x977F4AA19D128181ULL},
+        {35, 0x7C7A7E3417CB0AACULL},
+        {36, 0xFDE2562A393270B7ULL},
+        {39, 0xFBCEA83C8A378BF1ULL},
+        {40, 0x9812547736BCA667ULL},
+        {41, 0xC5943F69710C3A4FULL},
+        {44, 0x038556E5BFB4BB32ULL},
+        {63, 0x0699ED965DA45093ULL},
+        {64, 0xADBA6DDDE702362CULL},
+        {65, 0xE62BDB90FAAA4F24ULL},
+        {100, 0x59F4C4406ACAF6EDULL},
+    };
+    // The file data hashed by the loader has no particular alignment
+    char unaligned[sizeof(szText) + 8];
+    for (size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); ++i)
+    {
+        uint64_t hash = hashData(szText, vectors[i].size);
+        if (hash != vectors[i].hash) printf("%u bytes: 0x%016llX\n", (unsigned int)vectors[i].size, (unsigned long long)hash);
+        assert(hash == vectors[i].hash);
+        for (size_t offset = 1; offset < 8; offset += 3)
+        {
+            memcpy(unaligned + offset, szText, vectors[i].size);
+            assert(hashData(unaligned + offset, vectors[i].size) == vectors[i].hash);
+        }
+    }
+    printf("hash vectors: passed\n");
+}
+
+// Levels of a BC1 like chain, sizes that are not multiples of 16 included
+static SEGTextureCache makeCache(std::vector<std::vector<uint8_t> > &levels, uint32_t w, uint32_t h, uint32_t seed)
+{
+    SEGTextureCache cache;
+    memset(&cache, 0, sizeof(SEGTextureCache));
+    cache.sourceHash = 0x0123456789ABCDEFULL + seed;
+    cache.flags = 0x1234;
+    cache.normalStrength = 2.5f;
+    cache.w = w;
+    cache.h = h;
+    cache.format = 71; // DXGI_FORMAT_BC1_UNORM
+    sRandom random(seed);
+    levels.clear();
+    for (uint32_t mipW = w, mipH = h; ; mipW = mipW > 1 ? mipW / 2 : 1, mipH = mipH > 1 ? mipH / 2 : 1)
+    {
+        uint32_t pitch = (mipW + 3) / 4 * 8;
+        levels.push_back(std::vector<uint8_t>(pitch * ((mipH + 3) / 4) + cache.mipLevels % 3));
+        for (size_t i = 0; i < levels.back().size(); ++i) levels.back()[i] = (uint8_t)random.next();
+        cache.pLevels[cache.mipLevels] = levels.back().data();
+        cache.sizes[cache.mipLevels] = (uint32_t)levels.back().size();
+        cache.pitches[cache.mipLevels] = pitch;
+        ++cache.mipLevels;
+        if (mipW == 1 && mipH == 1) break;
+    }
+    return cache;
+}
+
+static std::vector<uint8_t> readWholeFile(const char *szFilename)
+{
+    std::vector<uint8_t> data;
+    FILE *pFile = fopen(szFilename, "rb");
+    assert(pFile);
+    int c;
+    while ((c = fgetc(pFile)) != EOF) data.push_back((uint8_t)c);
+    fclose(pFile);
+    return data;
+}
+
+static void checkRoundTrip()
+{
+    const uint32_t sizes[][2] = {{1, 1}, {4, 4}, {13, 7}, {256, 64}, {1000, 3}};
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+    {
+        std::vector<std::vector<uint8_t> > levels;
+        SEGTextureCache written = makeCache(levels, sizes[s][0], sizes[s][1], (uint32_t)s + 1);
+        assert(writeTextureCache(szCacheFilename, &written));
+
+        const uint8_t *pFileData;
+        uint64_t fileSize;
+        SEGMappedFile *pMapped = mapFile(szCacheFilename, &pFileData, &fileSize);
+        assert(pMapped);
+        SEGTextureCache read;
+        assert(readTextureCache(pFileData, fileSize, &read));
+        assert(read.sourceHash == written.sourceHash && read.flags == written.flags);
+        assert(read.normalStrength == written.normalStrength && read.format == written.format);
+        assert(read.w == written.w && read.h == written.h && read.mipLevels == written.mipLevels);
+        for (uint32_t i = 0; i < read.mipLevels; ++i)
+        {
+            assert((read.pLevels[i] - pFileData) % 16 == 0);
+            assert(((uintptr_t)read.pLevels[i]) % 16 == 0);
+            assert(read.pLevels[i] + read.sizes[i] <= pFileData + fileSize);
+            assert(read.sizes[i] == written.sizes[i] && read.pitches[i] == written.pitches[i]);
+            assert(memcmp(read.pLevels[i], written.pLevels[i], read.sizes[i]) == 0);
+        }
+        // Nothing after the last level
+        assert(read.pLevels[read.mipLevels - 1] + read.sizes[read.mipLevels - 1] == pFileData + fileSize);
+        unmapFile(pMapped);
+    }
+
+    // Rewriting replaces the file, even with a smaller one
+    std::vector<std::vector<uint8_t> > levels;
+    SEGTextureCache written = makeCache(levels, 2, 2, 99);
+    assert(writeTextureCache(szCacheFilename, &written));
+    std::vector<uint8_t> file = readWholeFile(szCacheFilename);
+    SEGTextureCache read;
+    assert(readTextureCache(file.data(), file.size(), &read));
+    assert(read.w == 2 && read.h == 2 && read.sourceHash == written.sourceHash);
+
+    // Level counts the format can't hold aren't written
+    written.mipLevels = 0;
+    assert(!writeTextureCache(szCacheFilename, &written));
+    written.mipLevels = TEXTURE_CACHE_MAX_LEVELS + 1;
+    assert(!writeTextureCache(szCacheFilename, &written));
+
+    const uint8_t *pFileData;
+    uint64_t fileSize;
+    assert(!mapFile("test/build/does_not_exist.egt", &pFileData, &fileSize));
+    FILE *pEmpty = fopen("test/build/cache_test_empty.egt", "wb");
+    assert(pEmpty);
+    fclose(pEmpty);
+    assert(!mapFile("test/build/cache_test_empty.egt", &pFileData, &fileSize));
+    remove("test/build/cache_test_empty.egt");
+    printf("round trip: passed\n");
+}
+
+static void setLevelField(std::vector<uint8_t> &file, uint32_t level, size_t fieldOffset, uint64_t value, size_t valueSize)
+{
+    memcpy(file.data() + headerSize + levelSize * level + fieldOffset, &value, valueSize);
+}
+
+static void checkRejected()
+{
+    std::vector<std::vector<uint8_t> > levels;
+    SEGTextureCache written = makeCache(levels, 64, 32, 7);
+    assert(writeTextureCache(szCacheFilename, &written));
+    const std::vector<uint8_t> file = readWholeFile(szCacheFilename);
+    SEGTextureCache read;
+    assert(readTextureCache(file.data(), file.size(), &read));
+    assert(read.pLevels[0] - file.data() == (ptrdiff_t)((headerSize + levelSize * written.mipLevels + 15) & ~15));
+
+    // Short header and short level table. Every cut before the last level's
+    // end drops data a level points to.
+    for (size_t size = 0; size < file.size(); ++size)
+    {
+        std::vector<uint8_t> cut(file.begin(), file.begin() + size);
+        assert(!readTextureCache(cut.data(), cut.size(), &read));
+    }
+    assert(headerSize + levelSize * written.mipLevels < file.size());
+
+    // Bad magic, version and level counts
+    const size_t fieldOffsets[] = {0, 4};
+    for (size_t i = 0; i < 2; ++i)
+    {
+        std::vector<uint8_t> bad = file;
+        bad[fieldOffsets[i]] ^= 1;
+        assert(!readTextureCache(bad.data(), bad.size(), &read));
+    }
+    const uint32_t levelCounts[] = {0, TEXTURE_CACHE_MAX_LEVELS + 1, 0xffffffffu};
+    for (size_t i = 0; i < 3; ++i)
+    {
+        std::vector<uint8_t> bad = file;
+        memcpy(bad.data() + levelCountOffset, &levelCounts[i], 4);
+        assert(!readTextureCache(bad.data(), bad.size(), &read));
+    }
+    // Fewer levels than written only reads the start of the table
+    uint32_t fewerLevels = written.mipLevels - 1;
+    std::vector<uint8_t> fewer = file;
+    memcpy(fewer.data() + levelCountOffset, &fewerLevels, 4);
+    assert(readTextureCache(fewer.data(), fewer.size(), &read) && read.mipLevels == fewerLevels);
+
+    // Offsets and sizes past EOF, including ones that overflow when added
+    const uint64_t fileSize = file.size();
+    const uint32_t checkedLevels[] = {0, written.mipLevels - 1};
+    for (size_t l = 0; l < 2; ++l)
+    {
+        uint32_t level = checkedLevels[l];
+        const uint64_t offsets[] = {fileSize + 1, fileSize + 16, 0x8000000000000000ULL, 0xfffffffffffffff0ULL};
+        for (size_t i = 0; i < sizeof(offsets) / sizeof(offsets[0]); ++i)
+        {
+            std::vector<uint8_t> bad = file;
+            setLevelField(bad, level, 0, offsets[i], 8);
+            assert(!readTextureCache(bad.data(), bad.size(), &read));
+        }
+        const uint64_t sizes[] = {fileSize + 1, 0xffffffffu};
+        for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+        {
+            std::vector<uint8_t> bad = file;
+            setLevelField(bad, level, 8, sizes[i], 4);
+            assert(!readTextureCache(bad.data(), bad.size(), &read));
+        }
+        // One byte more than what's left after the offset
+        std::vector<uint8_t> bad = file;
+        uint64_t offset;
+        memcpy(&offset, bad.data() + headerSize + levelSize * level, 8);
+        setLevelField(bad, level, 8, fileSize - offset + 1, 4);
+        assert(!readTextureCache(bad.data(), bad.size(), &read));
+        // Exactly up to the end is fine
+        setLevelField(bad, level, 8, fileSize - offset, 4);
+        assert(readTextureCache(bad.data(), bad.size(), &read));
+        assert(read.pLevels[level] + read.sizes[level] == bad.data() + bad.size());
+    }
+    remove(szCacheFilename);
+    printf("rejected files: passed\n");
+}
+
+int main()
+{
+    checkHashVectors();
+    checkRoundTrip();
+    checkRejected();
+    printf("cache_test: passed\n");
+    return 0;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+// colorFromDataFormat as egCreateTexture2D had it before getFormatConverter,
+// unchanged, for format_test and format_bench to compare with.
+
+#include <stdint.h>
+#include "eg.h"
+
+static uint8_t colorFromDataFormat(EGFormat dataFormat, const void *pData, uint32_t pos)
+{
+    if (dataFormat & EG_U8)
+    {
+        return *((uint8_t *)pData + pos);
+    }
+    else if (dataFormat & EG_U16)
+    {
+        return (uint8_t)((*((uint16_t *)pData + pos) >> 8) & 0xffffffff);
+    }
+    else if (dataFormat & EG_U32)
+    {
+        return (uint8_t)((*((uint32_t *)pData + pos) >> 24) & 0xffffffff);
+    }
+    else if (dataFormat & EG_U64)
+    {
+        return (uint8_t)((*((uint64_t *)pData + pos) >> 56) & 0xffffffff);
+    }
+    else if (dataFormat & EG_S8)
+    {
+        return (uint8_t)(*((int8_t *)pData + pos)) + INT8_MAX + 1;
+    }
+    else if (dataFormat & EG_S16)
+    {
+        return (uint8_t)((((uint16_t)(*((int16_t *)pData + pos)) + INT16_MAX + 1) >> 8) & 0xffffffff);
+    }
+    else if (dataFormat & EG_S32)
+    {
+        return (uint8_t)((((uint32_t)(*((int32_t *)pData + pos)) + INT32_MAX + 1) >> 24) & 0xffffffff);
+    }
+    else if (dataFormat & EG_S64)
+    {
+        return (uint8_t)((((uint64_t)(*((int64_t *)pData + pos)) + INT64_MAX + 1) >> 56) & 0xffffffff);
+    }
+    else if (dataFormat & EG_F32)
+    {
+        return (uint8_t)((*((float *)pData + pos)) * 255.f);
+    }
+    else if (dataFormat & EG_F64)
+    {
+        return (uint8_t)((*((double *)pData + pos)) * 255.0);
+    }
+    return 255;
+}
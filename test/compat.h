@@ -0,0 +1,13 @@
+#pragma once
+
+// LodePNG opens files with the MSVC secure CRT. This header is forced into
+// every file of the test build, so it also builds with GCC and Clang.
+#ifndef _MSC_VER
+#include <stdio.h>
+
+static inline int fopen_s(FILE **ppFile, const char *szFilename, const char *szMode)
+{
+    *ppFile = fopen(szFilename, szMode);
+    return *ppFile ? 0 : 1;
+}
+#endif
@@ -0,0 +1,112 @@
+// dfr timings with FreeType and a real font, see getTestFont
+
+#include "test.h"
+#include "dfr.h"
+
+static const char *szParagraph =
+    "The quick brown fox jumps over the lazy dog. Pack my box with five dozen liquor jugs. "
+    "How vexingly quick daft zebras jump! Sphinx of black quartz, judge my vow. "
+    "The five boxing wizards jump quickly.";
+
+static std::string makeLongParagraph()
+{
+    std::string paragraph;
+    for (int i = 0; i < 6; ++i)
+    {
+        paragraph += "The quick brown fox jumps over the lazy dog. Pack my box with five dozen liquor jugs. "
+                     "How vexingly quick daft zebras jump! ";
+    }
+    return paragraph;
+}
+
+// The same word wrapped paragraph drawn 1000 times, without the glyph cache
+// (size 0 keeps nothing from one draw to the next) and with it
+static void benchGlyphCache(const char *szFont)
+{
+    std::vector<unsigned char> pixels(512 * 256 * 4);
+    dfr::sImage image = {pixels.data(), 512, 256};
+    dfr::sFont font = {szFont, 20};
+    dfr::sFormating formating = {true, dfr::ALIGN_TOP_LEFT, 0, false};
+    for (int cached = 0; cached < 2; ++cached)
+    {
+        dfr::setGlyphCacheSize(cached ? 4 * 1024 * 1024 : 0);
+        dfr::sGlyphCacheStats before = dfr::getGlyphCacheStats();
+        double start = getSeconds();
+        for (int i = 0; i < 1000; ++i)
+        {
+            memset(pixels.data(), 0, pixels.size());
+            dfr::drawText(szParagraph, image, font, formating);
+        }
+        double ms = (getSeconds() - start) * 1000.0;
+        dfr::sGlyphCacheStats stats = dfr::getGlyphCacheStats();
+        printf("cache %d: %.3f ms per draw, %u hits, %u misses, %u glyphs in %u KB\n", cached, ms / 1000.0,
+               (unsigned int)(stats.hits - before.hits), (unsigned int)(stats.misses - before.misses),
+               (unsigned int)stats.glyphCount, (unsigned int)(stats.bytes / 1024));
+    }
+}
+
+// layoutText of a label that changes every frame, the glyphs go to a CPU
+// atlas the first time they're used
+static void benchLayoutText(const char *szFont)
+{
+    struct sCountingAtlas
+    {
+        static unsigned int insert(void *pContext, int, int, const unsigned char *)
+        {
+            return (unsigned int)++*(size_t *)pContext;
+        }
+    };
+    size_t entryCount = 0;
+    dfr::sGlyphAtlas glyphAtlas = {&entryCount, sCountingAtlas::insert, NULL};
+    dfr::sFont font = {szFont, 20};
+    dfr::sFormating formating = {false, dfr::ALIGN_TOP_LEFT, 0, false};
+    std::vector<dfr::sGlyphQuad> quads;
+    char text[64];
+    dfr::setGlyphCacheSize(4 * 1024 * 1024);
+    double start = getSeconds();
+    for (int i = 0; i < 1000; ++i)
+    {
+        snprintf(text, sizeof(text), "Score: %d, time left %d.%02d", i * 10, 60 - i / 100, i % 100);
+        dfr::layoutText(text, 512, 64, font, formating, glyphAtlas, quads);
+    }
+    double ms = (getSeconds() - start) * 1000.0;
+    printf("layoutText: %.4f ms per changing label, %u glyphs inserted for 1000 labels\n", ms / 1000.0,
+           (unsigned int)entryCount);
+}
+
+// Worst case autoresize: a long paragraph from 72 points that only fits much
+// smaller. drawText with a cold and a warm glyph cache, and measureText.
+static void benchAutoresize(const char *szFont)
+{
+    std::string paragraph = makeLongParagraph();
+    std::vector<unsigned char> pixels(512 * 256 * 4);
+    dfr::sImage image = {pixels.data(), 512, 256};
+    dfr::sFont font = {szFont, 72};
+    dfr::sFormating formating = {true, dfr::ALIGN_TOP_LEFT, 12, false};
+    dfr::sRenderInfo info;
+    for (int cached = 0; cached < 2; ++cached)
+    {
+        dfr::setGlyphCacheSize(cached ? 4 * 1024 * 1024 : 0);
+        dfr::drawText(paragraph, image, font, formating);
+        double start = getSeconds();
+        for (int i = 0; i < 100; ++i) info = dfr::drawText(paragraph, image, font, formating);
+        double ms = (getSeconds() - start) * 1000.0;
+        printf("cache %d: %.3f ms per autoresize draw, %d points\n", cached, ms / 100.0, info.renderedPointSize);
+    }
+
+    dfr::sTextMetrics metrics;
+    double start = getSeconds();
+    for (int i = 0; i < 100; ++i) metrics = dfr::measureText(paragraph, image.width, image.height, font, formating);
+    double ms = (getSeconds() - start) * 1000.0;
+    printf("%.3f ms per measure, %d points, %d lines\n", ms / 100.0, metrics.pointSize, metrics.lineCount);
+}
+
+int main()
+{
+    const char *szFont = getTestFont();
+    dfr::init();
+    benchGlyphCache(szFont);
+    benchLayoutText(szFont);
+    benchAutoresize(szFont);
+    return 0;
+}
@@ -0,0 +1,153 @@
+// dfr checks with FreeType and a real font, see getTestFont
+
+#include "test.h"
+#include "dfr.h"
+
+static const char *szParagraph =
+    "The quick brown fox jumps over the lazy dog. Pack my box with five dozen liquor jugs. "
+    "How vexingly quick daft zebras jump! Sphinx of black quartz, judge my vow. "
+    "The five boxing wizards jump quickly.";
+
+static std::string makeLongParagraph()
+{
+    std::string paragraph;
+    for (int i = 0; i < 6; ++i)
+    {
+        paragraph += "The quick brown fox jumps over the lazy dog. Pack my box with five dozen liquor jugs. "
+                     "How vexingly quick daft zebras jump! ";
+    }
+    return paragraph;
+}
+
+// A word wrapped paragraph drawn without the glyph cache (size 0 keeps
+// nothing from one draw to the next) and with it, cold then warm, gives the
+// same pixels
+static void checkGlyphCache(const char *szFont)
+{
+    std::vector<unsigned char> pixels(512 * 256 * 4);
+    dfr::sImage image = {pixels.data(), 512, 256};
+    dfr::sFont font = {szFont, 20};
+    dfr::sFormating formating = {true, dfr::ALIGN_TOP_LEFT, 0, false};
+    std::vector<unsigned char> results[3];
+    for (int pass = 0; pass < 3; ++pass)
+    {
+        dfr::setGlyphCacheSize(pass ? 4 * 1024 * 1024 : 0);
+        dfr::sGlyphCacheStats before = dfr::getGlyphCacheStats();
+        memset(pixels.data(), 0, pixels.size());
+        dfr::drawText(szParagraph, image, font, formating);
+        results[pass] = pixels;
+        dfr::sGlyphCacheStats stats = dfr::getGlyphCacheStats();
+        if (pass == 2) assert(stats.misses == before.misses && stats.hits > before.hits);
+    }
+    assert(results[0] == results[1] && results[0] == results[2]);
+    assert(std::vector<unsigned char>(pixels.size(), 0) != results[0]);
+    printf("glyph cache: passed\n");
+}
+
+struct sCpuAtlas
+{
+    std::vector<std::vector<unsigned char> > entries;
+
+    static unsigned int insert(void *pContext, int width, int height, const unsigned char *pCoverage)
+    {
+        sCpuAtlas *pAtlas = (sCpuAtlas *)pContext;
+        pAtlas->entries.push_back(std::vector<unsigned char>(pCoverage, pCoverage + width * height));
+        return (unsigned int)pAtlas->entries.size();
+    }
+};
+
+// Text laid out with a CPU atlas, the quads drawn the way drawText blends,
+// against drawText, for every alignment, wrapping, autoresize and direction
+static void checkLayoutText(const char *szFont)
+{
+    sCpuAtlas cpuAtlas;
+    dfr::sGlyphAtlas glyphAtlas = {&cpuAtlas, sCpuAtlas::insert, NULL};
+    const char *szText =
+        "The quick brown fox jumps over the lazy dog. AVAWAY Ta To LT 0123456789!\n"
+        "Second line, with more words to wrap around the edges and kerning pairs like AV, Yo, We.";
+    const dfr::eAlign aligns[] = {dfr::ALIGN_TOP_LEFT, dfr::ALIGN_CENTER, dfr::ALIGN_BOTTOM_RIGHT, dfr::ALIGN_TOP_LEFT_JUSTIFY};
+    const dfr::sColor color = {200, 100, 50};
+    const int w = 300, h = 200;
+    dfr::setGlyphCacheSize(4 * 1024 * 1024);
+    for (int i = 0; i < 4 * 4 * 8; ++i)
+    {
+        dfr::sFont font = {szFont, 9 + (i / 32) * 10};
+        dfr::sFormating formating = {(i & 1) != 0, aligns[(i / 8) % 4], (i & 2) ? 6 : 0, (i & 4) != 0};
+        std::vector<unsigned char> drawn(w * h * 4, 0), composed(w * h * 4, 0);
+        dfr::sImage image = {drawn.data(), w, h};
+        dfr::sRenderInfo drawInfo = dfr::drawText(szText, image, font, formating, color);
+        std::vector<dfr::sGlyphQuad> quads;
+        dfr::sRenderInfo layoutInfo = dfr::layoutText(szText, w, h, font, formating, glyphAtlas, quads);
+        assert(!memcmp(&drawInfo, &layoutInfo, sizeof(drawInfo)));
+        assert(!quads.empty());
+        for (size_t q = 0; q < quads.size(); ++q)
+        {
+            const dfr::sRect &rect = quads[q].rect;
+            const std::vector<unsigned char> &coverage = cpuAtlas.entries[quads[q].entry - 1];
+            assert((int)coverage.size() == rect.w * rect.h);
+            for (int y = 0; y < rect.h; ++y)
+            {
+                for (int x = 0; x < rect.w; ++x)
+                {
+                    if (rect.x + x < 0 || rect.y + y < 0 || rect.x + x >= w || rect.y + y >= h) continue;
+                    unsigned char *pPixel = &composed[((rect.y + y) * w + rect.x + x) * 4];
+                    unsigned char alpha = pPixel[3] > coverage[y * rect.w + x] ? pPixel[3] : coverage[y * rect.w + x];
+                    pPixel[0] = (unsigned char)(color.r * alpha / 255);
+                    pPixel[1] = (unsigned char)(color.g * alpha / 255);
+                    pPixel[2] = (unsigned char)(color.b * alpha / 255);
+                    pPixel[3] = alpha;
+                }
+            }
+        }
+        assert(drawn == composed);
+    }
+
+    // Glyphs go in the atlas once, while the glyph cache keeps them
+    size_t entryCount = cpuAtlas.entries.size();
+    std::vector<dfr::sGlyphQuad> quads;
+    dfr::sFont font = {szFont, 19};
+    dfr::sFormating formating = {true, dfr::ALIGN_TOP_LEFT, 0, false};
+    dfr::layoutText(szText, w, h, font, formating, glyphAtlas, quads);
+    assert(cpuAtlas.entries.size() == entryCount);
+    printf("layoutText: %d layouts match drawText, %u atlas entries\n", 4 * 4 * 8, (unsigned int)entryCount);
+}
+
+// Worst case autoresize: a long paragraph from 72 points that only fits much
+// smaller. drawText and measureText pick the same size, and going down one
+// point at a time finds it too.
+static void checkAutoresize(const char *szFont)
+{
+    std::string paragraph = makeLongParagraph();
+    std::vector<unsigned char> pixels(512 * 256 * 4);
+    dfr::sImage image = {pixels.data(), 512, 256};
+    dfr::sFont font = {szFont, 72};
+    dfr::sFormating formating = {true, dfr::ALIGN_TOP_LEFT, 12, false};
+    dfr::setGlyphCacheSize(4 * 1024 * 1024);
+    dfr::sRenderInfo info = dfr::drawText(paragraph, image, font, formating);
+    dfr::sTextMetrics metrics = dfr::measureText(paragraph, image.width, image.height, font, formating);
+    assert(metrics.pointSize == info.renderedPointSize);
+    assert(metrics.pointSize < font.pointSize && metrics.pointSize > formating.minPointSize);
+    assert(metrics.width <= image.width && metrics.height <= image.height);
+
+    dfr::sFormating noResize = formating;
+    noResize.minPointSize = 0;
+    dfr::sFont sized = font;
+    for (sized.pointSize = font.pointSize; sized.pointSize > formating.minPointSize; --sized.pointSize)
+    {
+        dfr::sTextMetrics fit = dfr::measureText(paragraph, image.width, image.height, sized, noResize);
+        if (fit.width <= image.width && fit.height <= image.height) break;
+    }
+    assert(sized.pointSize == metrics.pointSize);
+    printf("autoresize: %d points, %d lines: passed\n", metrics.pointSize, metrics.lineCount);
+}
+
+int main()
+{
+    const char *szFont = getTestFont();
+    dfr::init();
+    checkGlyphCache(szFont);
+    checkLayoutText(szFont);
+    checkAutoresize(szFont);
+    printf("dfr_test: passed\n");
+    return 0;
+}
@@ -0,0 +1,47 @@
+// 1024x1024 conversions to RGBA8: the converter of the format against the
+// old per channel colorFromDataFormat calls
+
+#include "test.h"
+#include "color_from_data_format.h"
+extern "C" {
+#include "eg_format.h"
+}
+
+int main()
+{
+    const uint32_t pixelCount = 1024 * 1024;
+    std::vector<float> in(pixelCount * 4 * 2);
+    std::vector<uint8_t> out(pixelCount * 4);
+    for (size_t i = 0; i < in.size(); ++i) in[i] = (float)(i % 1000) / 1000.f;
+
+    const EGFormat formats[] = {(EGFormat)(EG_U16 | EG_RGBA), (EGFormat)(EG_F32 | EG_RGBA), (EGFormat)(EG_F32 | EG_RGB),
+                                (EGFormat)(EG_U8 | EG_RGB), (EGFormat)(EG_F64 | EG_R)};
+    const char *szNames[] = {"U16 RGBA", "F32 RGBA", "F32 RGB", "U8 RGB", "F64 R"};
+    for (int f = 0; f < 5; ++f)
+    {
+        const int runCount = 20;
+        uint32_t channels = formats[f] & 0x0f;
+        EGFormatConverter converter = getFormatConverter(formats[f]);
+
+        double start = getSeconds();
+        for (int run = 0; run < runCount; ++run) converter(in.data(), out.data(), pixelCount);
+        double converterSeconds = (getSeconds() - start) / runCount;
+
+        start = getSeconds();
+        for (int run = 0; run < runCount; ++run)
+        {
+            for (uint32_t i = 0; i < pixelCount; ++i)
+            {
+                for (uint32_t c = 0; c < 4; ++c)
+                {
+                    out[i * 4 + c] = (c < channels) ? colorFromDataFormat(formats[f], in.data(), i * channels + c) : 255;
+                }
+            }
+        }
+        double oldSeconds = (getSeconds() - start) / runCount;
+
+        printf("%s: converter %.2f ms, colorFromDataFormat %.2f ms (%.1fx)\n", szNames[f], converterSeconds * 1000.0,
+               oldSeconds * 1000.0, oldSeconds / converterSeconds);
+    }
+    return 0;
+}
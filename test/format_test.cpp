@@ -0,0 +1,86 @@
+// getFormatConverter against colorFromDataFormat, the per channel function it
+// replaced in egCreateTexture2D. The old function tested the type bits with
+// &, so it took the wrong branch for U32, S8, S32, F32 (read as U8), S16 and
+// F64 (read as U16). The converters must give the bytes of the branch of the
+// actual type for all 40 formats, and the bytes of the old function itself
+// for the types it got right.
+
+#include "test.h"
+#include "color_from_data_format.h"
+extern "C" {
+#include "eg_format.h"
+}
+
+// The branch of colorFromDataFormat for the actual type of the format
+static uint8_t colorFromType(EGFormat dataFormat, const void *pData, uint32_t pos)
+{
+    switch (dataFormat & 0xf0)
+    {
+    case EG_U8: return *((uint8_t *)pData + pos);
+    case EG_U16: return (uint8_t)((*((uint16_t *)pData + pos) >> 8) & 0xffffffff);
+    case EG_U32: return (uint8_t)((*((uint32_t *)pData + pos) >> 24) & 0xffffffff);
+    case EG_U64: return (uint8_t)((*((uint64_t *)pData + pos) >> 56) & 0xffffffff);
+    case EG_S8: return (uint8_t)(*((int8_t *)pData + pos)) + INT8_MAX + 1;
+    case EG_S16: return (uint8_t)((((uint16_t)(*((int16_t *)pData + pos)) + INT16_MAX + 1) >> 8) & 0xffffffff);
+    case EG_S32: return (uint8_t)((((uint32_t)(*((int32_t *)pData + pos)) + INT32_MAX + 1) >> 24) & 0xffffffff);
+    case EG_S64: return (uint8_t)((((uint64_t)(*((int64_t *)pData + pos)) + INT64_MAX + 1) >> 56) & 0xffffffff);
+    case EG_F32: return (uint8_t)((*((float *)pData + pos)) * 255.f);
+    case EG_F64: return (uint8_t)((*((double *)pData + pos)) * 255.0);
+    }
+    return 255;
+}
+
+int main()
+{
+    static const uint32_t typeSizes[10] = {1, 2, 4, 8, 1, 2, 4, 8, 4, 8};
+
+    // Not a channel count or not a type
+    assert(getFormatConverter((EGFormat)(EG_U8 | 0)) == NULL);
+    assert(getFormatConverter((EGFormat)(EG_U8 | 5)) == NULL);
+    assert(getFormatConverter((EGFormat)EG_RGBA) == NULL);
+    assert(getFormatConverter((EGFormat)(0xb0 | EG_RGBA)) == NULL);
+
+    // An odd count, so that the SSE2 converters go through their tails
+    const uint32_t pixelCount = (1 << 16) - 3;
+    std::vector<unsigned char> in(pixelCount * 4 * 8);
+    std::vector<uint8_t> out(pixelCount * 4);
+    sRandom random;
+    int formatCount = 0;
+    for (uint32_t type = 1; type <= 10; ++type)
+    {
+        for (uint32_t channels = EG_R; channels <= EG_RGBA; ++channels)
+        {
+            EGFormat dataFormat = (EGFormat)((type << 4) | channels);
+            uint32_t valueCount = pixelCount * channels;
+            for (size_t i = 0; i < valueCount * typeSizes[type - 1]; ++i) in[i] = (unsigned char)random.next();
+            if ((dataFormat & 0xf0) == EG_F32)
+            {
+                for (uint32_t i = 0; i < valueCount; ++i) ((float *)in.data())[i] = (float)(random.next() % 100001) / 100000.f;
+            }
+            else if ((dataFormat & 0xf0) == EG_F64)
+            {
+                for (uint32_t i = 0; i < valueCount; ++i) ((double *)in.data())[i] = (double)(random.next() % 100001) / 100000.0;
+            }
+
+            EGFormatConverter converter = getFormatConverter(dataFormat);
+            assert(converter != NULL);
+            converter(in.data(), out.data(), pixelCount);
+
+            // The old dispatch was right for U8, U16, U64 and S64
+            bool bOldDispatchRight = (type == 1 || type == 2 || type == 4 || type == 8);
+            for (uint32_t i = 0; i < pixelCount; ++i)
+            {
+                for (uint32_t c = 0; c < 4; ++c)
+                {
+                    uint8_t expected = (c < channels) ? colorFromType(dataFormat, in.data(), i * channels + c) : ((c == 3) ? 255 : 0);
+                    assert(out[i * 4 + c] == expected);
+                    if (bOldDispatchRight && c < channels) assert(out[i * 4 + c] == colorFromDataFormat(dataFormat, in.data(), i * channels + c));
+                }
+            }
+            ++formatCount;
+        }
+    }
+
+    printf("format_test: %d formats, passed\n", formatCount);
+    return 0;
+}
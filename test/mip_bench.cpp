@@ -0,0 +1,30 @@
+// Full mip chain of ogre_dif.png for each filter, in MB/s of source pixels
+
+#include "test.h"
+extern "C" {
+#include "eg_mip.h"
+}
+
+int main()
+{
+    unsigned int w, h;
+    std::vector<unsigned char> image = loadPNG("ogre_dif.png", &w, &h);
+    unsigned int levelCount = getMipLevelCount(w, h);
+    std::vector<unsigned char> chain(getMipChainSize(w, h, levelCount));
+
+    const uint32_t mipFlags[] = {0, MIP_SRGB, MIP_KAISER, MIP_KAISER | MIP_SRGB};
+    const char *szNames[] = {"box linear", "box sRGB", "kaiser linear", "kaiser sRGB"};
+    for (int i = 0; i < 4; ++i)
+    {
+        const int runCount = 20;
+        double start = getSeconds();
+        for (int run = 0; run < runCount; ++run)
+        {
+            memcpy(chain.data(), image.data(), image.size());
+            generateMipChain(chain.data(), w, h, levelCount, mipFlags[i]);
+        }
+        double seconds = (getSeconds() - start) / runCount;
+        printf("%s %ux%u: %.2f ms, %.0f MB/s\n", szNames[i], w, h, seconds * 1000.0, (double)image.size() / seconds / 1e6);
+    }
+    return 0;
+}
@@ -0,0 +1,142 @@
+// generateMipChain against a double precision reference: the exact box
+// coverage filter on the unrounded previous level, in linear or sRGB space.
+// Every byte of every level must be within 1 of the reference.
+
+#include <math.h>
+#include "test.h"
+extern "C" {
+#include "eg_mip.h"
+}
+
+static double srgbToLinear(double c)
+{
+    return (c <= 0.04045) ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4);
+}
+
+static double linearToSrgb(double c)
+{
+    return (c <= 0.0031308) ? c * 12.92 : 1.055 * pow(c, 1.0 / 2.4) - 0.055;
+}
+
+static std::vector<unsigned char> referenceChain(const unsigned char *pImage, unsigned int w, unsigned int h, unsigned int levelCount, bool bSRGB)
+{
+    std::vector<unsigned char> chain(pImage, pImage + w * h * 4);
+    std::vector<double> level(w * h * 4);
+    for (size_t i = 0; i < level.size(); ++i)
+    {
+        double c = (double)pImage[i] / 255.0;
+        level[i] = (bSRGB && i % 4 != 3) ? srgbToLinear(c) : c;
+    }
+
+    for (unsigned int l = 1; l < levelCount; ++l)
+    {
+        unsigned int dstW = (w > 1) ? w / 2 : 1;
+        unsigned int dstH = (h > 1) ? h / 2 : 1;
+        double scaleX = (double)w / (double)dstW;
+        double scaleY = (double)h / (double)dstH;
+        std::vector<double> next(dstW * dstH * 4);
+        for (unsigned int y = 0; y < dstH; ++y)
+        {
+            for (unsigned int x = 0; x < dstW; ++x)
+            {
+                // Area of each source texel under the destination texel
+                double y0 = y * scaleY, y1 = (y + 1) * scaleY;
+                double x0 = x * scaleX, x1 = (x + 1) * scaleX;
+                double sum[4] = {0, 0, 0, 0};
+                double total = 0;
+                for (int j = (int)floor(y0); j < (int)ceil(y1); ++j)
+                {
+                    double wy = fmin(j + 1, y1) - fmax(j, y0);
+                    for (int i = (int)floor(x0); i < (int)ceil(x1); ++i)
+                    {
+                        double weight = wy * (fmin(i + 1, x1) - fmax(i, x0));
+                        for (int c = 0; c < 4; ++c) sum[c] += weight * level[(j * w + i) * 4 + c];
+                        total += weight;
+                    }
+                }
+                for (int c = 0; c < 4; ++c) next[(y * dstW + x) * 4 + c] = sum[c] / total;
+            }
+        }
+        for (size_t i = 0; i < next.size(); ++i)
+        {
+            double c = (bSRGB && i % 4 != 3) ? linearToSrgb(next[i]) : next[i];
+            chain.push_back((unsigned char)floor(c * 255.0 + .5));
+        }
+        level.swap(next);
+        w = dstW;
+        h = dstH;
+    }
+    return chain;
+}
+
+static void checkChain(const char *szName, const unsigned char *pImage, unsigned int w, unsigned int h)
+{
+    unsigned int levelCount = getMipLevelCount(w, h);
+    for (int bSRGB = 0; bSRGB < 2; ++bSRGB)
+    {
+        std::vector<unsigned char> chain(getMipChainSize(w, h, levelCount));
+        memcpy(chain.data(), pImage, w * h * 4);
+        generateMipChain(chain.data(), w, h, levelCount, bSRGB ? MIP_SRGB : 0);
+        std::vector<unsigned char> reference = referenceChain(pImage, w, h, levelCount, bSRGB != 0);
+        assert(chain.size() == reference.size());
+
+        int maxDiff = 0;
+        for (size_t i = 0; i < chain.size(); ++i)
+        {
+            int diff = abs((int)chain[i] - (int)reference[i]);
+            if (diff > maxDiff) maxDiff = diff;
+        }
+        printf("%s %ux%u, %u levels, box %s: max diff %d\n", szName, w, h, levelCount, bSRGB ? "sRGB" : "linear", maxDiff);
+        assert(maxDiff <= 1);
+    }
+}
+
+int main()
+{
+    assert(getMipLevelCount(1, 1) == 1);
+    assert(getMipLevelCount(1024, 1024) == 11);
+    assert(getMipLevelCount(128, 129) == 8);
+    assert(getMipChainSize(4, 2, 3) == (4 * 2 + 2 * 1 + 1 * 1) * 4);
+
+    const char *szFilenames[] = {"ogre_dif.png", "m02.png", "alphatest.png"};
+    for (int i = 0; i < 3; ++i)
+    {
+        unsigned int w, h;
+        std::vector<unsigned char> image = loadPNG(szFilenames[i], &w, &h);
+        checkChain(szFilenames[i], image.data(), w, h);
+    }
+
+    // Odd and thin sizes go through the 3 tap filter and the clamped axis
+    const unsigned int sizes[][2] = {{37, 23}, {1, 67}, {255, 3}, {9, 9}};
+    sRandom random;
+    for (int i = 0; i < 4; ++i)
+    {
+        std::vector<unsigned char> image(sizes[i][0] * sizes[i][1] * 4);
+        for (size_t j = 0; j < image.size(); ++j) image[j] = (unsigned char)random.next();
+        checkChain("random", image.data(), sizes[i][0], sizes[i][1]);
+    }
+
+    // Kaiser has negative lobes, but a flat image must stay flat
+    {
+        unsigned int w = 64, h = 40;
+        unsigned int levelCount = getMipLevelCount(w, h);
+        std::vector<unsigned char> chain(getMipChainSize(w, h, levelCount));
+        for (unsigned int i = 0; i < w * h; ++i)
+        {
+            chain[i * 4 + 0] = 200;
+            chain[i * 4 + 1] = 100;
+            chain[i * 4 + 2] = 30;
+            chain[i * 4 + 3] = 255;
+        }
+        generateMipChain(chain.data(), w, h, levelCount, MIP_KAISER | MIP_SRGB);
+        for (size_t i = w * h * 4; i < chain.size(); i += 4)
+        {
+            assert(abs(chain[i + 0] - 200) <= 1 && abs(chain[i + 1] - 100) <= 1 && abs(chain[i + 2] - 30) <= 1);
+            assert(chain[i + 3] == 255);
+        }
+        printf("kaiser sRGB %ux%u: flat image stays flat\n", w, h);
+    }
+
+    printf("mip_test: passed\n");
+    return 0;
+}
@@ -0,0 +1,27 @@
+// generateNormalMap on stone.png, with and without occlusion, in Mtexel/s
+
+#include "test.h"
+extern "C" {
+#include "eg_normal.h"
+}
+
+int main()
+{
+    unsigned int w, h;
+    std::vector<unsigned char> image = loadPNG("stone.png", &w, &h);
+    std::vector<unsigned char> normals(image.size());
+
+    for (int bOcclusion = 0; bOcclusion < 2; ++bOcclusion)
+    {
+        const int runCount = bOcclusion ? 5 : 20;
+        double start = getSeconds();
+        for (int run = 0; run < runCount; ++run)
+        {
+            generateNormalMap(image.data(), normals.data(), w, h, 3, 2.f, bOcclusion ? NORMAL_OCCLUSION : 0);
+        }
+        double seconds = (getSeconds() - start) / runCount;
+        printf("%s %ux%u: %.2f ms, %.0f Mtexel/s\n", bOcclusion ? "normals + occlusion" : "normals", w, h,
+            seconds * 1000.0, (double)w * h / seconds / 1e6);
+    }
+    return 0;
+}
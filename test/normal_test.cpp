@@ -0,0 +1,116 @@
+// generateNormalMap against a scalar reference built straight from the
+// definitions: a Scharr gradient on the wrapped heightmap, and occlusion from
+// the highest horizon of 8 directions x 8 steps. Both modes must match
+// exactly. A flat heightmap must give a flat map, and a pit normals that face
+// inward.
+
+#include <math.h>
+#include "test.h"
+extern "C" {
+#include "eg_normal.h"
+}
+
+static float getHeight(const uint8_t *pIn, int w, int h, int x, int y, float strength)
+{
+    x = ((x % w) + w) % w;
+    y = ((y % h) + h) % h;
+    const uint8_t *pTexel = pIn + (y * w + x) * 4;
+    return (float)(pTexel[0] + pTexel[1] + pTexel[2]) / (3.f * 255.f) * strength;
+}
+
+static void referenceNormalMap(const uint8_t *pIn, uint8_t *pOut, int w, int h, float strength, bool bOcclusion)
+{
+    static const float steps[8] = {1, 2, 3, 5, 7, 10, 13, 16};
+    for (int y = 0; y < h; ++y)
+    {
+        for (int x = 0; x < w; ++x)
+        {
+            float dx = (3.f * (getHeight(pIn, w, h, x + 1, y - 1, strength) - getHeight(pIn, w, h, x - 1, y - 1, strength)) +
+                        10.f * (getHeight(pIn, w, h, x + 1, y, strength) - getHeight(pIn, w, h, x - 1, y, strength)) +
+                        3.f * (getHeight(pIn, w, h, x + 1, y + 1, strength) - getHeight(pIn, w, h, x - 1, y + 1, strength))) / 32.f;
+            float dy = (3.f * (getHeight(pIn, w, h, x - 1, y + 1, strength) - getHeight(pIn, w, h, x - 1, y - 1, strength)) +
+                        10.f * (getHeight(pIn, w, h, x, y + 1, strength) - getHeight(pIn, w, h, x, y - 1, strength)) +
+                        3.f * (getHeight(pIn, w, h, x + 1, y + 1, strength) - getHeight(pIn, w, h, x + 1, y - 1, strength))) / 32.f;
+            float invLength = 1.f / sqrtf(dx * dx + dy * dy + 1.f);
+            uint8_t *pTexel = pOut + (y * w + x) * 4;
+            pTexel[0] = (uint8_t)lrintf(127.5f - dx * invLength * 127.5f);
+            pTexel[1] = (uint8_t)lrintf(127.5f - dy * invLength * 127.5f);
+            pTexel[2] = (uint8_t)lrintf(127.5f + invLength * 127.5f);
+
+            float occlusion = 0.f;
+            if (bOcclusion)
+            {
+                for (int d = 0; d < 8; ++d)
+                {
+                    float angle = (float)d * 6.2831853f / 8.f;
+                    float maxTangent = 0.f;
+                    for (int s = 0; s < 8; ++s)
+                    {
+                        int offsetX = (int)floorf(cosf(angle) * steps[s] + .5f);
+                        int offsetY = (int)floorf(sinf(angle) * steps[s] + .5f);
+                        float tangent = (getHeight(pIn, w, h, x + offsetX, y + offsetY, strength) - getHeight(pIn, w, h, x, y, strength)) /
+                                        sqrtf((float)(offsetX * offsetX + offsetY * offsetY));
+                        if (tangent > maxTangent) maxTangent = tangent;
+                    }
+                    occlusion += maxTangent / sqrtf(1.f + maxTangent * maxTangent);
+                }
+            }
+            pTexel[3] = bOcclusion ? (uint8_t)lrintf(255.f - occlusion * 255.f / 8.f) : 255;
+        }
+    }
+}
+
+int main()
+{
+    // Flat
+    {
+        const uint32_t w = 37, h = 29;
+        std::vector<uint8_t> in(w * h * 4, 100), out(w * h * 4);
+        generateNormalMap(in.data(), out.data(), w, h, 3, 4.f, NORMAL_OCCLUSION);
+        for (uint32_t i = 0; i < w * h; ++i)
+        {
+            assert(out[i * 4 + 0] == 128 && out[i * 4 + 1] == 128 && out[i * 4 + 2] == 255 && out[i * 4 + 3] == 255);
+        }
+        printf("flat %ux%u: passed\n", w, h);
+    }
+
+    // A pit centered on (18, 14): normals face its center, and its bottom is
+    // more occluded than the flat ground around it
+    {
+        const uint32_t w = 37, h = 29;
+        std::vector<uint8_t> in(w * h * 4), out(w * h * 4);
+        for (uint32_t y = 0; y < h; ++y)
+        {
+            for (uint32_t x = 0; x < w; ++x)
+            {
+                float r = hypotf((float)x - 18.f, (float)y - 14.f);
+                uint8_t value = (uint8_t)((r < 8.f) ? 255.f * r / 8.f : 255.f);
+                for (int c = 0; c < 4; ++c) in[(y * w + x) * 4 + c] = value;
+            }
+        }
+        generateNormalMap(in.data(), out.data(), w, h, 3, 4.f, NORMAL_OCCLUSION);
+        assert(out[(14 * w + 14) * 4 + 0] > 128); // Left of the center faces +x
+        assert(out[(14 * w + 22) * 4 + 0] < 128); // Right faces -x
+        assert(out[(10 * w + 18) * 4 + 1] > 128); // Above faces +y
+        assert(out[(14 * w + 18) * 4 + 3] < out[0 * 4 + 3]);
+        printf("pit %ux%u: passed\n", w, h);
+    }
+
+    // Random, odd sizes go through the SSE2 tails
+    {
+        const uint32_t w = 203, h = 67;
+        std::vector<uint8_t> in(w * h * 4), out(w * h * 4), reference(w * h * 4);
+        sRandom random;
+        for (size_t i = 0; i < in.size(); ++i) in[i] = (uint8_t)random.next();
+        for (int bOcclusion = 0; bOcclusion < 2; ++bOcclusion)
+        {
+            generateNormalMap(in.data(), out.data(), w, h, 3, 3.f, bOcclusion ? NORMAL_OCCLUSION : 0);
+            referenceNormalMap(in.data(), reference.data(), w, h, 3.f, bOcclusion != 0);
+            assert(out == reference);
+            printf("random %ux%u%s: matches the reference\n", w, h, bOcclusion ? " with occlusion" : "");
+        }
+    }
+
+    printf("normal_test: passed\n");
+    return 0;
+}
@@ -0,0 +1,451 @@
+// LodePNG timings, each faster path against the plain one
+
+#include <string>
+#include <thread>
+#include "test.h"
+
+// The PNGs in the repo, bit by bit inflate against the table driven one
+static void benchFastInflate()
+{
+    double totals[2] = {0, 0};
+    for (int i = 0; i < repoPNGCount; ++i)
+    {
+        std::vector<unsigned char> file;
+        lodepng::load_file(file, szRepoPNGs[i]);
+        double ms[2];
+        for (int fast = 0; fast < 2; ++fast)
+        {
+            std::vector<unsigned char> image;
+            unsigned int w, h;
+            lodepng::State pngState;
+            pngState.decoder.zlibsettings.fast_inflate = fast;
+            double start = getSeconds();
+            unsigned int error = lodepng::decode(image, w, h, pngState, file);
+            ms[fast] = (getSeconds() - start) * 1000.0;
+            assert(error == 0);
+            totals[fast] += ms[fast];
+        }
+        printf("%s: %.3f ms, fast %.3f ms\n", szRepoPNGs[i], ms[0], ms[1]);
+    }
+    printf("total: %.3f ms, fast %.3f ms\n", totals[0], totals[1]);
+}
+
+// 2048x2048 RGB and RGBA images stored with one filter type on every row,
+// plain C unfilter against SIMD. Filter 0 is the decoding time without any
+// unfiltering.
+static void benchSIMDUnfilter()
+{
+    sRandom random;
+    for (int channels = 3; channels <= 4; ++channels)
+    {
+        std::vector<unsigned char> image(2048 * 2048 * channels);
+        for (size_t i = 0; i < image.size(); ++i) image[i] = (unsigned char)(i / channels + random.next() % 16);
+        for (unsigned char filter = 0; filter <= 4; ++filter)
+        {
+            std::vector<unsigned char> filters(2048, filter);
+            std::vector<unsigned char> png;
+            lodepng::State pngState;
+            pngState.info_raw.colortype = (channels == 3) ? LCT_RGB : LCT_RGBA;
+            pngState.info_png.color.colortype = pngState.info_raw.colortype;
+            pngState.encoder.auto_convert = LAC_NO;
+            pngState.encoder.zlibsettings.btype = 0;
+            pngState.encoder.filter_strategy = LFS_PREDEFINED;
+            pngState.encoder.filter_palette_zero = 0;
+            pngState.encoder.predefined_filters = filters.data();
+            lodepng::encode(png, image, 2048, 2048, pngState);
+
+            double seconds[2];
+            for (int simd = 0; simd < 2; ++simd)
+            {
+                std::vector<unsigned char> decoded;
+                unsigned int w, h;
+                lodepng::State decodeState;
+                decodeState.decoder.color_convert = 0;
+                decodeState.decoder.ignore_crc = 1;
+                decodeState.decoder.zlibsettings.ignore_adler32 = 1;
+                decodeState.decoder.simd = simd;
+                double start = getSeconds();
+                unsigned int error = lodepng::decode(decoded, w, h, decodeState, png);
+                seconds[simd] = getSeconds() - start;
+                assert(error == 0 && decoded == image);
+            }
+            printf("%d bytes, filter %d: %.0f MB/s, SIMD %.0f MB/s\n", channels, filter,
+                   (double)image.size() / seconds[0] / 1e6, (double)image.size() / seconds[1] / 1e6);
+        }
+    }
+}
+
+// ogre_dif.png into a buffer of the caller, like the texture loader does:
+// decode then copy, against decoding straight into it
+static void benchStreamingDecode()
+{
+    std::vector<unsigned char> file;
+    lodepng::load_file(file, "ogre_dif.png");
+    unsigned int w, h;
+    lodepng::State inspectState;
+    lodepng_inspect(&w, &h, &inspectState, file.data(), file.size());
+    std::vector<unsigned char> buffers[2];
+    double best[2] = {1e9, 1e9};
+    for (int run = 0; run < 5; ++run)
+    {
+        for (int stream = 0; stream < 2; ++stream)
+        {
+            buffers[stream].resize((size_t)w * h * 4);
+            double start = getSeconds();
+            if (stream)
+            {
+                lodepng::State decodeState;
+                unsigned int error = lodepng_decode_into(buffers[stream].data(), w * 4, &decodeState, file.data(), file.size());
+                assert(error == 0);
+            }
+            else
+            {
+                unsigned char *pPixels = NULL;
+                unsigned int error = lodepng_decode32(&pPixels, &w, &h, file.data(), file.size());
+                assert(error == 0);
+                memcpy(buffers[stream].data(), pPixels, (size_t)w * h * 4);
+                free(pPixels);
+            }
+            double ms = (getSeconds() - start) * 1000.0;
+            if (ms < best[stream]) best[stream] = ms;
+        }
+    }
+    assert(buffers[0] == buffers[1]);
+    printf("ogre_dif.png, best of 5: decode + copy %.2f ms, decode into %.2f ms\n", best[0], best[1]);
+}
+
+// All the repo PNGs with decode_batch, on 1 thread to one per hardware
+// thread
+static void benchBatchDecode()
+{
+    unsigned int maxThreads = std::thread::hardware_concurrency();
+    if (maxThreads < 1) maxThreads = 1;
+    double oneThreadMs = 0.0;
+    for (unsigned int threads = 1; threads <= maxThreads; ++threads)
+    {
+        std::vector<lodepng::BatchImage> images(repoPNGCount);
+        for (int i = 0; i < repoPNGCount; ++i) images[i].filename = szRepoPNGs[i];
+        double start = getSeconds();
+        unsigned int error = lodepng::decode_batch(images, lodepng::State(), threads);
+        double ms = (getSeconds() - start) * 1000.0;
+        assert(error == 0);
+        if (threads == 1) oneThreadMs = ms;
+        printf("decode_batch, %u threads: %.1f ms, %.2fx\n", threads, ms, oneThreadMs / ms);
+    }
+}
+
+// A 1280x720 frame: ogre_dif.png over a stone.png background
+static std::vector<unsigned char> makeFrame()
+{
+    unsigned int ogreW, ogreH, stoneW, stoneH;
+    std::vector<unsigned char> ogre = loadPNG("ogre_dif.png", &ogreW, &ogreH);
+    std::vector<unsigned char> stone = loadPNG("stone.png", &stoneW, &stoneH);
+    std::vector<unsigned char> frame(1280 * 720 * 4);
+    for (unsigned int y = 0; y < 720; ++y)
+    {
+        for (unsigned int x = 0; x < 1280; ++x)
+        {
+            unsigned char *pPixel = &frame[(y * 1280 + x) * 4];
+            const unsigned char *pSource = &stone[((y % stoneH) * stoneW + x % stoneW) * 4];
+            if (x >= 340 && x < 940 && y >= 60 && y < 660)
+            {
+                const unsigned char *pOgre = &ogre[((y - 60) * ogreH / 600 * ogreW + (x - 340) * ogreW / 600) * 4];
+                if (pOgre[3] > 128) pSource = pOgre;
+            }
+            pPixel[0] = pSource[0];
+            pPixel[1] = pSource[1];
+            pPixel[2] = pSource[2];
+            pPixel[3] = 255;
+        }
+    }
+    return frame;
+}
+
+// The frame at each compression level, on 1 deflate thread to one per
+// hardware thread
+static void benchThreadedDeflate()
+{
+    std::vector<unsigned char> frame = makeFrame();
+    unsigned int maxThreads = std::thread::hardware_concurrency();
+    if (maxThreads < 1) maxThreads = 1;
+    const char *szLevels[] = {"default", "fast", "best"};
+    for (int level = LCL_DEFAULT; level <= LCL_BEST; ++level)
+    {
+        for (unsigned int threads = 1; threads <= maxThreads; ++threads)
+        {
+            std::vector<unsigned char> png;
+            lodepng::State pngState;
+            pngState.encoder.zlibsettings.threads = threads;
+            pngState.encoder.zlibsettings.level = (LodePNGCompressLevel)level;
+            double start = getSeconds();
+            unsigned int error = lodepng::encode(png, frame, 1280, 720, pngState);
+            double ms = (getSeconds() - start) * 1000.0;
+            assert(error == 0);
+            printf("1280x720 frame, %s, %u threads: %.1f ms, %.1f fps, %u bytes\n", szLevels[level], threads, ms, 1000.0 / ms,
+                   (unsigned int)png.size());
+        }
+    }
+}
+
+// Re-encode some of the repo PNGs at each compression level, time against
+// size
+static void benchCompressionLevels()
+{
+    const char *szFilenames[] = {"stone.png", "ogre_dif.png", "ogre_normal.png", "d01.png", "n01.png", "alphatest.png"};
+    const char *szLevels[] = {"default", "fast", "best"};
+    for (int i = 0; i < 6; ++i)
+    {
+        unsigned int w, h;
+        std::vector<unsigned char> image = loadPNG(szFilenames[i], &w, &h);
+        for (int level = LCL_DEFAULT; level <= LCL_BEST; ++level)
+        {
+            std::vector<unsigned char> png;
+            lodepng::State pngState;
+            pngState.encoder.zlibsettings.level = (LodePNGCompressLevel)level;
+            double start = getSeconds();
+            unsigned int error = lodepng::encode(png, image, w, h, pngState);
+            double ms = (getSeconds() - start) * 1000.0;
+            assert(error == 0);
+            printf("%s %s: %.1f ms, %u bytes (%.1f%% of raw)\n", szFilenames[i], szLevels[level], ms,
+                   (unsigned int)png.size(), 100.0 * (double)png.size() / (double)image.size());
+        }
+    }
+}
+
+// CRC32 and Adler-32 on 64 MB. Adler-32 is timed as the difference of
+// inflating stored blocks with and without the check.
+static void benchChecksums()
+{
+    sRandom random;
+    std::vector<unsigned char> data(64 << 20);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = (unsigned char)random.next();
+
+    double start = getSeconds();
+    unsigned int crc = lodepng_crc32(data.data(), data.size());
+    double crcSeconds = getSeconds() - start;
+
+    std::vector<unsigned char> zlib;
+    LodePNGCompressSettings compressSettings;
+    lodepng_compress_settings_init(&compressSettings);
+    compressSettings.btype = 0;
+    lodepng::compress(zlib, data, compressSettings);
+    double inflateSeconds[2];
+    for (int ignore = 0; ignore < 2; ++ignore)
+    {
+        std::vector<unsigned char> inflated;
+        inflated.reserve(data.size());
+        LodePNGDecompressSettings decompressSettings;
+        lodepng_decompress_settings_init(&decompressSettings);
+        decompressSettings.ignore_adler32 = ignore;
+        start = getSeconds();
+        lodepng::decompress(inflated, zlib, decompressSettings);
+        inflateSeconds[ignore] = getSeconds() - start;
+    }
+    printf("CRC32: %.2f GB/s (%08x), Adler-32: %.2f GB/s\n", (double)data.size() / crcSeconds / 1e9, crc,
+           (double)data.size() / (inflateSeconds[0] - inflateSeconds[1]) / 1e9);
+}
+
+// Decode and encode some of the repo PNGs 3 times with one state, with
+// and without the arena for the temporary buffers
+static void benchArena()
+{
+    const char *szFilenames[] = {"stone.png", "ogre_dif.png", "ogre_normal.png", "ogre_spec.png", "d01.png", "n01.png", "m01.png", "alphatest.png"};
+    const int fileCount = sizeof(szFilenames) / sizeof(szFilenames[0]);
+    std::vector<unsigned char> pngs[fileCount];
+    for (int i = 0; i < fileCount; ++i) lodepng::load_file(pngs[i], szFilenames[i]);
+
+    for (int useArena = 0; useArena < 2; ++useArena)
+    {
+        lodepng::State pngState;
+        pngState.use_arena = useArena;
+        double decodeSeconds = 0.0, encodeSeconds = 0.0;
+        for (int round = 0; round < 3; ++round)
+        {
+            for (int i = 0; i < fileCount; ++i)
+            {
+                std::vector<unsigned char> image, png;
+                unsigned int w, h;
+                double start = getSeconds();
+                unsigned int error = lodepng::decode(image, w, h, pngState, pngs[i]);
+                decodeSeconds += getSeconds() - start;
+                assert(error == 0);
+
+                start = getSeconds();
+                error = lodepng::encode(png, image, w, h, pngState);
+                encodeSeconds += getSeconds() - start;
+                assert(error == 0);
+            }
+        }
+        printf("arena %d: decode %.1f ms, encode %.1f ms, %u arena allocations, %u from the heap, %u KB arena\n",
+               useArena, decodeSeconds * 1000.0, encodeSeconds * 1000.0, (unsigned int)pngState.arena.allocations,
+               (unsigned int)pngState.arena.fallbacks, (unsigned int)(pngState.arena.allocsize / 1024));
+    }
+}
+
+// lodepng_convert of 4 megapixels to RGBA8, for each input mode
+static void benchConvert()
+{
+    static const struct { LodePNGColorType colortype; unsigned int bitdepth; unsigned int key; const char *szName; } modes[] = {
+        {LCT_PALETTE, 8, 0, "palette 8"}, {LCT_PALETTE, 4, 0, "palette 4"}, {LCT_GREY, 8, 0, "grey 8"},
+        {LCT_GREY, 8, 1, "grey 8 key"}, {LCT_GREY, 2, 0, "grey 2"}, {LCT_GREY_ALPHA, 8, 0, "grey alpha 8"},
+        {LCT_RGB, 8, 0, "RGB 8"}, {LCT_RGB, 8, 1, "RGB 8 key"}, {LCT_GREY, 16, 0, "grey 16"},
+        {LCT_GREY_ALPHA, 16, 0, "grey alpha 16"}, {LCT_RGB, 16, 0, "RGB 16"}, {LCT_RGBA, 16, 0, "RGBA 16"}};
+    const unsigned int w = 2048, h = 2048;
+    sRandom random;
+    std::vector<unsigned char> rgba8(w * h * 4);
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); ++m)
+    {
+        LodePNGColorMode in, out;
+        lodepng_color_mode_init(&in);
+        lodepng_color_mode_init(&out);
+        in.colortype = modes[m].colortype;
+        in.bitdepth = modes[m].bitdepth;
+        in.key_defined = modes[m].key;
+        in.key_r = in.key_g = in.key_b = 3;
+        if (in.colortype == LCT_PALETTE)
+        {
+            for (unsigned int i = 0; i < (1u << in.bitdepth); ++i)
+            {
+                lodepng_palette_add(&in, (unsigned char)random.next(), (unsigned char)random.next(),
+                                    (unsigned char)random.next(), (unsigned char)random.next());
+            }
+        }
+        std::vector<unsigned char> image(lodepng_get_raw_size(w, h, &in));
+        for (size_t i = 0; i < image.size(); ++i) image[i] = (unsigned char)(random.next() % 8);
+
+        double start = getSeconds();
+        unsigned int error = lodepng_convert(rgba8.data(), image.data(), &out, &in, w, h, 0);
+        double seconds = getSeconds() - start;
+        assert(error == 0);
+        printf("%s to RGBA8: %.0f Mpixels/s\n", modes[m].szName, (double)w * h / seconds / 1e6);
+        lodepng_color_mode_cleanup(&in);
+    }
+}
+
+// Decode, convert and encode the PNGs in the repo and generated images of
+// every color type, plain and interlaced. Speeds are in MB of RGBA8 pixels
+// per second, and the allocations are the temporary buffers of one decode
+// and one encode, counted by the arena.
+static void benchOverall()
+{
+    static const struct { LodePNGColorType colortype; unsigned int bitdepth; const char *szName; } modes[] = {
+        {LCT_GREY, 1, "grey 1"}, {LCT_GREY, 8, "grey 8"}, {LCT_GREY_ALPHA, 8, "grey alpha 8"},
+        {LCT_PALETTE, 8, "palette 8"}, {LCT_RGB, 8, "RGB 8"}, {LCT_RGBA, 8, "RGBA 8"},
+        {LCT_RGB, 16, "RGB 16"}, {LCT_RGBA, 16, "RGBA 16"}};
+    static const unsigned int sizes[] = {64, 512, 2048};
+    sRandom random;
+    char text[256];
+
+    std::vector<std::string> names;
+    std::vector<std::vector<unsigned char> > pngs;
+    for (int i = 0; i < repoPNGCount; ++i)
+    {
+        names.push_back(szRepoPNGs[i]);
+        pngs.push_back(std::vector<unsigned char>());
+        lodepng::load_file(pngs.back(), szRepoPNGs[i]);
+        assert(!pngs.back().empty());
+    }
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+    {
+        for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); ++m)
+        {
+            for (int interlace = 0; interlace < 2; ++interlace)
+            {
+                // Gradients with some noise, so that the filters and the LZ77
+                // matches have something to do
+                lodepng::State pngState;
+                pngState.info_raw.colortype = pngState.info_png.color.colortype = modes[m].colortype;
+                pngState.info_raw.bitdepth = pngState.info_png.color.bitdepth = modes[m].bitdepth;
+                pngState.info_png.interlace_method = interlace;
+                pngState.encoder.auto_convert = LAC_NO;
+                if (modes[m].colortype == LCT_PALETTE)
+                {
+                    for (unsigned int i = 0; i < 256; ++i)
+                    {
+                        lodepng_palette_add(&pngState.info_raw, i, 255 - i, i / 2, 255);
+                        lodepng_palette_add(&pngState.info_png.color, i, 255 - i, i / 2, 255);
+                    }
+                }
+                unsigned int w = sizes[s], h = sizes[s];
+                std::vector<unsigned char> image(lodepng_get_raw_size(w, h, &pngState.info_raw));
+                for (size_t i = 0; i < image.size(); ++i) image[i] = (unsigned char)((i % (w * 2)) / 16 + i / (w * 64) + random.next() % 4);
+                std::vector<unsigned char> png;
+                unsigned int error = lodepng::encode(png, image, w, h, pngState);
+                assert(error == 0);
+                snprintf(text, sizeof(text), "%ux%u %s%s", w, h, modes[m].szName, interlace ? " interlaced" : "");
+                names.push_back(text);
+                pngs.push_back(png);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < pngs.size(); ++i)
+    {
+        lodepng::State pngState;
+        pngState.use_arena = 1;
+        std::vector<unsigned char> image, raw, png;
+        unsigned int w, h;
+        double ms[3];
+        size_t allocations[2];
+
+        size_t allocated = pngState.arena.allocations + pngState.arena.fallbacks;
+        double start = getSeconds();
+        unsigned int error = lodepng::decode(image, w, h, pngState, pngs[i]);
+        ms[0] = (getSeconds() - start) * 1000.0;
+        assert(error == 0);
+        allocations[0] = pngState.arena.allocations + pngState.arena.fallbacks - allocated;
+
+        // Convert from the color type of the file, like the decode does
+        lodepng::State rawState;
+        rawState.decoder.color_convert = 0;
+        error = lodepng::decode(raw, w, h, rawState, pngs[i]);
+        assert(error == 0);
+        start = getSeconds();
+        error = lodepng_convert(image.data(), raw.data(), &pngState.info_raw, &rawState.info_png.color, w, h, 0);
+        ms[1] = (getSeconds() - start) * 1000.0;
+        assert(error == 0);
+
+        allocated = pngState.arena.allocations + pngState.arena.fallbacks;
+        start = getSeconds();
+        error = lodepng::encode(png, image, w, h, pngState);
+        ms[2] = (getSeconds() - start) * 1000.0;
+        assert(error == 0);
+        allocations[1] = pngState.arena.allocations + pngState.arena.fallbacks - allocated;
+
+        double mb = (double)w * h * 4 / 1e6;
+        printf("%s: decode %.0f MB/s (%u allocations), convert %.0f MB/s, encode %.0f MB/s (%u allocations)\n",
+               names[i].c_str(), mb * 1000.0 / ms[0], (unsigned int)allocations[0], mb * 1000.0 / ms[1],
+               mb * 1000.0 / ms[2], (unsigned int)allocations[1]);
+    }
+}
+
+static const struct { const char *szName; void (*pBench)(); } benches[] = {
+    {"inflate", benchFastInflate}, {"unfilter", benchSIMDUnfilter}, {"streaming", benchStreamingDecode},
+    {"batch", benchBatchDecode}, {"deflate", benchThreadedDeflate}, {"checksums", benchChecksums},
+    {"levels", benchCompressionLevels}, {"arena", benchArena}, {"convert", benchConvert},
+    {"overall", benchOverall}};
+
+// png_bench [name...] runs only the named benchmarks, all of them by default
+int main(int argc, char **argv)
+{
+    const int benchCount = sizeof(benches) / sizeof(benches[0]);
+    for (int i = 1; i < argc; ++i)
+    {
+        int b = 0;
+        while (b < benchCount && strcmp(argv[i], benches[b].szName) != 0) ++b;
+        if (b == benchCount)
+        {
+            printf("png_bench: unknown benchmark %s\n", argv[i]);
+            return 1;
+        }
+    }
+    for (int b = 0; b < benchCount; ++b)
+    {
+        bool bSelected = argc == 1;
+        for (int i = 1; i < argc; ++i) bSelected |= strcmp(argv[i], benches[b].szName) == 0;
+        if (!bSelected) continue;
+        printf("-- %s\n", benches[b].szName);
+        benches[b].pBench();
+    }
+    return 0;
+}
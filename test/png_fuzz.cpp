@@ -0,0 +1,152 @@
+// libFuzzer target for the LodePNG decoder. Every input is decoded with the
+// SIMD unfilter, the table driven inflate and the arena, and again with all
+// of them off. Both must give the same error, or the same pixels. CRCs and
+// Adler-32 are ignored, so that mutations get to the zlib data and the
+// filters. When both decode, lodepng_decode_into must give the same pixels
+// too, or error 91 where lodepng_decode fills missing rows with zeros.
+//
+// With Clang:  make -C test fuzz CXX=clang++
+// The test build defines PNG_FUZZ_MAIN and gets a standalone main instead,
+// see the end of this file.
+
+#include <stdint.h>
+#include "test.h"
+
+static unsigned int decodePNG(const uint8_t *pData, size_t size, int bOptimized, unsigned char **ppImage, unsigned int *pWidth, unsigned int *pHeight)
+{
+    LodePNGState pngState;
+    lodepng_state_init(&pngState);
+    pngState.decoder.ignore_crc = 1;
+    pngState.decoder.zlibsettings.ignore_adler32 = 1;
+    pngState.decoder.zlibsettings.fast_inflate = bOptimized;
+    pngState.decoder.simd = bOptimized;
+    pngState.use_arena = bOptimized;
+    unsigned int error = lodepng_decode(ppImage, pWidth, pHeight, &pngState, pData, size);
+    lodepng_state_cleanup(&pngState);
+    return error;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *pData, size_t size)
+{
+    // Don't let a mutated header allocate gigabytes
+    unsigned int w, h;
+    LodePNGState inspectState;
+    lodepng_state_init(&inspectState);
+    inspectState.decoder.ignore_crc = 1;
+    unsigned int error = lodepng_inspect(&w, &h, &inspectState, pData, size);
+    lodepng_state_cleanup(&inspectState);
+    if (!error && (size_t)w * h > (1 << 20)) return 0;
+
+    unsigned char *pImages[2] = {NULL, NULL};
+    unsigned int errors[2], widths[2] = {0, 0}, heights[2] = {0, 0};
+    for (int bOptimized = 0; bOptimized < 2; ++bOptimized)
+    {
+        errors[bOptimized] = decodePNG(pData, size, bOptimized, &pImages[bOptimized], &widths[bOptimized], &heights[bOptimized]);
+    }
+    assert(errors[0] == errors[1]);
+    if (!errors[0])
+    {
+        size_t imageSize = (size_t)widths[0] * heights[0] * 4;
+        assert(widths[0] == widths[1] && heights[0] == heights[1]);
+        assert(memcmp(pImages[0], pImages[1], imageSize) == 0);
+
+        std::vector<unsigned char> rows(imageSize ? imageSize : 1);
+        LodePNGState intoState;
+        lodepng_state_init(&intoState);
+        intoState.decoder.ignore_crc = 1;
+        intoState.decoder.zlibsettings.ignore_adler32 = 1;
+        unsigned int intoError = lodepng_decode_into(rows.data(), (size_t)widths[0] * 4, &intoState, pData, size);
+        lodepng_state_cleanup(&intoState);
+        assert(intoError == 0 || intoError == 91);
+        if (!intoError) assert(memcmp(rows.data(), pImages[0], imageSize) == 0);
+    }
+    free(pImages[0]);
+    free(pImages[1]);
+    return 0;
+}
+
+#ifdef PNG_FUZZ_MAIN
+// Standalone driver for compilers without libFuzzer. It decodes the files
+// given on the command line, or else runs random mutations of small PNGs
+// of every color type, plain and interlaced:
+//   png_fuzz [-runs=N] [-seed=N] [files...]
+
+static std::vector<std::vector<unsigned char> > makeSeeds(sRandom &random)
+{
+    static const struct { LodePNGColorType colortype; unsigned int bitdepth; } modes[] = {
+        {LCT_GREY, 1}, {LCT_GREY, 4}, {LCT_GREY, 8}, {LCT_GREY, 16}, {LCT_GREY_ALPHA, 8},
+        {LCT_GREY_ALPHA, 16}, {LCT_PALETTE, 2}, {LCT_PALETTE, 8}, {LCT_RGB, 8}, {LCT_RGB, 16},
+        {LCT_RGBA, 8}, {LCT_RGBA, 16}};
+    std::vector<std::vector<unsigned char> > seeds;
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); ++m)
+    {
+        for (int interlace = 0; interlace < 2; ++interlace)
+        {
+            lodepng::State pngState;
+            pngState.info_raw.colortype = pngState.info_png.color.colortype = modes[m].colortype;
+            pngState.info_raw.bitdepth = pngState.info_png.color.bitdepth = modes[m].bitdepth;
+            pngState.info_png.interlace_method = interlace;
+            pngState.encoder.auto_convert = LAC_NO;
+            if (modes[m].colortype == LCT_PALETTE)
+            {
+                for (unsigned int i = 0; i < (1u << modes[m].bitdepth); ++i)
+                {
+                    lodepng_palette_add(&pngState.info_raw, i * 40, i * 20, i, 255 - i);
+                    lodepng_palette_add(&pngState.info_png.color, i * 40, i * 20, i, 255 - i);
+                }
+            }
+            std::vector<unsigned char> image(lodepng_get_raw_size(37, 23, &pngState.info_raw));
+            for (size_t i = 0; i < image.size(); ++i) image[i] = (unsigned char)(i % 29 + random.next() % 3);
+            seeds.push_back(std::vector<unsigned char>());
+            unsigned int error = lodepng::encode(seeds.back(), image, 37, 23, pngState);
+            assert(error == 0);
+        }
+    }
+    return seeds;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long runCount = 20000;
+    unsigned long long seed = 1;
+    int fileCount = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strncmp(argv[i], "-runs=", 6) == 0) runCount = strtoul(argv[i] + 6, NULL, 10);
+        else if (strncmp(argv[i], "-seed=", 6) == 0) seed = strtoull(argv[i] + 6, NULL, 10);
+        else
+        {
+            std::vector<unsigned char> file;
+            lodepng::load_file(file, argv[i]);
+            LLVMFuzzerTestOneInput(file.data(), file.size());
+            ++fileCount;
+        }
+    }
+    if (fileCount)
+    {
+        printf("png_fuzz: %d files passed\n", fileCount);
+        return 0;
+    }
+
+    sRandom random(seed);
+    std::vector<std::vector<unsigned char> > seeds = makeSeeds(random);
+    for (unsigned long run = 0; run < runCount; ++run)
+    {
+        std::vector<unsigned char> png = seeds[random.next() % seeds.size()];
+        for (unsigned int mutations = 1 + random.next() % 4; mutations > 0; --mutations)
+        {
+            size_t pos = 8 + random.next() % (png.size() - 8); // Keep the signature
+            switch (random.next() % 4)
+            {
+            case 0: png[pos] ^= (unsigned char)(1 << (random.next() % 8)); break;
+            case 1: png[pos] = (unsigned char)random.next(); break;
+            case 2: png.insert(png.begin() + pos, (unsigned char)random.next()); break;
+            case 3: png.resize(pos + (png.size() - pos) / 2); break;
+            }
+        }
+        LLVMFuzzerTestOneInput(png.data(), png.size());
+    }
+    printf("png_fuzz: %lu runs, seed %llu, passed\n", runCount, seed);
+    return 0;
+}
+#endif
@@ -0,0 +1,514 @@
+// LodePNG against itself: every faster path must give the bytes of the plain
+// one it replaced.
+
+#include "test.h"
+
+// The table driven inflate against the bit by bit one
+static void checkFastInflate()
+{
+    for (int i = 0; i < repoPNGCount; ++i)
+    {
+        std::vector<unsigned char> file;
+        std::vector<unsigned char> images[2];
+        unsigned int w, h;
+        lodepng::load_file(file, szRepoPNGs[i]);
+        assert(!file.empty());
+        for (int fast = 0; fast < 2; ++fast)
+        {
+            lodepng::State pngState;
+            pngState.decoder.zlibsettings.fast_inflate = fast;
+            assert(lodepng::decode(images[fast], w, h, pngState, file) == 0);
+        }
+        assert(images[0] == images[1]);
+    }
+    printf("fast inflate, %d repo PNGs: passed\n", repoPNGCount);
+
+    // Stored, fixed and dynamic blocks of data with short and long matches
+    sRandom random;
+    std::vector<unsigned char> data(300000);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = (unsigned char)((i % 1000 < 500) ? random.next() % 7 : i / 3);
+    for (unsigned int btype = 0; btype < 3; ++btype)
+    {
+        std::vector<unsigned char> zlib;
+        std::vector<unsigned char> inflated[2];
+        LodePNGCompressSettings compressSettings;
+        lodepng_compress_settings_init(&compressSettings);
+        compressSettings.btype = btype;
+        assert(lodepng::compress(zlib, data, compressSettings) == 0);
+        for (int fast = 0; fast < 2; ++fast)
+        {
+            LodePNGDecompressSettings decompressSettings;
+            lodepng_decompress_settings_init(&decompressSettings);
+            decompressSettings.fast_inflate = fast;
+            assert(lodepng::decompress(inflated[fast], zlib, decompressSettings) == 0);
+            assert(inflated[fast] == data);
+        }
+    }
+    printf("fast inflate, btype 0 to 2: passed\n");
+}
+
+// Stored PNG with the given filter type on every row, 255 for a random one
+static std::vector<unsigned char> encodeFiltered(const std::vector<unsigned char> &image, unsigned int w, unsigned int h,
+                                                 LodePNGColorType colortype, unsigned int bitdepth, unsigned char filter, sRandom &random)
+{
+    std::vector<unsigned char> filters(h, filter);
+    if (filter == 255)
+    {
+        for (unsigned int y = 0; y < h; ++y) filters[y] = (unsigned char)(random.next() % 5);
+    }
+    std::vector<unsigned char> png;
+    lodepng::State pngState;
+    pngState.info_raw.colortype = pngState.info_png.color.colortype = colortype;
+    pngState.info_raw.bitdepth = pngState.info_png.color.bitdepth = bitdepth;
+    pngState.encoder.auto_convert = LAC_NO;
+    pngState.encoder.zlibsettings.btype = 0;
+    pngState.encoder.filter_strategy = LFS_PREDEFINED;
+    pngState.encoder.filter_palette_zero = 0;
+    pngState.encoder.predefined_filters = filters.data();
+    assert(lodepng::encode(png, image, w, h, pngState) == 0);
+    return png;
+}
+
+// The SIMD unfilter against the plain C one, for every filter type. Sub,
+// Average and Paeth have SIMD code for 3 and 4 byte pixels, Up for any size.
+// Odd widths go through the tails.
+static void checkSIMDUnfilter()
+{
+    static const struct { LodePNGColorType colortype; unsigned int bitdepth; } modes[] = {
+        {LCT_RGB, 8}, {LCT_RGBA, 8}, {LCT_GREY_ALPHA, 8}, {LCT_RGBA, 16}};
+    static const unsigned int widths[] = {1, 2, 5, 16, 17, 33, 257};
+    sRandom random;
+    int imageCount = 0;
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); ++m)
+    {
+        for (size_t i = 0; i < sizeof(widths) / sizeof(widths[0]); ++i)
+        {
+            unsigned int w = widths[i], h = 19;
+            LodePNGColorMode mode;
+            lodepng_color_mode_init(&mode);
+            mode.colortype = modes[m].colortype;
+            mode.bitdepth = modes[m].bitdepth;
+            std::vector<unsigned char> image(lodepng_get_raw_size(w, h, &mode));
+            for (size_t j = 0; j < image.size(); ++j) image[j] = (unsigned char)random.next();
+
+            for (int filter = 0; filter <= 5; ++filter)
+            {
+                std::vector<unsigned char> png = encodeFiltered(image, w, h, modes[m].colortype, modes[m].bitdepth,
+                                                                (unsigned char)((filter == 5) ? 255 : filter), random);
+                for (int simd = 0; simd < 2; ++simd)
+                {
+                    std::vector<unsigned char> decoded;
+                    unsigned int decodedW, decodedH;
+                    lodepng::State decodeState;
+                    decodeState.decoder.color_convert = 0;
+                    decodeState.decoder.simd = simd;
+                    assert(lodepng::decode(decoded, decodedW, decodedH, decodeState, png) == 0);
+                    assert(decoded == image);
+                }
+                ++imageCount;
+            }
+        }
+    }
+    printf("SIMD unfilter, %d images: passed\n", imageCount);
+}
+
+// lodepng_decode_into against lodepng_decode, into rows with padding that
+// must be left untouched
+static void checkDecodeInto(const std::vector<unsigned char> &png, const LodePNGColorMode &raw)
+{
+    unsigned int w, h;
+    std::vector<unsigned char> image;
+    lodepng::State decodeState;
+    lodepng_color_mode_copy(&decodeState.info_raw, &raw);
+    assert(lodepng::decode(image, w, h, decodeState, png) == 0);
+
+    size_t rowSize = lodepng_get_raw_size(w, 1, &raw);
+    size_t stride = rowSize + 13;
+    std::vector<unsigned char> rows(stride * h, 0xcd);
+    lodepng::State intoState;
+    lodepng_color_mode_copy(&intoState.info_raw, &raw);
+    assert(lodepng_decode_into(rows.data(), stride, &intoState, png.data(), png.size()) == 0);
+    for (unsigned int y = 0; y < h; ++y)
+    {
+        assert(memcmp(&rows[y * stride], &image[y * rowSize], rowSize) == 0);
+        for (size_t x = rowSize; x < stride; ++x) assert(rows[y * stride + x] == 0xcd);
+    }
+}
+
+static void checkStreamingDecode()
+{
+    LodePNGColorMode rgba8;
+    lodepng_color_mode_init(&rgba8);
+    for (int i = 0; i < repoPNGCount; ++i)
+    {
+        std::vector<unsigned char> file;
+        lodepng::load_file(file, szRepoPNGs[i]);
+        checkDecodeInto(file, rgba8);
+    }
+
+    // Every color type, plain and interlaced, to RGBA8 and to its own type.
+    // 300x200 doesn't fit the 32 KB window, so the inflate flushes several
+    // times.
+    static const struct { LodePNGColorType colortype; unsigned int bitdepth; } modes[] = {
+        {LCT_GREY, 8}, {LCT_GREY, 16}, {LCT_GREY_ALPHA, 8}, {LCT_PALETTE, 8}, {LCT_RGB, 8},
+        {LCT_RGB, 16}, {LCT_RGBA, 8}, {LCT_RGBA, 16}};
+    sRandom random;
+    int imageCount = 0;
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); ++m)
+    {
+        for (int interlace = 0; interlace < 2; ++interlace)
+        {
+            lodepng::State pngState;
+            pngState.info_raw.colortype = pngState.info_png.color.colortype = modes[m].colortype;
+            pngState.info_raw.bitdepth = pngState.info_png.color.bitdepth = modes[m].bitdepth;
+            pngState.info_png.interlace_method = interlace;
+            pngState.encoder.auto_convert = LAC_NO;
+            if (modes[m].colortype == LCT_PALETTE)
+            {
+                for (unsigned int i = 0; i < 256; ++i)
+                {
+                    lodepng_palette_add(&pngState.info_raw, i, 255 - i, i / 2, 255 - i / 3);
+                    lodepng_palette_add(&pngState.info_png.color, i, 255 - i, i / 2, 255 - i / 3);
+                }
+            }
+            unsigned int w = 300, h = 200;
+            std::vector<unsigned char> image(lodepng_get_raw_size(w, h, &pngState.info_raw));
+            for (size_t i = 0; i < image.size(); ++i) image[i] = (unsigned char)(i % 251 + random.next() % 5);
+            std::vector<unsigned char> png;
+            assert(lodepng::encode(png, image, w, h, pngState) == 0);
+
+            checkDecodeInto(png, rgba8);
+            checkDecodeInto(png, pngState.info_png.color);
+            imageCount += 2;
+        }
+    }
+
+    // Missing rows are error 91, not undefined pixels
+    {
+        unsigned int w = 64, h = 64;
+        std::vector<unsigned char> image(w * h * 4, 200), png, zlib;
+        lodepng::State pngState;
+        pngState.encoder.auto_convert = LAC_NO;
+        assert(lodepng::encode(png, image, w, h, pngState) == 0);
+        std::vector<unsigned char> halfRows(h / 2 * (1 + w * 4), 0);
+        LodePNGCompressSettings compressSettings;
+        lodepng_compress_settings_init(&compressSettings);
+        assert(lodepng::compress(zlib, halfRows, compressSettings) == 0);
+
+        // Signature and IHDR, then an IDAT with half the rows, then IEND
+        size_t truncatedSize = 33;
+        unsigned char *pTruncated = (unsigned char *)malloc(truncatedSize);
+        memcpy(pTruncated, png.data(), truncatedSize);
+        assert(lodepng_chunk_create(&pTruncated, &truncatedSize, (unsigned int)zlib.size(), "IDAT", zlib.data()) == 0);
+        assert(lodepng_chunk_create(&pTruncated, &truncatedSize, 0, "IEND", NULL) == 0);
+        std::vector<unsigned char> rows(w * h * 4);
+        lodepng::State intoState;
+        assert(lodepng_decode_into(rows.data(), w * 4, &intoState, pTruncated, truncatedSize) == 91);
+        free(pTruncated);
+    }
+
+    printf("streaming decode, %d repo PNGs and %d generated: passed\n", repoPNGCount, imageCount);
+}
+
+// decode_batch against decoding one by one, from files and from memory, on
+// 1 to 4 threads and one per hardware thread. Results stay in the order of
+// the images, and the state's settings apply to all of them.
+static void checkBatchDecode()
+{
+    std::vector<std::vector<unsigned char> > files(repoPNGCount);
+    std::vector<std::vector<unsigned char> > expected(repoPNGCount);
+    for (int i = 0; i < repoPNGCount; ++i)
+    {
+        unsigned int w, h;
+        lodepng::load_file(files[i], szRepoPNGs[i]);
+        assert(lodepng::decode(expected[i], w, h, files[i], LCT_RGB) == 0);
+    }
+
+    lodepng::State rgbState;
+    rgbState.info_raw.colortype = LCT_RGB;
+    for (unsigned int threads = 0; threads <= 4; ++threads)
+    {
+        std::vector<lodepng::BatchImage> images(repoPNGCount * 2);
+        for (int i = 0; i < repoPNGCount; ++i)
+        {
+            images[i].filename = szRepoPNGs[i];
+            images[repoPNGCount + i].in = files[i].data();
+            images[repoPNGCount + i].insize = files[i].size();
+        }
+        assert(lodepng::decode_batch(images, rgbState, threads) == 0);
+        for (size_t i = 0; i < images.size(); ++i)
+        {
+            assert(images[i].error == 0);
+            assert(images[i].out == expected[i % repoPNGCount]);
+        }
+    }
+
+    // A bad image fails alone, and its error is returned
+    std::vector<lodepng::BatchImage> images(3);
+    images[0].filename = "stone.png";
+    images[1].filename = "missing.png";
+    images[2].filename = "m01.png";
+    assert(lodepng::decode_batch(images, lodepng::State(), 2) != 0);
+    assert(images[0].error == 0 && images[1].error != 0 && images[2].error == 0);
+    assert(!images[0].out.empty() && !images[2].out.empty());
+    printf("batch decode: passed\n");
+}
+
+// Deflate on 1 to 8 threads: every stream must inflate back to the data.
+// 512 KB gives every thread a block of at least the 64 KB minimum.
+static void checkThreadedDeflate()
+{
+    sRandom random;
+    std::vector<unsigned char> data(1 << 19);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = (unsigned char)((i % 3000 < 1000) ? random.next() % 11 : (i / 7) ^ (i >> 12));
+    int streamCount = 0;
+    for (unsigned int btype = 1; btype <= 2; ++btype)
+    {
+        for (unsigned int useLZ77 = 0; useLZ77 < 2; ++useLZ77)
+        {
+            for (unsigned int lazy = 0; lazy < 2; ++lazy)
+            {
+                for (unsigned int threads = 1; threads <= 8; ++threads)
+                {
+                    std::vector<unsigned char> zlib, inflated;
+                    LodePNGCompressSettings compressSettings;
+                    lodepng_compress_settings_init(&compressSettings);
+                    compressSettings.btype = btype;
+                    compressSettings.use_lz77 = useLZ77;
+                    compressSettings.lazymatching = lazy;
+                    compressSettings.threads = threads;
+                    assert(lodepng::compress(zlib, data, compressSettings) == 0);
+                    LodePNGDecompressSettings decompressSettings;
+                    lodepng_decompress_settings_init(&decompressSettings);
+                    assert(lodepng::decompress(inflated, zlib, decompressSettings) == 0);
+                    assert(inflated == data);
+                    ++streamCount;
+                }
+            }
+        }
+    }
+
+    // Whole PNGs
+    unsigned int w, h;
+    std::vector<unsigned char> image = loadPNG("ogre_dif.png", &w, &h);
+    for (unsigned int threads = 1; threads <= 4; ++threads)
+    {
+        std::vector<unsigned char> png, decoded;
+        lodepng::State pngState;
+        pngState.encoder.zlibsettings.threads = threads;
+        assert(lodepng::encode(png, image, w, h, pngState) == 0);
+        assert(lodepng::decode(decoded, w, h, png) == 0);
+        assert(decoded == image);
+    }
+    printf("threaded deflate, %d streams and ogre_dif.png: passed\n", streamCount);
+}
+
+// lodepng_crc32 and the zlib Adler-32 against bit by bit versions, on
+// lengths and alignments that go through every tail. Adler-32 isn't
+// public, it's read from the end of a stored zlib stream.
+static void checkChecksums()
+{
+    sRandom random;
+    std::vector<unsigned char> data(200000 + 64);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = (unsigned char)random.next();
+    for (int i = 0; i < 600; ++i)
+    {
+        size_t offset = random.next() % 64;
+        size_t size = (i < 300) ? (size_t)i : (size_t)(random.next() % 200000);
+        const unsigned char *pData = &data[offset];
+        unsigned int crc = 0xffffffff, s1 = 1, s2 = 0;
+        for (size_t j = 0; j < size; ++j)
+        {
+            crc ^= pData[j];
+            for (int k = 0; k < 8; ++k) crc = (crc & 1) ? 0xedb88320 ^ (crc >> 1) : crc >> 1;
+            s1 = (s1 + pData[j]) % 65521;
+            s2 = (s2 + s1) % 65521;
+        }
+        assert(lodepng_crc32(pData, size) == ~crc);
+
+        std::vector<unsigned char> zlib;
+        LodePNGCompressSettings compressSettings;
+        lodepng_compress_settings_init(&compressSettings);
+        compressSettings.btype = 0;
+        assert(lodepng::compress(zlib, pData, size, compressSettings) == 0);
+        const unsigned char *pAdler = &zlib[zlib.size() - 4];
+        assert((((unsigned int)pAdler[0] << 24) | (pAdler[1] << 16) | (pAdler[2] << 8) | pAdler[3]) == ((s2 << 16) | s1));
+    }
+
+    // All 0xff is the worst case for the deferred modulo of Adler-32
+    std::vector<unsigned char> ones(1 << 20, 0xff), zlib;
+    LodePNGCompressSettings compressSettings;
+    lodepng_compress_settings_init(&compressSettings);
+    compressSettings.btype = 0;
+    assert(lodepng::compress(zlib, ones, compressSettings) == 0);
+    unsigned int s1 = 1, s2 = 0;
+    for (size_t j = 0; j < ones.size(); ++j)
+    {
+        s1 = (s1 + 0xff) % 65521;
+        s2 = (s2 + s1) % 65521;
+    }
+    const unsigned char *pAdler = &zlib[zlib.size() - 4];
+    assert((((unsigned int)pAdler[0] << 24) | (pAdler[1] << 16) | (pAdler[2] << 8) | pAdler[3]) == ((s2 << 16) | s1));
+    printf("CRC32 and Adler-32: passed\n");
+}
+
+// Every LZ77 level must round trip, alone and with threaded deflate, which
+// primes the level's match finder with the window before each block
+static void checkCompressionLevels()
+{
+    sRandom random;
+    std::vector<unsigned char> data(300000);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = (unsigned char)((i % 5000 < 2500) ? random.next() % 5 : (i / 13) ^ (i >> 9));
+    const char *szFilenames[] = {"stone.png", "n01.png", "alphatest.png"};
+    for (int level = LCL_DEFAULT; level <= LCL_BEST; ++level)
+    {
+        for (unsigned int threads = 1; threads <= 3; threads += 2)
+        {
+            std::vector<unsigned char> zlib, inflated;
+            LodePNGCompressSettings compressSettings;
+            lodepng_compress_settings_init(&compressSettings);
+            compressSettings.level = (LodePNGCompressLevel)level;
+            compressSettings.threads = threads;
+            assert(lodepng::compress(zlib, data, compressSettings) == 0);
+            LodePNGDecompressSettings decompressSettings;
+            lodepng_decompress_settings_init(&decompressSettings);
+            assert(lodepng::decompress(inflated, zlib, decompressSettings) == 0);
+            assert(inflated == data);
+        }
+
+        for (int i = 0; i < 3; ++i)
+        {
+            unsigned int w, h;
+            std::vector<unsigned char> image = loadPNG(szFilenames[i], &w, &h);
+            std::vector<unsigned char> png, decoded;
+            lodepng::State pngState;
+            pngState.encoder.zlibsettings.level = (LodePNGCompressLevel)level;
+            assert(lodepng::encode(png, image, w, h, pngState) == 0);
+            assert(lodepng::decode(decoded, w, h, png) == 0);
+            assert(decoded == image);
+        }
+    }
+    printf("compression levels: passed\n");
+}
+
+// One state with the arena decodes and encodes the repo PNGs twice, smallest
+// and largest mixed, and must give the bytes of a state without it. After
+// the first round the arena is big enough, so nothing goes to the heap.
+// A copy of the state starts with an empty arena of its own.
+static void checkArena()
+{
+    lodepng::State plainState, arenaState;
+    arenaState.use_arena = 1;
+    for (int round = 0; round < 2; ++round)
+    {
+        size_t fallbacks = arenaState.arena.fallbacks;
+        for (int i = 0; i < repoPNGCount; ++i)
+        {
+            std::vector<unsigned char> file;
+            lodepng::load_file(file, szRepoPNGs[i]);
+            std::vector<unsigned char> images[2], pngs[2];
+            unsigned int w, h;
+            assert(lodepng::decode(images[0], w, h, plainState, file) == 0);
+            assert(lodepng::decode(images[1], w, h, arenaState, file) == 0);
+            assert(images[0] == images[1]);
+            assert(lodepng::encode(pngs[0], images[0], w, h, plainState) == 0);
+            assert(lodepng::encode(pngs[1], images[1], w, h, arenaState) == 0);
+            assert(pngs[0] == pngs[1]);
+        }
+        if (round == 1) assert(arenaState.arena.fallbacks == fallbacks);
+    }
+    assert(arenaState.arena.allocations > 0 && arenaState.arena.allocsize > 0);
+    assert(plainState.arena.allocations == 0 && plainState.arena.data == NULL);
+
+    lodepng::State copiedState(arenaState);
+    assert(copiedState.use_arena == 1 && copiedState.arena.data == NULL && copiedState.arena.allocsize == 0);
+    std::vector<unsigned char> file, images[2];
+    unsigned int w, h;
+    lodepng::load_file(file, "stone.png");
+    assert(lodepng::decode(images[0], w, h, copiedState, file) == 0);
+    assert(lodepng::decode(images[1], w, h, "stone.png") == 0);
+    assert(images[0] == images[1] && copiedState.arena.allocations > 0);
+    printf("arena: passed\n");
+}
+
+// lodepng_convert to RGBA8 against the per pixel conversion to RGBA16, whose
+// high bytes must be the same, for every input mode, key and palette size.
+// Widths of 1 to 99 go through the tails of the SSE2 kernels, 3 rows through
+// the rows of sub byte pixels.
+static void checkConvert()
+{
+    static const struct { LodePNGColorType colortype; unsigned int bitdepth; } modes[] = {
+        {LCT_GREY, 1}, {LCT_GREY, 2}, {LCT_GREY, 4}, {LCT_GREY, 8}, {LCT_GREY, 16},
+        {LCT_GREY_ALPHA, 8}, {LCT_GREY_ALPHA, 16}, {LCT_RGB, 8}, {LCT_RGB, 16}, {LCT_RGBA, 8}, {LCT_RGBA, 16},
+        {LCT_PALETTE, 1}, {LCT_PALETTE, 2}, {LCT_PALETTE, 4}, {LCT_PALETTE, 8}};
+    sRandom random;
+    int caseCount = 0;
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); ++m)
+    {
+        for (int variant = 0; variant < 2; ++variant)
+        {
+            // The second variant has a color key, or a palette of less than
+            // 2^bitdepth colors
+            LodePNGColorMode in, out8, out16;
+            lodepng_color_mode_init(&in);
+            lodepng_color_mode_init(&out8);
+            lodepng_color_mode_init(&out16);
+            in.colortype = modes[m].colortype;
+            in.bitdepth = modes[m].bitdepth;
+            out16.bitdepth = 16;
+            unsigned int maxValue = (1u << in.bitdepth) - 1;
+            if (in.colortype == LCT_PALETTE)
+            {
+                unsigned int colorCount = variant ? (maxValue + 1) / 2 + 1 : maxValue + 1;
+                for (unsigned int i = 0; i < colorCount; ++i)
+                {
+                    lodepng_palette_add(&in, (unsigned char)random.next(), (unsigned char)random.next(),
+                                        (unsigned char)random.next(), (unsigned char)random.next());
+                }
+            }
+            else if (variant)
+            {
+                if (in.colortype == LCT_GREY_ALPHA || in.colortype == LCT_RGBA) continue;
+                in.key_defined = 1;
+                in.key_r = in.key_g = in.key_b = (in.bitdepth == 16) ? 0x0303 : 3 & maxValue;
+            }
+
+            for (unsigned int w = 1; w < 100; ++w)
+            {
+                // Small values, so that the key and the palette bounds get hit
+                std::vector<unsigned char> image(lodepng_get_raw_size(w, 3, &in));
+                for (size_t i = 0; i < image.size(); ++i) image[i] = (unsigned char)((in.bitdepth == 16 && i % 2 == 0) ? 3 : random.next() % 8);
+                if (in.colortype == LCT_PALETTE && in.bitdepth < 8)
+                {
+                    for (size_t i = 0; i < image.size(); ++i) image[i] = (unsigned char)random.next();
+                }
+                std::vector<unsigned char> rgba8(w * 3 * 4), rgba16(w * 3 * 8);
+                unsigned int error8 = lodepng_convert(rgba8.data(), image.data(), &out8, &in, w, 3, 0);
+                unsigned int error16 = lodepng_convert(rgba16.data(), image.data(), &out16, &in, w, 3, 0);
+                assert(error8 == error16);
+                if (!error8)
+                {
+                    for (unsigned int i = 0; i < w * 3 * 4; ++i) assert(rgba8[i] == rgba16[i * 2]);
+                }
+                ++caseCount;
+            }
+            lodepng_color_mode_cleanup(&in);
+        }
+    }
+    printf("convert to RGBA8, %d cases: passed\n", caseCount);
+}
+
+int main()
+{
+    checkFastInflate();
+    checkSIMDUnfilter();
+    checkStreamingDecode();
+    checkBatchDecode();
+    checkThreadedDeflate();
+    checkChecksums();
+    checkCompressionLevels();
+    checkArena();
+    checkConvert();
+    printf("png_test: passed\n");
+    return 0;
+}
@@ -0,0 +1,47 @@
+// Slot pool timings: 100k items allocated then freed, and handle lookups
+
+#include "test.h"
+extern "C" {
+#include "eg_pool.h"
+}
+
+int main()
+{
+    const int itemCount = 100000, roundCount = 10;
+    SEGPool pool;
+    initPool(&pool, 64);
+    std::vector<uint32_t> handles(itemCount);
+    double allocSeconds = 0, freeSeconds = 0;
+    for (int round = 0; round < roundCount; ++round)
+    {
+        double start = getSeconds();
+        for (int i = 0; i < itemCount; ++i)
+        {
+            void *pItem;
+            handles[i] = poolAlloc(&pool, &pItem);
+        }
+        allocSeconds += getSeconds() - start;
+        start = getSeconds();
+        for (int i = 0; i < itemCount; ++i) poolFree(&pool, handles[i]);
+        freeSeconds += getSeconds() - start;
+    }
+    printf("100k alloc: %.3f ms, %.1f ns each\n", allocSeconds * 1000.0 / roundCount, allocSeconds * 1e9 / roundCount / itemCount);
+    printf("100k free: %.3f ms, %.1f ns each\n", freeSeconds * 1000.0 / roundCount, freeSeconds * 1e9 / roundCount / itemCount);
+
+    for (int i = 0; i < itemCount; ++i)
+    {
+        void *pItem;
+        handles[i] = poolAlloc(&pool, &pItem);
+    }
+    sRandom random;
+    std::vector<uint32_t> order(itemCount * 10);
+    for (size_t i = 0; i < order.size(); ++i) order[i] = handles[random.next() % itemCount];
+    size_t found = 0;
+    double start = getSeconds();
+    for (size_t i = 0; i < order.size(); ++i) found += poolGet(&pool, order[i]) != NULL;
+    double seconds = getSeconds() - start;
+    assert(found == order.size());
+    printf("poolGet, random order: %.1f ns\n", seconds * 1e9 / order.size());
+    destroyPool(&pool);
+    return 0;
+}
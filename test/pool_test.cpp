@@ -0,0 +1,159 @@
+// Slot pool handles: 0, out of range, double frees and stale handles of
+// reused slots are rejected, items never move while the pool grows, and how
+// long the generation takes to wrap.
+
+#include "test.h"
+extern "C" {
+#include "eg_pool.h"
+}
+
+struct sItem
+{
+    uint32_t id;
+    double payload[3];
+};
+
+static void checkInvalidHandles()
+{
+    SEGPool pool;
+    initPool(&pool, sizeof(sItem));
+    assert(!poolGet(&pool, 0) && !poolFree(&pool, 0));
+
+    sItem *pItem;
+    uint32_t handle = poolAlloc(&pool, (void **)&pItem);
+    assert(handle && poolGet(&pool, handle) == pItem);
+    assert(!poolGet(&pool, 0) && !poolFree(&pool, 0));
+
+    // Index past the slots used so far, with the generation of a live one
+    uint32_t outOfRange = (handle & ~(POOL_MAX_ITEMS - 1)) | 5000;
+    assert(!poolGet(&pool, outOfRange) && !poolFree(&pool, outOfRange));
+    uint32_t lastIndex = (handle & ~(POOL_MAX_ITEMS - 1)) | (POOL_MAX_ITEMS - 1);
+    assert(!poolGet(&pool, lastIndex) && !poolFree(&pool, lastIndex));
+
+    // Right index, wrong generation
+    uint32_t wrongGeneration = handle + (1 << POOL_INDEX_BITS);
+    assert(!poolGet(&pool, wrongGeneration) && !poolFree(&pool, wrongGeneration));
+
+    // Double free
+    assert(poolFree(&pool, handle));
+    assert(pool.itemCount == 0);
+    assert(!poolFree(&pool, handle) && !poolGet(&pool, handle));
+    assert(pool.itemCount == 0 && pool.freeCount == 1);
+    destroyPool(&pool);
+    printf("invalid handles: passed\n");
+}
+
+// Slots are reused oldest first once POOL_MIN_FREE_SLOTS are free, with a
+// new generation. The old handles don't get the new items.
+static void checkReuse()
+{
+    SEGPool pool;
+    initPool(&pool, sizeof(sItem));
+    std::vector<uint32_t> handles(POOL_MIN_FREE_SLOTS + 10);
+    for (size_t i = 0; i < handles.size(); ++i)
+    {
+        sItem *pItem;
+        handles[i] = poolAlloc(&pool, (void **)&pItem);
+        pItem->id = (uint32_t)i;
+    }
+    for (size_t i = 0; i < handles.size(); ++i) assert(poolFree(&pool, handles[i]));
+    assert(pool.itemCount == 0 && pool.freeCount == handles.size());
+
+    for (size_t i = 0; i <= 10; ++i)
+    {
+        sItem *pItem;
+        uint32_t handle = poolAlloc(&pool, (void **)&pItem);
+        assert((handle & (POOL_MAX_ITEMS - 1)) == (handles[i] & (POOL_MAX_ITEMS - 1)));
+        assert(handle != handles[i]);
+        assert(pItem->id == 0); // Cleared
+        assert(poolGet(&pool, handle) == pItem);
+        assert(!poolGet(&pool, handles[i]) && !poolFree(&pool, handles[i]));
+    }
+    assert(pool.slotCount == handles.size() && pool.itemCount == 11);
+    assert(pool.freeCount == POOL_MIN_FREE_SLOTS - 1);
+
+    // Below POOL_MIN_FREE_SLOTS free, new slots are used instead
+    sItem *pItem;
+    uint32_t handle = poolAlloc(&pool, (void **)&pItem);
+    assert((handle & (POOL_MAX_ITEMS - 1)) == handles.size());
+    destroyPool(&pool);
+    printf("reuse: passed\n");
+}
+
+static void checkGrowth()
+{
+    SEGPool pool;
+    initPool(&pool, sizeof(sItem));
+    std::vector<uint32_t> handles(POOL_CHUNK_SIZE * 5 + 1);
+    std::vector<sItem *> items(handles.size());
+    for (size_t i = 0; i < handles.size(); ++i)
+    {
+        handles[i] = poolAlloc(&pool, (void **)&items[i]);
+        items[i]->id = (uint32_t)i;
+        items[i]->payload[2] = (double)i * .5;
+        // Every item allocated so far is still where it was
+        if (i % POOL_CHUNK_SIZE == 0)
+        {
+            for (size_t j = 0; j <= i; ++j) assert(poolGet(&pool, handles[j]) == items[j] && items[j]->id == j);
+        }
+    }
+    assert(pool.chunkCount == 6 && pool.itemCount == handles.size());
+    for (size_t i = 0; i < handles.size(); ++i)
+    {
+        assert(poolGet(&pool, handles[i]) == items[i]);
+        assert(items[i]->id == i && items[i]->payload[2] == (double)i * .5);
+        assert(((uintptr_t)items[i] & 7) == 0);
+    }
+
+    // Walking the slots sees the live items only
+    for (size_t i = 0; i < handles.size(); i += 2) poolFree(&pool, handles[i]);
+    uint32_t liveCount = 0;
+    for (uint32_t i = 0; i < pool.slotCount; ++i)
+    {
+        sItem *pItem = (sItem *)poolGetAt(&pool, i);
+        if (!pItem) continue;
+        assert(pItem == items[i] && i % 2 == 1);
+        ++liveCount;
+    }
+    assert(liveCount == pool.itemCount && liveCount == handles.size() / 2);
+    destroyPool(&pool);
+    printf("growth: passed\n");
+}
+
+// The generation has 12 bits. One item created and destroyed in a loop goes
+// through POOL_MIN_FREE_SLOTS slots in turn, so its first handle only
+// matches again after 4095 trips around them. Until then it's rejected.
+static void checkGenerationWrap()
+{
+    const uint32_t generationCount = (1 << (32 - POOL_INDEX_BITS)) - 1;
+    SEGPool pool;
+    initPool(&pool, sizeof(sItem));
+    sItem *pItem;
+    uint32_t first = poolAlloc(&pool, (void **)&pItem);
+    poolFree(&pool, first);
+    uint32_t cycleCount = 0;
+    for (;;)
+    {
+        uint32_t handle = poolAlloc(&pool, (void **)&pItem);
+        ++cycleCount;
+        if (handle == first) break;
+        assert(!poolGet(&pool, first));
+        poolFree(&pool, handle);
+        assert(cycleCount < 4 * 1024 * 1024);
+    }
+    printf("generation wraps after %u creates and destroys\n", cycleCount);
+    assert(cycleCount == POOL_MIN_FREE_SLOTS * generationCount);
+    assert(pool.slotCount == POOL_MIN_FREE_SLOTS);
+    destroyPool(&pool);
+    printf("generation wrap: passed\n");
+}
+
+int main()
+{
+    checkInvalidHandles();
+    checkReuse();
+    checkGrowth();
+    checkGenerationWrap();
+    printf("pool_test: passed\n");
+    return 0;
+}
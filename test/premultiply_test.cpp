@@ -0,0 +1,77 @@
+// premultiplyAlpha against the exact rounding of c * a / 255 in linear space,
+// and in sRGB space through a double precision reference. The sRGB table is
+// built on first use, so the sRGB pass runs from several pool threads at once.
+
+#include <math.h>
+#include "test.h"
+extern "C" {
+#include "eg_format.h"
+#include "eg_thread.h"
+}
+
+struct sJob
+{
+    const std::vector<uint8_t> *pIn;
+    std::vector<uint8_t> out;
+};
+
+static void premultiplySRGBJob(void *pData)
+{
+    sJob *pJob = (sJob *)pData;
+    premultiplyAlpha(pJob->pIn->data(), pJob->out.data(), (uint32_t)(pJob->pIn->size() / 4), 1);
+}
+
+static uint8_t referenceSRGB(uint8_t c, uint8_t a)
+{
+    double encoded = (double)c / 255.0;
+    double linear = (encoded <= 0.04045) ? encoded / 12.92 : pow((encoded + 0.055) / 1.055, 2.4);
+    double premultiplied = linear * (double)a / 255.0;
+    premultiplied = (premultiplied <= 0.0031308) ? premultiplied * 12.92 : 1.055 * pow(premultiplied, 1.0 / 2.4) - 0.055;
+    return (uint8_t)(premultiplied * 255.0 + .5);
+}
+
+int main()
+{
+    // Every color and alpha pair, plus a tail that isn't a multiple of 4
+    const uint32_t pixelCount = 256 * 256 + 3;
+    std::vector<uint8_t> in(pixelCount * 4), out(pixelCount * 4);
+    for (uint32_t i = 0; i < pixelCount; ++i)
+    {
+        in[i * 4 + 0] = (uint8_t)i;
+        in[i * 4 + 1] = (uint8_t)(255 - i);
+        in[i * 4 + 2] = (uint8_t)(i * 7);
+        in[i * 4 + 3] = (uint8_t)(i >> 8);
+    }
+
+    premultiplyAlpha(in.data(), out.data(), pixelCount, 0);
+    for (uint32_t i = 0; i < pixelCount; ++i)
+    {
+        uint32_t a = in[i * 4 + 3];
+        for (int c = 0; c < 3; ++c) assert(out[i * 4 + c] == (in[i * 4 + c] * a + 127) / 255);
+        assert(out[i * 4 + 3] == a);
+    }
+    printf("linear: passed\n");
+
+    SEGWorkerPool *pPool = createWorkerPool(4);
+    sJob jobs[8];
+    for (int i = 0; i < 8; ++i)
+    {
+        jobs[i].pIn = &in;
+        jobs[i].out.resize(in.size());
+        pushJob(pPool, premultiplySRGBJob, jobs + i);
+    }
+    waitWorkerPool(pPool);
+    destroyWorkerPool(pPool);
+    for (int j = 0; j < 8; ++j)
+    {
+        for (uint32_t i = 0; i < pixelCount; ++i)
+        {
+            for (int c = 0; c < 3; ++c) assert(jobs[j].out[i * 4 + c] == referenceSRGB(in[i * 4 + c], in[i * 4 + 3]));
+            assert(jobs[j].out[i * 4 + 3] == in[i * 4 + 3]);
+        }
+    }
+    printf("sRGB from 8 jobs: passed\n");
+
+    printf("premultiply_test: passed\n");
+    return 0;
+}
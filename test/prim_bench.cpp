@@ -0,0 +1,41 @@
+// The scene of the LOD sample without a device: 440 spheres going into the
+// distance, with fixed 24x12 tessellation and with egSphereAuto. Measures the
+// CPU time to emit the vertices, and how many there are.
+
+#include "prim_recorder.h"
+
+static double drawScene(bool bAutoLod, size_t *pVertexCount)
+{
+    const int frameCount = 100;
+    double start = getSeconds();
+    for (int frame = 0; frame < frameCount; ++frame)
+    {
+        recorder.vertices.clear();
+        recorder.modes.clear();
+        for (int y = 0; y < 40; ++y)
+        {
+            for (int x = -5; x <= 5; ++x)
+            {
+                setTranslationMatrix(&recorder.model, (float)x * 3, (float)y * 6, 0);
+                if (bAutoLod) egSphereAuto(1, 12, 2);
+                else egSphere(1, 24, 12, 2);
+            }
+        }
+    }
+    *pVertexCount = recorder.vertices.size();
+    return (getSeconds() - start) * 1000.0 / frameCount;
+}
+
+int main()
+{
+    setRecorderCamera(0, -5, 3, 0, 10, 0, 70, 1280, 720);
+    recorder.vertices.reserve(1 << 20);
+    for (int bAutoLod = 0; bAutoLod < 2; ++bAutoLod)
+    {
+        size_t vertexCount;
+        drawScene(bAutoLod != 0, &vertexCount);
+        double ms = drawScene(bAutoLod != 0, &vertexCount);
+        printf("%s: %.3f ms per frame, %u vertices\n", bAutoLod ? "auto" : "fixed 24x12", ms, (unsigned int)vertexCount);
+    }
+    return 0;
+}
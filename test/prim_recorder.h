@@ -0,0 +1,67 @@
+#pragma once
+
+// Stand-ins for the batch functions of the device, so that eg_prim.c runs
+// without Direct3D. Vertices are recorded the way a batch stores them, and
+// the matrices and the viewport are the ones the test sets.
+
+#include "test.h"
+extern "C" {
+#include "eg.h"
+#include "eg_math.h"
+}
+
+struct sRecordedVertex
+{
+    float normal[3];
+    float tangent[3];
+    float binormal[3];
+    float texCoord[2];
+    float position[3];
+};
+
+struct sRecorder
+{
+    std::vector<sRecordedVertex> vertices;
+    std::vector<EG_MODE> modes;         // One per egBegin
+    sRecordedVertex current;
+    SEGMatrix model;
+    SEGMatrix viewProj;
+    uint32_t viewport[4];
+};
+
+static sRecorder recorder;
+
+// Like egSet3DViewProj and egViewPort
+inline void setRecorderCamera(float eyeX, float eyeY, float eyeZ, float centerX, float centerY, float centerZ,
+                              float fov, uint32_t width, uint32_t height)
+{
+    SEGMatrix view, projection;
+    setProjectionMatrix(&projection, fov, (float)width / (float)height, .1f, 10000.f);
+    setLookAtMatrix(&view, eyeX, eyeY, eyeZ, centerX, centerY, centerZ, 0, 0, 1);
+    multMatrix(&view, &projection, &recorder.viewProj);
+    recorder.viewport[0] = recorder.viewport[1] = 0;
+    recorder.viewport[2] = width;
+    recorder.viewport[3] = height;
+}
+
+extern "C" {
+
+void egBegin(EG_MODE mode) { recorder.modes.push_back(mode); }
+void egEnd() {}
+void egNormal(float x, float y, float z) { float v[3] = {x, y, z}; memcpy(recorder.current.normal, v, sizeof(v)); }
+void egTangent(float x, float y, float z) { float v[3] = {x, y, z}; memcpy(recorder.current.tangent, v, sizeof(v)); }
+void egBinormal(float x, float y, float z) { float v[3] = {x, y, z}; memcpy(recorder.current.binormal, v, sizeof(v)); }
+void egTexCoord(float s, float t) { recorder.current.texCoord[0] = s; recorder.current.texCoord[1] = t; }
+
+void egPosition3(float x, float y, float z)
+{
+    float v[3] = {x, y, z};
+    memcpy(recorder.current.position, v, sizeof(v));
+    recorder.vertices.push_back(recorder.current);
+}
+
+void egGetModel(float *pModel) { memcpy(pModel, recorder.model.m, sizeof(recorder.model.m)); }
+void egGetViewProj(float *pViewProj) { memcpy(pViewProj, recorder.viewProj.m, sizeof(recorder.viewProj.m)); }
+void egGetViewport(uint32_t *pViewport) { memcpy(pViewport, recorder.viewport, sizeof(recorder.viewport)); }
+
+}
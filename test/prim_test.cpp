@@ -0,0 +1,106 @@
+// Sphere and cylinder tessellation. The automatic versions must emit exactly
+// what the fixed ones do at the slice count they pick, and pick more slices
+// for bigger spheres on screen.
+
+#include "prim_recorder.h"
+
+static const uint32_t lodSlices[] = {6, 8, 12, 16, 24, 32, 48, 64, 96, 128};
+static const int lodLevelCount = sizeof(lodSlices) / sizeof(lodSlices[0]);
+
+static std::vector<sRecordedVertex> record(void (*pDraw)(float), float arg)
+{
+    recorder.vertices.clear();
+    recorder.modes.clear();
+    pDraw(arg);
+    return recorder.vertices;
+}
+
+static bool sameVertices(const std::vector<sRecordedVertex> &a, const std::vector<sRecordedVertex> &b)
+{
+    return a.size() == b.size() && !memcmp(a.data(), b.data(), a.size() * sizeof(sRecordedVertex));
+}
+
+static uint32_t fixedSlices;
+static void drawSphereAuto(float edgeLength) { egSphereAuto(2, edgeLength, 3); }
+static void drawSphere(float) { egSphere(2, fixedSlices, fixedSlices / 2, 3); }
+static void drawCylinderAuto(float edgeLength) { egCylinderAuto(2, 1, 4, edgeLength, 3); }
+static void drawCylinder(float) { egCylinder(2, 1, 4, fixedSlices, 3); }
+
+// Slice count that egSphereAuto picked, from the vertex count of its strip
+static uint32_t getAutoSlices(float edgeLength)
+{
+    size_t vertexCount = record(drawSphereAuto, edgeLength).size();
+    for (int level = 0; level < lodLevelCount; ++level)
+    {
+        if (vertexCount == (size_t)lodSlices[level] / 2 * (lodSlices[level] + 1) * 2) return lodSlices[level];
+    }
+    assert(!"unexpected vertex count");
+    return 0;
+}
+
+static void checkGeometry(uint32_t slices, uint32_t stacks)
+{
+    fixedSlices = slices;
+    recorder.vertices.clear();
+    egSphere(2, slices, stacks, 3);
+    assert(recorder.vertices.size() == (size_t)stacks * (slices + 1) * 2);
+    for (size_t i = 0; i < recorder.vertices.size(); ++i)
+    {
+        const sRecordedVertex &v = recorder.vertices[i];
+        float n = sqrtf(v.normal[0] * v.normal[0] + v.normal[1] * v.normal[1] + v.normal[2] * v.normal[2]);
+        assert(fabsf(n - 1) < 1e-5f);
+        for (int c = 0; c < 3; ++c) assert(fabsf(v.position[c] - v.normal[c] * 2) < 1e-5f);
+        float d = v.normal[0] * v.tangent[0] + v.normal[1] * v.tangent[1] + v.normal[2] * v.tangent[2];
+        assert(fabsf(d) < 1e-5f);
+    }
+}
+
+int main()
+{
+    // The center at 1 unit in front of the camera, so the projected radius is
+    // the radius times half the viewport
+    setIdentityMatrix(&recorder.model);
+    setIdentityMatrix(&recorder.viewProj);
+    recorder.viewProj.m[15] = 1;
+    recorder.viewport[0] = recorder.viewport[1] = 0;
+    recorder.viewport[2] = recorder.viewport[3] = 1000;
+    const float projectedRadius = 2 * 500.f;
+
+    for (int level = 0; level < lodLevelCount; ++level)
+    {
+        fixedSlices = lodSlices[level];
+        float edgeLength = 2 * EG_PI * projectedRadius / ((float)fixedSlices - .5f);
+        assert(getAutoSlices(edgeLength) == fixedSlices);
+        assert(sameVertices(record(drawSphereAuto, edgeLength), record(drawSphere, 0)));
+        assert(sameVertices(record(drawCylinderAuto, edgeLength), record(drawCylinder, 0)));
+        assert(recorder.modes.size() == 3 && recorder.modes[0] == EG_POLYGON && recorder.modes[2] == EG_TRIANGLE_STRIP);
+    }
+    printf("auto matches fixed at every level: passed\n");
+
+    // Huge on screen, no edge length, or behind the camera all use the most
+    assert(getAutoSlices(1e-3f) == 128);
+    assert(getAutoSlices(0) == 128);
+    recorder.viewProj.m[15] = -1;
+    assert(getAutoSlices(1e6f) == 128);
+    recorder.viewProj.m[15] = 1;
+
+    // Farther is never more slices
+    uint32_t lastSlices = 128;
+    for (float w = 1; w < 1e5f; w *= 1.5f)
+    {
+        recorder.viewProj.m[15] = w;
+        uint32_t slices = getAutoSlices(12);
+        assert(slices <= lastSlices);
+        lastSlices = slices;
+    }
+    assert(lastSlices == 6);
+    printf("lod selection: passed\n");
+
+    checkGeometry(24, 12);
+    checkGeometry(7, 3);
+    checkGeometry(128, 64);
+    printf("sphere geometry: passed\n");
+
+    printf("prim_test: passed\n");
+    return 0;
+}
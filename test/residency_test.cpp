@@ -0,0 +1,152 @@
+// Texture memory bookkeeping without a device: residents live in a slot pool
+// like the textures of a device, and eviction drops them the way the device
+// releases their GPU memory. Checks the LRU order, that eviction stops at the
+// budget and at residents used this frame, and the per category totals.
+
+#include <stddef.h>
+#include "test.h"
+extern "C" {
+#include "eg_pool.h"
+#include "eg_residency.h"
+}
+
+struct sTexture
+{
+    int bResident;
+    SEGResident resident;
+};
+
+static sTexture *getTexture(SEGResident *pResident)
+{
+    return (sTexture *)((char *)pResident - offsetof(sTexture, resident));
+}
+
+static uint32_t createTexture(SEGPool *pPool, SEGResidency *pResidency, uint64_t bytes)
+{
+    sTexture *pTexture;
+    uint32_t handle = poolAlloc(pPool, (void **)&pTexture);
+    assert(handle);
+    memset(pTexture, 0, sizeof(sTexture));
+    pTexture->bResident = 1;
+    pTexture->resident.bytes = bytes;
+    pTexture->resident.category = RESIDENCY_TEXTURES;
+    trackResident(pResidency, &pTexture->resident, 1);
+    return handle;
+}
+
+static sTexture *get(SEGPool *pPool, uint32_t handle)
+{
+    return (sTexture *)poolGet(pPool, handle);
+}
+
+// What the device does at the start of a frame
+static uint32_t enforceBudget(SEGResidency *pResidency)
+{
+    uint32_t evictedCount = 0;
+    SEGResident *pResident;
+    while ((pResident = getEvictionCandidate(pResidency)) != NULL)
+    {
+        untrackResident(pResidency, pResident);
+        getTexture(pResident)->bResident = 0;
+        ++pResidency->evictionCount;
+        ++evictedCount;
+    }
+    return evictedCount;
+}
+
+int main()
+{
+    SEGPool pool;
+    SEGResidency residency;
+    initPool(&pool, sizeof(sTexture));
+    initResidency(&residency);
+
+    // Render targets are accounted for, but never evicted
+    SEGResident gBuffer;
+    memset(&gBuffer, 0, sizeof(gBuffer));
+    gBuffer.bytes = 1000;
+    gBuffer.category = RESIDENCY_G_BUFFER;
+    trackResident(&residency, &gBuffer, 0);
+
+    uint32_t textures[8];
+    for (int i = 0; i < 8; ++i) textures[i] = createTexture(&pool, &residency, 100);
+    assert(residency.bytes[RESIDENCY_TEXTURES] == 800 && residency.counts[RESIDENCY_TEXTURES] == 8);
+    assert(residency.bytes[RESIDENCY_G_BUFFER] == 1000 && residency.counts[RESIDENCY_G_BUFFER] == 1);
+    assert(getResidentBytes(&residency) == 1800);
+
+    // LRU order is creation order, then touches move to the most recent end
+    assert(residency.pLeastRecent == &get(&pool, textures[0])->resident);
+    assert(residency.pMostRecent == &get(&pool, textures[7])->resident);
+
+    // Over budget, but everything was used this frame
+    residency.budget = 1500;
+    assert(enforceBudget(&residency) == 0);
+
+    nextResidencyFrame(&residency);
+    touchResident(&residency, &get(&pool, textures[0])->resident);
+    touchResident(&residency, &get(&pool, textures[1])->resident);
+    assert(residency.pMostRecent == &get(&pool, textures[1])->resident);
+    assert(residency.pLeastRecent == &get(&pool, textures[2])->resident);
+
+    // The 3 least recent go, down to the budget exactly
+    assert(enforceBudget(&residency) == 3);
+    for (int i = 0; i < 8; ++i) assert(get(&pool, textures[i])->bResident == (i < 2 || i > 4));
+    assert(getResidentBytes(&residency) == 1500);
+    assert(residency.bytes[RESIDENCY_TEXTURES] == 500 && residency.counts[RESIDENCY_TEXTURES] == 5);
+    assert(residency.evictionCount == 3);
+
+    // A budget below what this frame uses stops at the residents it used
+    nextResidencyFrame(&residency);
+    for (int i = 0; i < 8; ++i)
+    {
+        if (get(&pool, textures[i])->bResident) touchResident(&residency, &get(&pool, textures[i])->resident);
+    }
+    residency.budget = 1100;
+    assert(enforceBudget(&residency) == 0);
+    nextResidencyFrame(&residency);
+    assert(enforceBudget(&residency) == 4);
+    assert(getResidentBytes(&residency) == 1100 && get(&pool, textures[7])->bResident);
+
+    // Tracking again updates the size, untracking twice is a no-op
+    sTexture *pLast = get(&pool, textures[7]);
+    pLast->resident.bytes = 50;
+    trackResident(&residency, &pLast->resident, 1);
+    assert(residency.bytes[RESIDENCY_TEXTURES] == 50 && residency.counts[RESIDENCY_TEXTURES] == 1);
+    untrackResident(&residency, &pLast->resident);
+    untrackResident(&residency, &pLast->resident);
+    untrackResident(&residency, &gBuffer);
+    assert(getResidentBytes(&residency) == 0 && !residency.pLeastRecent && !residency.pMostRecent);
+    for (int i = 0; i < 8; ++i) assert(poolFree(&pool, textures[i]));
+    assert(!get(&pool, textures[0]));
+
+    // Residents stay linked while the pool grows past a chunk, since pool
+    // items never move
+    residency.budget = 0;
+    std::vector<uint32_t> many(POOL_CHUNK_SIZE * 3);
+    for (size_t i = 0; i < many.size(); ++i) many[i] = createTexture(&pool, &residency, 10);
+    assert(residency.counts[RESIDENCY_TEXTURES] == many.size());
+    uint32_t linkedCount = 0;
+    for (SEGResident *pResident = residency.pLeastRecent; pResident; pResident = pResident->pNext)
+    {
+        assert(pResident == &get(&pool, many[linkedCount])->resident);
+        ++linkedCount;
+    }
+    assert(linkedCount == many.size());
+
+    // Then a budget of half evicts the older half
+    nextResidencyFrame(&residency);
+    residency.budget = many.size() / 2 * 10;
+    assert(enforceBudget(&residency) == many.size() / 2);
+    for (size_t i = 0; i < many.size(); ++i) assert(get(&pool, many[i])->bResident == (i >= many.size() / 2));
+
+    for (size_t i = 0; i < many.size(); ++i)
+    {
+        untrackResident(&residency, &get(&pool, many[i])->resident);
+        poolFree(&pool, many[i]);
+    }
+    assert(getResidentBytes(&residency) == 0);
+    destroyPool(&pool);
+
+    printf("residency_test: passed\n");
+    return 0;
+}
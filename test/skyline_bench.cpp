@@ -0,0 +1,102 @@
+// Skyline packer speed and occupancy: 20k rectangles of 8 to 64 texels into
+// 1024x1024 pages, each going into the first page it fits in. In insertion
+// order and sorted tallest first like egAtlasDefragment, against a shelf
+// packer. Occupancy is the rectangle area over the pages used, and over the
+// pages that are full, all but the last.
+
+#include <algorithm>
+#include "test.h"
+extern "C" {
+#include "eg_skyline.h"
+}
+
+struct sRect
+{
+    uint32_t w, h;
+};
+
+static bool isTaller(const sRect &a, const sRect &b)
+{
+    return a.h > b.h;
+}
+
+static void printOccupancy(const char *szName, double seconds, size_t rectCount, const std::vector<uint64_t> &pageAreas)
+{
+    const double pageArea = 1024.0 * 1024.0;
+    uint64_t fullArea = 0;
+    for (size_t i = 0; i + 1 < pageAreas.size(); ++i) fullArea += pageAreas[i];
+    double area = (double)(fullArea + pageAreas.back());
+    printf("%s: %.3f us/insert, %u pages, %.1f%% occupancy, %.1f%% over the full pages\n", szName,
+           seconds * 1e6 / (double)rectCount, (unsigned int)pageAreas.size(), area * 100.0 / (pageArea * pageAreas.size()),
+           (double)fullArea * 100.0 / (pageArea * (pageAreas.size() - 1)));
+}
+
+static void benchSkyline(const char *szName, const std::vector<sRect> &rects)
+{
+    std::vector<SEGSkyline> pages(1);
+    initSkyline(&pages[0], 1024, 1024);
+    double start = getSeconds();
+    for (size_t i = 0; i < rects.size(); ++i)
+    {
+        uint32_t x, y;
+        size_t page = 0;
+        while (page < pages.size() && !skylineInsert(&pages[page], rects[i].w, rects[i].h, &x, &y)) ++page;
+        if (page == pages.size())
+        {
+            pages.push_back(SEGSkyline());
+            initSkyline(&pages.back(), 1024, 1024);
+            int bInserted = skylineInsert(&pages.back(), rects[i].w, rects[i].h, &x, &y);
+            assert(bInserted);
+        }
+    }
+    double seconds = getSeconds() - start;
+    std::vector<uint64_t> pageAreas;
+    for (size_t i = 0; i < pages.size(); ++i)
+    {
+        pageAreas.push_back(pages[i].usedArea);
+        destroySkyline(&pages[i]);
+    }
+    printOccupancy(szName, seconds, rects.size(), pageAreas);
+}
+
+// Rows as tall as their tallest rectangle, filled left to right
+static void benchShelf(const std::vector<sRect> &rects)
+{
+    std::vector<uint64_t> pageAreas(1, 0);
+    uint32_t x = 0, y = 0, shelfH = 0;
+    double start = getSeconds();
+    for (size_t i = 0; i < rects.size(); ++i)
+    {
+        if (x + rects[i].w > 1024)
+        {
+            y += shelfH;
+            x = shelfH = 0;
+        }
+        if (y + rects[i].h > 1024)
+        {
+            pageAreas.push_back(0);
+            x = y = shelfH = 0;
+        }
+        x += rects[i].w;
+        if (rects[i].h > shelfH) shelfH = rects[i].h;
+        pageAreas.back() += rects[i].w * rects[i].h;
+    }
+    printOccupancy("shelf", getSeconds() - start, rects.size(), pageAreas);
+}
+
+int main()
+{
+    sRandom random;
+    std::vector<sRect> rects(20000);
+    for (size_t i = 0; i < rects.size(); ++i)
+    {
+        rects[i].w = 8 + random.next() % 57;
+        rects[i].h = 8 + random.next() % 57;
+    }
+    benchSkyline("skyline", rects);
+    std::vector<sRect> sorted = rects;
+    std::stable_sort(sorted.begin(), sorted.end(), isTaller);
+    benchSkyline("skyline, tallest first", sorted);
+    benchShelf(rects);
+    return 0;
+}
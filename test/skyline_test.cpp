@@ -0,0 +1,96 @@
+// Skyline packer: placed rectangles stay inside the page and never overlap,
+// sizes that can't fit are refused, and a reset page packs the same again.
+
+#include "test.h"
+extern "C" {
+#include "eg_skyline.h"
+}
+
+struct sPlaced
+{
+    uint32_t x, y, w, h;
+};
+
+// Inserts until the first failure, marking every texel of the page
+static std::vector<sPlaced> fill(SEGSkyline *pSkyline, sRandom &random, uint32_t minSize, uint32_t maxSize)
+{
+    std::vector<uint8_t> used(pSkyline->w * pSkyline->h, 0);
+    std::vector<sPlaced> placed;
+    uint64_t area = 0;
+    for (;;)
+    {
+        sPlaced rect;
+        rect.w = minSize + random.next() % (maxSize - minSize + 1);
+        rect.h = minSize + random.next() % (maxSize - minSize + 1);
+        if (!skylineInsert(pSkyline, rect.w, rect.h, &rect.x, &rect.y)) break;
+        assert(rect.x + rect.w <= pSkyline->w && rect.y + rect.h <= pSkyline->h);
+        for (uint32_t y = rect.y; y < rect.y + rect.h; ++y)
+        {
+            for (uint32_t x = rect.x; x < rect.x + rect.w; ++x)
+            {
+                assert(!used[y * pSkyline->w + x]);
+                used[y * pSkyline->w + x] = 1;
+            }
+        }
+        placed.push_back(rect);
+        area += (uint64_t)rect.w * rect.h;
+    }
+    assert(pSkyline->usedArea == area);
+    return placed;
+}
+
+static bool samePlacements(const std::vector<sPlaced> &a, const std::vector<sPlaced> &b)
+{
+    return a.size() == b.size() && !memcmp(a.data(), b.data(), a.size() * sizeof(sPlaced));
+}
+
+int main()
+{
+    SEGSkyline skyline;
+    initSkyline(&skyline, 1024, 1024);
+    uint32_t x, y;
+    assert(!skylineInsert(&skyline, 0, 10, &x, &y) && !skylineInsert(&skyline, 10, 0, &x, &y));
+    assert(!skylineInsert(&skyline, 1025, 1, &x, &y) && !skylineInsert(&skyline, 1, 1025, &x, &y));
+    assert(skyline.usedArea == 0);
+
+    // A page exactly full of squares, the first one is bottom left
+    SEGSkyline squares;
+    initSkyline(&squares, 256, 256);
+    for (int i = 0; i < 16; ++i)
+    {
+        assert(skylineInsert(&squares, 64, 64, &x, &y));
+        if (i == 0) assert(x == 0 && y == 0);
+    }
+    assert(squares.usedArea == 256 * 256 && squares.nodeCount == 1);
+    assert(!skylineInsert(&squares, 1, 1, &x, &y));
+    resetSkyline(&squares);
+    assert(squares.usedArea == 0 && skylineInsert(&squares, 256, 256, &x, &y) && x == 0 && y == 0);
+    destroySkyline(&squares);
+    printf("exact fit: passed\n");
+
+    // Random pages, then the same again after a reset
+    for (int page = 0; page < 4; ++page)
+    {
+        sRandom random(page + 1);
+        resetSkyline(&skyline);
+        std::vector<sPlaced> first = fill(&skyline, random, 8, 64);
+        random = sRandom(page + 1);
+        resetSkyline(&skyline);
+        std::vector<sPlaced> second = fill(&skyline, random, 8, 64);
+        assert(samePlacements(first, second));
+        assert(first.size() > 500);
+    }
+    printf("random pages: passed\n");
+
+    // Narrow columns of alternating heights grow the node array past its
+    // first 16 nodes
+    resetSkyline(&skyline);
+    sRandom random;
+    std::vector<sPlaced> columns = fill(&skyline, random, 1, 3);
+    assert(skyline.nodeCapacity > 16 && columns.size() > 1000);
+    printf("node growth: passed\n");
+    destroySkyline(&skyline);
+
+    printf("skyline_test: passed\n");
+    return 0;
+}
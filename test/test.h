@@ -0,0 +1,64 @@
+#pragma once
+
+// Shared by the tests and benchmarks. They run from the repository root, so
+// the sample PNGs are opened by name like main.cpp does.
+
+// The checks are asserts, they must stay in optimized builds
+#undef NDEBUG
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include "LodePNG.h"
+
+static const char *szRepoPNGs[] = {
+    "alphatest.png", "d01.png", "d02.png", "m01.png", "m02.png",
+    "n01.png", "n02.png", "ogre_dif.png", "ogre_hammer_dif.png",
+    "ogre_hammer_normal.png", "ogre_hammer_spec.png",
+    "ogre_normal.png", "ogre_spec.png", "stone.png"};
+static const int repoPNGCount = sizeof(szRepoPNGs) / sizeof(szRepoPNGs[0]);
+
+inline double getSeconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// RGBA8 pixels of a PNG, asserts if it can't be decoded
+inline std::vector<unsigned char> loadPNG(const char *szFilename, unsigned int *pWidth, unsigned int *pHeight)
+{
+    std::vector<unsigned char> image;
+    unsigned int error = lodepng::decode(image, *pWidth, *pHeight, szFilename);
+    if (error) printf("%s: %s\n", szFilename, lodepng_error_text(error));
+    assert(error == 0);
+    return image;
+}
+
+// Deterministic random numbers, so that a failure can be reproduced
+struct sRandom
+{
+    unsigned long long state;
+
+    explicit sRandom(unsigned long long seed = 1) : state(seed * 0x9e3779b97f4a7c15ull + 1) {}
+
+    unsigned int next()
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return (unsigned int)(state >> 32);
+    }
+};
+
+// The font for the dfr tests, DFR_FONT or DejaVu Sans where Linux puts it
+inline const char *getTestFont()
+{
+    const char *szFont = getenv("DFR_FONT");
+    if (!szFont) szFont = "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf";
+    FILE *pFile = fopen(szFont, "rb");
+    if (!pFile) printf("%s not found, set DFR_FONT to a .ttf file\n", szFont);
+    assert(pFile);
+    fclose(pFile);
+    return szFont;
+}
@@ -0,0 +1,94 @@
+// parallelFor, callOnce and the worker pool. parallelFor must cover every
+// item once, and run inline on pool threads so that loader jobs don't each
+// start a thread per core. callOnce must run its function once when many
+// threads race for it.
+
+#include <pthread.h>
+#include "test.h"
+extern "C" {
+#include "eg_thread.h"
+}
+
+struct sCoverage
+{
+    std::vector<int> counts;
+    SEGMutex *pMutex;
+    std::vector<pthread_t> threads;
+};
+
+static void countRange(void *pData, uint32_t begin, uint32_t end)
+{
+    sCoverage *pCoverage = (sCoverage *)pData;
+    lockMutex(pCoverage->pMutex);
+    for (uint32_t i = begin; i < end; ++i) ++pCoverage->counts[i];
+    pCoverage->threads.push_back(pthread_self());
+    unlockMutex(pCoverage->pMutex);
+}
+
+static void checkCoverage(uint32_t count, uint32_t minBatch)
+{
+    sCoverage coverage;
+    coverage.counts.resize(count);
+    coverage.pMutex = createMutex();
+    parallelFor(count, minBatch, countRange, &coverage);
+    for (uint32_t i = 0; i < count; ++i) assert(coverage.counts[i] == 1);
+    destroyMutex(coverage.pMutex);
+}
+
+static void parallelForJob(void *pData)
+{
+    sCoverage *pCoverage = (sCoverage *)pData;
+    parallelFor((uint32_t)pCoverage->counts.size(), 1, countRange, pCoverage);
+
+    // Every range ran on this pool thread
+    for (size_t i = 0; i < pCoverage->threads.size(); ++i) assert(pthread_equal(pCoverage->threads[i], pthread_self()));
+}
+
+static int onceCallCount = 0;
+static EGOnce once = EG_ONCE_INIT;
+
+static void initOnce()
+{
+    ++onceCallCount;
+}
+
+static void callOnceJob(void *pData)
+{
+    callOnce(&once, initOnce);
+    assert(onceCallCount == 1);
+}
+
+int main()
+{
+    assert(getHardwareThreadCount() >= 1);
+
+    checkCoverage(0, 1);
+    checkCoverage(1, 1);
+    checkCoverage(1000, 1);
+    checkCoverage(1000, 32);
+    checkCoverage(31, 32);
+
+    SEGWorkerPool *pPool = createWorkerPool(4);
+    assert(pPool && getWorkerCount(pPool) == 4);
+
+    sCoverage coverages[8];
+    for (int i = 0; i < 8; ++i)
+    {
+        coverages[i].counts.resize(1000);
+        coverages[i].pMutex = createMutex();
+        pushJob(pPool, parallelForJob, coverages + i);
+    }
+    for (int i = 0; i < 64; ++i) pushJob(pPool, callOnceJob, NULL);
+    waitWorkerPool(pPool);
+
+    for (int i = 0; i < 8; ++i)
+    {
+        for (size_t j = 0; j < coverages[i].counts.size(); ++j) assert(coverages[i].counts[j] == 1);
+        destroyMutex(coverages[i].pMutex);
+    }
+    assert(onceCallCount == 1);
+
+    destroyWorkerPool(pPool);
+    printf("thread_test: passed\n");
+    return 0;
+}